@@ -8,6 +8,18 @@ typedef enum {
 	CTWindowOpenDispositionNewBackgroundTab,
 } CTWindowOpenDisposition;
 
+// Estimated memory use, in bytes, of a set of tabs.
+typedef struct {
+	// What the tabs' contents report with |estimatedMemoryUsage|.
+	NSUInteger contents;
+	// What the framework keeps for the tabs: tab and contents controllers,
+	// views, icons and recently closed tabs.
+	NSUInteger framework;
+	// The number of tabs, and of those that are not placeholders.
+	NSUInteger tabCount;
+	NSUInteger loadedTabCount;
+} CTMemoryUsage;
+
 @class CTTabStripModel;
 @class CTBrowserWindowController;
 @class CTTabContentsController;
@@ -54,6 +66,31 @@ typedef enum {
 // @autoreleased
 - (CTTabContents*)createBlankTabBasedOn:(CTTabContents*)baseContents;
 
+// Create the real contents of |placeholder|, a tab created with
+// |-[CTTabContents initPlaceholderWithTitle:icon:]| that is about to become
+// the active tab for the first time. Whatever the new contents leave unset of
+// the placeholder's title and icon, and its opener, carry over. The default
+// calls |createBlankTabBasedOn:| with nil. Returning nil keeps the
+// placeholder.
+// @autoreleased
+- (CTTabContents*)createTabContentsForPlaceholder:(CTTabContents*)placeholder;
+
+// Create the placeholder that takes the place of |contents| when its tab is
+// discarded. The default carries over the title, icon and app state; a
+// subclass can return a placeholder of its own class that also remembers
+// what |createTabContentsForPlaceholder:| needs to bring the tab back.
+// @autoreleased
+- (CTTabContents*)createPlaceholderForTabContents:(CTTabContents*)contents;
+
+// Returns NO if the tab at |index| must not be discarded. Active, pinned,
+// blocked, loading and teared tabs, and placeholders, are never discarded.
+// Subclasses can exempt more, like tabs that play audio.
+- (BOOL)canDiscardTabAtIndex:(int)index;
+
+// Turns the tab at |index| back into a placeholder, freeing its contents and
+// their view. Returns NO if |canDiscardTabAtIndex:| says no.
+- (BOOL)discardTabAtIndex:(int)index;
+
 // Add blank tab
 - (CTTabContents*)addBlankTabAtIndex:(int)index 
 						inForeground:(BOOL)foreground;
@@ -113,4 +150,83 @@ typedef enum {
 - (void)closeTabAtIndex:(int)index makeHistory:(BOOL)makeHistory;
 - (void)closeAllTabs;
 
+// Memory accounting
+//
+// These walk the tabs once and only ask for cached numbers, so they are cheap
+// enough to poll every second.
+
+// The estimated memory use of the tab at |index|, contents and framework
+// overhead together.
+- (NSUInteger)memoryUsageOfTabAtIndex:(int)index;
+
+// The estimated memory use of all the tabs of this browser.
+- (CTMemoryUsage)memoryUsage;
+
+// The totals of |memoryUsage| over |browsers|.
++ (CTMemoryUsage)memoryUsageOfBrowsers:(NSArray*)browsers;
+
+// The totals of |memoryUsage| over the browsers of every window of the
+// application.
++ (CTMemoryUsage)memoryUsageOfAllBrowsers;
+
+// Closed tabs
+//
+// Tabs closed with CLOSE_CREATE_HISTORICAL_TAB are remembered so that
+// |restoreTab| can reopen them, newest first. Only a serialized entry is
+// kept, never the CTTabContents itself.
+
+// How many bytes of closed-tab entries are kept in memory. Older entries go
+// to a temporary file. Defaults to 256 KB; takes effect when the first tab is
+// closed.
+@property(assign, nonatomic) NSUInteger historicalTabMemoryBudget;
+
+// How many bytes of older closed-tab entries the temporary file keeps. The
+// oldest are dropped beyond that. Defaults to 16 MB; takes effect when the
+// first tab is closed.
+@property(assign, nonatomic) NSUInteger historicalTabDiskBudget;
+
+// Returns whatever a subclass needs to recreate |contents| later, like the
+// URL it shows. The title, pinned/app/blocked state and position are saved
+// in any case. The default returns nil.
+- (NSData*)historicalStateOfTabContents:(CTTabContents*)contents;
+
+// Creates the contents of a reopened tab from what
+// |historicalStateOfTabContents:| returned (nil if it returned nil). The
+// default ignores |state| and calls |createBlankTabBasedOn:|.
+// @autoreleased
+- (CTTabContents*)createTabContentsWithHistoricalState:(NSData*)state
+											   basedOn:(CTTabContents*)baseContents;
+
+// Sessions
+//
+// A session snapshot records, for each browser, the order of its tabs, their
+// pinned/app/blocked flags, opener links and titles, and which tab is active.
+// See CTSessionSnapshot.h for the format.
+
+// Writes a snapshot of the tab strips of |browsers| to |path|, replacing any
+// previous one atomically. Returns NO on failure.
++ (BOOL)saveSessionOfBrowsers:(NSArray*)browsers toFile:(NSString*)path;
+
+// Memory maps the snapshot at |path| and restores it with
+// |restoreSessionFromData:|. Returns nil if there is no readable snapshot at
+// |path|.
++ (NSArray*)restoreSessionFromFile:(NSString*)path;
+
+// Creates one browser, with a window controller, per window in the snapshot
+// in |data|. The windows are not shown. Returns nil if |data| is not a
+// snapshot.
+//
+// Only the active tab of each window is created with
+// |createBlankTabBasedOn:|; the others are deferred tabs with no contents at
+// all. Each gets a placeholder, decoded from |data|, only once the tab strip
+// lays it out or something else needs its contents, and real contents from
+// |createTabContentsForPlaceholder:| when it is first selected.
++ (NSArray*)restoreSessionFromData:(NSData*)data;
+
+// Adds a window with the tabs of this browser to |writer|.
+- (void)appendToSessionSnapshot:(struct CTSessionSnapshotWriter*)writer;
+
+// The kCTSessionTab flags (see CTSessionSnapshot.h) of the tab at |index|.
+- (uint32_t)sessionFlagsOfTabAtIndex:(int)index;
+
 @end
@@ -8,15 +8,79 @@
 #import "CTTabContentsController.h"
 #import "CTToolbarController.h"
 #import "CTUtil.h"
+#import "CTSessionSnapshot.h"
+#import "CTClosedTabStore.h"
+
+// A serialized closed tab: this header, then the title (UTF-8) and the state
+// from |historicalStateOfTabContents:|.
+typedef struct {
+	uint32_t flags;  // kCTSessionTab flags
+	int32_t index;
+	uint32_t titleLength;
+	uint32_t stateLength;
+} CTHistoricalTabHeader;
+
+// Rough sizes of what the framework keeps for a tab: the tab's controller and
+// view in the strip and its contents controller, and the view of a loaded
+// tab's contents.
+static const NSUInteger kTabFrameworkMemoryUsage = 4 * 1024;
+static const NSUInteger kContentsViewMemoryUsage = 16 * 1024;
+
+@interface CTBrowser (PrivateMethods)
+// The serial background queue the closed tab stores of all browsers are used
+// on. Separate from |+[CTSessionRecorder writeQueue]|, whose journal syncs
+// would otherwise hold up reopening a tab.
++ (dispatch_queue_t)closedTabQueue;
+// Fills the (empty) tab strip with the tabs of |window| in |snapshot|, which
+// reads the bytes of |data|. All but the active tab are left deferred.
+- (void)restoreTabsOfWindow:(uint32_t)window
+		 fromSessionSnapshot:(const CTSessionSnapshot*)snapshot
+					   data:(NSData*)data;
+// Pushes an entry for the tab at |index|, with |state|, onto |closedTabs_|.
+- (void)createHistoricalTabAtIndex:(int)index state:(NSData*)state;
+// Reopens the closed tab |entry|, which |restoreTab| popped, and frees it.
+- (void)restoreTabFromEntry:(uint8_t*)entry length:(size_t)length;
+// Takes in what the closed tab store had after |operation|, unless a later
+// operation already reported.
+- (void)closedTabsDidChangeWithOperation:(NSUInteger)operation
+								   count:(size_t)count
+							  memoryUsed:(size_t)memoryUsed;
+@end
 
 @implementation CTBrowser {
 	CTTabStripModel *tabStripModel_;
 	
 	CTBrowserWindowController* windowController_;
+	
+	// Recently closed tabs, created when the first one is closed. Once
+	// created it is only used on |closedTabQueue|, so spilling closed tabs to
+	// disk never holds up the main thread, and reopening one never waits for
+	// the session files to be written.
+	CTClosedTabStore* closedTabs_;
+	NSUInteger historicalTabMemoryBudget_;
+	NSUInteger historicalTabDiskBudget_;
+	// What the main thread knows of |closedTabs_|: the number of operations
+	// handed to the queue, the last one to report and what it reported, and
+	// the pushes and pops that haven't reported yet.
+	NSUInteger closedTabOperations_;
+	NSUInteger lastReportedClosedTabOperation_;
+	size_t closedTabCount_;
+	size_t closedTabMemoryUsed_;
+	NSUInteger pendingClosedTabs_;
+	NSUInteger pendingRestoredTabs_;
+	
+	// The session snapshot this browser's window was restored from, and its
+	// window in it. The tabs that are still deferred are decoded from it,
+	// keyed by their index in that window, when the model first needs them.
+	NSData* restoredSessionData_;
+	CTSessionSnapshot restoredSession_;
+	uint32_t restoredWindow_;
 }
 
 @synthesize windowController = windowController_;
 @synthesize tabStripModel = tabStripModel_;
+@synthesize historicalTabMemoryBudget = historicalTabMemoryBudget_;
+@synthesize historicalTabDiskBudget = historicalTabDiskBudget_;
 
 
 + (CTBrowser*)browser {
@@ -39,10 +103,31 @@
 - (id)init {
 	if ((self = [super init])) {
 		tabStripModel_ = [[CTTabStripModel alloc] initWithDelegate:self];
+		historicalTabMemoryBudget_ = 256 * 1024;
+		historicalTabDiskBudget_ = 16 * 1024 * 1024;
 	}
 	return self;
 }
 
++ (dispatch_queue_t)closedTabQueue {
+	static dispatch_queue_t queue;
+	static dispatch_once_t once;
+	dispatch_once(&once, ^{
+		queue = dispatch_queue_create("chromium-tabs.closed-tabs", DISPATCH_QUEUE_SERIAL);
+	});
+	return queue;
+}
+
+- (void)dealloc {
+	// After whatever is still queued for it.
+	CTClosedTabStore* closedTabs = closedTabs_;
+	if (closedTabs) {
+		dispatch_async([CTBrowser closedTabQueue], ^{
+			CTClosedTabStoreFree(closedTabs);
+		});
+	}
+}
+
 - (CTToolbarController *)createToolbarController {
 	// subclasses could override this -- returning nil means no toolbar
 	NSBundle *bundle = [CTUtil bundleForResource:@"Toolbar" ofType:@"nib"];
@@ -130,6 +215,225 @@
 	[tabStripModel_ closeAllTabs];
 }
 
+#pragma mark -
+#pragma mark Memory accounting
+
+// Adds the memory use of |contents| to |usage|.
+static void CTAddMemoryUsageOfTabContents(CTMemoryUsage* usage,
+										  CTTabContents* contents) {
+	usage->tabCount++;
+	usage->framework += kTabFrameworkMemoryUsage + contents.iconMemoryUsage;
+	if (contents.isPlaceholder)
+		return;
+	usage->loadedTabCount++;
+	usage->contents += contents.estimatedMemoryUsage;
+	if (contents.view)
+		usage->framework += kContentsViewMemoryUsage;
+}
+
+- (NSUInteger)memoryUsageOfTabAtIndex:(int)index {
+	// Deferred tabs don't have anything yet.
+	if ([tabStripModel_ isTabDeferredAtIndex:index])
+		return 0;
+	CTMemoryUsage usage = {0};
+	CTAddMemoryUsageOfTabContents(&usage, [tabStripModel_ tabContentsAtIndex:index]);
+	return usage.contents + usage.framework;
+}
+
+- (CTMemoryUsage)memoryUsage {
+	CTMemoryUsage usage = {0};
+	int count = [tabStripModel_ count];
+	for (int i = 0; i < count; ++i) {
+		if ([tabStripModel_ isTabDeferredAtIndex:i])
+			usage.tabCount++;
+		else
+			CTAddMemoryUsageOfTabContents(&usage, [tabStripModel_ tabContentsAtIndex:i]);
+	}
+	usage.framework += closedTabMemoryUsed_;
+	return usage;
+}
+
++ (CTMemoryUsage)memoryUsageOfBrowsers:(NSArray*)browsers {
+	CTMemoryUsage total = {0};
+	for (CTBrowser* browser in browsers) {
+		CTMemoryUsage usage = [browser memoryUsage];
+		total.contents += usage.contents;
+		total.framework += usage.framework;
+		total.tabCount += usage.tabCount;
+		total.loadedTabCount += usage.loadedTabCount;
+	}
+	return total;
+}
+
++ (CTMemoryUsage)memoryUsageOfAllBrowsers {
+	NSMutableArray* browsers = [NSMutableArray array];
+	for (NSWindow* window in [NSApp windows]) {
+		// Not |browserWindowControllerForWindow:|, which would count a
+		// browser again for each of its child windows.
+		id controller = [window windowController];
+		if ([controller isKindOfClass:[CTBrowserWindowController class]] &&
+			[controller browser]) {
+			[browsers addObject:[controller browser]];
+		}
+	}
+	return [self memoryUsageOfBrowsers:browsers];
+}
+
+#pragma mark -
+#pragma mark Sessions
+
++ (BOOL)saveSessionOfBrowsers:(NSArray*)browsers toFile:(NSString*)path {
+	CTSessionSnapshotWriter* writer = CTSessionSnapshotWriterCreate();
+	for (CTBrowser* browser in browsers)
+		[browser appendToSessionSnapshot:writer];
+	BOOL saved = CTSessionSnapshotWriterWriteToFile(writer,
+													[path fileSystemRepresentation]);
+	CTSessionSnapshotWriterFree(writer);
+	return saved;
+}
+
+- (uint32_t)sessionFlagsOfTabAtIndex:(int)index {
+	uint32_t flags = 0;
+	if ([tabStripModel_ isTabPinnedAtIndex:index])
+		flags |= kCTSessionTabPinned;
+	if ([tabStripModel_ isAppTabAtIndex:index])
+		flags |= kCTSessionTabApp;
+	if ([tabStripModel_ isTabBlockedAtIndex:index])
+		flags |= kCTSessionTabBlocked;
+	return flags;
+}
+
+- (void)appendToSessionSnapshot:(struct CTSessionSnapshotWriter*)writer {
+	int count = [tabStripModel_ count];
+	int activeIndex = tabStripModel_.activeIndex;
+	CTSessionSnapshotWriterBeginWindow(writer,
+		[tabStripModel_ containsIndex:activeIndex] ? activeIndex : -1);
+	for (int i = 0; i < count; ++i) {
+		// Neither creates the contents of deferred tabs.
+		int openerIndex = [tabStripModel_ indexOfOpenerOfTabAtIndex:i];
+		NSData* title = [[tabStripModel_ titleOfTabAtIndex:i]
+						 dataUsingEncoding:NSUTF8StringEncoding];
+		CTSessionSnapshotWriterAddTab(writer, [self sessionFlagsOfTabAtIndex:i],
+									  openerIndex == kNoTab ? -1 : openerIndex,
+									  (const char*)[title bytes], [title length]);
+	}
+}
+
++ (NSArray*)restoreSessionFromFile:(NSString*)path {
+	// Mapped, so only the pages of the tabs that are actually decoded are
+	// ever read from disk.
+	NSData* data = [NSData dataWithContentsOfFile:path
+										  options:NSDataReadingMappedAlways
+											error:NULL];
+	if (!data) {
+		DLOG("[ChromiumTabs] no session snapshot at %@", path);
+		return nil;
+	}
+	return [self restoreSessionFromData:data];
+}
+
++ (NSArray*)restoreSessionFromData:(NSData*)data {
+	CTSessionSnapshot snapshot;
+	if (!CTSessionSnapshotInit(&snapshot, [data bytes], [data length])) {
+		DLOG("[ChromiumTabs] not a session snapshot");
+		return nil;
+	}
+	uint32_t windowCount = CTSessionSnapshotWindowCount(&snapshot);
+	NSMutableArray* browsers = [NSMutableArray arrayWithCapacity:windowCount];
+	for (uint32_t window = 0; window < windowCount; ++window) {
+		CTBrowser* browser = [self browser];
+		browser.windowController =
+			[[CTBrowserWindowController alloc] initWithBrowser:browser];
+		[browser restoreTabsOfWindow:window
+				 fromSessionSnapshot:&snapshot
+								data:data];
+		[browsers addObject:browser];
+	}
+	return browsers;
+}
+
+- (void)restoreTabsOfWindow:(uint32_t)window
+		 fromSessionSnapshot:(const CTSessionSnapshot*)snapshot
+					   data:(NSData*)data {
+	const CTSessionSnapshotWindowRecord* windowRecord =
+		CTSessionSnapshotGetWindow(snapshot, window);
+	int count = (int)windowRecord->tabCount;
+	restoredSessionData_ = data;
+	restoredSession_ = *snapshot;
+	restoredWindow_ = window;
+	// Where each tab of the snapshot ended up, or -1 if it was damaged and
+	// skipped, so the opener links of the others still line up.
+	int* indices = malloc(MAX(count, 1) * sizeof(int));
+	int* openers = malloc(MAX(count, 1) * sizeof(int));
+	
+	// Only the active tab gets contents now. The others are deferred: the
+	// model gets their contents, placeholders decoded from |data|, through
+	// |tabContentsForDeferredTabWithKey:| once the tab strip lays them out or
+	// they are selected, so restoring doesn't allocate anything per tab.
+	[tabStripModel_ beginUpdates];
+	for (int i = 0; i < count; ++i) {
+		const CTSessionSnapshotTabRecord* record;
+		const char* title;
+		indices[i] = -1;
+		openers[i] = -1;
+		if (!CTSessionSnapshotGetTab(snapshot, window, i, &record, &title)) {
+			DLOG("[ChromiumTabs] skipping damaged tab %d of window %u", i, window);
+			continue;
+		}
+		int addTypes = ADD_FORCE_INDEX;
+		if (record->flags & kCTSessionTabPinned)
+			addTypes |= ADD_PINNED;
+		BOOL isApp = (record->flags & kCTSessionTabApp) != 0;
+		int index = [tabStripModel_ constrainInsertionIndex:[tabStripModel_ count]
+													miniTab:isApp || (addTypes & ADD_PINNED)];
+		// Only a snapshot with mini-tabs after other tabs puts a tab in front
+		// of ones restored already.
+		if (index < (int)[tabStripModel_ count]) {
+			for (int j = 0; j < i; ++j) {
+				if (indices[j] >= index)
+					++indices[j];
+			}
+		}
+		if (i == windowRecord->activeIndex) {
+			CTTabContents* contents = [self createBlankTabBasedOn:nil];
+			contents.isApp = isApp;
+			[contents setTitleFromData:data
+								 range:NSMakeRange(title - (const char*)[data bytes],
+												   record->titleLength)];
+			[tabStripModel_ insertTabContents:contents
+									  atIndex:index
+								 withAddTypes:addTypes];
+		} else {
+			[tabStripModel_ insertDeferredTabWithKey:i
+											   isApp:isApp
+											 atIndex:index
+										withAddTypes:addTypes];
+		}
+		if (record->flags & kCTSessionTabBlocked)
+			[tabStripModel_ setTabAtIndex:index blocked:YES];
+		indices[i] = index;
+		openers[i] = record->opener;
+	}
+	
+	// Openers can come after the tabs they opened, so link them up last.
+	for (int i = 0; i < count; ++i) {
+		if (indices[i] < 0 || openers[i] < 0 || openers[i] >= count)
+			continue;
+		int opener = indices[openers[i]];
+		if (opener >= 0 && opener != indices[i])
+			[tabStripModel_ setOpenerOfTabAtIndex:indices[i] toTabAtIndex:opener];
+	}
+	
+	if (windowRecord->activeIndex >= 0 && windowRecord->activeIndex < count &&
+		indices[windowRecord->activeIndex] >= 0) {
+		[tabStripModel_ selectTabContentsAtIndex:indices[windowRecord->activeIndex]
+									 userGesture:NO];
+	}
+	free(openers);
+	free(indices);
+	[tabStripModel_ endUpdates];
+}
+
 #pragma mark -
 #pragma mark Callbacks
 
@@ -202,6 +506,86 @@
 	return [[CTTabContents alloc] initWithBaseTabContents:baseContents];
 }
 
+- (CTTabContents*)createTabContentsForPlaceholder:(CTTabContents*)placeholder {
+	return [self createBlankTabBasedOn:nil];
+}
+
+- (CTTabContents*)createPlaceholderForTabContents:(CTTabContents*)contents {
+	CTTabContents* placeholder =
+		[[CTTabContents alloc] initPlaceholderWithTitle:contents.title
+												   icon:contents.icon];
+	placeholder.isApp = contents.isApp;
+	return placeholder;
+}
+
+- (BOOL)canDiscardTabAtIndex:(int)index {
+	if (![tabStripModel_ containsIndex:index] ||
+		index == tabStripModel_.activeIndex ||
+		[tabStripModel_ isTabPinnedAtIndex:index] ||
+		[tabStripModel_ isTabBlockedAtIndex:index]) {
+		return NO;
+	}
+	CTTabContents* contents = [tabStripModel_ tabContentsAtIndex:index];
+	return !contents.isPlaceholder && !contents.isLoading && !contents.isTeared;
+}
+
+- (BOOL)discardTabAtIndex:(int)index {
+	if (![self canDiscardTabAtIndex:index])
+		return NO;
+	CTTabContents* contents = [tabStripModel_ tabContentsAtIndex:index];
+	CTTabContents* placeholder = [self createPlaceholderForTabContents:contents];
+	placeholder.parentOpener = contents.parentOpener;
+	[tabStripModel_ discardTabContentsAtIndex:index withPlaceholder:placeholder];
+	return YES;
+}
+
+// implementation conforms to CTTabStripModelDelegate
+- (CTTabContents*)tabContentsForPlaceholder:(CTTabContents*)placeholder {
+	CTTabContents* contents = [self createTabContentsForPlaceholder:placeholder];
+	if (!contents)
+		return nil;
+	if (!contents.title)
+		contents.title = placeholder.title;
+	if (!contents.icon)
+		contents.icon = placeholder.icon;
+	contents.isApp = placeholder.isApp;
+	contents.parentOpener = placeholder.parentOpener;
+	return contents;
+}
+
+// implementation conforms to CTTabStripModelDelegate
+- (CTTabContents*)tabContentsForDeferredTabWithKey:(NSUInteger)key {
+	// Restoring checked the record already.
+	const CTSessionSnapshotTabRecord* record;
+	const char* title;
+	BOOL found __attribute__((unused)) =
+		CTSessionSnapshotGetTab(&restoredSession_, restoredWindow_,
+								(uint32_t)key, &record, &title);
+	assert(found);
+	CTTabContents* contents =
+		[[CTTabContents alloc] initPlaceholderWithTitle:nil icon:nil];
+	contents.isApp = (record->flags & kCTSessionTabApp) != 0;
+	[contents setTitleFromData:restoredSessionData_
+						 range:NSMakeRange(title - (const char*)[restoredSessionData_ bytes],
+										   record->titleLength)];
+	// What its Inserted event would have done.
+	contents.browser = self;
+	return contents;
+}
+
+// implementation conforms to CTTabStripModelDelegate
+- (NSString*)titleOfDeferredTabWithKey:(NSUInteger)key {
+	const CTSessionSnapshotTabRecord* record;
+	const char* title;
+	BOOL found __attribute__((unused)) =
+		CTSessionSnapshotGetTab(&restoredSession_, restoredWindow_,
+								(uint32_t)key, &record, &title);
+	assert(found);
+	return [[NSString alloc] initWithBytes:title
+									length:record->titleLength
+								  encoding:NSUTF8StringEncoding];
+}
+
 // implementation conforms to CTTabStripModelDelegate
 - (CTTabContents*)addBlankTabAtIndex:(int)index 
 						inForeground:(BOOL)foreground {
@@ -221,8 +605,9 @@
 
 - (void)closeTab {
 	if ([self canCloseTab]) {
-		[tabStripModel_ closeTabContentsAtIndex:tabStripModel_.activeIndex 
-									 closeTypes:CLOSE_USER_GESTURE |
+		// Closes every selected tab, the active one included.
+		[tabStripModel_ closeTabContentsAtIndices:[tabStripModel_ selectedIndices]
+									   closeTypes:CLOSE_USER_GESTURE |
 		 CLOSE_CREATE_HISTORICAL_TAB];
 	}
 }
@@ -308,7 +693,10 @@
 		}
 		case CTBrowserCommandSelectLastTab:    [self selectLastTab]; break;
 		case CTBrowserCommandDuplicateTab:     [self duplicateTab]; break;
-			//case CTBrowserCommandRestoreTab:     break;
+		case CTBrowserCommandRestoreTab:
+			if ([self canRestoreTab])
+				[self restoreTab];
+			break;
 			//case CTBrowserCommandShowAsTab:      break;
 			//case CTBrowserCommandFullscreen:     DLOG("TODO ToggleFullscreenMode();"); break;
 		case CTBrowserCommandExit:             [NSApp terminate:self]; break;
@@ -354,6 +742,26 @@
 	return browser;
 }
 
+- (CTBrowser*)createNewStripWithTabContents:(NSArray*)contents
+                             pinnedIndices:(NSIndexSet*)pinnedIndices {
+	CTBrowser* browser = [self createNewBrowser];
+	CTTabStripModel* model = browser.tabStripModel;
+	// One transaction, so the new strip lays out once.
+	[model beginUpdates];
+	int index = 0;
+	for (CTTabContents* tabContents in contents) {
+		int addTypes = index == 0 ? ADD_ACTIVE : ADD_NONE;
+		if ([pinnedIndices containsIndex:index])
+			addTypes |= ADD_PINNED;
+		[model insertTabContents:tabContents atIndex:index withAddTypes:addTypes];
+		[browser loadingStateDidChange:tabContents];
+		++index;
+	}
+	[model endUpdates];
+	[browser.windowController showWindow:self];
+	return browser;
+}
+
 // Creates a new CTBrowser object and window containing the specified
 // |contents|, and continues a drag operation that began within the source
 // window's tab strip. |window_bounds| are the bounds of the source window in
@@ -387,7 +795,77 @@
 // Creates an entry in the historical tab database for the specified
 // CTTabContents.
 - (void)createHistoricalTab:(CTTabContents*)contents {
-	DLOG("[ChromiumTabs] TODO createHistoricalTab %@", contents);
+	int index = [tabStripModel_ indexOfTabContents:contents];
+	if (index == kNoTab)
+		return;
+	[self createHistoricalTabAtIndex:index
+							   state:[self historicalStateOfTabContents:contents]];
+}
+
+// A deferred tab only has what the session snapshot kept of it, so it is
+// reopened as a blank tab with its title.
+- (void)createHistoricalTabForDeferredTabAtIndex:(int)index {
+	[self createHistoricalTabAtIndex:index state:nil];
+}
+
+- (void)createHistoricalTabAtIndex:(int)index state:(NSData*)state {
+	if (!closedTabs_) {
+		NSString* spillPath = [NSTemporaryDirectory() stringByAppendingPathComponent:
+			[NSString stringWithFormat:@"ChromiumTabs-closed-%d-%p", getpid(), self]];
+		closedTabs_ = CTClosedTabStoreCreate(historicalTabMemoryBudget_,
+											 [spillPath fileSystemRepresentation],
+											 historicalTabDiskBudget_);
+	}
+	
+	NSData* title = [[tabStripModel_ titleOfTabAtIndex:index]
+					 dataUsingEncoding:NSUTF8StringEncoding];
+	CTHistoricalTabHeader header = {
+		.flags = [self sessionFlagsOfTabAtIndex:index],
+		.index = index,
+		.titleLength = (uint32_t)[title length],
+		.stateLength = (uint32_t)[state length],
+	};
+	NSMutableData* entry = [NSMutableData dataWithCapacity:
+		sizeof(header) + header.titleLength + header.stateLength];
+	[entry appendBytes:&header length:sizeof(header)];
+	[entry appendData:title];
+	[entry appendData:state];
+	
+	CTClosedTabStore* closedTabs = closedTabs_;
+	NSUInteger operation = ++closedTabOperations_;
+	++pendingClosedTabs_;
+	dispatch_async([CTBrowser closedTabQueue], ^{
+		BOOL pushed = CTClosedTabStorePush(closedTabs, [entry bytes], [entry length]);
+		size_t count = CTClosedTabStoreCount(closedTabs);
+		size_t memoryUsed = CTClosedTabStoreMemoryUsed(closedTabs);
+		dispatch_async(dispatch_get_main_queue(), ^{
+			if (!pushed)
+				DLOG("[ChromiumTabs] could not remember a closed tab");
+			--pendingClosedTabs_;
+			[self closedTabsDidChangeWithOperation:operation
+											 count:count
+										memoryUsed:memoryUsed];
+		});
+	});
+}
+
+- (void)closedTabsDidChangeWithOperation:(NSUInteger)operation
+								   count:(size_t)count
+							  memoryUsed:(size_t)memoryUsed {
+	if (operation < lastReportedClosedTabOperation_)
+		return;
+	lastReportedClosedTabOperation_ = operation;
+	closedTabCount_ = count;
+	closedTabMemoryUsed_ = memoryUsed;
+}
+
+- (NSData*)historicalStateOfTabContents:(CTTabContents*)contents {
+	return nil;
+}
+
+- (CTTabContents*)createTabContentsWithHistoricalState:(NSData*)state
+											   basedOn:(CTTabContents*)baseContents {
+	return [self createBlankTabBasedOn:baseContents];
 }
 
 // Runs any unload listeners associated with the specified CTTabContents before
@@ -401,11 +879,70 @@
 
 // Returns YES if a tab can be restored.
 - (BOOL)canRestoreTab {
-	return NO;
+	return closedTabCount_ + pendingClosedTabs_ > pendingRestoredTabs_;
 }
 
-// Restores the last closed tab if CanRestoreTab would return YES.
+// Restores the last closed tab if CanRestoreTab would return YES. The entry
+// may have been spilled to disk, so it is popped on |closedTabQueue| and the
+// tab is created once it is back on the main thread.
 - (void)restoreTab {
+	if (!closedTabs_)
+		return;
+	CTClosedTabStore* closedTabs = closedTabs_;
+	NSUInteger operation = ++closedTabOperations_;
+	++pendingRestoredTabs_;
+	dispatch_async([CTBrowser closedTabQueue], ^{
+		size_t length = 0;
+		uint8_t* entry = (uint8_t*)CTClosedTabStorePop(closedTabs, &length);
+		size_t count = CTClosedTabStoreCount(closedTabs);
+		size_t memoryUsed = CTClosedTabStoreMemoryUsed(closedTabs);
+		dispatch_async(dispatch_get_main_queue(), ^{
+			--pendingRestoredTabs_;
+			[self closedTabsDidChangeWithOperation:operation
+											 count:count
+										memoryUsed:memoryUsed];
+			if (entry)
+				[self restoreTabFromEntry:entry length:length];
+		});
+	});
+}
+
+- (void)restoreTabFromEntry:(uint8_t*)entry length:(size_t)length {
+	CTHistoricalTabHeader header;
+	if (length < sizeof(header)) {
+		free(entry);
+		return;
+	}
+	memcpy(&header, entry, sizeof(header));
+	if ((uint64_t)header.titleLength + header.stateLength > length - sizeof(header)) {
+		free(entry);
+		return;
+	}
+	const uint8_t* titleBytes = entry + sizeof(header);
+	NSString* title = [[NSString alloc] initWithBytes:titleBytes
+											   length:header.titleLength
+											 encoding:NSUTF8StringEncoding];
+	NSData* state = header.stateLength ?
+		[NSData dataWithBytes:titleBytes + header.titleLength
+					   length:header.stateLength] : nil;
+	free(entry);
+	
+	CTTabContents* contents =
+		[self createTabContentsWithHistoricalState:state
+										   basedOn:[tabStripModel_ activeTabContents]];
+	contents.title = title;
+	contents.isApp = (header.flags & kCTSessionTabApp) != 0;
+	int addTypes = ADD_ACTIVE | ADD_FORCE_INDEX;
+	if (header.flags & kCTSessionTabPinned)
+		addTypes |= ADD_PINNED;
+	int index = MIN(MAX(header.index, 0), [tabStripModel_ count]);
+	[tabStripModel_ insertTabContents:contents
+							  atIndex:index
+						 withAddTypes:addTypes];
+	if (header.flags & kCTSessionTabBlocked) {
+		[tabStripModel_ setTabAtIndex:[tabStripModel_ indexOfTabContents:contents]
+							  blocked:YES];
+	}
 }
 
 // Returns whether some contents can be closed.
@@ -20,6 +20,9 @@
 - (void)setBottomCornerRounded:(BOOL)y;
 @end
 
+@interface CTBrowserWindowController () <CTTabStripModelObserver>
+@end
+
 @interface CTBrowserWindowController (Private)
 - (CGFloat)layoutTabStripAtMaxY:(CGFloat)maxY
                           width:(CGFloat)width
@@ -186,35 +189,7 @@ static CTBrowserWindowController* _currentMain = nil; // weak
     [self enableBarVisibilityUpdates];
 	
 	// Observe tabs	
-	[[NSNotificationCenter defaultCenter] addObserver:self 
-											 selector:@selector(tabDidSelect:) 
-												 name:CTTabSelectedNotification 
-											   object:browser_.tabStripModel];
-	
-	[[NSNotificationCenter defaultCenter] addObserver:self 
-											 selector:@selector(tabDidInsert:) 
-												 name:CTTabInsertedNotification 
-											   object:browser_.tabStripModel];
-	
-	[[NSNotificationCenter defaultCenter] addObserver:self 
-											 selector:@selector(tabDidReplace:) 
-												 name:CTTabReplacedNotification 
-											   object:browser_.tabStripModel];
-	
-	[[NSNotificationCenter defaultCenter] addObserver:self 
-											 selector:@selector(tabDidDetach:) 
-												 name:CTTabDetachedNotification 
-											   object:browser_.tabStripModel];
-	
-	[[NSNotificationCenter defaultCenter] addObserver:self 
-											 selector:@selector(tabWillClose:) 
-												 name:CTTabClosingNotification 
-											   object:browser_.tabStripModel];
-	
-	[[NSNotificationCenter defaultCenter] addObserver:self 
-											 selector:@selector(tabStripDidBecomeEmpty) 
-												 name:CTTabStripEmptyNotification
-											   object:browser_.tabStripModel];
+	[browser_.tabStripModel addObserver:self];
 	
     // Register for application hide/unhide notifications.
     [[NSNotificationCenter defaultCenter] addObserver:self
@@ -268,6 +243,7 @@ static CTBrowserWindowController* _currentMain = nil; // weak
 	//[fullscreenController_ exitFullscreen]; // TODO
 	//fullscreenController_.reset();
 	
+	[browser_.tabStripModel removeObserver:self];
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
 }
 
@@ -1005,39 +981,31 @@ static CTBrowserWindowController* _currentMain = nil; // weak
 // doing things like restoring focus is not possible.
 
 // Note: this is called _before_ the view is on screen
-- (void)tabDidSelect:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *newContents = [userInfo valueForKey:CTTabNewContentsUserInfoKey];
-	CTTabContents *oldContents = [userInfo valueForKey:CTTabContentsUserInfoKey];
+- (void)tabSelectedWithContents:(CTTabContents *)newContents
+			   previousContents:(CTTabContents *)oldContents {
 	assert(newContents != oldContents);
 	[self updateToolbarWithContents:newContents
 				 shouldRestoreState:!!oldContents];
 }
 
-- (void)tabWillClose:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger index = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
+- (void)tabWillCloseWithContents:(CTTabContents *)contents
+						 atIndex:(NSInteger)index {
 	[contents tabWillCloseInBrowser:browser_ atIndex:index];
 	if (contents.isActive)
 		[self updateToolbarWithContents:nil shouldRestoreState:NO];
 }
 
-- (void)tabDidInsert:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger index = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
-	BOOL isInForeground = [[userInfo valueForKey:CTTabOptionsUserInfoKey] boolValue];
+- (void)tabInsertedWithContents:(CTTabContents *)contents
+						atIndex:(NSInteger)index
+				   inForeground:(BOOL)isInForeground {
 	[contents tabDidInsertIntoBrowser:browser_
 							  atIndex:index
 						 inForeground:isInForeground];
 }
 
-- (void)tabDidReplace:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *newContents = [userInfo valueForKey:CTTabNewContentsUserInfoKey];
-	CTTabContents *oldContents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger index = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
+- (void)tabReplacedWithContents:(CTTabContents *)newContents
+			   previousContents:(CTTabContents *)oldContents
+						atIndex:(NSInteger)index {
 	[newContents tabReplaced:oldContents inBrowser:browser_ atIndex:index];
 	if ([self activeTabIndex] == index) {
 		[self updateToolbarWithContents:newContents
@@ -1045,10 +1013,8 @@ static CTBrowserWindowController* _currentMain = nil; // weak
 	}
 }
 
-- (void)tabDidDetach:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger index = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
+- (void)tabDetachedWithContents:(CTTabContents *)contents
+						atIndex:(NSInteger)index {
 	[contents tabDidDetachFromBrowser:browser_ atIndex:index];
 	if (contents.isActive)
 		[self updateToolbarWithContents:nil shouldRestoreState:NO];
@@ -1057,6 +1023,47 @@ static CTBrowserWindowController* _currentMain = nil; // weak
 - (void)tabStripDidBecomeEmpty {
 	[self close];
 }
+
+- (void)tabStripModel:(CTTabStripModel *)model
+	  didReceiveEvent:(const CTTabStripModelEvent *)event {
+	switch (event->type) {
+		case CTTabStripModelEventSelected:
+			[self tabSelectedWithContents:event->contents
+						 previousContents:event->oldContents];
+			break;
+		case CTTabStripModelEventClosing:
+			[self tabWillCloseWithContents:event->contents atIndex:event->index];
+			break;
+		case CTTabStripModelEventInserted:
+			[self tabInsertedWithContents:event->contents
+								  atIndex:event->index
+							 inForeground:event->flag];
+			break;
+		case CTTabStripModelEventReplaced:
+			[self tabReplacedWithContents:event->contents
+						 previousContents:event->oldContents
+								  atIndex:event->index];
+			break;
+		case CTTabStripModelEventDetached:
+			[self tabDetachedWithContents:event->contents atIndex:event->index];
+			break;
+		case CTTabStripModelEventDetachedRange:
+			for (NSUInteger i = event->range.length; i-- > 0;) {
+				// Deferred tabs never had contents to tell.
+				id contents = [event->rangeContents objectAtIndex:i];
+				if (contents != [NSNull null]) {
+					[self tabDetachedWithContents:contents
+										  atIndex:event->range.location + i];
+				}
+			}
+			break;
+		case CTTabStripModelEventEmpty:
+			[self tabStripDidBecomeEmpty];
+			break;
+		default:
+			break;
+	}
+}
 @end
 
 #pragma mark -
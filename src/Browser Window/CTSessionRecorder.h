@@ -0,0 +1,65 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#pragma once
+
+#import <Foundation/Foundation.h>
+#import "CTTabStripModel.h"
+
+@class CTBrowser;
+
+// Keeps the session of a set of browsers on disk as it changes.
+//
+// Every mutation of the browsers' tab strips is encoded as a small record of
+// an append-only journal (see CTSessionJournal.h). Records are collected on
+// the main thread and written and synced in batches on a background queue,
+// so the main thread never waits for the disk. Once the journal has grown
+// past |compactionThreshold| records it is folded into a new session
+// snapshot and started over.
+//
+// The directory holds the snapshot ("Session") and the journal ("Session
+// Journal"). |sessionSnapshotFromDirectory:| replays the journal on top of
+// the snapshot, and the result can be restored with CTBrowser's
+// |restoreSessionFromData:|.
+@interface CTSessionRecorder : NSObject <CTTabStripModelObserver>
+
+// Starts recording into |directory|, which must exist, by compacting
+// |browsers| into a new snapshot there.
+- (id)initWithDirectory:(NSString*)directory browsers:(NSArray*)browsers;
+
+// Starts or stops recording a browser, as its window opens and closes. A
+// browser whose tab strip model is deleted is removed automatically.
+- (void)addBrowser:(CTBrowser*)browser;
+- (void)removeBrowser:(CTBrowser*)browser;
+
+// Hands the records collected so far to the background queue now instead of
+// when the current batch is due.
+- (void)flush;
+
+// Writes a new snapshot of all the browsers and starts a new journal.
+- (void)compact;
+
+// Flushes and waits for everything handed to the background queue to be on
+// disk. Meant for application termination; this is the one call that blocks.
+- (void)waitUntilWritten;
+
+// The number of records after which the journal is compacted. Defaults to
+// 10000.
+@property (nonatomic) NSUInteger compactionThreshold;
+
+// How long records are collected before they are written. Defaults to one
+// second.
+@property (nonatomic) NSTimeInterval flushDelay;
+
+// The serial background queue session files are written on. Shared by every
+// recorder, so that their writes queue up behind each other instead of
+// competing for the disk.
++ (dispatch_queue_t)writeQueue;
+
+// Returns the snapshot in |directory| with the journal replayed on top of it,
+// or nil if there is no session there. When the journal is empty this is the
+// memory mapped snapshot itself.
++ (NSData*)sessionSnapshotFromDirectory:(NSString*)directory;
+
+@end
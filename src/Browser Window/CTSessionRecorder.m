@@ -0,0 +1,473 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#import "CTSessionRecorder.h"
+#import "CTBrowser.h"
+#import "CTTabContents.h"
+#import "CTSessionJournal.h"
+#import "CTSessionSnapshot.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+static NSString* const kSnapshotFileName = @"Session";
+static NSString* const kJournalFileName = @"Session Journal";
+
+// Writes all |length| bytes, retrying short writes.
+static BOOL CTWriteFully(int fd, const void* bytes, size_t length) {
+	const uint8_t* cursor = (const uint8_t*)bytes;
+	while (length) {
+		ssize_t written = write(fd, cursor, length);
+		if (written < 0)
+			return NO;
+		cursor += written;
+		length -= written;
+	}
+	return YES;
+}
+
+@interface CTSessionRecorder (PrivateMethods)
+// Appends a record to the current batch.
+- (void)appendRecord:(CTSessionJournalRecordType)type
+			  window:(uint32_t)window
+			   index:(int)index
+			argument:(int)argument
+			   flags:(uint32_t)flags
+			 payload:(NSData*)payload;
+// Records the tabs |browser| already has, as if they were inserted one by
+// one.
+- (void)appendTabsOfBrowser:(CTBrowser*)browser window:(uint32_t)window;
+// Returns the recorded browser whose model is |model| and sets |window| to
+// its window number, or returns nil.
+- (CTBrowser*)browserForModel:(CTTabStripModel*)model window:(uint32_t*)window;
+- (void)scheduleFlush;
+- (void)scheduleCompaction;
+
+// Only called on |queue_|.
+- (void)startJournalWithEpoch:(uint32_t)epoch;
+- (void)writeBatch:(NSData*)batch epoch:(uint32_t)epoch;
+@end
+
+@implementation CTSessionRecorder {
+	NSString* snapshotPath_;
+	NSString* journalPath_;
+
+	// The recorded browsers and, in the same order, the window numbers their
+	// records use. Compacting renumbers the windows in this order, which is
+	// the order the snapshot stores them in.
+	NSMutableArray* browsers_;
+	NSMutableArray* windows_;
+	uint32_t nextWindow_;
+
+	// The epoch of the journal records are being collected for.
+	uint32_t epoch_;
+	// Records not handed to |queue_| yet, and how many records there have been
+	// since the last compaction.
+	NSMutableData* pendingRecords_;
+	NSUInteger recordCount_;
+	BOOL flushScheduled_;
+	BOOL compactionScheduled_;
+	NSUInteger compactionThreshold_;
+	NSTimeInterval flushDelay_;
+
+	// All file I/O happens on this serial queue, |writeQueue|. The journal
+	// file, and the epoch of the journal in it, are only touched there.
+	dispatch_queue_t queue_;
+	int journalFile_;
+	uint32_t journalEpoch_;
+}
+
+@synthesize compactionThreshold = compactionThreshold_;
+@synthesize flushDelay = flushDelay_;
+
+- (id)initWithDirectory:(NSString*)directory browsers:(NSArray*)browsers {
+	if ((self = [super init])) {
+		snapshotPath_ = [directory stringByAppendingPathComponent:kSnapshotFileName];
+		journalPath_ = [directory stringByAppendingPathComponent:kJournalFileName];
+		browsers_ = [[NSMutableArray alloc] init];
+		windows_ = [[NSMutableArray alloc] init];
+		pendingRecords_ = [[NSMutableData alloc] init];
+		compactionThreshold_ = 10000;
+		flushDelay_ = 1.0;
+		queue_ = [CTSessionRecorder writeQueue];
+		journalFile_ = -1;
+
+		// Carry on from the epoch of the snapshot that is already there, so
+		// the journal that goes with it is never replayed onto ours.
+		NSData* existing = [NSData dataWithContentsOfFile:snapshotPath_
+												  options:NSDataReadingMappedAlways
+													error:NULL];
+		CTSessionSnapshot snapshot;
+		if (existing &&
+			CTSessionSnapshotInit(&snapshot, [existing bytes], [existing length])) {
+			epoch_ = snapshot.header->epoch;
+		}
+
+		for (CTBrowser* browser in browsers) {
+			[browsers_ addObject:browser];
+			[windows_ addObject:[NSNumber numberWithUnsignedInt:0]];
+			[browser.tabStripModel addObserver:self];
+		}
+		[self compact];
+	}
+	return self;
+}
+
++ (dispatch_queue_t)writeQueue {
+	static dispatch_queue_t queue;
+	static dispatch_once_t once;
+	dispatch_once(&once, ^{
+		queue = dispatch_queue_create("chromium-tabs.session", DISPATCH_QUEUE_SERIAL);
+	});
+	return queue;
+}
+
+- (void)dealloc {
+	for (CTBrowser* browser in browsers_)
+		[browser.tabStripModel removeObserver:self];
+	int journalFile = journalFile_;
+	if (journalFile >= 0) {
+		dispatch_async(queue_, ^{
+			close(journalFile);
+		});
+	}
+}
+
+- (void)addBrowser:(CTBrowser*)browser {
+	if ([browsers_ indexOfObjectIdenticalTo:browser] != NSNotFound)
+		return;
+	uint32_t window = nextWindow_++;
+	[browsers_ addObject:browser];
+	[windows_ addObject:[NSNumber numberWithUnsignedInt:window]];
+	[browser.tabStripModel addObserver:self];
+	[self appendRecord:kCTSessionJournalOpenWindow
+				window:window
+				 index:0
+			  argument:0
+				 flags:0
+			   payload:nil];
+	[self appendTabsOfBrowser:browser window:window];
+}
+
+- (void)removeBrowser:(CTBrowser*)browser {
+	NSUInteger position = [browsers_ indexOfObjectIdenticalTo:browser];
+	if (position == NSNotFound)
+		return;
+	uint32_t window = [[windows_ objectAtIndex:position] unsignedIntValue];
+	[browser.tabStripModel removeObserver:self];
+	[browsers_ removeObjectAtIndex:position];
+	[windows_ removeObjectAtIndex:position];
+	[self appendRecord:kCTSessionJournalCloseWindow
+				window:window
+				 index:0
+			  argument:0
+				 flags:0
+			   payload:nil];
+}
+
+- (void)appendTabsOfBrowser:(CTBrowser*)browser window:(uint32_t)window {
+	CTTabStripModel* model = browser.tabStripModel;
+	int count = [model count];
+	for (int i = 0; i < count; ++i) {
+		// Openers further along the strip aren't in the journal yet, so those
+		// links only come back with the next compaction. Neither the opener
+		// nor the title creates the contents of deferred tabs.
+		int openerIndex = [model indexOfOpenerOfTabAtIndex:i];
+		NSString* title = [model titleOfTabAtIndex:i];
+		[self appendRecord:kCTSessionJournalInsert
+					window:window
+					 index:i
+				  argument:openerIndex != kNoTab && openerIndex <= i ?
+							openerIndex : -1
+					 flags:[browser sessionFlagsOfTabAtIndex:i]
+				   payload:[title dataUsingEncoding:NSUTF8StringEncoding]];
+	}
+	if ([model containsIndex:model.activeIndex]) {
+		[self appendRecord:kCTSessionJournalSelect
+					window:window
+					 index:model.activeIndex
+				  argument:0
+					 flags:0
+				   payload:nil];
+	}
+}
+
+- (CTBrowser*)browserForModel:(CTTabStripModel*)model window:(uint32_t*)window {
+	NSUInteger count = [browsers_ count];
+	for (NSUInteger i = 0; i < count; ++i) {
+		CTBrowser* browser = [browsers_ objectAtIndex:i];
+		if (browser.tabStripModel == model) {
+			*window = [[windows_ objectAtIndex:i] unsignedIntValue];
+			return browser;
+		}
+	}
+	return nil;
+}
+
+#pragma mark -
+#pragma mark CTTabStripModelObserver
+
+- (void)tabStripModel:(CTTabStripModel*)model
+	  didReceiveEvent:(const CTTabStripModelEvent*)event {
+	uint32_t window;
+	CTBrowser* browser = [self browserForModel:model window:&window];
+	if (!browser)
+		return;
+	switch (event->type) {
+		case CTTabStripModelEventInserted: {
+			int opener = [model indexOfOpenerOfTabAtIndex:event->index];
+			[self appendRecord:kCTSessionJournalInsert
+						window:window
+						 index:event->index
+					  argument:opener == kNoTab ? -1 : opener
+						 flags:[browser sessionFlagsOfTabAtIndex:event->index]
+					   payload:[[model titleOfTabAtIndex:event->index]
+								dataUsingEncoding:NSUTF8StringEncoding]];
+			break;
+		}
+		case CTTabStripModelEventDetached:
+			[self appendRecord:kCTSessionJournalDetach
+						window:window
+						 index:event->index
+					  argument:1
+						 flags:0
+					   payload:nil];
+			break;
+		case CTTabStripModelEventDetachedRange:
+			[self appendRecord:kCTSessionJournalDetach
+						window:window
+						 index:event->range.location
+					  argument:event->range.length
+						 flags:0
+					   payload:nil];
+			break;
+		case CTTabStripModelEventMoved:
+			[self appendRecord:kCTSessionJournalMove
+						window:window
+						 index:event->index
+					  argument:event->toIndex
+						 flags:0
+					   payload:nil];
+			break;
+		case CTTabStripModelEventReordered: {
+			// CTTabStripModelEvent's permutation is an int per tab, like the
+			// record's.
+			int count = [model count];
+			[self appendRecord:kCTSessionJournalReorder
+						window:window
+						 index:0
+					  argument:count
+						 flags:0
+					   payload:[NSData dataWithBytes:event->permutation
+											  length:count * sizeof(int32_t)]];
+			break;
+		}
+		case CTTabStripModelEventReplaced:
+			[self appendRecord:kCTSessionJournalReplace
+						window:window
+						 index:event->index
+					  argument:0
+						 flags:0
+					   payload:[event->contents.title
+								dataUsingEncoding:NSUTF8StringEncoding]];
+			break;
+		case CTTabStripModelEventChanged:
+			if (event->changeType == CTTabChangeTypeLoadingOnly)
+				break;
+			[self appendRecord:kCTSessionJournalSetTitle
+						window:window
+						 index:event->index
+					  argument:0
+						 flags:0
+					   payload:[event->contents.title
+								dataUsingEncoding:NSUTF8StringEncoding]];
+			break;
+		case CTTabStripModelEventPinnedStateChanged:
+		case CTTabStripModelEventBlockedStateChanged:
+		case CTTabStripModelEventMiniStateChanged:
+			[self appendRecord:kCTSessionJournalSetFlags
+						window:window
+						 index:event->index
+					  argument:0
+						 flags:[browser sessionFlagsOfTabAtIndex:event->index]
+					   payload:nil];
+			break;
+		case CTTabStripModelEventSelected:
+			[self appendRecord:kCTSessionJournalSelect
+						window:window
+						 index:event->index
+					  argument:0
+						 flags:0
+					   payload:nil];
+			break;
+		case CTTabStripModelEventDeleted:
+			[self removeBrowser:browser];
+			break;
+		default:
+			break;
+	}
+}
+
+#pragma mark -
+#pragma mark Writing
+
+- (void)appendRecord:(CTSessionJournalRecordType)type
+			  window:(uint32_t)window
+			   index:(int)index
+			argument:(int)argument
+			   flags:(uint32_t)flags
+			 payload:(NSData*)payload {
+	uint32_t length = (uint32_t)[payload length];
+	NSUInteger offset = [pendingRecords_ length];
+	[pendingRecords_ increaseLengthBy:CTSessionJournalRecordSize(length)];
+	CTSessionJournalEncodeRecord((uint8_t*)[pendingRecords_ mutableBytes] + offset,
+								 type, window, index, argument, flags,
+								 [payload bytes], length);
+	if (++recordCount_ >= compactionThreshold_)
+		[self scheduleCompaction];
+	[self scheduleFlush];
+}
+
+- (void)scheduleFlush {
+	if (flushScheduled_)
+		return;
+	flushScheduled_ = YES;
+	[self performSelector:@selector(flush) withObject:nil afterDelay:flushDelay_];
+}
+
+// Compacting in the middle of a series of events would put the rest of the
+// series on top of a snapshot that already includes it, so it waits for the
+// run loop.
+- (void)scheduleCompaction {
+	if (compactionScheduled_)
+		return;
+	compactionScheduled_ = YES;
+	[self performSelector:@selector(compact) withObject:nil afterDelay:0];
+}
+
+- (void)flush {
+	[NSObject cancelPreviousPerformRequestsWithTarget:self
+											 selector:@selector(flush)
+											   object:nil];
+	flushScheduled_ = NO;
+	if (![pendingRecords_ length])
+		return;
+	NSData* batch = pendingRecords_;
+	pendingRecords_ = [[NSMutableData alloc] init];
+	uint32_t epoch = epoch_;
+	dispatch_async(queue_, ^{
+		[self writeBatch:batch epoch:epoch];
+	});
+}
+
+- (void)compact {
+	[NSObject cancelPreviousPerformRequestsWithTarget:self
+											 selector:@selector(compact)
+											   object:nil];
+	compactionScheduled_ = NO;
+	// The snapshot has everything the records collected so far would add.
+	[pendingRecords_ setLength:0];
+	recordCount_ = 0;
+
+	uint32_t epoch = ++epoch_;
+	CTSessionSnapshotWriter* writer = CTSessionSnapshotWriterCreate();
+	CTSessionSnapshotWriterSetEpoch(writer, epoch);
+	NSUInteger count = [browsers_ count];
+	for (NSUInteger i = 0; i < count; ++i) {
+		[[browsers_ objectAtIndex:i] appendToSessionSnapshot:writer];
+		[windows_ replaceObjectAtIndex:i
+							withObject:[NSNumber numberWithUnsignedInt:(uint32_t)i]];
+	}
+	nextWindow_ = (uint32_t)count;
+
+	NSString* snapshotPath = snapshotPath_;
+	dispatch_async(queue_, ^{
+		BOOL written = CTSessionSnapshotWriterWriteToFile(
+			writer, [snapshotPath fileSystemRepresentation]);
+		CTSessionSnapshotWriterFree(writer);
+		if (written) {
+			[self startJournalWithEpoch:epoch];
+		} else {
+			// Keep the old snapshot and journal, which are still consistent,
+			// and try again. Batches for the new epoch are dropped meanwhile.
+			DLOG("[ChromiumTabs] failed to write session snapshot %@", snapshotPath);
+			dispatch_async(dispatch_get_main_queue(), ^{
+				[self scheduleCompaction];
+			});
+		}
+	});
+}
+
+- (void)waitUntilWritten {
+	[self flush];
+	dispatch_sync(queue_, ^{});
+}
+
+- (void)startJournalWithEpoch:(uint32_t)epoch {
+	if (journalFile_ >= 0)
+		close(journalFile_);
+	journalFile_ = open([journalPath_ fileSystemRepresentation],
+						O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (journalFile_ < 0) {
+		DLOG("[ChromiumTabs] failed to open session journal %@", journalPath_);
+		return;
+	}
+	CTSessionJournalHeader header;
+	CTSessionJournalInitHeader(&header, epoch);
+	if (!CTWriteFully(journalFile_, &header, sizeof(header)) ||
+		fsync(journalFile_) != 0) {
+		DLOG("[ChromiumTabs] failed to start session journal %@", journalPath_);
+		close(journalFile_);
+		journalFile_ = -1;
+		return;
+	}
+	journalEpoch_ = epoch;
+}
+
+- (void)writeBatch:(NSData*)batch epoch:(uint32_t)epoch {
+	if (journalFile_ < 0 || epoch != journalEpoch_)
+		return;
+	if (!CTWriteFully(journalFile_, [batch bytes], [batch length]) ||
+		fsync(journalFile_) != 0) {
+		DLOG("[ChromiumTabs] failed to write session journal %@", journalPath_);
+	}
+}
+
+#pragma mark -
+#pragma mark Reading
+
++ (NSData*)sessionSnapshotFromDirectory:(NSString*)directory {
+	NSData* snapshotData = [NSData
+		dataWithContentsOfFile:[directory stringByAppendingPathComponent:kSnapshotFileName]
+					   options:NSDataReadingMappedAlways
+						 error:NULL];
+	CTSessionSnapshot snapshot;
+	if (!snapshotData ||
+		!CTSessionSnapshotInit(&snapshot, [snapshotData bytes], [snapshotData length])) {
+		return nil;
+	}
+	NSData* journalData = [NSData
+		dataWithContentsOfFile:[directory stringByAppendingPathComponent:kJournalFileName]
+					   options:NSDataReadingMappedAlways
+						 error:NULL];
+	if ([journalData length] <= sizeof(CTSessionJournalHeader))
+		return snapshotData;
+
+	uint32_t epoch = snapshot.header->epoch;
+	CTSessionState* state = CTSessionStateCreate(&snapshot);
+	size_t applied = CTSessionStateApplyJournal(state, [journalData bytes],
+												[journalData length], epoch);
+	if (!applied) {
+		CTSessionStateFree(state);
+		return snapshotData;
+	}
+	CTSessionSnapshotWriter* writer = CTSessionStateCreateSnapshotWriter(state, epoch);
+	CTSessionStateFree(state);
+	NSMutableData* data =
+		[NSMutableData dataWithLength:CTSessionSnapshotWriterSize(writer)];
+	CTSessionSnapshotWriterCopyBytes(writer, [data mutableBytes]);
+	CTSessionSnapshotWriterFree(writer);
+	return data;
+}
+
+@end
@@ -0,0 +1,72 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#pragma once
+
+#import <Foundation/Foundation.h>
+#import "CTTabStripModel.h"
+
+@class CTBrowser;
+@class CTTabContents;
+
+typedef enum {
+	// Discard the least recently used half of the tabs that can be discarded.
+	CTMemoryPressureWarning,
+	// Discard every tab that can be discarded.
+	CTMemoryPressureCritical,
+} CTMemoryPressureLevel;
+
+// Frees the contents of background tabs nobody has looked at for a while.
+//
+// The discarder remembers when each loaded tab of a set of browsers was last
+// activated. When there are more loaded tabs than |maximumLoadedTabCount|,
+// when CTBrowser's memory accounting adds up to more than |memoryBudget|, or
+// when memory gets tight, it turns the least recently used ones back into
+// placeholders with CTBrowser's |discardTabAtIndex:|, which leaves out the
+// active, pinned, blocked and loading tabs. A discarded tab is created again
+// through CTBrowser's |createTabContentsForPlaceholder:| when it is next
+// activated.
+@interface CTTabDiscarder : NSObject <CTTabStripModelObserver>
+
+// Starts watching |browsers|. If the system reports memory pressure (Mac OS X
+// 10.9 and later), |handleMemoryPressure:| is called with its level.
+- (id)initWithBrowsers:(NSArray*)browsers;
+
+// Starts or stops watching a browser, as its window opens and closes. A
+// browser whose tab strip model is deleted is removed automatically.
+- (void)addBrowser:(CTBrowser*)browser;
+- (void)removeBrowser:(CTBrowser*)browser;
+
+// The number of loaded tabs, across all the browsers, above which the least
+// recently used ones are discarded. Checked after the run loop turns, not in
+// the middle of a change to a tab strip. Defaults to NSUIntegerMax, so that
+// only memory pressure discards tabs.
+@property (nonatomic) NSUInteger maximumLoadedTabCount;
+
+// The estimated bytes (see CTBrowser's |memoryUsage|) the watched browsers
+// may use before the least recently used tabs are discarded. Checked every
+// |memoryCheckInterval| seconds. Defaults to NSUIntegerMax, which turns the
+// check off.
+@property (nonatomic) NSUInteger memoryBudget;
+
+// How often |memoryBudget| is checked. Defaults to one second.
+@property (nonatomic) NSTimeInterval memoryCheckInterval;
+
+// The number of tabs that are loaded, that is not placeholders.
+@property (readonly, nonatomic) NSUInteger loadedTabCount;
+
+// When the tab of |contents| was last activated, or inserted if it was never
+// activated, as seconds since the reference date. 0 if |contents| is not a
+// loaded tab of a watched browser.
+- (NSTimeInterval)lastActivationTimeOfTabContents:(CTTabContents*)contents;
+
+// Discards up to |count| tabs, least recently used first. Returns how many
+// were discarded.
+- (NSUInteger)discardTabs:(NSUInteger)count;
+
+// Discards tabs according to |level|. Call it directly to simulate pressure.
+// Returns how many were discarded.
+- (NSUInteger)handleMemoryPressure:(CTMemoryPressureLevel)level;
+
+@end
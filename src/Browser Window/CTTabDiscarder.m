@@ -0,0 +1,381 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#import "CTTabDiscarder.h"
+#import "CTBrowser.h"
+#import "CTTabContents.h"
+
+// A loaded tab in the activation history. The links live in the entry itself
+// so that moving a tab to the front or dropping it is O(1) once it is found.
+@interface CTTabDiscarderEntry : NSObject {
+@public
+	__unsafe_unretained CTTabContents* contents;
+	__unsafe_unretained CTBrowser* browser;
+	NSTimeInterval lastActivation;
+	// The entry activated more recently than this one, or nil.
+	__unsafe_unretained CTTabDiscarderEntry* newer;
+	// The entry activated less recently than this one, or nil.
+	__unsafe_unretained CTTabDiscarderEntry* older;
+}
+@end
+
+@implementation CTTabDiscarderEntry
+@end
+
+@interface CTTabDiscarder (PrivateMethods)
+// Returns the watched browser whose model is |model|, or nil.
+- (CTBrowser*)browserForModel:(CTTabStripModel*)model;
+// Adds the loaded tabs |browser| already has, oldest first, so that its
+// active tab is the most recent.
+- (void)addTabsOfBrowser:(CTBrowser*)browser;
+// Moves |contents| to the front of the history, adding it if it is new.
+- (void)tabContentsWasActivated:(CTTabContents*)contents
+					  inBrowser:(CTBrowser*)browser;
+// Drops |contents| from the history.
+- (void)forgetTabContents:(CTTabContents*)contents;
+- (void)unlinkEntry:(CTTabDiscarderEntry*)entry;
+// Discards tabs after the run loop turns if there are too many loaded.
+- (void)scheduleEnforcement;
+- (void)enforceMaximumLoadedTabCount;
+// Discards up to |count| tabs, least recently used first, but stops once
+// they add up to |bytes| of estimated memory use. Returns how many were
+// discarded.
+- (NSUInteger)discardTabs:(NSUInteger)count toFree:(NSUInteger)bytes;
+// Starts, restarts or stops |memoryCheckTimer_| to match the settings.
+- (void)updateMemoryCheckTimer;
+- (void)enforceMemoryBudget;
+@end
+
+@implementation CTTabDiscarder {
+	NSMutableArray* browsers_;
+
+	// The history of loaded tabs, as a doubly linked list from |newestEntry_|
+	// to |oldestEntry_|. |entries_| owns the entries and finds the entry of a
+	// CTTabContents.
+	NSMapTable* entries_;
+	__unsafe_unretained CTTabDiscarderEntry* newestEntry_;
+	__unsafe_unretained CTTabDiscarderEntry* oldestEntry_;
+
+	NSUInteger maximumLoadedTabCount_;
+	BOOL enforcementScheduled_;
+
+	NSUInteger memoryBudget_;
+	NSTimeInterval memoryCheckInterval_;
+	dispatch_source_t memoryCheckTimer_;
+
+	dispatch_source_t memoryPressureSource_;
+}
+
+@synthesize maximumLoadedTabCount = maximumLoadedTabCount_;
+@synthesize memoryBudget = memoryBudget_;
+@synthesize memoryCheckInterval = memoryCheckInterval_;
+
+- (id)initWithBrowsers:(NSArray*)browsers {
+	if ((self = [super init])) {
+		browsers_ = [[NSMutableArray alloc] init];
+		entries_ = [[NSMapTable alloc]
+			initWithKeyOptions:NSPointerFunctionsOpaqueMemory |
+							   NSPointerFunctionsOpaquePersonality
+				  valueOptions:NSPointerFunctionsStrongMemory |
+							   NSPointerFunctionsObjectPersonality
+					  capacity:0];
+		maximumLoadedTabCount_ = NSUIntegerMax;
+		memoryBudget_ = NSUIntegerMax;
+		memoryCheckInterval_ = 1.0;
+		for (CTBrowser* browser in browsers)
+			[self addBrowser:browser];
+
+#ifdef DISPATCH_MEMORYPRESSURE_WARN
+		// Weakly linked when deploying to systems before 10.9.
+		if (DISPATCH_SOURCE_TYPE_MEMORYPRESSURE) {
+			memoryPressureSource_ = dispatch_source_create(
+				DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+				DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+				dispatch_get_main_queue());
+		}
+		if (memoryPressureSource_) {
+			__weak CTTabDiscarder* weakSelf = self;
+			dispatch_source_set_event_handler(memoryPressureSource_, ^{
+				CTTabDiscarder* discarder = weakSelf;
+				if (!discarder)
+					return;
+				unsigned long level =
+					dispatch_source_get_data(discarder->memoryPressureSource_);
+				[discarder handleMemoryPressure:
+					(level & DISPATCH_MEMORYPRESSURE_CRITICAL) ?
+						CTMemoryPressureCritical : CTMemoryPressureWarning];
+			});
+			dispatch_resume(memoryPressureSource_);
+		}
+#endif
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[NSObject cancelPreviousPerformRequestsWithTarget:self];
+	if (memoryPressureSource_)
+		dispatch_source_cancel(memoryPressureSource_);
+	if (memoryCheckTimer_)
+		dispatch_source_cancel(memoryCheckTimer_);
+	for (CTBrowser* browser in browsers_)
+		[browser.tabStripModel removeObserver:self];
+}
+
+- (void)addBrowser:(CTBrowser*)browser {
+	if ([browsers_ indexOfObjectIdenticalTo:browser] != NSNotFound)
+		return;
+	[browsers_ addObject:browser];
+	[browser.tabStripModel addObserver:self];
+	[self addTabsOfBrowser:browser];
+}
+
+- (void)removeBrowser:(CTBrowser*)browser {
+	NSUInteger position = [browsers_ indexOfObjectIdenticalTo:browser];
+	if (position == NSNotFound)
+		return;
+	CTTabStripModel* model = browser.tabStripModel;
+	[model removeObserver:self];
+	[browsers_ removeObjectAtIndex:position];
+	int count = [model count];
+	for (int i = 0; i < count; ++i) {
+		// Deferred tabs were never tracked.
+		if (![model isTabDeferredAtIndex:i])
+			[self forgetTabContents:[model tabContentsAtIndex:i]];
+	}
+}
+
+- (void)addTabsOfBrowser:(CTBrowser*)browser {
+	CTTabStripModel* model = browser.tabStripModel;
+	int count = [model count];
+	for (int i = 0; i < count; ++i) {
+		// Deferred tabs have nothing to discard yet.
+		if ([model isTabDeferredAtIndex:i])
+			continue;
+		CTTabContents* contents = [model tabContentsAtIndex:i];
+		if (!contents.isPlaceholder && i != model.activeIndex)
+			[self tabContentsWasActivated:contents inBrowser:browser];
+	}
+	if ([model containsIndex:model.activeIndex]) {
+		[self tabContentsWasActivated:[model activeTabContents]
+							inBrowser:browser];
+	}
+	[self scheduleEnforcement];
+}
+
+- (CTBrowser*)browserForModel:(CTTabStripModel*)model {
+	for (CTBrowser* browser in browsers_) {
+		if (browser.tabStripModel == model)
+			return browser;
+	}
+	return nil;
+}
+
+- (NSUInteger)loadedTabCount {
+	return [entries_ count];
+}
+
+- (NSTimeInterval)lastActivationTimeOfTabContents:(CTTabContents*)contents {
+	CTTabDiscarderEntry* entry = [entries_ objectForKey:contents];
+	return entry ? entry->lastActivation : 0;
+}
+
+#pragma mark -
+#pragma mark Discarding
+
+- (NSUInteger)discardTabs:(NSUInteger)count {
+	return [self discardTabs:count toFree:NSUIntegerMax];
+}
+
+- (NSUInteger)discardTabs:(NSUInteger)count toFree:(NSUInteger)bytes {
+	// Discarding changes the history, so pick the tabs first.
+	NSMutableArray* victims = [NSMutableArray array];
+	NSMutableArray* victimBrowsers = [NSMutableArray array];
+	NSUInteger freed = 0;
+	for (CTTabDiscarderEntry* entry = oldestEntry_;
+		 entry && [victims count] < count && freed < bytes;
+		 entry = entry->newer) {
+		int index = [entry->browser indexOfTabContents:entry->contents];
+		if (index == kNoTab || ![entry->browser canDiscardTabAtIndex:index])
+			continue;
+		[victims addObject:entry->contents];
+		[victimBrowsers addObject:entry->browser];
+		if (bytes != NSUIntegerMax)
+			freed += [entry->browser memoryUsageOfTabAtIndex:index];
+	}
+
+	NSUInteger discarded = 0;
+	NSUInteger victimCount = [victims count];
+	for (NSUInteger i = 0; i < victimCount; ++i) {
+		CTBrowser* browser = [victimBrowsers objectAtIndex:i];
+		int index = [browser indexOfTabContents:[victims objectAtIndex:i]];
+		if (index != kNoTab && [browser discardTabAtIndex:index])
+			++discarded;
+	}
+	return discarded;
+}
+
+- (NSUInteger)handleMemoryPressure:(CTMemoryPressureLevel)level {
+	NSUInteger count = NSUIntegerMax;
+	if (level == CTMemoryPressureWarning) {
+		NSUInteger discardable = 0;
+		for (CTTabDiscarderEntry* entry = oldestEntry_; entry; entry = entry->newer) {
+			int index = [entry->browser indexOfTabContents:entry->contents];
+			if (index != kNoTab && [entry->browser canDiscardTabAtIndex:index])
+				++discardable;
+		}
+		count = (discardable + 1) / 2;
+	}
+	NSUInteger discarded = [self discardTabs:count];
+	DLOG("[ChromiumTabs] discarded %lu tabs under memory pressure",
+		 (unsigned long)discarded);
+	return discarded;
+}
+
+- (void)scheduleEnforcement {
+	if (enforcementScheduled_ || [entries_ count] <= maximumLoadedTabCount_)
+		return;
+	enforcementScheduled_ = YES;
+	[self performSelector:@selector(enforceMaximumLoadedTabCount)
+			   withObject:nil
+			   afterDelay:0];
+}
+
+- (void)enforceMaximumLoadedTabCount {
+	enforcementScheduled_ = NO;
+	NSUInteger count = [entries_ count];
+	if (count > maximumLoadedTabCount_)
+		[self discardTabs:count - maximumLoadedTabCount_];
+}
+
+- (void)setMaximumLoadedTabCount:(NSUInteger)count {
+	maximumLoadedTabCount_ = count;
+	[self scheduleEnforcement];
+}
+
+- (void)setMemoryBudget:(NSUInteger)budget {
+	memoryBudget_ = budget;
+	[self updateMemoryCheckTimer];
+}
+
+- (void)setMemoryCheckInterval:(NSTimeInterval)interval {
+	memoryCheckInterval_ = interval;
+	[self updateMemoryCheckTimer];
+}
+
+- (void)updateMemoryCheckTimer {
+	if (memoryCheckTimer_) {
+		dispatch_source_cancel(memoryCheckTimer_);
+		memoryCheckTimer_ = NULL;
+	}
+	if (memoryBudget_ == NSUIntegerMax || memoryCheckInterval_ <= 0)
+		return;
+	memoryCheckTimer_ = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+											   dispatch_get_main_queue());
+	uint64_t interval = (uint64_t)(memoryCheckInterval_ * NSEC_PER_SEC);
+	// The checks don't need to be punctual, so let the system batch them.
+	dispatch_source_set_timer(memoryCheckTimer_,
+							  dispatch_time(DISPATCH_TIME_NOW, interval),
+							  interval, interval / 10);
+	__weak CTTabDiscarder* weakSelf = self;
+	dispatch_source_set_event_handler(memoryCheckTimer_, ^{
+		[weakSelf enforceMemoryBudget];
+	});
+	dispatch_resume(memoryCheckTimer_);
+}
+
+- (void)enforceMemoryBudget {
+	CTMemoryUsage usage = [CTBrowser memoryUsageOfBrowsers:browsers_];
+	NSUInteger total = usage.contents + usage.framework;
+	if (total > memoryBudget_)
+		[self discardTabs:NSUIntegerMax toFree:total - memoryBudget_];
+}
+
+#pragma mark -
+#pragma mark CTTabStripModelObserver
+
+- (void)tabStripModel:(CTTabStripModel*)model
+	  didReceiveEvent:(const CTTabStripModelEvent*)event {
+	CTBrowser* browser = [self browserForModel:model];
+	if (!browser)
+		return;
+	switch (event->type) {
+		case CTTabStripModelEventInserted:
+			// A tab opened in the background is about as likely to be looked
+			// at soon as one that was just active. Deferred tabs come without
+			// contents.
+			if (event->contents && !event->contents.isPlaceholder)
+				[self tabContentsWasActivated:event->contents inBrowser:browser];
+			break;
+		case CTTabStripModelEventSelected:
+			[self tabContentsWasActivated:event->contents inBrowser:browser];
+			break;
+		case CTTabStripModelEventReplaced:
+			// A placeholder being loaded is about to be selected; a discarded
+			// tab is not loaded anymore.
+			[self forgetTabContents:event->oldContents];
+			if (!event->contents.isPlaceholder)
+				[self tabContentsWasActivated:event->contents inBrowser:browser];
+			break;
+		case CTTabStripModelEventDetached:
+			[self forgetTabContents:event->contents];
+			break;
+		case CTTabStripModelEventDetachedRange:
+			for (CTTabContents* contents in event->rangeContents)
+				[self forgetTabContents:contents];
+			break;
+		case CTTabStripModelEventDeleted:
+			[self removeBrowser:browser];
+			break;
+		default:
+			break;
+	}
+}
+
+#pragma mark -
+#pragma mark History
+
+- (void)tabContentsWasActivated:(CTTabContents*)contents
+					  inBrowser:(CTBrowser*)browser {
+	CTTabDiscarderEntry* entry = [entries_ objectForKey:contents];
+	if (entry) {
+		[self unlinkEntry:entry];
+	} else {
+		entry = [[CTTabDiscarderEntry alloc] init];
+		entry->contents = contents;
+		[entries_ setObject:entry forKey:contents];
+	}
+	entry->browser = browser;
+	entry->lastActivation = [NSDate timeIntervalSinceReferenceDate];
+	entry->older = newestEntry_;
+	if (newestEntry_)
+		newestEntry_->newer = entry;
+	else
+		oldestEntry_ = entry;
+	newestEntry_ = entry;
+	[self scheduleEnforcement];
+}
+
+- (void)forgetTabContents:(CTTabContents*)contents {
+	CTTabDiscarderEntry* entry = [entries_ objectForKey:contents];
+	if (!entry)
+		return;
+	[self unlinkEntry:entry];
+	[entries_ removeObjectForKey:contents];
+}
+
+- (void)unlinkEntry:(CTTabDiscarderEntry*)entry {
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		newestEntry_ = entry->older;
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		oldestEntry_ = entry->newer;
+	entry->newer = nil;
+	entry->older = nil;
+}
+
+@end
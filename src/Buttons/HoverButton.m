@@ -60,6 +60,8 @@
 
 - (void)setTrackingEnabled:(BOOL)enabled {
 	if (enabled) {
+		if (trackingArea_)
+			return;
 		trackingArea_ = [[NSTrackingArea alloc] initWithRect:[self bounds]
 													 options:NSTrackingMouseEnteredAndExited | NSTrackingActiveAlways
 													   owner:self
@@ -11,6 +11,14 @@
 // including icon, title and state (loading, crashed, etc).
 #import <ChromiumTabs/CTTabContents.h>
 
+// Describes the |CTSessionRecorder| class which keeps the session of a set of
+// browsers on disk as it changes.
+#import <ChromiumTabs/CTSessionRecorder.h>
+
+// Describes the |CTTabDiscarder| class which frees the contents of background
+// tabs that haven't been looked at for a while.
+#import <ChromiumTabs/CTTabDiscarder.h>
+
 // Toolbar view and view controller
 #import <ChromiumTabs/CTToolbarView.h>
 #import <ChromiumTabs/CTToolbarController.h>
@@ -74,7 +74,8 @@
 // are no longer in the model.
 - (NSInteger)modelIndexForTabView:(NSView*)view;
 
-// Return the view at a given index.
+// Return the view at a given index, or nil if the tab is out of sight and
+// has no view.
 - (NSView*)viewAtIndex:(NSUInteger)index;
 
 // Return the number of tab views in the tab strip. It's same as number of tabs
@@ -93,6 +94,10 @@
 // is visible.
 - (BOOL)isTabFullyVisible:(CTTabView*)tab;
 
+// Scrolls the tabs for a scroll wheel |event| if they overflow the strip.
+// Returns NO if they fit and there is nothing to scroll.
+- (BOOL)scrollTabsWithEvent:(NSEvent*)event;
+
 // Force the tabs to rearrange themselves to reflect the current model.
 - (void)layoutTabs;
 - (void)layoutTabsWithoutAnimation;
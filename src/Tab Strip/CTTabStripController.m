@@ -19,6 +19,7 @@
 #import "CTTabStripModel.h"
 #import "GTMNSAnimation+Duration.h"
 #import "CTBrowserCommand.h"
+#import "CTTabLayout.h"
 
 NSString* const kTabStripNumberOfTabsChanged = @"kTabStripNumberOfTabsChanged";
 
@@ -49,6 +50,25 @@ const CGFloat kNewTabButtonOffset = 8.0;
 // Time (in seconds) in which tabs animate to their final position.
 const NSTimeInterval kAnimationDuration = 0.125;
 
+// The number of tabs on either side of the ones in sight that keep their
+// controllers, so that small resizes don't rebind them back and forth.
+const NSUInteger kMaterializedTabMargin = 3;
+
+// When the tabs don't fit, holding a dragged tab within |kEdgeScrollWidth| of
+// either end of the strip scrolls them by |kEdgeScrollStep| every
+// |kEdgeScrollInterval| seconds.
+const CGFloat kEdgeScrollWidth = 32.0;
+const CGFloat kEdgeScrollStep = 12.0;
+const NSTimeInterval kEdgeScrollInterval = 1.0 / 30.0;
+
+// The number of tab controllers loaded when the strip is created, and the
+// most that are kept for reuse once their tabs are gone.
+const NSUInteger kPrewarmedTabControllerCount = 8;
+const NSUInteger kMaxSpareTabControllerCount = 64;
+
+@interface CTTabStripController () <CTTabStripModelObserver>
+@end
+
 @interface CTTabStripController (Private)
 - (void)installTrackingArea;
 - (void)addSubviewToPermanentList:(NSView*)aView;
@@ -61,6 +81,19 @@ const NSTimeInterval kAnimationDuration = 0.125;
 - (void)animationDidStopForController:(CTTabController*)controller
                              finished:(BOOL)finished;
 - (NSInteger)indexFromModelIndex:(NSInteger)index;
+- (NSInteger)modelIndexFromIndex:(NSUInteger)index;
+- (void)invalidateLayoutFromIndex:(NSUInteger)index;
+- (CTTabController*)tabControllerAtIndex:(NSUInteger)index;
+- (CTTabContentsController*)contentsControllerAtIndex:(NSUInteger)index;
+- (CTTabController*)materializeTabAtIndex:(NSUInteger)index;
+- (CTTabController*)unbindTabAtIndex:(NSUInteger)index;
+- (void)recycleTabController:(CTTabController*)controller;
+- (void)removeTabAtIndex:(NSUInteger)index;
+- (NSRect)frameOfTabAtIndex:(NSUInteger)index;
+- (CGFloat)endOfVisibleTabs;
+- (void)scrollTabsBy:(CGFloat)delta;
+- (void)updateEdgeScrolling;
+- (void)updateSelectedStateOfTabs;
 - (NSInteger)numberOfOpenTabs;
 - (NSInteger)numberOfOpenMiniTabs;
 - (NSInteger)numberOfOpenNonMiniTabs;
@@ -205,6 +238,28 @@ const NSTimeInterval kAnimationDuration = 0.125;
 // itself gets marked as such so it no longer will send back its select action
 // or allow itself to be dragged. In addition, drags on the tab strip as a
 // whole are disabled while there are tabs closing.
+//
+// Finally, not every tab has its controllers. With thousands of tabs, most of
+// them are squeezed off the end of the strip, so only the tabs in sight (plus
+// a few on either side, the active tab, the one being dragged and the closing
+// ones) are "materialized". The slots of the others hold NSNull in both
+// parallel arrays, and |materializedTabs_| says which slots don't. After every
+// layout, the controllers of the tabs that went out of sight are rebound to
+// the ones that came into it, so the number of controllers, views and
+// TabContentsControllers depends on the width of the window, not on the
+// number of tabs. Everything the strip needs to know about a tab without
+// controllers (whether it is mini, where it is) comes from the model and the
+// last layout. TabContentsControllers are only made when needed, which is
+// mostly for the active tab. Tab controllers aren't thrown away with their
+// tabs either: |-newTab| hands out the ones that were recycled before loading
+// a nib.
+//
+// When even the narrowest tabs don't fit, they overflow: the strip scrolls
+// them horizontally by |scrollOffset_| (with the scroll wheel, by holding a
+// dragged tab at either end, and to show a newly active tab) and the new tab
+// button stays at the end of the strip, above them. The layout itself is
+// never scrolled; tab views are moved by the offset when they are placed, so
+// scrolling only touches the views in sight.
 
 @implementation CTTabStripController {
 	__weak CTTabContents* currentTab_;  // weak, tab for which we're showing state
@@ -243,6 +298,16 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	// Set of TabControllers that are currently animating closed.
 	NSMutableSet* closingControllers_;
 	
+	// TabControllers that no tab uses, ready to be handed out by |-newTab|.
+	NSMutableArray* spareTabControllers_;
+	
+	// The indices into |tabArray_| that hold controllers rather than NSNull.
+	// Always includes the active tab once it was laid out, and closing tabs.
+	NSMutableIndexSet* materializedTabs_;
+	// The contents inserted since the last layout. Their tabs animate in when
+	// they get controllers, the others are just put in place.
+	NSMutableSet* insertedContents_;
+	
 	// These values are only used during a drag, and override tab positioning.
 	__weak CTTabView* placeholderTab_;  // weak. Tab being dragged
 	NSRect placeholderFrame_;  // Frame to use
@@ -287,6 +352,33 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	
 	// Is the mouse currently inside the strip;
 	BOOL mouseInside_;
+	
+	// YES if a layout was requested while the model was in the middle of a
+	// batch of updates. The layout is done once the updates are committed.
+	BOOL layoutDeferredForUpdates_;
+	
+	// The input and output of |CTTabLayoutUpdate|, one entry per controller
+	// in |tabArray_|, and what it needs to pick up from where the last layout
+	// left off. Only the entries from |firstDirtyTab_| on are filled in again.
+	CTTabLayoutFlags* layoutFlags_;
+	CTTabLayoutFrame* layoutFrames_;
+	NSUInteger layoutCapacity_;
+	CTTabLayoutState layoutState_;
+	// The first index into |tabArray_| whose controller or layout flags
+	// changed since the last layout.
+	NSUInteger firstDirtyTab_;
+	// The index into |tabArray_| of the tab that was active in the last
+	// layout, or NSNotFound.
+	NSUInteger layoutActiveTab_;
+	
+	// How far the tabs are scrolled to the left, and how far they can be, which
+	// is 0 unless they overflow the strip.
+	CGFloat scrollOffset_;
+	CGFloat scrollableWidth_;
+	// Scrolls the tabs while a dragged tab is held at an end of the strip, by
+	// |edgeScrollStep_| at a time.
+	NSTimer* edgeScrollTimer_;
+	CGFloat edgeScrollStep_;
 }
 
 @synthesize indentForControls = indentForControls_;
@@ -310,35 +402,7 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		browser_ = browser;
 		tabStripModel_ = browser_.tabStripModel;
 		
-		[[NSNotificationCenter defaultCenter] addObserver:self 
-												 selector:@selector(tabDidSelect:) 
-													 name:CTTabSelectedNotification 
-												   object:tabStripModel_];
-		
-		[[NSNotificationCenter defaultCenter] addObserver:self 
-												 selector:@selector(tabDidInsert:) 
-													 name:CTTabInsertedNotification 
-												   object:tabStripModel_];
-		
-		[[NSNotificationCenter defaultCenter] addObserver:self 
-												 selector:@selector(tabDidChange:) 
-													 name:CTTabChangedNotification 
-												   object:tabStripModel_];
-		
-		[[NSNotificationCenter defaultCenter] addObserver:self 
-												 selector:@selector(tabDidDetach:) 
-													 name:CTTabDetachedNotification 
-												   object:tabStripModel_];
-		
-		[[NSNotificationCenter defaultCenter] addObserver:self 
-												 selector:@selector(tabDidMove:) 
-													 name:CTTabMovedNotification 
-												   object:tabStripModel_];
-		
-		[[NSNotificationCenter defaultCenter] addObserver:self 
-												 selector:@selector(tabDidChangeMiniState:) 
-													 name:CTTabMiniStateChangedNotification
-												   object:tabStripModel_];
+		[tabStripModel_ addObserver:self];
 		
 		dragController_ = [[CTTabStripDragController alloc] initWithTabStripController:self];
 		tabContentsArray_ = [[NSMutableArray alloc] init];
@@ -385,6 +449,21 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		
 		closingControllers_ = [[NSMutableSet alloc] init];
 		
+		// Load some tab controllers up front, so the first tabs of the window
+		// don't wait for their nibs.
+		spareTabControllers_ =
+			[[NSMutableArray alloc] initWithCapacity:kPrewarmedTabControllerCount];
+		for (NSUInteger i = 0; i < kPrewarmedTabControllerCount; ++i)
+			[spareTabControllers_ addObject:[[CTTabController alloc] init]];
+		
+		materializedTabs_ = [[NSMutableIndexSet alloc] init];
+		insertedContents_ = [[NSMutableSet alloc] init];
+		
+		CTTabLayoutStateInit(&layoutState_);
+		firstDirtyTab_ = 0;
+		layoutActiveTab_ = NSNotFound;
+		[view setTabStripController:self];
+		
 		// Install the permanent subviews.
 		[self regenerateSubviewList];
 		
@@ -425,13 +504,16 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		// means the tab model is already fully formed with tabs. Need to walk the
 		// list and create the UI for each.
 		const int existingTabCount = [tabStripModel_ count];
-		const CTTabContents* selection = [tabStripModel_ activeTabContents];
+		// Deferred tabs stay that way until the layout finds them in sight.
+		const int activeIndex = [tabStripModel_ activeIndex];
 		for (int i = 0; i < existingTabCount; ++i) {
-			CTTabContents* currentContents = [tabStripModel_ tabContentsAtIndex:i];
+			CTTabContents* currentContents =
+				[tabStripModel_ isTabDeferredAtIndex:i] && i != activeIndex ?
+				nil : [tabStripModel_ tabContentsAtIndex:i];
 			[self tabInsertedWithContents:currentContents
 								  atIndex:i
 							 inForeground:NO];
-			if (selection == currentContents) {
+			if (i == activeIndex) {
 				// Must manually force a selection since the model won't send
 				// selection messages in this scenario.
 				[self tabSelectedWithContents:currentContents
@@ -452,6 +534,7 @@ const NSTimeInterval kAnimationDuration = 0.125;
 }
 
 - (void)dealloc {
+	[tabStripModel_ removeObserver:self];
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
 	
 	if (trackingArea_)
@@ -465,6 +548,10 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		[[[view animationForKey:@"frameOrigin"] delegate] invalidate];
 	}
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	[edgeScrollTimer_ invalidate];
+	free(layoutFlags_);
+	free(layoutFrames_);
+	CTTabLayoutStateFree(&layoutState_);
 }
 
 + (CGFloat)defaultTabHeight {
@@ -484,7 +571,7 @@ const NSTimeInterval kAnimationDuration = 0.125;
 - (void)swapInTabAtIndex:(NSInteger)modelIndex {
 	assert(modelIndex >= 0 && modelIndex < [tabStripModel_ count]);
 	NSInteger index = [self indexFromModelIndex:modelIndex];
-	CTTabContentsController* controller = [tabContentsArray_ objectAtIndex:index];
+	CTTabContentsController* controller = [self contentsControllerAtIndex:index];
 	
 	// Resize the new view to fit the window. Calling |view| may lazily
 	// instantiate the CTTabContentsController from the nib. Until we call
@@ -530,10 +617,16 @@ const NSTimeInterval kAnimationDuration = 0.125;
 // Create a new tab view and set its cell correctly so it draws the way we want
 // it to. It will be sized and positioned by |-layoutTabs| so there's no need to
 // set the frame here. This also creates the view as hidden, it will be
-// shown during layout.
+// shown during layout. Spare controllers are used before loading a new one.
 - (CTTabController*)newTab {
-	//  CTTabController* controller = [[[CTTabController alloc] init] autorelease];
-	CTTabController* controller = [[CTTabController alloc] init];
+	CTTabController* controller = [spareTabControllers_ lastObject];
+	// |-prepareForReuse| dropped the tracking areas of a spare controller. The
+	// |-regenerateSubviewList| that puts its view in turns them back on if the
+	// mouse is in the strip.
+	if (controller)
+		[spareTabControllers_ removeLastObject];
+	else
+		controller = [[CTTabController alloc] init];
 	[controller setTarget:self];
 	[controller setAction:@selector(selectTab:)];
 	[[controller view] setHidden:YES];
@@ -567,39 +660,146 @@ const NSTimeInterval kAnimationDuration = 0.125;
 // or tab contents controller array accounting for tabs that are currently
 // closing. For example, if there are two tabs in the process of closing before
 // |index|, this returns |index| + 2. If there are no closing tabs, this will
-// return |index|.
+// return |index|. Closing tabs always have controllers, so only the
+// materialized tabs need to be looked at.
 - (NSInteger)indexFromModelIndex:(NSInteger)index {
 	assert(index >= 0);
 	if (index < 0)
 		return index;
 	
-	NSInteger i = 0;
-	for (CTTabController* controller in tabArray_) {
+	for (NSUInteger i = [materializedTabs_ firstIndex];
+		 i != NSNotFound && (NSInteger)i <= index;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		CTTabController* controller = [tabArray_ objectAtIndex:i];
 		if ([closingControllers_ containsObject:controller]) {
 			assert([(CTTabView*)[controller view] isClosing]);
 			++index;
 		}
-		if (i == index)  // No need to check anything after, it has no effect.
-			break;
-		++i;
 	}
 	return index;
 }
 
+// The reverse of |-indexFromModelIndex:|: given an index into the tab
+// controller array of a tab that isn't closing, returns its index in the
+// model.
+- (NSInteger)modelIndexFromIndex:(NSUInteger)index {
+	NSInteger modelIndex = index;
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i < index;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		if ([closingControllers_ containsObject:[tabArray_ objectAtIndex:i]])
+			--modelIndex;
+	}
+	return modelIndex;
+}
+
+// Makes the next layout start at |index| into |tabArray_| or before. Called
+// whenever a controller is added, removed or moved there, or changes in a
+// way that affects its frame.
+- (void)invalidateLayoutFromIndex:(NSUInteger)index {
+	firstDirtyTab_ = MIN(firstDirtyTab_, index);
+}
+
+// Returns the controller of the tab at |index| into |tabArray_|, giving the
+// tab one if it has none. Returns nil if out of range.
+- (CTTabController*)tabControllerAtIndex:(NSUInteger)index {
+	if (index >= [tabArray_ count])
+		return nil;
+	if (![materializedTabs_ containsIndex:index])
+		return [self materializeTabAtIndex:index];
+	return [tabArray_ objectAtIndex:index];
+}
+
+// Returns the CTTabContentsController of the tab at |index| into
+// |tabContentsArray_|, making it if needed. Only tabs with a tab controller
+// have one, so they go away together.
+- (CTTabContentsController*)contentsControllerAtIndex:(NSUInteger)index {
+	[self tabControllerAtIndex:index];
+	id controller = [tabContentsArray_ objectAtIndex:index];
+	if (controller == [NSNull null]) {
+		CTTabContents* contents =
+			[tabStripModel_ tabContentsAtIndex:[self modelIndexFromIndex:index]];
+		controller = [browser_ createTabContentsControllerWithContents:contents];
+		[tabContentsArray_ replaceObjectAtIndex:index withObject:controller];
+	}
+	return controller;
+}
+
+// Gives the tab at |index| into |tabArray_|, which has none, a tab controller
+// set up for its contents. Tabs whose contents were just inserted are hidden
+// so the layout animates them in; the others are put in place by the next
+// layout.
+- (CTTabController*)materializeTabAtIndex:(NSUInteger)index {
+	assert(![materializedTabs_ containsIndex:index]);
+	NSInteger modelIndex = [self modelIndexFromIndex:index];
+	CTTabContents* contents = [tabStripModel_ tabContentsAtIndex:modelIndex];
+	
+	CTTabController* controller = [self newTab];
+	[tabArray_ replaceObjectAtIndex:index withObject:controller];
+	[materializedTabs_ addIndex:index];
+	
+	[controller setMini:[tabStripModel_ isMiniTabAtIndex:modelIndex]];
+	[controller setPinned:[tabStripModel_ isTabPinnedAtIndex:modelIndex]];
+	[controller setApp:[tabStripModel_ isAppTabAtIndex:modelIndex]];
+	[controller setActive:modelIndex == tabStripModel_.activeIndex];
+	[controller setSelected:[tabStripModel_ isTabSelectedAtIndex:modelIndex]];
+	[self setTabTitle:controller withContents:contents];
+	[self updateFavIconForContents:contents atIndex:modelIndex];
+	
+	NSView* view = [controller view];
+	if ([insertedContents_ containsObject:contents]) {
+		// Set the originating frame to just below the strip so that it animates
+		// upwards as it's being initially layed out. Oddly, this works while
+		// doing something similar in |-layoutTabs| confuses the window server.
+		[view setHidden:YES];
+		[view setFrame:NSOffsetRect([view frame],
+									0, -[[self class] defaultTabHeight])];
+	} else {
+		[view setHidden:NO];
+	}
+	return controller;
+}
+
+// Takes the controllers away from the tab at |index| into |tabArray_| and
+// returns its tab controller, which should be recycled.
+- (CTTabController*)unbindTabAtIndex:(NSUInteger)index {
+	CTTabController* controller = [tabArray_ objectAtIndex:index];
+	assert(![closingControllers_ containsObject:controller]);
+	[tabArray_ replaceObjectAtIndex:index withObject:[NSNull null]];
+	[tabContentsArray_ replaceObjectAtIndex:index withObject:[NSNull null]];
+	[materializedTabs_ removeIndex:index];
+	return controller;
+}
+
+// Makes every tab controller draw whether its tab is selected. Closing tabs
+// are no longer in the model and aren't.
+- (void)updateSelectedStateOfTabs {
+	NSInteger closing = 0;
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		CTTabController* controller = [tabArray_ objectAtIndex:i];
+		if ([closingControllers_ containsObject:controller]) {
+			[controller setSelected:NO];
+			++closing;
+			continue;
+		}
+		[controller setSelected:[tabStripModel_ isTabSelectedAtIndex:i - closing]];
+	}
+}
 
 // Returns the index of the subview |view|. Returns -1 if not present. Takes
 // closing tabs into account such that this index will correctly match the tab
 // model. If |view| is in the process of closing, returns -1, as closing tabs
 // are no longer in the model.
 - (NSInteger)modelIndexForTabView:(NSView*)view {
-	NSInteger index = 0;
-	for (CTTabController* current in tabArray_) {
+	NSInteger closing = 0;
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		CTTabController* current = [tabArray_ objectAtIndex:i];
 		// If |current| is closing, skip it.
 		if ([closingControllers_ containsObject:current])
-			continue;
+			++closing;
 		else if ([current view] == view)
-			return index;
-		++index;
+			return i - closing;
 	}
 	return -1;
 }
@@ -609,28 +809,26 @@ const NSTimeInterval kAnimationDuration = 0.125;
 // tab model. If |view| is in the process of closing, returns -1, as closing
 // tabs are no longer in the model.
 - (NSInteger)modelIndexForContentsView:(NSView*)view {
-	NSInteger index = 0;
-	NSInteger i = 0;
-	for (CTTabContentsController* current in tabContentsArray_) {
+	NSInteger closing = 0;
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
 		// If the CTTabController corresponding to |current| is closing, skip it.
 		CTTabController* controller = [tabArray_ objectAtIndex:i];
-		if ([closingControllers_ containsObject:controller]) {
-			++i;
-			continue;
-		} else if ([current view] == view) {
-			return index;
-		}
-		++index;
-		++i;
+		id current = [tabContentsArray_ objectAtIndex:i];
+		if ([closingControllers_ containsObject:controller])
+			++closing;
+		else if (current != [NSNull null] && [current view] == view)
+			return i - closing;
 	}
 	return -1;
 }
 
 
 // Returns the view at the given index, using the array of TabControllers to
-// get the associated view. Returns nil if out of range.
+// get the associated view. Returns nil if out of range or if the tab has no
+// controller.
 - (NSView*)viewAtIndex:(NSUInteger)index {
-	if (index >= [tabArray_ count])
+	if (![materializedTabs_ containsIndex:index])
 		return NULL;
 	return [[tabArray_ objectAtIndex:index] view];
 }
@@ -639,14 +837,102 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	return [tabArray_ count];
 }
 
+// Returns where the last layout put the tab at |index| into |tabArray_|,
+// whether or not it has a view, in the coordinates of the strip (that is,
+// scrolled). Tabs in collapsed groups have no width.
+- (NSRect)frameOfTabAtIndex:(NSUInteger)index {
+	const CGFloat tabHeight = [[self class] defaultTabHeight] + 1;
+	if (index >= (NSUInteger)layoutState_.count)
+		return NSZeroRect;
+	if (layoutFlags_[index] & CTTabLayoutHidden) {
+		return NSMakeRect(layoutState_.cursors[index].offset - scrollOffset_, 0,
+						  0, tabHeight);
+	}
+	CTTabLayoutFrame frame = layoutFrames_[index];
+	return NSMakeRect(frame.x - scrollOffset_, 0, frame.width, tabHeight);
+}
+
+// Returns where the part of the strip the tabs are seen in ends, which is
+// short of the new tab button. It starts at |indentForControls_|.
+- (CGFloat)endOfVisibleTabs {
+	return NSWidth([tabStripView_ frame]) - NSWidth([newTabButton_ frame]) -
+		kNewTabButtonOffset;
+}
+
+// Scrolls the tabs |delta| points further to the left (or to the right if
+// negative), as far as they go.
+- (void)scrollTabsBy:(CGFloat)delta {
+	CGFloat offset = MAX(0, MIN(scrollOffset_ + delta, scrollableWidth_));
+	if (offset == scrollOffset_)
+		return;
+	scrollOffset_ = offset;
+	[self layoutTabsWithAnimation:NO regenerateSubviews:NO];
+}
+
+- (BOOL)scrollTabsWithEvent:(NSEvent*)event {
+	if (scrollableWidth_ <= 0)
+		return NO;
+	// The strip only scrolls one way, so a vertical wheel scrolls it too. A line
+	// is a tab at its minimum width.
+	CGFloat delta = [event scrollingDeltaX];
+	if (!delta)
+		delta = [event scrollingDeltaY];
+	if (![event hasPreciseScrollingDeltas])
+		delta *= [CTTabController minTabWidth] - kTabOverlap;
+	[self scrollTabsBy:-delta];
+	return YES;
+}
+
+// Starts scrolling the tabs while the dragged tab is held at either end of
+// the strip, and stops when it isn't.
+- (void)updateEdgeScrolling {
+	edgeScrollStep_ = 0;
+	if (placeholderTab_ && scrollableWidth_ > 0) {
+		if (NSMinX(placeholderFrame_) < [self indentForControls] + kEdgeScrollWidth)
+			edgeScrollStep_ = -kEdgeScrollStep;
+		else if (NSMaxX(placeholderFrame_) > [self endOfVisibleTabs] - kEdgeScrollWidth)
+			edgeScrollStep_ = kEdgeScrollStep;
+	}
+	if (edgeScrollStep_ && !edgeScrollTimer_) {
+		// The drag runs its own event loop in the default mode, which fires the
+		// timer as well.
+		edgeScrollTimer_ =
+			[NSTimer scheduledTimerWithTimeInterval:kEdgeScrollInterval
+											 target:self
+										   selector:@selector(edgeScrollTimerFired:)
+										   userInfo:nil
+											repeats:YES];
+	} else if (!edgeScrollStep_ && edgeScrollTimer_) {
+		[edgeScrollTimer_ invalidate];
+		edgeScrollTimer_ = nil;
+	}
+}
+
+// The dragged tab stays under the mouse while the tabs scroll under it, which
+// moves the placeholder among them.
+- (void)edgeScrollTimerFired:(NSTimer*)timer {
+	[self scrollTabsBy:edgeScrollStep_];
+}
+
 // Called when the user clicks a tab. Tell the model the selection has changed,
-// which feeds back into us via a notification.
+// which feeds back into us via a notification. Shift-clicking selects the tabs
+// up to the clicked one (adding them to the selection with Command as well),
+// and Command-clicking adds or removes a single tab.
 - (void)selectTab:(id)sender {
 	assert([sender isKindOfClass:[NSView class]]);
 	int index = [self modelIndexForTabView:sender];
-	if ([tabStripModel_ containsIndex:index])
+	if (![tabStripModel_ containsIndex:index])
+		return;
+	NSUInteger modifiers = [[NSApp currentEvent] modifierFlags];
+	if (modifiers & NSShiftKeyMask) {
+		[tabStripModel_ extendSelectionToIndex:index
+							 addingToSelection:(modifiers & NSCommandKeyMask) != 0];
+	} else if (modifiers & NSCommandKeyMask) {
+		[tabStripModel_ toggleSelectionAtIndex:index];
+	} else {
 		[tabStripModel_ selectTabContentsAtIndex:index
 									 userGesture:YES];
+	}
 }
 
 // Called when the user closes a tab. Asks the model to close the tab. |sender|
@@ -670,14 +956,16 @@ const NSTimeInterval kAnimationDuration = 0.125;
 			// resized until a later time (when the mouse leaves the tab strip).
 			// TODO(pinkerton): re-visit when handling tab overflow.
 			// http://crbug.com/188
-			NSView* penultimateTab = [self viewAtIndex:numberOfOpenTabs - 2];
-			availableResizeWidth_ = NSMaxX([penultimateTab frame]);
+			NSInteger penultimateTab = [self indexFromModelIndex:numberOfOpenTabs - 2];
+			availableResizeWidth_ =
+				NSMaxX([self frameOfTabAtIndex:penultimateTab]) + scrollOffset_;
 		} else {
 			// If the rightmost tab is closed, change the available width so that
 			// another tab's close button lands below the cursor (assuming the tabs
 			// are currently below their maximum width and can grow).
-			NSView* lastTab = [self viewAtIndex:numberOfOpenTabs - 1];
-			availableResizeWidth_ = NSMaxX([lastTab frame]);
+			NSInteger lastTab = [self indexFromModelIndex:numberOfOpenTabs - 1];
+			availableResizeWidth_ =
+				NSMaxX([self frameOfTabAtIndex:lastTab]) + scrollOffset_;
 		}
 		[tabStripModel_ closeTabContentsAtIndex:index 
 									 closeTypes:CLOSE_USER_GESTURE |
@@ -712,8 +1000,21 @@ const NSTimeInterval kAnimationDuration = 0.125;
 
 - (void)insertPlaceholderForTab:(CTTabView*)tab
                           frame:(NSRect)frame {
+	// The placeholder is laid out differently from the other tabs and put back
+	// in place on every layout, so start the layout at whichever of the old and
+	// new ones comes first. The layout itself takes care of the tabs the gap
+	// for it moves away from or to. Both have controllers.
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		NSView* view = [[tabArray_ objectAtIndex:i] view];
+		if ((tab && view == tab) || (placeholderTab_ && view == placeholderTab_)) {
+			[self invalidateLayoutFromIndex:i];
+			break;
+		}
+	}
 	placeholderTab_ = tab;
 	placeholderFrame_ = frame;
+	[self updateEdgeScrolling];
 	[self layoutTabsWithAnimation:initialLayoutComplete_ regenerateSubviews:NO];
 }
 
@@ -748,22 +1049,25 @@ const NSTimeInterval kAnimationDuration = 0.125;
 }
 
 // Lay out all tabs in the order of their TabContentsControllers, which matches
-// the ordering in the TabStripModel. This call isn't that expensive, though
-// it is O(n) in the number of tabs. Tabs will animate to their new position
-// if the window is visible and |animate| is YES.
-// TODO(pinkerton): Note this doesn't do too well when the number of min-sized
-// tabs would cause an overflow. http://crbug.com/188
+// the ordering in the TabStripModel. Only the tabs from the first one that
+// changed since the last layout (see |-invalidateLayoutFromIndex:|) are laid
+// out again, unless the width of the tabs changes. Afterwards, only the tabs
+// in sight have controllers and views. Tabs that don't fit scroll (see the
+// note at the top). Tabs will animate to their new position if the window is
+// visible and |animate| is YES.
 - (void)layoutTabsWithAnimation:(BOOL)animate
              regenerateSubviews:(BOOL)doUpdate {
 	assert([NSThread isMainThread]);
 	if (![tabArray_ count])
 		return;
 	
-	const CGFloat kMaxTabWidth = [CTTabController maxTabWidth];
-	const CGFloat kMinTabWidth = [CTTabController minTabWidth];
-	const CGFloat kMinActiveTabWidth = [CTTabController minActiveTabWidth];
-	const CGFloat kMiniTabWidth = [CTTabController miniTabWidth];
-	const CGFloat kAppTabWidth = [CTTabController appTabWidth];
+	// Don't lay out intermediate states of a batch of model updates; we'll be
+	// told when the batch is committed.
+	if ([tabStripModel_ isUpdating]) {
+		layoutDeferredForUpdates_ = YES;
+		return;
+	}
+	layoutDeferredForUpdates_ = NO;
 	
 	NSRect enclosingRect = NSZeroRect;
 	//  ScopedNSAnimationContextGroup mainAnimationGroup(animate);
@@ -774,82 +1078,177 @@ const NSTimeInterval kAnimationDuration = 0.125;
     }
 	
 	
-	// Update the current subviews and their z-order if requested.
-	if (doUpdate)
-		[self regenerateSubviewList];
-	
-	// Compute the base width of tabs given how much room we're allowed. Note that
-	// mini-tabs have a fixed width. We may not be able to use the entire width
-	// if the user is quickly closing tabs. This may be negative, but that's okay
-	// (taken care of by |MAX()| when calculating tab sizes).
-	CGFloat availableSpace = 0;
-	
+	// Compute the room for tabs given how much we're allowed. We may not be
+	// able to use the entire width if the user is quickly closing tabs. This
+	// may be negative, but that's okay (the layout clamps tab widths).
+	CTTabLayoutParameters params = {
+		.maxTabWidth = [CTTabController maxTabWidth],
+		.minTabWidth = [CTTabController minTabWidth],
+		.minActiveTabWidth = [CTTabController minActiveTabWidth],
+		.miniTabWidth = [CTTabController miniTabWidth],
+		.appTabWidth = [CTTabController appTabWidth],
+		.tabOverlap = kTabOverlap,
+		.lastMiniTabSpacing = kLastMiniTabSpacing,
+		.start = [self indentForControls],
+		.hasPlaceholder = placeholderTab_ != nil,
+		.placeholderX = NSMinX(placeholderFrame_) + scrollOffset_,
+		.placeholderWidth = NSWidth(placeholderFrame_),
+	};
 	if ([self inRapidClosureMode]) {
-		availableSpace = availableResizeWidth_;
+		params.availableWidth = availableResizeWidth_;
 	} else {
-		availableSpace = NSWidth([tabStripView_ frame]);
+		params.availableWidth = NSWidth([tabStripView_ frame]);
 		
 		// Account for the width of the new tab button.
-		availableSpace -= NSWidth([newTabButton_ frame]) + kNewTabButtonOffset;
+		params.availableWidth -= NSWidth([newTabButton_ frame]) + kNewTabButtonOffset;
 	}
 	
 	// Need to leave room for the left-side controls even in rapid closure mode.
-	availableSpace -= [self indentForControls];
-	
-	// If there are any mini tabs, account for the extra spacing between the last
-	// mini tab and the first regular tab.
-	if ([self numberOfOpenMiniTabs])
-		availableSpace -= kLastMiniTabSpacing;
-	
-	// This may be negative, but that's okay (taken care of by |MAX()| when
-	// calculating tab sizes). "mini" tabs in horizontal mode just get a special
-	// section, they don't change size.
-	CGFloat availableSpaceForNonMini = availableSpace;
-
-	availableSpaceForNonMini -= 
-		[self numberOfOpenMiniTabs] * (kMiniTabWidth - kTabOverlap);
-
-	// Initialize |nonMiniTabWidth| in case there aren't any non-mini-tabs; this
-	// value shouldn't actually be used.
-	CGFloat nonMiniTabWidth = kMaxTabWidth;
-	CGFloat nonMiniTabWidthFraction = 0;
-	const NSInteger numberOfOpenNonMiniTabs = [self numberOfOpenNonMiniTabs];
-	if (numberOfOpenNonMiniTabs) {
-		// Find the width of a non-mini-tab. This only applies to horizontal
-		// mode. Add in the amount we "get back" from the tabs overlapping.
-		availableSpaceForNonMini += (numberOfOpenNonMiniTabs - 1) * kTabOverlap;
-		
-		// Divide up the space between the non-mini-tabs.
-		nonMiniTabWidth = availableSpaceForNonMini / numberOfOpenNonMiniTabs;
-		
-		// Clamp the width between the max and min.
-		nonMiniTabWidth = MAX(MIN(nonMiniTabWidth, kMaxTabWidth), kMinTabWidth);
-		
-		// Separate integral and fractional parts.
-		CGFloat integralPart = floor(nonMiniTabWidth);
-		nonMiniTabWidthFraction = nonMiniTabWidth - integralPart;
-		nonMiniTabWidth = integralPart;
+	params.availableWidth -= [self indentForControls];
+	
+	NSUInteger count = [tabArray_ count];
+	if (count > layoutCapacity_) {
+		layoutCapacity_ = MAX(count, layoutCapacity_ * 2);
+		layoutFlags_ = (CTTabLayoutFlags*)realloc(
+			layoutFlags_, layoutCapacity_ * sizeof(CTTabLayoutFlags));
+		layoutFrames_ = (CTTabLayoutFrame*)realloc(
+			layoutFrames_, layoutCapacity_ * sizeof(CTTabLayoutFrame));
 	}
 	
-	BOOL visible = [[tabStripView_ window] isVisible];
+	// Refill the flags of the tabs that changed from the model, as most tabs
+	// have no controller. The ones before them are still there from the last
+	// layout. Closing tabs keep their controllers, so the model index to start
+	// at only takes a walk over the tabs with controllers. The active tab may
+	// have changed without any tab being invalidated, so start at the old or
+	// the new one if that's earlier.
+	NSInteger activeIndex = tabStripModel_.activeIndex;
+	NSUInteger activeTab = activeIndex >= 0 ?
+		(NSUInteger)[self indexFromModelIndex:activeIndex] : NSNotFound;
+	if (activeTab != layoutActiveTab_)
+		[self invalidateLayoutFromIndex:MIN(activeTab, layoutActiveTab_)];
+	NSUInteger first = MIN(firstDirtyTab_, count);
+	NSInteger modelIndex = [self modelIndexFromIndex:first] - 1;
+	// Tabs in collapsed groups take up no space.
+	NSIndexSet* collapsedTabs = [tabStripModel_ indicesOfTabsHiddenByCollapsedGroups];
+	for (NSUInteger i = first; i < count; ++i) {
+		id tab = [tabArray_ objectAtIndex:i];
+		CTTabLayoutFlags flags = 0;
+		if ([closingControllers_ containsObject:tab]) {
+			flags |= CTTabLayoutClosing;
+		} else {
+			if ([collapsedTabs containsIndex:++modelIndex])
+				flags |= CTTabLayoutHidden;
+			if ([tabStripModel_ isMiniTabAtIndex:modelIndex])
+				flags |= CTTabLayoutMini;
+			if ([tabStripModel_ isAppTabAtIndex:modelIndex])
+				flags |= CTTabLayoutApp;
+			if (modelIndex == activeIndex)
+				flags |= CTTabLayoutActive;
+			if (placeholderTab_ && tab != [NSNull null] &&
+				[[tab view] isEqual:placeholderTab_])
+				flags |= CTTabLayoutPlaceholder;
+		}
+		layoutFlags_[i] = flags;
+	}
+	
+	int firstLaidOut;
+	CTTabLayoutResult layout =
+		CTTabLayoutUpdate(&layoutState_, &params, layoutFlags_, (int)count,
+						  (int)first, layoutFrames_, &firstLaidOut);
+	firstDirtyTab_ = count;
+	BOOL activeTabChanged = activeTab != layoutActiveTab_;
+	layoutActiveTab_ = activeTab;
+	
+	// Scroll the tabs if they don't fit, showing the active tab when it
+	// changes.
+	CGFloat startOfVisibleTabs = [self indentForControls];
+	CGFloat endOfVisibleTabs = [self endOfVisibleTabs];
+	BOOL wasOverflowing = scrollableWidth_ > 0;
+	scrollableWidth_ = MAX(0, layout.end + kTabOverlap - endOfVisibleTabs);
+	if (activeTabChanged && activeTab != NSNotFound) {
+		NSRect activeFrame = [self frameOfTabAtIndex:activeTab];
+		if (NSMinX(activeFrame) < startOfVisibleTabs)
+			scrollOffset_ -= startOfVisibleTabs - NSMinX(activeFrame);
+		else if (NSMaxX(activeFrame) > endOfVisibleTabs)
+			scrollOffset_ += NSMaxX(activeFrame) - endOfVisibleTabs;
+	}
+	scrollOffset_ = MAX(0, MIN(scrollOffset_, scrollableWidth_));
+	
+	const CGFloat tabHeight = [[self class] defaultTabHeight] + 1;
+	if (layout.maxX > layout.minX) {
+		enclosingRect = NSMakeRect(layout.minX - scrollOffset_, 0,
+								   layout.maxX - layout.minX, tabHeight);
+		enclosingRect = NSIntersectionRect(enclosingRect, [tabStripView_ bounds]);
+	}
+	
+	// Find the tabs in sight and move the controllers of the ones that are no
+	// longer over to the ones that now are. The active tab, the dragged one and
+	// closing ones keep theirs.
+	int firstInSight, endInSight;
+	CTTabLayoutTabsBetween(&layoutState_, startOfVisibleTabs + scrollOffset_,
+						   endOfVisibleTabs + scrollOffset_,
+						   &firstInSight, &endInSight);
+	NSUInteger firstMaterialized =
+		(NSUInteger)firstInSight > kMaterializedTabMargin ?
+		firstInSight - kMaterializedTabMargin : 0;
+	NSUInteger endMaterialized = MIN(endInSight + kMaterializedTabMargin, count);
+	BOOL materializedChanged = NO;
+	NSIndexSet* materialized = [materializedTabs_ copy];
+	for (NSUInteger i = [materialized firstIndex]; i != NSNotFound;
+		 i = [materialized indexGreaterThanIndex:i]) {
+		CTTabLayoutFlags flags = layoutFlags_[i];
+		if (i == activeTab ||
+			(flags & (CTTabLayoutClosing | CTTabLayoutPlaceholder)))
+			continue;
+		if (i >= firstMaterialized && i < endMaterialized &&
+			!(flags & CTTabLayoutHidden))
+			continue;
+		[self recycleTabController:[self unbindTabAtIndex:i]];
+		materializedChanged = YES;
+	}
+	for (NSUInteger i = firstMaterialized; i < endMaterialized; ++i) {
+		if ([materializedTabs_ containsIndex:i] ||
+			(layoutFlags_[i] & CTTabLayoutHidden))
+			continue;
+		[self materializeTabAtIndex:i];
+		materializedChanged = YES;
+	}
+	if (activeTab != NSNotFound && ![materializedTabs_ containsIndex:activeTab]) {
+		[self materializeTabAtIndex:activeTab];
+		materializedChanged = YES;
+	}
+	[insertedContents_ removeAllObjects];
 	
-	CGFloat offset = [self indentForControls];
-	BOOL hasPlaceholderGap = NO;
-	// Whether or not the last tab processed by the loop was a mini tab.
-	BOOL isLastTabMini = NO;
-	CGFloat tabWidthAccumulatedFraction = 0;
-	NSInteger laidOutNonMiniTabs = 0;
+	// Update the current subviews and their z-order if requested, if tabs got
+	// or lost their views or if the new tab button goes above them.
+	if (doUpdate || materializedChanged || wasOverflowing != (scrollableWidth_ > 0))
+		[self regenerateSubviewList];
 	
-	for (CTTabController* tab in tabArray_) {
+	BOOL visible = [[tabStripView_ window] isVisible];
+	
+	// Only the tabs from |firstLaidOut| on can have moved, but tabs that just
+	// got their controllers need to be put in place too. There are only so
+	// many tabs with views, so look at all of them and let the target frames
+	// weed out the ones that didn't move.
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		CTTabController* tab = [tabArray_ objectAtIndex:i];
+		CTTabLayoutFlags flags = layoutFlags_[i];
+		CTTabLayoutFrame frame = layoutFrames_[i];
+		
 		// Ignore a tab that is going through a close animation.
-		if ([closingControllers_ containsObject:tab])
+		if (flags & CTTabLayoutClosing)
 			continue;
 		
-		BOOL isPlaceholder = [[tab view] isEqual:placeholderTab_];
-		NSRect tabFrame = [[tab view] frame];
-		tabFrame.size.height = [[self class] defaultTabHeight] + 1;
-		tabFrame.origin.y = 0;
-		tabFrame.origin.x = offset;
+		// Hide the tabs of collapsed groups. When the group is expanded again
+		// they are animated back in like new tabs.
+		if (flags & CTTabLayoutHidden) {
+			[[tab view] setHidden:YES];
+			continue;
+		}
+		
+		NSRect tabFrame = NSMakeRect(frame.x - scrollOffset_, 0, frame.width,
+									 tabHeight);
 		
 		// If the tab is hidden, we consider it a new tab. We make it visible
 		// and animate it in.
@@ -858,7 +1257,7 @@ const NSTimeInterval kAnimationDuration = 0.125;
 			[[tab view] setHidden:NO];
 		}
 		
-		if (isPlaceholder) {
+		if (flags & CTTabLayoutPlaceholder) {
 			// Move the current tab to the correct location instantly.
 			// We need a duration or else it doesn't cancel an inflight animation.
 			//      ScopedNSAnimationContextGroup localAnimationGroup(animate);
@@ -868,8 +1267,6 @@ const NSTimeInterval kAnimationDuration = 0.125;
 				[[NSAnimationContext currentContext] setDuration:0];
 			}
 			
-			tabFrame.origin.x = placeholderFrame_.origin.x;
-			
 			id target = animate ? [[tab view] animator] : [tab view];
 			[target setFrame:tabFrame];
 			
@@ -881,57 +1278,6 @@ const NSTimeInterval kAnimationDuration = 0.125;
 			continue;
 		}
 		
-		if (placeholderTab_ && !hasPlaceholderGap) {
-			const CGFloat placeholderMin = NSMinX(placeholderFrame_);
-			// If the left edge is to the left of the placeholder's left, but the
-			// mid is to the right of it slide over to make space for it.
-			if (NSMidX(tabFrame) > placeholderMin) {
-				hasPlaceholderGap = YES;
-				offset += NSWidth(placeholderFrame_);
-				offset -= kTabOverlap;
-				tabFrame.origin.x = offset;
-			}
-		}
-		
-		// Set the width. Active tabs are slightly wider when things get really
-		// small and thus we enforce a different minimum width.
-		BOOL isMini = [tab isMini];
-		if (isMini) {
-			tabFrame.size.width = [tab isApp] ? kAppTabWidth : kMiniTabWidth;
-		} else {
-			// Tabs have non-integer widths. Assign the integer part to the tab, and
-			// keep an accumulation of the fractional parts. When the fractional
-			// accumulation gets to be more than one pixel, assign that to the current
-			// tab being laid out. This is vaguely inspired by Bresenham's line
-			// algorithm.
-			tabFrame.size.width = nonMiniTabWidth;
-			tabWidthAccumulatedFraction += nonMiniTabWidthFraction;
-			
-			if (tabWidthAccumulatedFraction >= 1.0) {
-				++tabFrame.size.width;
-				--tabWidthAccumulatedFraction;
-			}
-			
-			// In case of rounding error, give any left over pixels to the last tab.
-			if (laidOutNonMiniTabs == numberOfOpenNonMiniTabs - 1 &&
-				tabWidthAccumulatedFraction > 0.5) {
-				++tabFrame.size.width;
-			}
-			
-			++laidOutNonMiniTabs;
-		}
-		
-		if ([tab isActive])
-			tabFrame.size.width = MAX(tabFrame.size.width, kMinActiveTabWidth);
-		
-		// If this is the first non-mini tab, then add a bit of spacing between this
-		// and the last mini tab.
-		if (!isMini && isLastTabMini) {
-			offset += kLastMiniTabSpacing;
-			tabFrame.origin.x = offset;
-		}
-		isLastTabMini = isMini;
-		
 		// Animate a new tab in by putting it below the horizon unless told to put
 		// it in a specific location (i.e., from a drop).
 		if (newTab && visible && animate) {
@@ -943,10 +1289,14 @@ const NSTimeInterval kAnimationDuration = 0.125;
 			}
 		}
 		
-		// Check the frame by identifier to avoid redundant calls to animator.
-		id frameTarget = visible && animate ? [[tab view] animator] : [tab view];
+		// Only apply the frames that changed. Checking the frame by identifier
+		// also avoids redundant calls to animator. A tab that just came into
+		// sight has no target frame and is put in place right away.
 		NSValue* identifier = [NSValue valueWithPointer:(__bridge const void*)[tab view]];
 		NSValue* oldTargetValue = [targetFrames_ objectForKey:identifier];
+		BOOL rebound = !oldTargetValue && !newTab;
+		id frameTarget = visible && animate && !rebound ?
+			[[tab view] animator] : [tab view];
 		if (!oldTargetValue ||
 			!NSEqualRects([oldTargetValue rectValue], tabFrame)) {
 			[frameTarget setFrame:tabFrame];
@@ -954,14 +1304,14 @@ const NSTimeInterval kAnimationDuration = 0.125;
 							  forKey:identifier];
 		}
 		
-		enclosingRect = NSUnionRect(tabFrame, enclosingRect);
-		
-		offset += NSWidth(tabFrame);
-		offset -= kTabOverlap;
-		
 		[NSAnimationContext endGrouping];
 	}
 	
+	// Where the tabs end, unless they overflow, in which case the new tab
+	// button stays at the end of the strip.
+	CGFloat offset = MIN(layout.end - scrollOffset_,
+						 endOfVisibleTabs - kTabOverlap);
+	
 	// Hide the new tab button if we're explicitly told to. It may already
 	// be hidden, doing it again doesn't hurt. Otherwise position it
 	// appropriately, showing it if necessary.
@@ -1037,17 +1387,9 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	[tab setTitle:titleString];
 }
 
-// Remove all knowledge about this tab and its associated controller, and remove
-// the view from the strip.
-- (void)removeTab:(CTTabController*)controller {
-	NSUInteger index = [tabArray_ indexOfObject:controller];
-	
-	// Release the tab contents controller so those views get destroyed. This
-	// will remove all the tab content Cocoa views from the hierarchy. A
-	// subsequent "select tab" notification will follow from the model. To
-	// tell us what to swap in in its absence.
-	[tabContentsArray_ removeObjectAtIndex:index];
-	
+// Takes the view of |controller|, which no tab uses anymore, out of the strip
+// and keeps the controller for |-newTab| if there aren't too many already.
+- (void)recycleTabController:(CTTabController*)controller {
 	// Remove the view from the tab strip.
 	NSView* tab = [controller view];
 	[tab removeFromSuperview];
@@ -1069,8 +1411,36 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	NSValue* identifier = [NSValue valueWithPointer:(__bridge const void*)tab];
 	[targetFrames_ removeObjectForKey:identifier];
 	
-	// Once we're totally done with the tab, delete its controller
+	if ([spareTabControllers_ count] < kMaxSpareTabControllerCount) {
+		[controller prepareForReuse];
+		[spareTabControllers_ addObject:controller];
+	}
+}
+
+// Remove all knowledge about the tab at |index| into |tabArray_| and its
+// associated controller, if it has one, and remove the view from the strip.
+- (void)removeTabAtIndex:(NSUInteger)index {
+	// Release the tab contents controller so those views get destroyed. This
+	// will remove all the tab content Cocoa views from the hierarchy. A
+	// subsequent "select tab" notification will follow from the model. To
+	// tell us what to swap in in its absence.
+	[tabContentsArray_ removeObjectAtIndex:index];
+	
+	if ([materializedTabs_ containsIndex:index]) {
+		[self recycleTabController:[tabArray_ objectAtIndex:index]];
+		[materializedTabs_ removeIndex:index];
+	}
+	
+	// Once we're totally done with the tab, drop its slot.
 	[tabArray_ removeObjectAtIndex:index];
+	[materializedTabs_ shiftIndexesStartingAtIndex:index + 1 by:-1];
+	[self invalidateLayoutFromIndex:index];
+}
+
+// Remove all knowledge about this tab and its associated controller, and remove
+// the view from the strip.
+- (void)removeTab:(CTTabController*)controller {
+	[self removeTabAtIndex:[tabArray_ indexOfObject:controller]];
 }
 
 // Called by the CAAnimation delegate when the tab completes the closing
@@ -1154,8 +1524,11 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		assert(sadFaviconImage);
 	}
 	
-	// Take closing tabs into account.
+	// Take closing tabs into account. Tabs without a controller get their icon
+	// when they come into sight.
 	NSInteger index = [self indexFromModelIndex:modelIndex];
+	if (![materializedTabs_ containsIndex:index])
+		return;
 	
 	CTTabController* tabController = [tabArray_ objectAtIndex:index];
 		
@@ -1221,7 +1594,7 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	int activeIndex = tabStripModel_.activeIndex;
 	// Take closing tabs into account. They can't ever be active.
 	activeIndex = [self indexFromModelIndex:activeIndex];
-	return [self viewAtIndex:activeIndex];
+	return [[self tabControllerAtIndex:activeIndex] view];
 }
 
 // Find the model index based on the x coordinate of the placeholder. If there
@@ -1231,28 +1604,28 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	double placeholderX = placeholderFrame_.origin.x;
 	int index = 0;
 	int location = 0;
-	// Use |tabArray_| here instead of the tab strip count in order to get the
-	// correct index when there are closing tabs to the left of the placeholder.
-	const int count = [tabArray_ count];
+	// Use the last layout here instead of the tab strip count in order to get
+	// the correct index when there are closing tabs to the left of the
+	// placeholder. Most tabs have no view, so their frames come from there too.
+	const int count = layoutState_.count;
 	while (index < count) {
 		// Ignore closing tabs for simplicity. The only drawback of this is that
 		// if the placeholder is placed right before one or several contiguous
 		// currently closing tabs, the associated CTTabController will start at the
 		// end of the closing tabs.
-		if ([closingControllers_ containsObject:[tabArray_ objectAtIndex:index]]) {
+		if (layoutFlags_[index] & CTTabLayoutClosing) {
 			index++;
 			continue;
 		}
-		NSView* curr = [self viewAtIndex:index];
 		// The placeholder tab works by changing the frame of the tab being dragged
 		// to be the bounds of the placeholder, so we need to skip it while we're
 		// iterating, otherwise we'll end up off by one.  Note This only effects
 		// dragging to the right, not to the left.
-		if (curr == placeholderTab_) {
+		if (layoutFlags_[index] & CTTabLayoutPlaceholder) {
 			index++;
 			continue;
 		}
-		if (placeholderX <= NSMinX([curr frame]))
+		if (placeholderX <= NSMinX([self frameOfTabAtIndex:index]))
 			break;
 		index++;
 		location++;
@@ -1390,8 +1763,9 @@ const NSTimeInterval kAnimationDuration = 0.125;
 // when the mouse is in the tabstrip.
 - (void)setTabTrackingAreasEnabled:(BOOL)enabled {
 	NSNotificationCenter* defaultCenter = [NSNotificationCenter defaultCenter];
-	for (CTTabController* controller in tabArray_) {
-		CTTabView* tabView = [controller tabView];
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		CTTabView* tabView = [[tabArray_ objectAtIndex:i] tabView];
 		if (enabled) {
 			// Set self up to observe tabs so hover states will be correct.
 			[defaultCenter addObserver:self
@@ -1444,8 +1818,11 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	NSMutableArray* subviews = [NSMutableArray arrayWithArray:permanentSubviews_];
 	
 	NSView* activeTabView = nil;
-	// Go through tabs in reverse order, since |subviews| is bottom-to-top.
-	for (CTTabController* tab in [tabArray_ reverseObjectEnumerator]) {
+	// Go through tabs in reverse order, since |subviews| is bottom-to-top. Only
+	// the tabs with controllers have views.
+	for (NSUInteger i = [materializedTabs_ lastIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexLessThanIndex:i]) {
+		CTTabController* tab = [tabArray_ objectAtIndex:i];
 		NSView* tabView = [tab view];
 		if ([tab isActive]) {
 			assert(!activeTabView);
@@ -1457,6 +1834,11 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	if (activeTabView) {
 		[subviews addObject:activeTabView];
 	}
+	// Tabs that don't fit scroll under the new tab button.
+	if (scrollableWidth_ > 0 && [subviews containsObject:newTabButton_]) {
+		[subviews removeObject:newTabButton_];
+		[subviews addObject:newTabButton_];
+	}
 	[tabStripView_ setSubviews:subviews];
 	[self setTabTrackingAreasEnabled:mouseInside_];
 }
@@ -1474,15 +1856,12 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	const double kLRProportion = (1.0 - kMiddleProportion) / 2.0;
 	
 	assert(index && disposition);
-	NSInteger i = 0;
-	for (CTTabController* tab in tabArray_) {
-		NSView* view = [tab view];
-		assert([view isKindOfClass:[CTTabView class]]);
-		
-		// Recall that |-[NSView frame]| is in its superview's coordinates, so a
-		// |CTTabView|'s frame is in the coordinates of the |CTTabStripView| (which
-		// matches the coordinate system of |point|).
-		NSRect frame = [view frame];
+	const NSInteger count = [tabArray_ count];
+	for (NSInteger i = 0; i < count; ++i) {
+		// Tab frames are in the coordinates of the |CTTabStripView| (which
+		// matches the coordinate system of |point|). Most tabs have no view, so
+		// ask the layout.
+		NSRect frame = [self frameOfTabAtIndex:i];
 		
 		// Modify the frame to make it "unoverlapped".
 		frame.origin.x += kTabOverlap / 2.0;
@@ -1507,7 +1886,6 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		
 		// (Dropping in a new tab to the right of tab |i| will be taken care of in
 		// the next iteration.)
-		i++;
 	}
 	
 	// If we've made it here, we want to append a new tab to the end.
@@ -1579,10 +1957,10 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		// Append a tab at the end.
 		assert(disposition == CTWindowOpenDispositionNewForegroundTab);
 		NSInteger lastIndex = [tabArray_ count] - 1;
-		NSRect overRect = [[[tabArray_ objectAtIndex:lastIndex] view] frame];
+		NSRect overRect = [self frameOfTabAtIndex:lastIndex];
 		arrowPos.x = overRect.origin.x + overRect.size.width - kTabOverlap / 2.0;
 	} else {
-		NSRect overRect = [[[tabArray_ objectAtIndex:index] view] frame];
+		NSRect overRect = [self frameOfTabAtIndex:index];
 		switch (disposition) {
 			case CTWindowOpenDispositionNewForegroundTab:
 				// Insert tab (to the left of the given tab).
@@ -1620,7 +1998,7 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	if (index < 0 ||
 		index >= (NSInteger)[tabContentsArray_ count])
 		return nil;
-	return [tabContentsArray_ objectAtIndex:index];
+	return [self contentsControllerAtIndex:index];
 }
 
 /*- (void)attachConstrainedWindow:(ConstrainedWindowMac*)window {
@@ -1704,47 +2082,26 @@ const NSTimeInterval kAnimationDuration = 0.125;
 #pragma mark -
 #pragma mark Delegate methods
 
-- (void)tabDidInsert:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger modelIndex = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
-	BOOL isInForeground = [[userInfo valueForKey:CTTabOptionsUserInfoKey] boolValue];
-	[self tabInsertedWithContents:contents atIndex:modelIndex inForeground:isInForeground];
-}
-
 // Called when a notification is received from the model to insert a new tab
 // at |modelIndex|.
 - (void)tabInsertedWithContents:(CTTabContents*)contents
                         atIndex:(NSInteger)modelIndex
                    inForeground:(BOOL)inForeground {
-	assert(contents);
+	// |contents| is nil for a deferred tab.
 	assert(modelIndex == kNoTab ||
 		   [tabStripModel_ containsIndex:modelIndex]);
 	
 	// Take closing tabs into account.
 	NSInteger index = [self indexFromModelIndex:modelIndex];
 	
-	// Make a new tab. Load the contents of this tab from the nib and associate
-	// the new controller with |contents| so it can be looked up later.
-	CTTabContentsController* contentsController =
-	[browser_ createTabContentsControllerWithContents:contents];
-	[tabContentsArray_ insertObject:contentsController atIndex:index];
-	
-	// Make a new tab and add it to the strip. Keep track of its controller.
-	CTTabController* newController = [self newTab];
-	[newController setMini:[tabStripModel_ isMiniTabAtIndex:modelIndex]];
-	[newController setPinned:[tabStripModel_ isTabPinnedAtIndex:modelIndex]];
-	[newController setApp:[tabStripModel_ isAppTabAtIndex:modelIndex]];
-	[tabArray_ insertObject:newController atIndex:index];
-	NSView* newView = [newController view];
-	
-	// Set the originating frame to just below the strip so that it animates
-	// upwards as it's being initially layed out. Oddly, this works while doing
-	// something similar in |-layoutTabs| confuses the window server.
-	[newView setFrame:NSOffsetRect([newView frame],
-								   0, -[[self class] defaultTabHeight])];
-	
-	[self setTabTitle:newController withContents:contents];
+	// Make room for the new tab. It gets its controllers, and animates in, if
+	// the layout finds it in sight (see |-materializeTabAtIndex:|).
+	[tabContentsArray_ insertObject:[NSNull null] atIndex:index];
+	[tabArray_ insertObject:[NSNull null] atIndex:index];
+	[materializedTabs_ shiftIndexesStartingAtIndex:index by:1];
+	if (contents)
+		[insertedContents_ addObject:contents];
+	[self invalidateLayoutFromIndex:index];
 	
 	// If a tab is being inserted, we can again use the entire tab strip width
 	// for layout.
@@ -1753,35 +2110,19 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	// We don't need to call |-layoutTabs| if the tab will be in the foreground
 	// because it will get called when the new tab is selected by the tab model.
 	// Whenever |-layoutTabs| is called, it'll also add the new subview.
+	// The favicon is put into the right state up front when the tab gets its
+	// controller, which matters when we're dragging a tab out into a new window
+	// as we won't be told to do it from anywhere else.
 	if (!inForeground) {
 		[self layoutTabs];
 	}
 	
-	// During normal loading, we won't yet have a favicon and we'll get
-	// subsequent state change notifications to show the throbber, but when we're
-	// dragging a tab out into a new window, we have to put the tab's favicon
-	// into the right state up front as we won't be told to do it from anywhere
-	// else.
-	[self updateFavIconForContents:contents atIndex:modelIndex];
-	
 	// Send a broadcast that the number of tabs have changed.
 	[[NSNotificationCenter defaultCenter]
 	 postNotificationName:kTabStripNumberOfTabsChanged
 	 object:self];
 }
 
-- (void)tabDidSelect:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *newContents = [userInfo valueForKey:CTTabNewContentsUserInfoKey];
-	CTTabContents *oldContents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger modelIndex = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
-	BOOL wasUserGesture = [[userInfo valueForKey:CTTabOptionsUserInfoKey] boolValue];
-	[self tabSelectedWithContents:newContents 
-				 previousContents:oldContents 
-						  atIndex:modelIndex 
-					  userGesture:wasUserGesture];
-}
-
 // Called when a notification is received from the model to select a particular
 // tab. Swaps in the toolbar and content area associated with |newContents|.
 - (void)tabSelectedWithContents:(CTTabContents*)newContents
@@ -1796,24 +2137,27 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		//browser_->GetIndexOfController(&(oldContents->controller()));
 		if (oldModelIndex != -1) {  // When closing a tab, the old tab may be gone.
 			NSInteger oldIndex = [self indexFromModelIndex:oldModelIndex];
-			CTTabContentsController* oldController =
-			[tabContentsArray_ objectAtIndex:oldIndex];
-			[oldController willResignActiveTab];
+			id oldController = [tabContentsArray_ objectAtIndex:oldIndex];
+			if (oldController != [NSNull null])
+				[oldController willResignActiveTab];
 			//oldContents->view()->StoreFocus();
 		}
 	}
 	
-	// De-select all other tabs and select the new tab.
-	int i = 0;
-	for (CTTabController* current in tabArray_) {
-		[current setActive:(i == index) ? YES : NO];
-		++i;
+	// De-select all other tabs and select the new tab, which always has a
+	// controller. The layout notices that the active tab changed, which may be
+	// wider than the others.
+	[self tabControllerAtIndex:index];
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		[[tabArray_ objectAtIndex:i] setActive:i == (NSUInteger)index];
 	}
+	[self updateSelectedStateOfTabs];
 	
 	// Tell the new tab contents it is about to become the active tab. Here it
 	// can do things like make sure the toolbar is up to date.
 	CTTabContentsController *newController =
-	[tabContentsArray_ objectAtIndex:index];
+	[self contentsControllerAtIndex:index];
 	[newController willBecomeActiveTab];
 	
 	// Relayout for new tabs and to let the active tab grow to be larger in
@@ -1836,14 +2180,6 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	}
 }
 
-- (void)tabDidChange:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger modelIndex = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
-	CTTabChangeType change = (CTTabChangeType)[[userInfo valueForKey:CTTabOptionsUserInfoKey] intValue];
-	[self tabChangedWithContents:contents atIndex:modelIndex changeType:change];
-}
-
 // Called when a notification is received from the model that the given tab
 // has been updated. |loading| will be YES when we only want to update the
 // throbber state, not anything else about the (partially) loading tab.
@@ -1859,6 +2195,11 @@ const NSTimeInterval kAnimationDuration = 0.125;
 		return;
 	}
 	
+	// A tab without controllers gets its title and icon, and the contents
+	// controller its contents, when it needs them.
+	if (![materializedTabs_ containsIndex:index])
+		return;
+	
 	CTTabController* tabController = [tabArray_ objectAtIndex:index];
 	
 	if (change != CTTabChangeTypeLoadingOnly)
@@ -1866,17 +2207,9 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	
 	[self updateFavIconForContents:contents atIndex:modelIndex];
 	
-	CTTabContentsController* updatedController =
-	[tabContentsArray_ objectAtIndex:index];
-	[updatedController tabDidChange:contents];
-}
-
-- (void)tabDidMove:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger modelFrom = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
-	NSInteger modelTo = [[userInfo valueForKey:CTTabToIndexUserInfoKey] intValue];
-	[self tabMovedWithContents:contents fromIndex:modelFrom toIndex:modelTo];
+	id updatedController = [tabContentsArray_ objectAtIndex:index];
+	if (updatedController != [NSNull null])
+		[updatedController tabDidChange:contents];
 }
 
 // Called when a tab is moved (usually by drag&drop). Keep our parallel arrays
@@ -1893,21 +2226,58 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	[tabContentsArray_ removeObjectAtIndex:from];
 	[tabContentsArray_ insertObject:movedTabContentsController
 							atIndex:to];
-	CTTabController* movedTabController = [tabArray_ objectAtIndex:from];
-	assert([movedTabController isKindOfClass:[CTTabController class]]);
+	id movedTabController = [tabArray_ objectAtIndex:from];
 	[tabArray_ removeObjectAtIndex:from];
 	[tabArray_ insertObject:movedTabController atIndex:to];
-	
-	// The tab moved, which means that the mini-tab state may have changed.
-	if ([tabStripModel_ isMiniTabAtIndex:modelTo] != [movedTabController isMini])
+	BOOL materialized = [materializedTabs_ containsIndex:from];
+	[materializedTabs_ removeIndex:from];
+	[materializedTabs_ shiftIndexesStartingAtIndex:from + 1 by:-1];
+	[materializedTabs_ shiftIndexesStartingAtIndex:to by:1];
+	if (materialized)
+		[materializedTabs_ addIndex:to];
+	[self invalidateLayoutFromIndex:MIN(from, to)];
+	
+	// The tab moved, which means that the mini-tab state may have changed. The
+	// layout asks the model about tabs without a controller.
+	if (materialized &&
+		[tabStripModel_ isMiniTabAtIndex:modelTo] != [movedTabController isMini])
 		[self tabMiniStateChangedWithContents:contents atIndex:modelTo];
 }
 
-- (void)tabDidChangeMiniState:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger modelIndex = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
-	[self tabMiniStateChangedWithContents:contents atIndex:modelIndex];
+// Called when the model rearranges the whole strip at once. Keep our parallel
+// arrays in sync in one pass. Tabs that are animating closed keep their slots;
+// the open tabs are permuted among the remaining ones. The model keeps
+// mini-tabs in front, so no tab's mini state changes.
+- (void)tabsReorderedWithPermutation:(const int*)permutation {
+	NSMutableArray* openSlots =
+	[NSMutableArray arrayWithCapacity:[tabStripModel_ count]];
+	NSInteger slot = 0;
+	for (CTTabController* controller in tabArray_) {
+		if (![closingControllers_ containsObject:controller])
+			[openSlots addObject:[NSNumber numberWithInteger:slot]];
+		++slot;
+	}
+	
+	NSArray* oldTabs = [tabArray_ copy];
+	NSArray* oldContents = [tabContentsArray_ copy];
+	NSIndexSet* oldMaterializedTabs = [materializedTabs_ copy];
+	for (NSUInteger i = 0; i < [openSlots count]; ++i) {
+		NSUInteger to = [[openSlots objectAtIndex:i] unsignedIntegerValue];
+		NSUInteger from =
+		[[openSlots objectAtIndex:permutation[i]] unsignedIntegerValue];
+		if (from == to)
+			continue;
+		[tabArray_ replaceObjectAtIndex:to withObject:[oldTabs objectAtIndex:from]];
+		[tabContentsArray_ replaceObjectAtIndex:to
+									 withObject:[oldContents objectAtIndex:from]];
+		if ([oldMaterializedTabs containsIndex:from])
+			[materializedTabs_ addIndex:to];
+		else
+			[materializedTabs_ removeIndex:to];
+		[self invalidateLayoutFromIndex:to];
+	}
+	
+	[self layoutTabs];
 }
 
 // Called when a tab is pinned or unpinned without moving.
@@ -1916,11 +2286,13 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	// Take closing tabs into account.
 	NSInteger index = [self indexFromModelIndex:modelIndex];
 	
-	CTTabController* tabController = [tabArray_ objectAtIndex:index];
-	assert([tabController isKindOfClass:[CTTabController class]]);
-	[tabController setMini:[tabStripModel_ isMiniTabAtIndex:modelIndex]];
-	[tabController setPinned:[tabStripModel_ isTabPinnedAtIndex:modelIndex]];
-	[tabController setApp:[tabStripModel_ isAppTabAtIndex:modelIndex]];
+	if ([materializedTabs_ containsIndex:index]) {
+		CTTabController* tabController = [tabArray_ objectAtIndex:index];
+		[tabController setMini:[tabStripModel_ isMiniTabAtIndex:modelIndex]];
+		[tabController setPinned:[tabStripModel_ isTabPinnedAtIndex:modelIndex]];
+		[tabController setApp:[tabStripModel_ isAppTabAtIndex:modelIndex]];
+	}
+	[self invalidateLayoutFromIndex:index];
 	[self updateFavIconForContents:contents atIndex:modelIndex];
 	// If the tab is being restored and it's pinned, the mini state is set after
 	// the tab has already been rendered, so re-layout the tabstrip. In all other
@@ -1928,13 +2300,6 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	[self layoutTabs];
 }
 
-- (void)tabDidDetach:(NSNotification *)notification {
-	NSDictionary *userInfo = notification.userInfo;
-	CTTabContents *contents = [userInfo valueForKey:CTTabContentsUserInfoKey];
-	NSInteger modelIndex = [[userInfo valueForKey:CTTabIndexUserInfoKey] intValue];
-	[self tabDetachedWithContents:contents atIndex:modelIndex];
-}
-
 // Called when a notification is received from the model that the given tab
 // has gone away. Start an animation then force a layout to put everything
 // in motion.
@@ -1943,17 +2308,147 @@ const NSTimeInterval kAnimationDuration = 0.125;
 	// Take closing tabs into account.
 	NSInteger index = [self indexFromModelIndex:modelIndex];
 	
-	CTTabController* tab = [tabArray_ objectAtIndex:index];
-	if ([tabStripModel_ count] > 0) {
-		[self startClosingTabWithAnimation:tab];
-		[self layoutTabs];
+	// A tab without a view has nothing to animate and goes right away.
+	[self invalidateLayoutFromIndex:index];
+	if ([tabStripModel_ count] > 0 && [materializedTabs_ containsIndex:index]) {
+		[self startClosingTabWithAnimation:[tabArray_ objectAtIndex:index]];
 	} else {
-		[self removeTab:tab];
+		[self removeTabAtIndex:index];
+	}
+	if ([tabStripModel_ count] > 0)
+		[self layoutTabs];
+	
+	// Send a broadcast that the number of tabs have changed.
+	[[NSNotificationCenter defaultCenter] postNotificationName:kTabStripNumberOfTabsChanged
+														object:self];
+}
+
+// Called when the model removes a contiguous run of tabs at once. Same as
+// |-tabDetachedWithContents:atIndex:| for each of them, but finds their
+// controllers with a single walk over |tabArray_| and lays out once.
+- (void)tabsDetachedInRange:(NSRange)modelRange {
+	// Take closing tabs into account.
+	NSInteger index = [self indexFromModelIndex:modelRange.location];
+	
+	[self invalidateLayoutFromIndex:index];
+	BOOL animate = [tabStripModel_ count] > 0;
+	NSMutableArray* detached = [NSMutableArray array];
+	NSMutableIndexSet* removed = [NSMutableIndexSet indexSet];
+	NSUInteger found = 0;
+	for (NSInteger i = index; found < modelRange.length; ++i) {
+		id tab = [tabArray_ objectAtIndex:i];
+		if ([closingControllers_ containsObject:tab])
+			continue;
+		++found;
+		if (animate && [materializedTabs_ containsIndex:i])
+			[detached addObject:tab];
+		else
+			[removed addIndex:i];
 	}
 	
+	// Tabs without a view go right away, all in one go like the model does, as
+	// that is nearly all of them. Only the tabs with controllers are renumbered
+	// one by one.
+	NSMutableIndexSet* materialized = [NSMutableIndexSet indexSet];
+	for (NSUInteger i = [materializedTabs_ firstIndex]; i != NSNotFound;
+		 i = [materializedTabs_ indexGreaterThanIndex:i]) {
+		if ([removed containsIndex:i]) {
+			[self recycleTabController:[tabArray_ objectAtIndex:i]];
+			continue;
+		}
+		[materialized addIndex:i - [removed countOfIndexesInRange:NSMakeRange(0, i)]];
+	}
+	[materializedTabs_ removeAllIndexes];
+	[materializedTabs_ addIndexes:materialized];
+	[tabContentsArray_ removeObjectsAtIndexes:removed];
+	[tabArray_ removeObjectsAtIndexes:removed];
+	for (CTTabController* tab in detached)
+		[self startClosingTabWithAnimation:tab];
+	if (animate)
+		[self layoutTabs];
+	
 	// Send a broadcast that the number of tabs have changed.
 	[[NSNotificationCenter defaultCenter] postNotificationName:kTabStripNumberOfTabsChanged
 														object:self];
 }
 
+// Called when the model commits a batch of updates (see
+// |-[CTTabStripModel beginUpdates]|). Does the layout that was deferred while
+// the batch was recorded, unless the coalesced selection change already did.
+- (void)tabStripModelDidCommitUpdates:(CTTabStripChangeSet*)changes {
+	if (layoutDeferredForUpdates_)
+		[self layoutTabs];
+}
+
+#pragma mark -
+#pragma mark CTTabStripModelObserver
+
+- (void)tabStripModel:(CTTabStripModel*)model
+	  didReceiveEvent:(const CTTabStripModelEvent*)event {
+	switch (event->type) {
+		case CTTabStripModelEventInserted:
+			[self tabInsertedWithContents:event->contents
+								  atIndex:event->index
+							 inForeground:event->flag];
+			break;
+		case CTTabStripModelEventSelected:
+			[self tabSelectedWithContents:event->contents
+						 previousContents:event->oldContents
+								  atIndex:event->index
+							  userGesture:event->flag];
+			break;
+		case CTTabStripModelEventSelectionChanged:
+			[self updateSelectedStateOfTabs];
+			break;
+		case CTTabStripModelEventChanged:
+			[self tabChangedWithContents:event->contents
+								 atIndex:event->index
+							  changeType:event->changeType];
+			break;
+		case CTTabStripModelEventReplaced:
+			// Points the tab's contents controller at the new contents, like
+			// when a placeholder is loaded.
+			[self tabChangedWithContents:event->contents
+								 atIndex:event->index
+							  changeType:CTTabChangeTypeAll];
+			break;
+		case CTTabStripModelEventMoved:
+			[self tabMovedWithContents:event->contents
+							 fromIndex:event->index
+							   toIndex:event->toIndex];
+			break;
+		case CTTabStripModelEventReordered:
+			[self tabsReorderedWithPermutation:event->permutation];
+			break;
+		case CTTabStripModelEventMiniStateChanged:
+			[self tabMiniStateChangedWithContents:event->contents
+										  atIndex:event->index];
+			break;
+		case CTTabStripModelEventDetached:
+			[self tabDetachedWithContents:event->contents
+								  atIndex:event->index];
+			break;
+		case CTTabStripModelEventDetachedRange:
+			[self tabsDetachedInRange:event->range];
+			break;
+		case CTTabStripModelEventDidCommitUpdates:
+			[self tabStripModelDidCommitUpdates:event->changes];
+			break;
+		case CTTabStripModelEventGroupChanged:
+			// Collapsing or expanding a group shows or hides its tabs. The ones
+			// shown are animated in like new tabs.
+			for (NSUInteger i = event->range.location;
+				 i < NSMaxRange(event->range); ++i) {
+				if (![tabStripModel_ isTabDeferredAtIndex:i])
+					[insertedContents_ addObject:[tabStripModel_ tabContentsAtIndex:i]];
+			}
+			[self invalidateLayoutFromIndex:
+				[self indexFromModelIndex:event->range.location]];
+			[self layoutTabs];
+			break;
+		default:
+			break;
+	}
+}
+
 @end
@@ -12,14 +12,18 @@
 #import "CTPageTransition.h"
 #import "CTTabStripModelDelegate.h"
 
+@class CTTabStripModel;
 @class CTTabStripModelOrderController;
 @class CTTabContents;
+@class CTTabStripChangeSet;
+@class CTTabStripSnapshot;
 
 extern NSString* const CTTabInsertedNotification;
 extern NSString* const CTTabClosingNotification;
 extern NSString* const CTTabDetachedNotification;
 extern NSString* const CTTabDeselectedNotification;
 extern NSString* const CTTabSelectedNotification;
+extern NSString* const CTTabSelectionChangedNotification;
 extern NSString* const CTTabMovedNotification;
 extern NSString* const CTTabChangedNotification;
 extern NSString* const CTTabReplacedNotification;
@@ -28,6 +32,8 @@ extern NSString* const CTTabBlockedStateChangedNotification;
 extern NSString* const CTTabMiniStateChangedNotification;
 extern NSString* const CTTabStripEmptyNotification;
 extern NSString* const CTTabStripModelDeletedNotification;
+extern NSString* const CTTabStripModelDidCommitUpdatesNotification;
+extern NSString* const CTTabGroupChangedNotification;
 
 extern NSString* const CTTabContentsUserInfoKey;
 extern NSString* const CTTabNewContentsUserInfoKey;
@@ -35,8 +41,12 @@ extern NSString* const CTTabIndexUserInfoKey;
 extern NSString* const CTTabToIndexUserInfoKey;
 extern NSString* const CTTabForegroundUserInfoKey;
 extern NSString* const CTTabOptionsUserInfoKey;
+extern NSString* const CTTabChangeSetUserInfoKey;
+extern NSString* const CTTabGroupUserInfoKey;
 
 extern const int kNoTab;
+// The group of a tab that is not in one.
+extern const int kNoTabGroup;
 
 // Policy for how new tabs are inserted.
 typedef enum {
@@ -77,15 +87,13 @@ typedef enum {
 	// specified index. Otherwise the index supplied is used.
 	ADD_FORCE_INDEX   = 1 << 2,
 	
-	// If set the newly inserted tab inherits the group of the currently
-	// active tab. If not set the tab may still inherit the group under
-	// certain situations.
+	// If set the newly inserted tab joins the group of the currently active
+	// tab, and is kept within it. Its opener is left alone. If not set the
+	// tab still joins a group when it is inserted between two of its tabs.
 	ADD_INHERIT_GROUP = 1 << 3,
 	
 	// If set the newly inserted tab's opener is set to the currently active
-	// tab. If not set the tab may still inherit the group/opener under certain
-	// situations.
-	// NOTE: this is ignored if ADD_INHERIT_GROUP is set.
+	// tab. This is the only flag that sets the opener.
 	ADD_INHERIT_OPENER = 1 << 4,
 } AddTabTypes;
 
@@ -112,9 +120,117 @@ typedef enum {
 	CommandCloseTabsToRight,
 	CommandRestoreTab,
 	CommandTogglePinned,
+	CommandMoveTabsToNewWindow,
 	CommandLast,
 } ContextMenuCommand;
 
+// Describes everything that happened to a CTTabStripModel between a
+// |beginUpdates| and the matching |endUpdates|. Delivered with the
+// CTTabStripModelEventDidCommitUpdates event (and as the
+// CTTabChangeSetUserInfoKey of a CTTabStripModelDidCommitUpdatesNotification).
+@interface CTTabStripChangeSet : NSObject
+
+// Indices, in the model as it was before the updates began, of the tabs that
+// were removed.
+@property (readonly, nonatomic) NSIndexSet *removedIndices;
+// Indices, in the model as it is now, of the tabs that were inserted.
+@property (readonly, nonatomic) NSIndexSet *insertedIndices;
+// Indices, in the model as it is now, of tabs that existed before the
+// updates and were moved.
+@property (readonly, nonatomic) NSIndexSet *movedIndices;
+// Indices, in the model as it is now, of tabs whose state or contents
+// changed.
+@property (readonly, nonatomic) NSIndexSet *changedIndices;
+// The active index once the updates were committed.
+@property (readonly, nonatomic) int activeIndex;
+// YES if a different tab is active than before the updates began.
+@property (readonly, nonatomic) BOOL activeTabChanged;
+
+@end
+
+// The kinds of event delivered to a CTTabStripModelObserver. Each one
+// corresponds to the notification of the same name; a DetachedRange event is
+// posted as one CTTabDetachedNotification per tab, and a Reordered event as
+// the sequence of CTTabMovedNotifications that has the same effect.
+typedef enum {
+	CTTabStripModelEventInserted,
+	CTTabStripModelEventClosing,
+	CTTabStripModelEventDetached,
+	CTTabStripModelEventDetachedRange,
+	CTTabStripModelEventSelected,
+	CTTabStripModelEventSelectionChanged,
+	CTTabStripModelEventMoved,
+	CTTabStripModelEventReordered,
+	CTTabStripModelEventChanged,
+	CTTabStripModelEventReplaced,
+	CTTabStripModelEventPinnedStateChanged,
+	CTTabStripModelEventBlockedStateChanged,
+	CTTabStripModelEventMiniStateChanged,
+	CTTabStripModelEventEmpty,
+	CTTabStripModelEventDidCommitUpdates,
+	CTTabStripModelEventDeleted,
+	CTTabStripModelEventGroupChanged,
+} CTTabStripModelEventType;
+
+// A model event. Only the fields that apply to |type| are set; the rest are
+// zero. The objects are not retained and are only valid for the duration of
+// the callback.
+typedef struct {
+	CTTabStripModelEventType type;
+	// The tab the event is about. For Selected and Replaced this is the new
+	// tab. Nil for the Inserted, BlockedStateChanged and Closing events of a
+	// deferred tab (see |insertDeferredTabWithKey:isApp:atIndex:withAddTypes:|).
+	__unsafe_unretained CTTabContents *contents;
+	// The previously active tab for Selected, the replaced tab for Replaced.
+	__unsafe_unretained CTTabContents *oldContents;
+	int index;
+	// The destination index for Moved.
+	int toIndex;
+	// Foreground for Inserted, user gesture for Selected, the new state for
+	// PinnedStateChanged and BlockedStateChanged.
+	BOOL flag;
+	// The kind of change for Changed.
+	CTTabChangeType changeType;
+	// The committed transaction for DidCommitUpdates.
+	__unsafe_unretained CTTabStripChangeSet *changes;
+	// For SelectionChanged, the tabs whose selected state may have changed.
+	// For DetachedRange, the contiguous run of tabs that was removed and the
+	// tabs themselves, in order, with NSNull for deferred tabs that were
+	// closed. When several ranges are removed at once they
+	// are reported back to front, so |range| is always in terms of the model
+	// as the observer last saw it.
+	NSRange range;
+	__unsafe_unretained NSArray *rangeContents;
+	// For Reordered, one entry per tab: |permutation[i]| is the index the tab
+	// now at |i| had before the reorder.
+	const int *permutation;
+	// For GroupChanged, the group that was created, removed, or collapsed
+	// or expanded, and the range of tabs it covers.
+	int group;
+} CTTabStripModelEvent;
+
+// The kinds of change |changedIndicesSinceGeneration:attributes:| reports.
+typedef enum {
+	// Tabs were inserted, removed or moved.
+	CTTabStripAttributeStructure = 1 << 0,
+	// The active tab or the set of selected tabs changed.
+	CTTabStripAttributeSelection = 1 << 1,
+	// A tab's contents changed or were replaced (title, loading state, ...).
+	CTTabStripAttributeContents  = 1 << 2,
+	CTTabStripAttributePinned    = 1 << 3,
+	CTTabStripAttributeBlocked   = 1 << 4,
+	CTTabStripAttributeMini      = 1 << 5,
+	// A group was created, removed, collapsed or expanded.
+	CTTabStripAttributeGroup     = 1 << 6,
+} CTTabStripAttributes;
+
+// Receives CTTabStripModel events synchronously, without going through
+// NSNotificationCenter.
+@protocol CTTabStripModelObserver <NSObject>
+- (void)tabStripModel:(CTTabStripModel *)model
+	  didReceiveEvent:(const CTTabStripModelEvent *)event;
+@end
+
 @interface CTTabStripModel : NSObject
 
 // The CTTabStripModelDelegate associated with this TabStripModel.
@@ -129,6 +245,17 @@ typedef enum {
 
 - (id)initWithDelegate:(NSObject<CTTabStripModelDelegate> *)delegate;
 
+// Registers |observer| for model events. Observers are not retained and must
+// be removed before they are deallocated. Events are delivered in
+// registration order.
+- (void)addObserver:(id<CTTabStripModelObserver>)observer;
+- (void)removeObserver:(id<CTTabStripModelObserver>)observer;
+
+// If YES, every event is also posted as the corresponding NSNotification for
+// code that still observes the model through NSNotificationCenter. Off by
+// default.
+@property (nonatomic) BOOL postsNotifications;
+
 // Retrieve the number of CTTabContentses/emptiness of the TabStripModel.
 - (NSUInteger)count;
 
@@ -171,6 +298,15 @@ typedef enum {
 - (BOOL)closeTabContentsAtIndex:(int)index 
 				 closeTypes:(uint32)closeTypes;
 
+// Closes the CTTabContents at each of |indices| as a single operation: the
+// strip is compacted once, the new active tab is chosen once and observers
+// receive one DetachedRange event per contiguous run of closed tabs. Every
+// tab is still checked with |canCloseContentsAt:| and
+// |runUnloadListenerBeforeClosing:|; tabs that can't close right away are
+// left in place. Returns NO if any tab was left in place.
+- (BOOL)closeTabContentsAtIndices:(NSIndexSet *)indices
+					   closeTypes:(uint32)closeTypes;
+
 // Replaces the entire state of a the tab at index by switching in a
 // different NavigationController. This is used through the recently
 // closed tabs list, which needs to replace a tab's current state
@@ -186,16 +322,59 @@ typedef enum {
 - (void)replaceTabContentsAtIndex:(int)index
 					 withContents:(CTTabContents *)newContents;
 
+// Replaces the contents of the background tab at |index| by |placeholder|
+// (see |-[CTTabContents initPlaceholderWithTitle:icon:]|) to free what the
+// contents hold on to. Unlike |replaceTabContentsAtIndex:withContents:|, the
+// tab keeps its place as the opener of the tabs it opened. It gets real
+// contents again, through the delegate, when it is next activated.
+- (void)discardTabContentsAtIndex:(int)index
+				  withPlaceholder:(CTTabContents *)placeholder;
+
+// Deferred tabs --------------------------------------------------------------
+//
+// A deferred tab is in the strip without any CTTabContents. The model asks
+// the delegate for them, with |tabContentsForDeferredTabWithKey:|, the first
+// time something needs them: |tabContentsAtIndex:| when the tab strip lays
+// the tab out, selecting it, moving or closing it. Until then the tab only
+// costs the model's bookkeeping, so a restored session with thousands of
+// tabs only creates contents for the ones that are looked at. Closing a
+// deferred tab doesn't create any either. The Inserted, BlockedStateChanged
+// and Closing events of a deferred tab carry nil |contents|, and
+// DetachedRange events NSNull; observers that need the contents of a tab
+// still in the strip can ask |tabContentsAtIndex:|. With |postsNotifications|,
+// the notifications about closing or reordering deferred tabs carry NSNull.
+
+// Inserts a deferred background tab at |index|, which is constrained like for
+// |insertTabContents:atIndex:withAddTypes:|. |key| is what the delegate gets
+// back to tell which tab it is; |isApp| stands in for |CTTabContents.isApp|.
+// Of |addTypes|, only ADD_PINNED applies.
+- (void)insertDeferredTabWithKey:(NSUInteger)key
+						   isApp:(BOOL)isApp
+						 atIndex:(int)index
+					withAddTypes:(int)addTypes;
+
+// Returns YES if the tab at |index| has no CTTabContents yet.
+- (BOOL)isTabDeferredAtIndex:(int)index;
+
+// Returns the title of the tab at |index|. Unlike going through
+// |tabContentsAtIndex:|, doesn't create the contents of a deferred tab.
+- (NSString *)titleOfTabAtIndex:(int)index;
+
 // Detaches the CTTabContents at the specified index from this strip. The
 // CTTabContents is not destroyed, just removed from display. The caller is
 // responsible for doing something with it (e.g. stuffing it into another
 // strip).
 - (CTTabContents*)detachTabContentsAtIndex:(int)index;
 
-// Select the CTTabContents at the specified index. |userGesture| is true if
-// the user actually clicked on the tab or navigated to it using a keyboard
-// command, false if the tab was selected as a by-product of some other
-// action.
+// Detaches the CTTabContents at each of |indices| in a single pass, like
+// |closeTabContentsAtIndices:closeTypes:| but without closing them. Returns
+// them in strip order. Deferred tabs get their contents first.
+- (NSArray *)detachTabContentsAtIndices:(NSIndexSet *)indices;
+
+// Select the CTTabContents at the specified index, which becomes the only
+// selected tab. |userGesture| is true if the user actually clicked on the
+// tab or navigated to it using a keyboard command, false if the tab was
+// selected as a by-product of some other action.
 - (void)selectTabContentsAtIndex:(int)index 
 					 userGesture:(BOOL)userGesture;
 
@@ -211,9 +390,51 @@ typedef enum {
 					   toIndex:(int)toPosition 
 			   selectAfterMove:(BOOL)selectAfterMove;
 
+// Rearranges the whole strip into the order of |orderedContents|, which must
+// contain every CTTabContents in the model exactly once, in linear time and
+// with a single Reordered event. Mini-tabs stay in front of the other tabs:
+// each group keeps the relative order it has in |orderedContents|. The
+// active tab stays active. Returns NO, without changing anything, if
+// |orderedContents| isn't a permutation of the tabs in the model.
+- (BOOL)reorderTabContents:(NSArray *)orderedContents;
+
 // Returns the currently active CTTabContents, or NULL if there is none.
 - (CTTabContents *)activeTabContents;
 
+// Multiple selection ---------------------------------------------------------
+//
+// Any number of tabs can be selected; the active tab always is. Selecting a
+// tab with |selectTabContentsAtIndex:userGesture:| makes it the only selected
+// tab. Whenever more than one tab was or is selected afterwards, observers
+// get a SelectionChanged event after the Selected event, if any.
+
+// Returns the indices of the selected tabs.
+- (NSIndexSet *)selectedIndices;
+- (BOOL)isTabSelectedAtIndex:(int)index;
+- (int)selectedTabCount;
+
+// Adds the tab at |index| to the selection and activates it, or takes it out
+// of the selection, like a Cmd-click. If the active tab is taken out, the
+// nearest selected tab after it (else before it) is activated. The last
+// selected tab can't be taken out.
+- (void)toggleSelectionAtIndex:(int)index;
+
+// Selects the tabs from the one last clicked to |index| and activates
+// |index|, like a Shift-click. The tabs are added to the selection if |add|
+// and replace it otherwise.
+- (void)extendSelectionToIndex:(int)index
+			 addingToSelection:(BOOL)add;
+
+// Pins or unpins every selected tab that isn't an app, in one pass, and moves
+// them to their side of the strip with a single Reordered event.
+- (void)setSelectedTabsPinned:(BOOL)pinned;
+
+// Moves the selected tabs next to each other, in the order they are in, so
+// that the first of them is at |index| among the tabs that aren't selected.
+// Selected mini-tabs stay in front of the other tabs. Uses a single Reordered
+// event.
+- (void)moveSelectedTabsToIndex:(int)index;
+
 // Returns the CTTabContents at the specified index, or NULL if there is none.
 - (CTTabContents *)tabContentsAtIndex:(int)index;
 
@@ -243,28 +464,114 @@ typedef enum {
 // Returns true if there are any CTTabContents that are currently loading.
 - (BOOL)tabsAreLoading;
 
+// Groups a series of mutations so that observers can handle them as a single
+// change. Calls nest; the outermost |endUpdates| commits the transaction.
+//
+// While updating, inserted, detached, moved and pinned events are still
+// delivered as they happen, since observers keep per-tab bookkeeping in sync
+// with them. Selection and state-change events are held back: on commit at
+// most one Selected event (from the tab that was active when the updates
+// began), at most one SelectionChanged event and one Changed event per
+// changed tab are delivered, followed by a
+// DidCommitUpdates event carrying a CTTabStripChangeSet. Observers can check |isUpdating| to defer
+// expensive work, such as layout, until then.
+- (void)beginUpdates;
+- (void)endUpdates;
+
+// YES between the outermost |beginUpdates| and |endUpdates|.
+@property (readonly, nonatomic) BOOL isUpdating;
+
+// Goes up by one with every event that changes the model, before the event is
+// delivered. Consumers that cache anything derived from the model can
+// remember the generation they built it at and later ask what changed since.
+@property (readonly, nonatomic) NSUInteger generation;
+
+// Returns the indices, in the model as it is now, of the tabs that may differ
+// from what they were at |generation|, and sets |attributes| (if not NULL) to
+// the kinds of change involved. Inserting, removing or moving a tab marks
+// every index it shifts. Returns nil if |generation| is too old for the
+// model to still know, in which case everything should be considered
+// changed.
+- (NSIndexSet *)changedIndicesSinceGeneration:(NSUInteger)generation
+								   attributes:(CTTabStripAttributes *)attributes;
+
+// Returns an immutable copy of the tabs, which may be handed to and read on
+// any thread without locking (see CTTabStripSnapshot.h). The first call
+// builds the structure snapshots share, in O(count); from then on the model
+// keeps it up to date as it changes, and taking a snapshot is O(1).
+- (CTTabStripSnapshot *)snapshot;
+
+
+// Returns the CTTabContents that opened the CTTabContents at |index|, or nil.
+// This is the tab's |parentOpener| as of when it was inserted or last
+// changed, as long as that opener is still in the strip.
+- (CTTabContents *)openerOfTabContentsAtIndex:(int)index;
+
+// Returns the index of the opener of the tab at |index|, or kNoTab. Doesn't
+// create the contents of either tab if they are deferred.
+- (int)indexOfOpenerOfTabAtIndex:(int)index;
+
+// Makes the tab at |openerIndex| the opener of the tab at |index|, or leaves
+// it without one if |openerIndex| is kNoTab. Works like setting
+// |parentOpener|, for deferred tabs too.
+- (void)setOpenerOfTabAtIndex:(int)index
+				 toTabAtIndex:(int)openerIndex;
+
+// Returns the index of the next CTTabContents in the sequence of
+// CTTabContentses opened by |opener| after |startIndex|. If there is none
+// after it, the closest one before |startIndex| is returned instead.
+- (int)indexOfNextTabContentsOpenedBy:(CTTabContents *)opener
+						   afterIndex:(int)startIndex;
+
+// Returns the index of the first CTTabContents in the model opened by
+// |opener|, if it is before |startIndex|.
+- (int)indexOfFirstTabContentsOpenedBy:(CTTabContents *)opener
+							beforeIndex:(int)startIndex;
+
+// Returns the index of the last CTTabContents in the model opened by
+// |opener|, if it is after |startIndex|.
+- (int)indexOfLastTabContentsOpenedBy:(CTTabContents *)opener
+						   afterIndex:(int)startIndex;
+
+// Returns the indices of all the CTTabContentses opened by |opener|.
+- (NSIndexSet *)indicesOfTabContentsOpenedBy:(CTTabContents *)opener;
+
+// Called by CTTabContents when its |parentOpener| is set, so that the opener
+// queries above stay current. A |parentOpener| that isn't in the strip counts
+// as no opener.
+- (void)tabContentsParentOpenerDidChange:(CTTabContents *)contents;
+
+// Tab groups -----------------------------------------------------------------
+//
+// A group is a run of adjacent tabs. Its tabs stay together as the strip
+// changes: a tab inserted or moved between two of them joins the group, and
+// a tab moved away from them leaves it. A group disappears when its last tab
+// is removed, or when a reorder splits its tabs up.
 
-// Returns the controller controller that opened the CTTabContents at |index|.
-//NavigationController* GetOpenerOfTabContentsAt(int index);
+// Returns the group of the tab at |index|, or kNoTabGroup.
+- (int)groupOfTabAtIndex:(int)index;
 
-// Returns the index of the next CTTabContents in the sequence of CTTabContentses
-// spawned by the specified NavigationController after |start_index|.
-// If |use_group| is true, the group property of the tab is used instead of
-// the opener to find the next tab. Under some circumstances the group
-// relationship may exist but the opener may not.
-//int GetIndexOfNextTabContentsOpenedBy(const NavigationController* opener,
-//                                      int start_index,
-//                                      BOOL use_group) const;
+// Returns the range of tabs in |group|, or {NSNotFound, 0} if there is no
+// such group.
+- (NSRange)rangeOfGroup:(int)group;
 
-// Returns the index of the first CTTabContents in the model opened by the
-// specified opener.
-//int GetIndexOfFirstTabContentsOpenedBy(const NavigationController* opener,
-//                                       int start_index) const;
+// Groups the tabs in |range| and returns the new group, or kNoTabGroup if the
+// range is empty, out of bounds, or overlaps another group.
+- (int)createGroupWithTabsInRange:(NSRange)range;
 
-// Returns the index of the last CTTabContents in the model opened by the
-// specified opener, starting at |start_index|.
-//int GetIndexOfLastTabContentsOpenedBy(const NavigationController* opener,
-//                                      int start_index) const;
+// Ungroups the tabs of |group|. The tabs themselves are left alone.
+- (void)removeGroup:(int)group;
+
+// Moves the tabs of |group| so the first of them is at |index|. The group is
+// never moved into the middle of another group; it ends up after it instead.
+- (void)moveGroup:(int)group toIndex:(int)index;
+
+// Collapses or expands |group|. A collapsed group only shows its first tab.
+- (void)setGroup:(int)group collapsed:(BOOL)collapsed;
+- (BOOL)isGroupCollapsed:(int)group;
+
+// Returns the indices of the tabs collapsed groups keep out of sight.
+- (NSIndexSet *)indicesOfTabsHiddenByCollapsedGroups;
 
 // Called by the CTBrowser when a navigation is about to occur in the specified
 // CTTabContents. Depending on the tab, and the transition type of the
@@ -292,14 +599,27 @@ typedef enum {
 
 // Is the tab at |index| an app?
 // See description above class for details on app tabs.
+// The app state is captured from |CTTabContents.isApp| when the tab is
+// inserted into the model.
 - (BOOL)isAppTabAtIndex:(int)index;
 
 // Returns true if the tab at |index| is blocked by a tab modal dialog.
 - (BOOL)isTabBlockedAtIndex:(int)index;
 
+// Returns the number of pinned and blocked tabs. These are popcounts over the
+// model's packed flag storage and don't touch the individual tabs.
+- (int)pinnedTabCount;
+- (int)blockedTabCount;
+
+// Returns the indices of all pinned and all blocked tabs, respectively.
+- (NSIndexSet *)indicesOfPinnedTabs;
+- (NSIndexSet *)indicesOfBlockedTabs;
+
 // Returns the index of the first tab that is not a mini-tab. This returns
 // |count()| if all of the tabs are mini-tabs, and 0 if none of the tabs are
 // mini-tabs.
+// The count is maintained as tabs are added, removed and (un)pinned, so this
+// is O(1).
 - (int)indexOfFirstNonMiniTab;
 
 // Returns a valid index for inserting a new tab into this model. |index| is
@@ -334,6 +654,9 @@ typedef enum {
 // Selects the last tab in the tab strip.
 - (void)selectLastTab;
 
+// Switches back to the tab that was active before the active one, if any.
+- (void)selectPreviouslyActiveTab;
+
 // Swap adjacent tabs.
 - (void)moveTabNext;
 - (void)moveTabPrevious;
@@ -352,7 +675,8 @@ typedef enum {
 						  commandID:(ContextMenuCommand)commandID;
 
 // Performs the action associated with the specified command for the given
-// TabStripModel index |contextIndex|.
+// TabStripModel index |contextIndex|. If that tab is selected, the close,
+// pin and new window commands act on every selected tab.
 - (void)executeContextMenuCommand:(int)contextIndex
 						commandID:(ContextMenuCommand)commandID;
 
@@ -10,9 +10,15 @@
 #import "CTTabStripModel.h"
 #import "CTTabStripModelOrderController.h"
 #import "CTPageTransition.h"
+#import "CTBitVector.h"
+#import "CTTabStripCore.h"
+#import "CTTabStripSnapshot.h"
 
 #import "CTTabContents.h"
 
+@class TabContentsData;
+@class CTTabGroupData;
+
 @interface CTTabStripModel (PrivateMethods)
 // Returns true if the specified CTTabContents is a New Tab at the end of the
 // TabStrip. We check for this because opener relationships are _not_
@@ -29,13 +35,14 @@
 //
 // Returns true if the CTTabContents were closed immediately, false if we are
 // waiting for the result of an onunload handler.
-- (BOOL)internalCloseTabs:(NSArray *)indices
+- (BOOL)internalCloseTabs:(NSIndexSet *)indices
 			   closeTypes:(uint32)closeTypes;
 
 // Invoked from InternalCloseTabs and when an extension is removed for an app
-// tab. Notifies observers of TabClosingAt and deletes |contents|. If
-// |createHistoricalTabs| is true, CreateHistoricalTab is invoked on the
-// delegate.
+// tab. Notifies observers of TabClosingAt. If |createHistoricalTabs| is true,
+// CreateHistoricalTab is invoked on the delegate. The caller is responsible
+// for detaching |contents| afterwards. |contents| is nil if the tab is
+// deferred.
 //
 // The boolean parameter create_historical_tab controls whether to
 // record these tabs and their history for reopening recently closed
@@ -44,6 +51,69 @@
 				 atIndex:(int)index
 	 createHistoricalTab:(BOOL)createHistoricalTabs;
 
+// Returns the TabContentsData of the tab at |index|.
+- (TabContentsData *)dataAtIndex:(int)index;
+
+// Returns the TabContentsData of the tabs in |range|, in strip order.
+- (NSArray *)dataInRange:(NSRange)range;
+
+// Returns the TabContentsData of the tab in the strip that |contents| is the
+// contents of, or nil.
+- (TabContentsData *)dataOfContents:(CTTabContents *)contents;
+
+// Returns the TabContentsData of the tabs |data| opened, in strip order.
+- (NSArray *)dataOpenedByData:(TabContentsData *)data;
+
+// Returns the contents of |data|, asking the delegate for them if the tab is
+// deferred. The tabs it opened get them as their |parentOpener|, like when
+// contents are swapped.
+- (CTTabContents *)contentsOfData:(TabContentsData *)data;
+
+// Does the work of |detachTabContentsAtIndices:|, but leaves deferred tabs
+// without contents: they are NSNull in the returned array and in the
+// DetachedRange events.
+- (NSArray *)removeTabsAtIndices:(NSIndexSet *)indices;
+
+// Does the work of |insertTabContents:atIndex:withAddTypes:| and
+// |insertDeferredTabWithKey:isApp:atIndex:withAddTypes:| for |data|, whose
+// contents are nil if it is deferred.
+- (void)insertData:(TabContentsData *)data
+			 isApp:(BOOL)isApp
+		   atIndex:(int)index
+	  withAddTypes:(int)addTypes;
+
+// Does the work of |reorderTabContents:| on the TabContentsData of the tabs.
+- (BOOL)reorderData:(NSArray *)orderedData;
+
+// Tab groups. See |groups_|. The lookups ask the core which of two tabs
+// comes first, so they never look up an index, and return right away
+// without groups.
+//
+// Returns the position in |groups_| of the group that contains |index|, or
+// NSNotFound.
+- (NSUInteger)positionOfGroupContainingIndex:(int)index;
+// Returns the position in |groups_| of the first group that starts at or
+// after |index|.
+- (NSUInteger)positionOfFirstGroupStartingAtOrAfter:(int)index;
+// Takes |data|, which is at |index|, out of the group it belongs to, if any.
+// Returns the group it was taken out of, which is dropped if it is empty now.
+- (CTTabGroupData *)removeDataFromGroup:(TabContentsData *)data
+								atIndex:(int)index;
+// Adds |data|, which is at |index| and not in a group, to the group whose
+// tabs surround it, if any.
+- (void)addDataToSurroundingGroup:(TabContentsData *)data
+						  atIndex:(int)index;
+// Delivers a GroupChanged event for |group|.
+- (void)notifyGroupChanged:(CTTabGroupData *)group;
+
+// The tabs a context menu command for the tab at |index| acts on: every
+// selected tab if it is selected, else just that tab.
+- (NSIndexSet *)indicesAffectedByCommandForTabAtIndex:(int)index;
+
+// The indices |getIndicesClosedByCommand:forTabAtIndex:| reports, as a set.
+- (NSIndexSet *)indicesClosedByCommand:(ContextMenuCommand)commandID
+						 forTabAtIndex:(int)index;
+
 // The actual implementation of SelectTabContentsAt. Takes the previously
 // active contents in |old_contents|, which may actually not be in
 // |contents_| anymore because it may have been removed by a call to say
@@ -52,6 +122,27 @@
 						   toIndex:(int)toIndex
 					   userGesture:(BOOL)userGesture;
 
+// The first to the last selected tab, or {NSNotFound, 0}.
+- (NSRange)selectionSpan;
+
+// Called once the core has made a different tab active or changed the
+// selection, which spanned |oldSpan| and had |oldContents| active. Sends the
+// Selected and SelectionChanged events that apply, or holds them back while
+// updating.
+- (void)selectionDidChangeFrom:(CTTabContents *)oldContents
+				 selectionSpan:(NSRange)oldSpan
+				   userGesture:(BOOL)userGesture;
+
+// Delivers a SelectionChanged event for the tabs in |range|, or notes that
+// one is due when the updates are committed.
+- (void)notifySelectionChangedInRange:(NSRange)range;
+
+// Rearranges the tabs so that the one at |i| is the one that was at
+// |permutation[i]|, which keeps the mini-tabs in front, and sends the
+// Reordered event. The flags, the selection and the openers follow the
+// tabs; groups whose tabs end up apart are dissolved.
+- (void)applyPermutation:(const int *)permutation;
+
 // Returns the number of New Tab tabs in the TabStripModel.
 //- (int)newTabCount;
 
@@ -66,16 +157,104 @@
 			  selectAfterMove:(BOOL)selectAfterMove;
 
 // Does the work for ReplaceTabContentsAt returning the old CTTabContents.
-// The caller owns the returned CTTabContents.
+// The caller owns the returned CTTabContents. Unless |keepOpenedTabs|, the
+// tabs the old contents opened lose their opener.
 - (CTTabContents *)replaceTabContentsAtImpl:(int)index
-							   withContents:(CTTabContents *)newContents;
+							   withContents:(CTTabContents *)newContents
+							 keepOpenedTabs:(BOOL)keepOpenedTabs;
+
+// If the tab at |index| is a placeholder, asks the delegate for its real
+// contents and puts them in its place. Returns the contents now at |index|.
+- (CTTabContents *)loadPlaceholderAtIndex:(int)index;
+
+// Replaces the contents at |index| by |newContents|, which takes over as the
+// opener of the tabs the old contents opened. Used when a tab is loaded or
+// discarded, which doesn't make it a different tab.
+- (void)swapTabContentsAtIndex:(int)index
+				  withContents:(CTTabContents *)newContents;
+
+// Returns the slot of |data|, which is in the strip. See
+// |CTTabStripCoreIndexOfTab|.
+- (int)indexOfData:(TabContentsData *)data;
+
+// Builds the change set for the transaction that is being committed and
+// posts the notifications that were held back while updating.
+- (void)commitUpdates;
+
+// Delivers |event| to every registered observer and, if |postsNotifications|
+// is set, posts the equivalent NSNotification.
+- (void)notifyObservers:(const CTTabStripModelEvent *)event;
+
+// The NSNotification compatibility shim used by |notifyObservers:|.
+- (void)postNotificationForEvent:(const CTTabStripModelEvent *)event;
+
+// Bumps |generation| and logs what |event| changed, if anything.
+- (void)recordChangeForEvent:(const CTTabStripModelEvent *)event;
+
+// Snapshots. See |snapshotBuilder_|.
+//
+// Returns what a snapshot records about the tab at |index|.
+- (CTTabSnapshot *)snapshotOfTabAtIndex:(int)index;
+// Keeps |snapshotBuilder_| in step with |event|.
+- (void)updateSnapshotBuilderForEvent:(const CTTabStripModelEvent *)event;
+// Notes that the opener of |data| changed, for the next snapshot.
+- (void)openerOfDataDidChange:(TabContentsData *)data;
+// Appends a record for the current generation to the change log. |index| to
+// |lastIndex| is the span of tabs touched; if |shiftsFollowingTabs| the
+// tabs after it were touched as well.
+- (void)logChangeFromIndex:(int)index
+				   toIndex:(int)lastIndex
+		shiftsFollowingTabs:(BOOL)shiftsFollowingTabs
+				attributes:(CTTabStripAttributes)attributes;
 @end
 
+// The signature of |-tabStripModel:didReceiveEvent:|, called directly
+// through a cached IMP.
+typedef void (*CTTabStripModelObserverIMP)(id, SEL, CTTabStripModel *,
+										   const CTTabStripModelEvent *);
+
+typedef struct {
+	__unsafe_unretained id<CTTabStripModelObserver> observer;
+	CTTabStripModelObserverIMP imp;
+} CTTabStripModelObserverEntry;
+
+// One entry of the model's change log: the tabs |index| to |lastIndex| as the
+// model was at |generation|, and all the tabs after them too if
+// |shiftsFollowingTabs|.
+typedef struct {
+	NSUInteger generation;
+	int index;
+	int lastIndex;
+	BOOL shiftsFollowingTabs;
+	CTTabStripAttributes attributes;
+} CTTabStripChangeRecord;
+
+// How many records the change log keeps. Consumers that fall further behind
+// than this start over.
+enum { kChangeLogCapacity = 256 };
+
+@interface CTTabStripChangeSet (PrivateMethods)
+- (id)initWithRemovedIndices:(NSIndexSet *)removed
+			 insertedIndices:(NSIndexSet *)inserted
+				movedIndices:(NSIndexSet *)moved
+			  changedIndices:(NSIndexSet *)changed
+				 activeIndex:(int)activeIndex
+			activeTabChanged:(BOOL)activeTabChanged;
+@end
+
+// What the model keeps about a tab besides what |core_| knows, which is
+// where it is, who opened it and whom it opened.
 @interface TabContentsData : NSObject {
 @public
+	// Nil while the tab is deferred, until |contentsOfData:| asks the delegate
+	// for them with |deferredKey|.
     CTTabContents* contents;
-	BOOL isPinned;
-	BOOL isBlocked;
+	NSUInteger deferredKey;
+	// Stays with the slot when its contents are replaced. See
+	// |CTTabSnapshot.identifier|.
+	uint64_t identifier;
+	// The tab in |core_|, or CTNoTabHandle once it left the strip.
+	CTTabHandle handle;
 }
 @end
 
@@ -83,15 +262,96 @@
 
 @end
 
+// A tab group: |count| adjacent tabs from |first| to |last|.
+@interface CTTabGroupData : NSObject {
+@public
+	int identifier;
+	// The first and last tabs of the group. A tab is in the group if it is
+	// between them.
+	TabContentsData* first;
+	TabContentsData* last;
+	int count;
+	BOOL collapsed;
+}
+@end
+
+@implementation CTTabGroupData
+
+@end
+
+@implementation CTTabStripChangeSet
+
+@synthesize removedIndices = removedIndices_;
+@synthesize insertedIndices = insertedIndices_;
+@synthesize movedIndices = movedIndices_;
+@synthesize changedIndices = changedIndices_;
+@synthesize activeIndex = activeIndex_;
+@synthesize activeTabChanged = activeTabChanged_;
+
+- (id)initWithRemovedIndices:(NSIndexSet *)removed
+			 insertedIndices:(NSIndexSet *)inserted
+				movedIndices:(NSIndexSet *)moved
+			  changedIndices:(NSIndexSet *)changed
+				 activeIndex:(int)activeIndex
+			activeTabChanged:(BOOL)activeTabChanged {
+	if ((self = [super init])) {
+		removedIndices_ = [removed copy];
+		insertedIndices_ = [inserted copy];
+		movedIndices_ = [moved copy];
+		changedIndices_ = [changed copy];
+		activeIndex_ = activeIndex;
+		activeTabChanged_ = activeTabChanged;
+	}
+	return self;
+}
+
+@end
+
 @implementation CTTabStripModel {
 	// Our delegate.
     __weak NSObject<CTTabStripModelDelegate> *delegate_;
 	
-	// The CTTabContents data currently hosted within this TabStripModel.
-	NSMutableArray *contentsData_;
+	// The TabContentsData of the tabs in the strip, indexed by their handle in
+	// |core_|, which knows their order. Entries of handles that aren't in use
+	// are NSNull.
+	NSMutableArray *dataByHandle_;
+	
+	// Maps each hosted CTTabContents to its TabContentsData, whose handle the
+	// core finds the slot of. Lets |indexOfTabContents:| answer without
+	// walking the strip.
+	NSMapTable *contentsIndex_;
 	
-	// The index of the CTTabContents in |contents_| that is currently active.
-	int activeIndex_;
+	// Tab groups, ordered by where they start. Every group covers a run of
+	// adjacent tabs and groups never overlap, so finding the group of a tab is
+	// a binary search. Groups only store their first and last tabs and their
+	// size, and are searched by comparing the order of those tabs in the
+	// core, so inserting or removing tabs elsewhere in the strip doesn't
+	// touch them and finding a group never looks up an index.
+	NSMutableArray *groups_;
+	// Maps group identifiers to groups.
+	NSMutableDictionary *groupsByIdentifier_;
+	int nextGroupIdentifier_;
+	
+	// The index level state of the strip: the order of the tabs, the per-tab
+	// flags (the app flag is captured from |CTTabContents.isApp| when the tab
+	// is inserted), the mini-tab count, the active index, who opened whom
+	// (seeded from |CTTabContents.parentOpener| when a tab is inserted and
+	// kept up to date through |tabContentsParentOpenerDidChange:|; only
+	// openers in the strip count) and the activation history, along with the
+	// rules that only need those. See CTTabStripCore.h.
+	CTTabStripCore *core_;
+	
+	// The identifier of the next TabContentsData.
+	uint64_t nextTabIdentifier_;
+	
+	// The tabs the way |snapshot| shares them with its snapshots. Created by
+	// the first call to |snapshot| and from then on kept in step with the
+	// model by |notifyObservers:|. Openers change in the middle of mutations
+	// the builder hasn't seen yet, so tabs whose opener changed are only
+	// collected in |tabsWithStaleSnapshots_| and refreshed by the next
+	// |snapshot|.
+	CTTabStripSnapshotBuilder *snapshotBuilder_;
+	NSMutableSet *tabsWithStaleSnapshots_;
 	
 	// A profile associated with this TabStripModel, used when creating new Tabs.
 	//Profile* profile_;
@@ -102,17 +362,63 @@
 	// An object that determines where new Tabs should be inserted and where
 	// selection should move when a Tab is closed.
 	CTTabStripModelOrderController *orderController_;
+	
+	// Nesting depth of |beginUpdates|. The remaining members are only used
+	// while it is non-zero and describe the transaction being recorded.
+	int updateDepth_;
+	// The tabs, in order, and the active tab as they were when the outermost
+	// |beginUpdates| was called. Tabs are tracked by their TabContentsData,
+	// which deferred tabs have too, and which stays the same when a tab's
+	// contents are replaced.
+	NSArray *dataBeforeUpdates_;
+	CTTabContents *activeContentsBeforeUpdates_;
+	// Whether the last selection change made while updating was a user
+	// gesture.
+	BOOL selectionByUserGesture_;
+	// Whether a SelectionChanged event is due when the updates are committed.
+	BOOL selectionChangedWhileUpdating_;
+	// Tabs that were inserted, moved or changed while updating. Tabs that were
+	// inserted and then removed again are left in; they are filtered out when
+	// the change set is built.
+	NSHashTable *insertedWhileUpdating_;
+	NSHashTable *movedWhileUpdating_;
+	NSHashTable *changedWhileUpdating_;
+	
+	// Registered observers, in registration order. Observers are not
+	// retained. Removing an observer while events are being dispatched only
+	// clears its entry; the list is compacted once the outermost dispatch
+	// returns.
+	CTTabStripModelObserverEntry *observers_;
+	int observerCount_;
+	int observerCapacity_;
+	int dispatchDepth_;
+	BOOL observersNeedCompaction_;
+	
+	// See |postsNotifications|.
+	BOOL postsNotifications_;
+	
+	// See |generation|. Changes are logged in a ring buffer of
+	// |changeLogCount_| records starting at |changeLogStart_|; records are
+	// dropped oldest first, and |firstLoggedGeneration_| is the oldest
+	// generation that changes are still known since.
+	NSUInteger generation_;
+	CTTabStripChangeRecord changeLog_[kChangeLogCapacity];
+	int changeLogStart_;
+	int changeLogCount_;
+	NSUInteger firstLoggedGeneration_;
 }
 
 @synthesize delegate = delegate_;
-@synthesize activeIndex = activeIndex_;
 @synthesize closingAll = closingAll_;
+@synthesize postsNotifications = postsNotifications_;
+@synthesize generation = generation_;
 
 NSString* const CTTabInsertedNotification = @"CTTabInsertedNotification";
 NSString* const CTTabClosingNotification = @"CTTabClosingNotification";
 NSString* const CTTabDetachedNotification = @"CTTabDetachedNotification";
 NSString* const CTTabDeselectedNotification = @"CTTabDeselectedNotification";
 NSString* const CTTabSelectedNotification = @"CTTabSelectedNotification";
+NSString* const CTTabSelectionChangedNotification = @"CTTabSelectionChangedNotification";
 NSString* const CTTabMovedNotification = @"CTTabMovedNotification";
 NSString* const CTTabChangedNotification = @"CTTabChangedNotification";
 NSString* const CTTabReplacedNotification = @"CTTabReplacedNotification";
@@ -121,6 +427,8 @@ NSString* const CTTabBlockedStateChangedNotification = @"CTTabBlockedStateChange
 NSString* const CTTabMiniStateChangedNotification = @"CTTabMiniStateChangedNotification";
 NSString* const CTTabStripEmptyNotification = @"CTTabStripEmptyNotification";
 NSString* const CTTabStripModelDeletedNotification = @"CTTabStripModelDeletedNotification";
+NSString* const CTTabStripModelDidCommitUpdatesNotification = @"CTTabStripModelDidCommitUpdatesNotification";
+NSString* const CTTabGroupChangedNotification = @"CTTabGroupChangedNotification";
 
 NSString* const CTTabContentsUserInfoKey = @"CTTabContentsUserInfoKey";
 NSString* const CTTabNewContentsUserInfoKey = @"CTTabNewContentsUserInfoKey";
@@ -129,14 +437,28 @@ NSString* const CTTabToIndexUserInfoKey = @"CTTabToIndexUserInfoKey";
 NSString* const CTTabForegroundUserInfoKey = @"CTTabForegroundUserInfoKey";
 NSString* const CTTabUserGestureUserInfoKey = @"CTTaUserGestureUserInfoKey";
 NSString* const CTTabOptionsUserInfoKey = @"CTTaOptionsInfoKey";
+NSString* const CTTabChangeSetUserInfoKey = @"CTTabChangeSetUserInfoKey";
+NSString* const CTTabGroupUserInfoKey = @"CTTabGroupUserInfoKey";
 
 const int kNoTab = NSNotFound;
+const int kNoTabGroup = 0;
 
 - (id)initWithDelegate:(NSObject <CTTabStripModelDelegate>*)delegate {
 	self = [super init];
 	if (self) {	
-		contentsData_ = [[NSMutableArray alloc] init];
-		activeIndex_ = kNoTab;
+		// Handle 0 is CTNoTabHandle.
+		dataByHandle_ = [[NSMutableArray alloc] initWithObjects:[NSNull null], nil];
+		contentsIndex_ = [[NSMapTable alloc]
+			initWithKeyOptions:NSPointerFunctionsOpaqueMemory |
+							   NSPointerFunctionsOpaquePersonality
+				  valueOptions:NSPointerFunctionsStrongMemory |
+							   NSPointerFunctionsObjectPersonality
+					  capacity:0];
+		groups_ = [[NSMutableArray alloc] init];
+		groupsByIdentifier_ = [[NSMutableDictionary alloc] init];
+		nextGroupIdentifier_ = 1;
+		core_ = CTTabStripCoreCreate();
+		nextTabIdentifier_ = 1;
 		closingAll_ = NO;
 		
 		delegate_ = delegate; // weak
@@ -146,7 +468,12 @@ const int kNoTab = NSNotFound;
 		 NotificationService::AllSources());
 		 registrar_.Add(this,
 		 NotificationType::EXTENSION_UNLOADED);*/
-		orderController_ = [[CTTabStripModelOrderController alloc] initWithTabStripModel:self];
+		orderController_ = [[CTTabStripModelOrderController alloc]
+			initWithTabStripModel:self
+							 core:core_];
+		// Registered first so that its activation history is up to date before
+		// any other observer can react to a selection change.
+		[self addObserver:orderController_];
 		
 	}
 
@@ -154,14 +481,21 @@ const int kNoTab = NSNotFound;
 }
 
 - (void)dealloc {
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabStripModelDeletedNotification 
-														object:self];
+	CTTabStripModelEvent event = { .type = CTTabStripModelEventDeleted };
+	[self notifyObservers:&event];
+	free(observers_);
+	CTTabStripCoreFree(core_);
 }
 
 #pragma mark -
 #pragma mark getters/setters
 - (NSUInteger)count {
-	return [contentsData_ count];
+	return CTTabStripCoreCount(core_);
+}
+
+- (int)activeIndex {
+	int index = CTTabStripCoreActiveIndex(core_);
+	return index == CTTabStripCoreNoTab ? kNoTab : index;
 }
 
 // Sets the insertion policy. Default is INSERT_AFTER.
@@ -191,12 +525,61 @@ const int kNoTab = NSNotFound;
 - (void)insertTabContents:(CTTabContents *)contents
 				  atIndex:(int)index 
 			 withAddTypes:(int)addTypes {
+	TabContentsData* data = [[TabContentsData alloc] init];
+	data->contents = contents;
+	[self insertData:data
+			   isApp:contents.isApp
+			 atIndex:index
+		withAddTypes:addTypes];
+}
+
+- (void)insertDeferredTabWithKey:(NSUInteger)key
+						   isApp:(BOOL)isApp
+						 atIndex:(int)index
+					withAddTypes:(int)addTypes {
+	TabContentsData* data = [[TabContentsData alloc] init];
+	data->deferredKey = key;
+	[self insertData:data
+			   isApp:isApp
+			 atIndex:index
+		withAddTypes:addTypes & ADD_PINNED];
+}
+
+- (void)insertData:(TabContentsData *)data
+			 isApp:(BOOL)isApp
+		   atIndex:(int)index
+	  withAddTypes:(int)addTypes {
+	CTTabContents* contents = data->contents;
 	BOOL foreground = addTypes & ADD_ACTIVE;
 	// Force app tabs to be pinned.
-	BOOL pin = contents.isApp || addTypes & ADD_PINNED;
+	BOOL pin = isApp || addTypes & ADD_PINNED;
 	index = [self constrainInsertionIndex:index 
 								  miniTab:pin];
 	
+	// A tab that inherits the group of the active tab is placed within that
+	// group's bounds.
+	CTTabGroupData* inheritedGroup = nil;
+	int start = 0;
+	int end = 0;
+	if (addTypes & ADD_INHERIT_GROUP && [self containsIndex:[self activeIndex]]) {
+		NSUInteger position = [self positionOfGroupContainingIndex:[self activeIndex]];
+		if (position != NSNotFound) {
+			inheritedGroup = [groups_ objectAtIndex:position];
+			start = [self indexOfData:inheritedGroup->first];
+			end = start + inheritedGroup->count;
+			int constrained = [self constrainInsertionIndex:MIN(MAX(index, start), end)
+													miniTab:pin];
+			if (constrained >= start && constrained <= end)
+				index = constrained;
+			else
+				inheritedGroup = nil;
+		}
+	}
+	if (contents && addTypes & ADD_INHERIT_OPENER &&
+		[self activeTabContents] != contents) {
+		contents.parentOpener = [self activeTabContents];
+	}
+	
 	// In tab dragging situations, if the last tab in the window was detached
 	// then the user aborted the drag, we will have the |closing_all_| member
 	// set (see DetachTabContentsAt) which will mess with our mojo here. We need
@@ -206,27 +589,44 @@ const int kNoTab = NSNotFound;
 	// Have to get the active contents before we monkey with |contents_|
 	// otherwise we run into problems when we try to change the active contents
 	// since the old contents and the new contents will be the same...
-	CTTabContents* activeContents = [self activeTabContents];
-	TabContentsData* data = [[TabContentsData alloc] init];
-	data->contents = contents;
-	data->isPinned = pin;
+	CTTabContents* activeContents = foreground ? [self activeTabContents] : nil;
+	data->identifier = nextTabIdentifier_++;
 	
-	[contentsData_ insertObject:data atIndex:index];
-	
-	if (index <= activeIndex_) {
-		// If a tab is inserted before the current active index,
-		// then |activeIndex| needs to be incremented.
-		++activeIndex_;
+	// The core shifts the active index along, and files the tab under its
+	// opener if that is in the strip.
+	TabContentsData* openerData = contents.parentOpener != contents ?
+		[self dataOfContents:contents.parentOpener] : nil;
+	data->handle = CTTabStripCoreInsert(core_, index,
+		(pin ? CTTabStripCorePinned : 0) | (isApp ? CTTabStripCoreApp : 0),
+		openerData ? openerData->handle : CTNoTabHandle);
+	// The core hands out new handles in sequence, and reuses old ones.
+	if (data->handle == [dataByHandle_ count])
+		[dataByHandle_ addObject:data];
+	else
+		[dataByHandle_ replaceObjectAtIndex:data->handle withObject:data];
+	if (contents)
+		[contentsIndex_ setObject:data forKey:contents];
+	if (inheritedGroup) {
+		// If it went in right in front of or behind the group it is the new
+		// first or last tab.
+		if (index == start)
+			inheritedGroup->first = data;
+		else if (index == end)
+			inheritedGroup->last = data;
+		++inheritedGroup->count;
+	} else {
+		[self addDataToSurroundingGroup:data atIndex:index];
 	}
+	if (updateDepth_)
+		[insertedWhileUpdating_ addObject:data];
 	
-    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-                              contents, CTTabContentsUserInfoKey,
-                              [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-                              [NSNumber numberWithBool:foreground], CTTabForegroundUserInfoKey, 
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabInsertedNotification 
-														object:self 
-													  userInfo:userInfo];
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventInserted,
+		.contents = contents,
+		.index = index,
+		.flag = foreground,
+	};
+	[self notifyObservers:&event];
 	
 	if (foreground)
 		[self changeSelectedContentsFrom:activeContents
@@ -238,45 +638,55 @@ const int kNoTab = NSNotFound;
 - (void)replaceTabContentsAtIndex:(int)index 
 					withContents:(CTTabContents *)newContents {
 	[self replaceTabContentsAtImpl:index
-					  withContents:newContents];
+					  withContents:newContents
+					keepOpenedTabs:NO];
 }
 
 - (CTTabContents *)detachTabContentsAtIndex:(int)index {
-	if ([contentsData_ count] == 0)
+	if ([self count] == 0)
 		return NULL;
 	
 	assert([self containsIndex:index]);
 	
 	CTTabContents* removedContents = [self tabContentsAtIndex:index];
-	int nextActiveIndex =
-		[orderController_ determineNewSelectedIndexAfterClose:index];
-	[contentsData_ removeObjectAtIndex:index];
+	TabContentsData* removedData = [self dataAtIndex:index];
+	// While its neighbours are still next to it.
+	[self removeDataFromGroup:removedData atIndex:index];
+	// The core picks the next active tab while the openers are intact, and
+	// forgets the ones that leave with the tab.
+	NSArray* orphans = [self dataOpenedByData:removedData];
+	BOOL wasActive = index == [self activeIndex];
+	// Closing the active tab leaves its replacement as the only selected tab.
+	BOOL collapsesSelection = wasActive && [self selectedTabCount] > 1;
+	int nextActiveIndex = CTTabStripCoreRemove(core_, index);
+	[dataByHandle_ replaceObjectAtIndex:removedData->handle
+							 withObject:[NSNull null]];
+	removedData->handle = CTNoTabHandle;
+	for (TabContentsData* orphan in orphans)
+		[self openerOfDataDidChange:orphan];
+	[contentsIndex_ removeObjectForKey:removedContents];
 	if ([self count] > 0)
 		closingAll_ = YES;
 	
-    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-                              removedContents, CTTabContentsUserInfoKey,
-                              [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabDetachedNotification 
-														object:self 
-													  userInfo:userInfo];
-    if (![self count]) {
-        [[NSNotificationCenter defaultCenter] postNotificationName:CTTabStripEmptyNotification 
-															object:self 
-														  userInfo:nil];
-    }
-	if ([self count] > 0) {
-		if (index == activeIndex_) {
-			[self changeSelectedContentsFrom:removedContents
-									 toIndex:nextActiveIndex
-								 userGesture:NO];
-		} else if (index < activeIndex_) {
-			// The active tab didn't change, but its position shifted; update our
-			// index to continue to point at it.
-			--activeIndex_;
-		}
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventDetached,
+		.contents = removedContents,
+		.index = index,
+	};
+	[self notifyObservers:&event];
+	if (![self count]) {
+		CTTabStripModelEvent emptyEvent = { .type = CTTabStripModelEventEmpty };
+		[self notifyObservers:&emptyEvent];
 	}
+	// If the active tab didn't change, the core already shifted its index to
+	// continue to point at it.
+	if ([self count] > 0 && wasActive) {
+		[self changeSelectedContentsFrom:removedContents
+								 toIndex:nextActiveIndex
+							 userGesture:NO];
+	}
+	if ([self count] > 0 && collapsesSelection)
+		[self notifySelectionChangedInRange:NSMakeRange(0, [self count])];
 	return removedContents;
 }
 
@@ -299,9 +709,7 @@ const int kNoTab = NSNotFound;
 	if (index == toPosition)
 		return;
 	
-	int firstNonMiniTab = [self indexOfFirstNonMiniTab];
-	if ((index < firstNonMiniTab && toPosition >= firstNonMiniTab) ||
-		(toPosition < firstNonMiniTab && index >= firstNonMiniTab)) {
+	if (!CTTabStripCoreCanMove(core_, index, toPosition)) {
 		// This would result in mini tabs mixed with non-mini tabs. We don't allow
 		// that.
 		return;
@@ -312,66 +720,513 @@ const int kNoTab = NSNotFound;
 				selectAfterMove:selectAfterMove];
 }
 
+- (BOOL)reorderTabContents:(NSArray *)orderedContents {
+	NSMutableArray *orderedData =
+		[NSMutableArray arrayWithCapacity:[orderedContents count]];
+	for (CTTabContents *contents in orderedContents) {
+		TabContentsData *data = [contentsIndex_ objectForKey:contents];
+		if (!data) {
+			DLOG("[ChromiumTabs] %s: %@ is not in the strip", __PRETTY_FUNCTION__,
+				 contents);
+			return NO;
+		}
+		[orderedData addObject:data];
+	}
+	return [self reorderData:orderedData];
+}
+
+- (BOOL)reorderData:(NSArray *)orderedData {
+	int count = [self count];
+	if ((int)[orderedData count] != count) {
+		DLOG("[ChromiumTabs] %s: expected %d tabs, got %d", __PRETTY_FUNCTION__,
+			 count, (int)[orderedData count]);
+		return NO;
+	}
+	
+	// Work out where every tab goes. Mini-tabs fill the slots in front of
+	// |miniTabCount| and the rest the slots after it, each in the order they
+	// come in.
+	int miniTabCount = CTTabStripCoreMiniTabCount(core_);
+	int *permutation = malloc(count * sizeof(int));
+	CTBitVector seen;
+	CTBitVectorInit(&seen);
+	CTBitVectorResize(&seen, count);
+	int nextMiniSlot = 0;
+	int nextSlot = miniTabCount;
+	BOOL identity = YES;
+	for (TabContentsData *data in orderedData) {
+		int index = [self indexOfData:data];
+		if (CTBitVectorGet(&seen, index)) {
+			DLOG("[ChromiumTabs] %s: tab %d is listed twice", __PRETTY_FUNCTION__,
+				 index);
+			CTBitVectorFree(&seen);
+			free(permutation);
+			return NO;
+		}
+		CTBitVectorSet(&seen, index, true);
+		int slot = index < miniTabCount ? nextMiniSlot++ : nextSlot++;
+		permutation[slot] = index;
+		identity = identity && slot == index;
+	}
+	CTBitVectorFree(&seen);
+	if (identity) {
+		free(permutation);
+		return YES;
+	}
+	
+	[self applyPermutation:permutation];
+	free(permutation);
+	return YES;
+}
+
 - (CTTabContents *)activeTabContents {
-	return [self tabContentsAtIndex:activeIndex_];
+	return [self tabContentsAtIndex:[self activeIndex]];
+}
+
+- (NSIndexSet *)selectedIndices {
+	const CTRangeSet *selection = CTTabStripCoreSelection(core_);
+	NSMutableIndexSet *indices = [NSMutableIndexSet indexSet];
+	for (int i = 0; i < selection->count; ++i) {
+		CTRange range = selection->ranges[i];
+		[indices addIndexesInRange:NSMakeRange(range.start, range.end - range.start)];
+	}
+	return indices;
+}
+
+- (BOOL)isTabSelectedAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	return CTTabStripCoreIsSelected(core_, index);
+}
+
+- (int)selectedTabCount {
+	return CTTabStripCoreSelection(core_)->size;
+}
+
+- (void)toggleSelectionAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	CTTabContents *oldContents = [self activeTabContents];
+	NSRange oldSpan = [self selectionSpan];
+	CTTabStripCoreToggleSelected(core_, index);
+	[self selectionDidChangeFrom:oldContents
+				   selectionSpan:oldSpan
+					 userGesture:YES];
+}
+
+- (void)extendSelectionToIndex:(int)index
+			 addingToSelection:(BOOL)add {
+	assert([self containsIndex:index]);
+	CTTabContents *oldContents = [self activeTabContents];
+	NSRange oldSpan = [self selectionSpan];
+	CTTabStripCoreExtendSelection(core_, index, add);
+	[self selectionDidChangeFrom:oldContents
+				   selectionSpan:oldSpan
+					 userGesture:YES];
+}
+
+- (void)setSelectedTabsPinned:(BOOL)pinned {
+	// The tabs whose state changes, found before the core moves the flags.
+	NSIndexSet *selected = [self selectedIndices];
+	NSMutableArray *changing = [NSMutableArray arrayWithCapacity:[selected count]];
+	for (NSUInteger i = [selected firstIndex]; i != NSNotFound;
+		 i = [selected indexGreaterThanIndex:i]) {
+		if (!CTTabStripCoreIsApp(core_, (int)i) &&
+			CTTabStripCoreIsPinned(core_, (int)i) != !!pinned) {
+			[changing addObject:[self tabContentsAtIndex:(int)i]];
+		}
+	}
+	if (![changing count])
+		return;
+	
+	[self beginUpdates];
+	int count = [self count];
+	int *permutation = malloc(count * sizeof(int));
+	CTTabStripCoreSetSelectionPinned(core_, pinned, permutation);
+	BOOL identity = YES;
+	for (int i = 0; i < count && identity; ++i)
+		identity = permutation[i] == i;
+	// The core already flipped the flags, so the tabs have to be moved to
+	// their side before anyone looks at them.
+	if (!identity)
+		[self applyPermutation:permutation];
+	free(permutation);
+	for (CTTabContents *contents in changing) {
+		int index = [self indexOfTabContents:contents];
+		CTTabStripModelEvent miniEvent = {
+			.type = CTTabStripModelEventMiniStateChanged,
+			.contents = contents,
+			.index = index,
+		};
+		[self notifyObservers:&miniEvent];
+		CTTabStripModelEvent pinnedEvent = {
+			.type = CTTabStripModelEventPinnedStateChanged,
+			.contents = contents,
+			.index = index,
+			.flag = pinned,
+		};
+		[self notifyObservers:&pinnedEvent];
+	}
+	[self endUpdates];
+}
+
+- (void)moveSelectedTabsToIndex:(int)index {
+	int count = [self count];
+	if (!count)
+		return;
+	int *permutation = malloc(count * sizeof(int));
+	CTTabStripCorePermutationForMovingSelection(core_, index, permutation);
+	BOOL identity = YES;
+	for (int i = 0; i < count && identity; ++i)
+		identity = permutation[i] == i;
+	if (!identity)
+		[self applyPermutation:permutation];
+	free(permutation);
 }
 
 - (CTTabContents *)tabContentsAtIndex:(int)index {
     if ([self containsIndex:index]) {
-		TabContentsData* data = [contentsData_ objectAtIndex:index];
-		return data->contents;
+		return [self contentsOfData:[self dataAtIndex:index]];
     }
     return nil;
 }
 
+- (BOOL)isTabDeferredAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	TabContentsData* data = [self dataAtIndex:index];
+	return !data->contents;
+}
+
+- (NSString *)titleOfTabAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	TabContentsData* data = [self dataAtIndex:index];
+	if (data->contents)
+		return data->contents.title;
+	return [delegate_ titleOfDeferredTabWithKey:data->deferredKey];
+}
+
 - (int)indexOfTabContents:(const CTTabContents *)contents {
-	int index = 0;
-    for (TabContentsData* data in contentsData_) {
-        if (data->contents == contents) {
-            return index;
-        }
-        index++;
-    }
+	TabContentsData* data = [self dataOfContents:(CTTabContents *)contents];
+	return data ? [self indexOfData:data] : kNoTab;
+}
+
+- (CTTabContents *)openerOfTabContentsAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	CTTabHandle opener =
+		CTTabStripCoreOpenerOfTab(core_, CTTabStripCoreTabAtIndex(core_, index));
+	if (!opener)
+		return nil;
+	return [self contentsOfData:[dataByHandle_ objectAtIndex:opener]];
+}
+
+- (int)indexOfOpenerOfTabAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	CTTabHandle opener =
+		CTTabStripCoreOpenerOfTab(core_, CTTabStripCoreTabAtIndex(core_, index));
+	return opener ? CTTabStripCoreIndexOfTab(core_, opener) : kNoTab;
+}
+
+- (void)setOpenerOfTabAtIndex:(int)index
+				 toTabAtIndex:(int)openerIndex {
+	assert([self containsIndex:index]);
+	TabContentsData* data = [self dataAtIndex:index];
+	TabContentsData* openerData = nil;
+	if (openerIndex != index && [self containsIndex:openerIndex])
+		openerData = [self dataAtIndex:openerIndex];
+	// A deferred opener has no contents to set |parentOpener| to yet, and
+	// setting it to nil leaves the tab without an opener, so the core is
+	// told last.
+	if (data->contents)
+		data->contents.parentOpener = openerData ? openerData->contents : nil;
+	CTTabHandle opener = openerData ? openerData->handle : CTNoTabHandle;
+	if (opener == CTTabStripCoreOpenerOfTab(core_, data->handle))
+		return;
+	CTTabStripCoreSetOpener(core_, data->handle, opener);
+	[self openerOfDataDidChange:data];
+}
+
+- (int)indexOfNextTabContentsOpenedBy:(CTTabContents *)opener
+						   afterIndex:(int)startIndex {
+	TabContentsData *data = [self dataOfContents:opener];
+	if (!data)
+		return kNoTab;
+	int index = CTTabStripCoreIndexOfNextTabOpenedBy(core_, data->handle,
+													 startIndex);
+	return index == CTTabStripCoreNoTab ? kNoTab : index;
+}
+
+- (int)indexOfFirstTabContentsOpenedBy:(CTTabContents *)opener
+							beforeIndex:(int)startIndex {
+	TabContentsData *data = [self dataOfContents:opener];
+	if (!data || !CTTabStripCoreOpenedTabCount(core_, data->handle))
+		return kNoTab;
+	int index = CTTabStripCoreIndexOfTab(core_,
+		CTTabStripCoreOpenedTab(core_, data->handle, 0));
+	return index < startIndex ? index : kNoTab;
+}
+
+- (int)indexOfLastTabContentsOpenedBy:(CTTabContents *)opener
+						   afterIndex:(int)startIndex {
+	TabContentsData *data = [self dataOfContents:opener];
+	int count = data ? CTTabStripCoreOpenedTabCount(core_, data->handle) : 0;
+	if (!count)
+		return kNoTab;
+	int index = CTTabStripCoreIndexOfTab(core_,
+		CTTabStripCoreOpenedTab(core_, data->handle, count - 1));
+	return index > startIndex ? index : kNoTab;
+}
+
+- (NSIndexSet *)indicesOfTabContentsOpenedBy:(CTTabContents *)opener {
+	NSMutableIndexSet *indices = [NSMutableIndexSet indexSet];
+	TabContentsData *data = [self dataOfContents:opener];
+	int count = data ? CTTabStripCoreOpenedTabCount(core_, data->handle) : 0;
+	for (int i = 0; i < count; ++i) {
+		[indices addIndex:CTTabStripCoreIndexOfTab(core_,
+			CTTabStripCoreOpenedTab(core_, data->handle, i))];
+	}
+	return indices;
+}
+
+- (void)tabContentsParentOpenerDidChange:(CTTabContents *)contents {
+	TabContentsData* data = [self dataOfContents:contents];
+	if (!data)
+		return;
+	// Only openers in the strip count.
+	CTTabContents* parentOpener = contents.parentOpener;
+	TabContentsData* openerData =
+		parentOpener != contents ? [self dataOfContents:parentOpener] : nil;
+	CTTabHandle opener = openerData ? openerData->handle : CTNoTabHandle;
+	if (opener == CTTabStripCoreOpenerOfTab(core_, data->handle))
+		return;
+	CTTabStripCoreSetOpener(core_, data->handle, opener);
+	[self openerOfDataDidChange:data];
+}
+
+#pragma mark -
+#pragma mark Tab groups
+- (int)groupOfTabAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	NSUInteger position = [self positionOfGroupContainingIndex:index];
+	if (position == NSNotFound)
+		return kNoTabGroup;
+	CTTabGroupData *group = [groups_ objectAtIndex:position];
+	return group->identifier;
+}
+
+- (NSRange)rangeOfGroup:(int)groupID {
+	CTTabGroupData *group =
+		[groupsByIdentifier_ objectForKey:[NSNumber numberWithInt:groupID]];
+	if (!group)
+		return NSMakeRange(NSNotFound, 0);
+	return NSMakeRange([self indexOfData:group->first], group->count);
+}
+
+- (int)createGroupWithTabsInRange:(NSRange)range {
+	if (!range.length || NSMaxRange(range) > [self count]) {
+		DLOG("[ChromiumTabs] %s: invalid range %@", __PRETTY_FUNCTION__,
+			 NSStringFromRange(range));
+		return kNoTabGroup;
+	}
+	NSUInteger position = [self positionOfFirstGroupStartingAtOrAfter:range.location];
+	CTTabGroupData *before = position > 0 ? [groups_ objectAtIndex:position - 1] : nil;
+	CTTabGroupData *after =
+		position < [groups_ count] ? [groups_ objectAtIndex:position] : nil;
+	TabContentsData *first = [self dataAtIndex:range.location];
+	TabContentsData *last = [self dataAtIndex:NSMaxRange(range) - 1];
+	if ((before && !CTTabStripCoreIsBefore(core_, before->last->handle,
+										   first->handle)) ||
+		(after && !CTTabStripCoreIsBefore(core_, last->handle,
+										  after->first->handle))) {
+		DLOG("[ChromiumTabs] %s: %@ overlaps an existing group",
+			 __PRETTY_FUNCTION__, NSStringFromRange(range));
+		return kNoTabGroup;
+	}
+	
+	CTTabGroupData *group = [[CTTabGroupData alloc] init];
+	group->identifier = nextGroupIdentifier_++;
+	group->first = first;
+	group->last = last;
+	group->count = range.length;
+	[groups_ insertObject:group atIndex:position];
+	[groupsByIdentifier_ setObject:group
+							forKey:[NSNumber numberWithInt:group->identifier]];
+	[self notifyGroupChanged:group];
+	return group->identifier;
+}
+
+- (void)removeGroup:(int)groupID {
+	NSNumber *key = [NSNumber numberWithInt:groupID];
+	CTTabGroupData *group = [groupsByIdentifier_ objectForKey:key];
+	if (!group)
+		return;
+	NSUInteger position =
+		[self positionOfFirstGroupStartingAtOrAfter:[self indexOfData:group->first]];
+	assert([groups_ objectAtIndex:position] == group);
+	[groups_ removeObjectAtIndex:position];
+	[groupsByIdentifier_ removeObjectForKey:key];
+	[self notifyGroupChanged:group];
+}
+
+- (void)moveGroup:(int)groupID toIndex:(int)index {
+	NSRange range = [self rangeOfGroup:groupID];
+	if (range.location == NSNotFound)
+		return;
+	int count = [self count];
+	int length = range.length;
+	index = MIN(MAX(index, 0), count - length);
+	if (index == (int)range.location)
+		return;
+	
+	// |index| is a position among the tabs outside the group. Don't split
+	// another group: if the tabs on either side of |index| share a group,
+	// move past the end of it.
+	// Works on the TabContentsData, so deferred tabs stay deferred.
+	NSMutableArray *others = [NSMutableArray arrayWithCapacity:count];
+	[others addObjectsFromArray:
+		[self dataInRange:NSMakeRange(0, range.location)]];
+	[others addObjectsFromArray:
+		[self dataInRange:NSMakeRange(NSMaxRange(range), count - NSMaxRange(range))]];
+	if (index > 0 && index < (int)[others count]) {
+		int beforeIndex = [self indexOfData:[others objectAtIndex:index - 1]];
+		int afterIndex = [self indexOfData:[others objectAtIndex:index]];
+		int group = [self groupOfTabAtIndex:beforeIndex];
+		if (group != kNoTabGroup && group == [self groupOfTabAtIndex:afterIndex]) {
+			NSRange other = [self rangeOfGroup:group];
+			index = NSMaxRange(other) - (other.location > range.location ? length : 0);
+		}
+	}
 	
-	return kNoTab;
+	NSMutableArray *ordered = [NSMutableArray arrayWithArray:others];
+	[ordered insertObjects:[self dataInRange:range]
+				 atIndexes:[NSIndexSet indexSetWithIndexesInRange:
+							NSMakeRange(index, length)]];
+	[self reorderData:ordered];
+}
+
+- (void)setGroup:(int)groupID collapsed:(BOOL)collapsed {
+	CTTabGroupData *group =
+		[groupsByIdentifier_ objectForKey:[NSNumber numberWithInt:groupID]];
+	if (!group || group->collapsed == collapsed)
+		return;
+	group->collapsed = collapsed;
+	[self notifyGroupChanged:group];
+}
+
+- (BOOL)isGroupCollapsed:(int)groupID {
+	CTTabGroupData *group =
+		[groupsByIdentifier_ objectForKey:[NSNumber numberWithInt:groupID]];
+	return group && group->collapsed;
+}
+
+- (NSIndexSet *)indicesOfTabsHiddenByCollapsedGroups {
+	NSMutableIndexSet *indices = [NSMutableIndexSet indexSet];
+	for (CTTabGroupData *group in groups_) {
+		if (group->collapsed && group->count > 1) {
+			[indices addIndexesInRange:
+				NSMakeRange([self indexOfData:group->first] + 1, group->count - 1)];
+		}
+	}
+	return indices;
 }
 
 - (void)updateTabContentsStateAtIndex:(int)index 
 						   changeType:(CTTabChangeType)changeType {
 	assert([self containsIndex:index]);
 	
-    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-							  [self tabContentsAtIndex:index], CTTabContentsUserInfoKey,
-                              [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-                              [NSNumber numberWithInt:changeType], CTTabOptionsUserInfoKey, 
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabChangedNotification 
-														object:self 
-													  userInfo:userInfo];
+	if (updateDepth_) {
+		[changedWhileUpdating_ addObject:[self dataAtIndex:index]];
+		return;
+	}
+	
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventChanged,
+		.contents = [self tabContentsAtIndex:index],
+		.index = index,
+		.changeType = changeType,
+	};
+	[self notifyObservers:&event];
 }
 
 - (void)closeAllTabs {
 	closingAll_ = YES;
-	NSMutableArray *closing_tabs = [NSMutableArray array];
-	for (int i = [self count] - 1; i >= 0; --i)
-		[closing_tabs addObject:[NSNumber numberWithInt:i]];
+	NSIndexSet *closing_tabs =
+		[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, [self count])];
 	[self internalCloseTabs:closing_tabs closeTypes:CLOSE_CREATE_HISTORICAL_TAB];
 }
 
 - (BOOL)closeTabContentsAtIndex:(int)index 
 				 closeTypes:(uint32)closeTypes {
-	return [self internalCloseTabs:[NSArray arrayWithObject:[NSNumber numberWithInt:index]]
+	return [self internalCloseTabs:[NSIndexSet indexSetWithIndex:index]
 						closeTypes:closeTypes];
 }
 
+- (BOOL)closeTabContentsAtIndices:(NSIndexSet *)indices
+					   closeTypes:(uint32)closeTypes {
+	return [self internalCloseTabs:indices closeTypes:closeTypes];
+}
+
 - (BOOL)tabsAreLoading {
-	for (TabContentsData *data in contentsData_) {
-		if (data->contents.isLoading)
+	int count = [self count];
+	for (int i = 0; i < count; ++i) {
+		if ([self dataAtIndex:i]->contents.isLoading)
 			return YES;
 	}
 	return NO;
 }
 
+- (void)beginUpdates {
+	if (updateDepth_++)
+		return;
+	dataBeforeUpdates_ = [self dataInRange:NSMakeRange(0, [self count])];
+	activeContentsBeforeUpdates_ = [self activeTabContents];
+	selectionByUserGesture_ = NO;
+	selectionChangedWhileUpdating_ = NO;
+	NSPointerFunctionsOptions options = NSPointerFunctionsStrongMemory |
+		NSPointerFunctionsObjectPointerPersonality;
+	insertedWhileUpdating_ = [[NSHashTable alloc] initWithOptions:options capacity:0];
+	movedWhileUpdating_ = [[NSHashTable alloc] initWithOptions:options capacity:0];
+	changedWhileUpdating_ = [[NSHashTable alloc] initWithOptions:options capacity:0];
+}
+
+- (void)endUpdates {
+	assert(updateDepth_ > 0);
+	if (--updateDepth_ == 0)
+		[self commitUpdates];
+}
+
+- (BOOL)isUpdating {
+	return updateDepth_ > 0;
+}
+
+#pragma mark -
+#pragma mark Observers
+- (void)addObserver:(id<CTTabStripModelObserver>)observer {
+	assert(observer);
+	if (observerCount_ == observerCapacity_) {
+		observerCapacity_ = observerCapacity_ ? observerCapacity_ * 2 : 4;
+		observers_ = realloc(observers_,
+							 observerCapacity_ * sizeof(CTTabStripModelObserverEntry));
+	}
+	CTTabStripModelObserverEntry *entry = &observers_[observerCount_++];
+	entry->observer = observer;
+	entry->imp = (CTTabStripModelObserverIMP)
+		[(id)observer methodForSelector:@selector(tabStripModel:didReceiveEvent:)];
+}
+
+- (void)removeObserver:(id<CTTabStripModelObserver>)observer {
+	for (int i = 0; i < observerCount_; ++i) {
+		if (observers_[i].observer != observer)
+			continue;
+		if (dispatchDepth_) {
+			observers_[i].observer = nil;
+			observersNeedCompaction_ = YES;
+		} else {
+			memmove(&observers_[i], &observers_[i + 1],
+					(observerCount_ - i - 1) * sizeof(CTTabStripModelObserverEntry));
+			--observerCount_;
+		}
+		return;
+	}
+}
+
 - (void)tabNavigating:(CTTabContents *)contents
 	   withTransition:(CTPageTransition)transition {
 	
@@ -380,28 +1235,28 @@ const int kNoTab = NSNotFound;
 - (void)setTabAtIndex:(int)index 
 			  blocked:(BOOL)blocked {
 	assert([self containsIndex:index]);
-	TabContentsData *data = [contentsData_ objectAtIndex:index];
+	// Nil if the tab is deferred, which blocking it doesn't change.
+	TabContentsData *data = [self dataAtIndex:index];
 	CTTabContents *contents = data->contents;
-	if (data->isBlocked == blocked) {
+	if (CTTabStripCoreIsBlocked(core_, index) == !!blocked) {
 		return;
 	}
-	data->isBlocked = blocked;
+	CTTabStripCoreSetBlocked(core_, index, blocked);
 	
-    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-							  contents, CTTabContentsUserInfoKey,
-                              [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-                              [NSNumber numberWithInt:blocked], CTTabOptionsUserInfoKey, 
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabBlockedStateChangedNotification
-														object:self 
-													  userInfo:userInfo];
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventBlockedStateChanged,
+		.contents = contents,
+		.index = index,
+		.flag = blocked,
+	};
+	[self notifyObservers:&event];
 }
 
 - (void)setTabAtIndex:(int)index 
 			   pinned:(BOOL)pinned {
-	TabContentsData *data = [contentsData_ objectAtIndex:index];
-	CTTabContents *contents = data->contents;
-	if (data->isPinned == pinned)
+	assert([self containsIndex:index]);
+	CTTabContents *contents = [self tabContentsAtIndex:index];
+	if (CTTabStripCoreIsPinned(core_, index) == !!pinned)
 		return;
 	
 	if ([self isAppTabAtIndex:index]) {
@@ -412,44 +1267,39 @@ const int kNoTab = NSNotFound;
 		}
 		// Changing the pinned state of an app tab doesn't effect it's mini-tab
 		// status.
-		data->isPinned = pinned;
+		CTTabStripCoreSetPinned(core_, index, pinned);
 	} else {
 		// The tab is not an app tab, it's position may have to change as the
 		// mini-tab state is changing.
-		int non_miniTab_index = [self indexOfFirstNonMiniTab];
-		data->isPinned = pinned;
-		if (pinned && index != non_miniTab_index) {
-			[self moveTabContentsAtImpl:index toPosition:non_miniTab_index selectAfterMove:NO];
-			return;  // Don't send TabPinnedStateChanged notification.
-		} else if (!pinned && index + 1 != non_miniTab_index) {
-			[self moveTabContentsAtImpl:index toPosition:non_miniTab_index - 1 selectAfterMove:NO];
+		int toIndex = CTTabStripCoreSetPinned(core_, index, pinned);
+		if (toIndex != index) {
+			[self moveTabContentsAtImpl:index toPosition:toIndex selectAfterMove:NO];
 			return;  // Don't send TabPinnedStateChanged notification.
 		}
 	
-	    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-								  contents, CTTabContentsUserInfoKey,
-								  [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-								  nil];
-		[[NSNotificationCenter defaultCenter] postNotificationName:CTTabMiniStateChangedNotification
-															object:self 
-														  userInfo:userInfo];
+		CTTabStripModelEvent event = {
+			.type = CTTabStripModelEventMiniStateChanged,
+			.contents = contents,
+			.index = index,
+		};
+		[self notifyObservers:&event];
 	}
 	
 	// else: the tab was at the boundary and it's position doesn't need to
 	// change.
 	
-	NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-							  contents, CTTabContentsUserInfoKey,
-							  [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-							  [NSNumber numberWithInt:pinned], CTTabOptionsUserInfoKey, 
-							  nil];
-	[[NSNotificationCenter defaultCenter] postNotificationName:CTTabPinnedStateChangedNotification
-														object:self
-													  userInfo:userInfo];
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventPinnedStateChanged,
+		.contents = contents,
+		.index = index,
+		.flag = pinned,
+	};
+	[self notifyObservers:&event];
 }
 
 - (BOOL)isTabPinnedAtIndex:(int)index {
-	return ((TabContentsData *)[contentsData_ objectAtIndex:index])->isPinned;
+	assert([self containsIndex:index]);
+	return CTTabStripCoreIsPinned(core_, index);
 }
 
 - (BOOL)isMiniTabAtIndex:(int)index {
@@ -457,28 +1307,49 @@ const int kNoTab = NSNotFound;
 }
 
 - (BOOL)isAppTabAtIndex:(int)index {
-	CTTabContents* contents = [self tabContentsAtIndex:index];
-	return contents && contents.isApp;
+	return [self containsIndex:index] && CTTabStripCoreIsApp(core_, index);
 }
 
 - (BOOL)isTabBlockedAtIndex:(int)index {
-	return ((TabContentsData *)[contentsData_ objectAtIndex:index])->isBlocked;
+	assert([self containsIndex:index]);
+	return CTTabStripCoreIsBlocked(core_, index);
 }
 
 - (int)indexOfFirstNonMiniTab {
-	for (int i = 0; i < [contentsData_ count]; ++i) {
-		if (![self isMiniTabAtIndex:i])
-			return i;
+	return CTTabStripCoreMiniTabCount(core_);
+}
+
+- (int)pinnedTabCount {
+	return CTBitVectorCountSet(CTTabStripCorePinnedTabs(core_));
+}
+
+- (int)blockedTabCount {
+	return CTBitVectorCountSet(CTTabStripCoreBlockedTabs(core_));
+}
+
+- (NSIndexSet *)indicesOfPinnedTabs {
+	NSMutableIndexSet *indices = [NSMutableIndexSet indexSet];
+	const CTBitVector *pinned = CTTabStripCorePinnedTabs(core_);
+	for (size_t i = CTBitVectorNextSet(pinned, 0); i < pinned->count;
+		 i = CTBitVectorNextSet(pinned, i + 1)) {
+		[indices addIndex:i];
 	}
-	// No non-mini-tabs.
-	return [self count];
+	return indices;
+}
+
+- (NSIndexSet *)indicesOfBlockedTabs {
+	NSMutableIndexSet *indices = [NSMutableIndexSet indexSet];
+	const CTBitVector *blocked = CTTabStripCoreBlockedTabs(core_);
+	for (size_t i = CTBitVectorNextSet(blocked, 0); i < blocked->count;
+		 i = CTBitVectorNextSet(blocked, i + 1)) {
+		[indices addIndex:i];
+	}
+	return indices;
 }
 
 - (int)constrainInsertionIndex:(int)index 
 					   miniTab:(BOOL)miniTab {
-//	return miniTab ? std::min(std::max(0, index), [self IndexOfFirstNonMiniTab]) :
-//	std::min([self count], std::max(index, [self IndexOfFirstNonMiniTab]));
-    return miniTab ? MIN(MAX(0, index), [self indexOfFirstNonMiniTab]) : MIN(self.count, MAX(index, [self indexOfFirstNonMiniTab]));
+	return CTTabStripCoreConstrainInsertionIndex(core_, index, miniTab);
 }
 
 #pragma mark -
@@ -529,7 +1400,7 @@ const int kNoTab = NSNotFound;
 }
 
 - (void)closeActiveTab {
-	[self closeTabContentsAtIndex:activeIndex_
+	[self closeTabContentsAtIndex:[self activeIndex]
 				   closeTypes:CLOSE_CREATE_HISTORICAL_TAB];
 }
 
@@ -546,16 +1417,22 @@ const int kNoTab = NSNotFound;
 					   userGesture:YES];
 }
 
+- (void)selectPreviouslyActiveTab {
+	int index = [orderController_ indexOfPreviouslyActiveTab];
+	if (index != kNoTab)
+		[self selectTabContentsAtIndex:index userGesture:YES];
+}
+
 - (void)moveTabNext {
-	int newIndex = MIN(activeIndex_ + 1, [self count] - 1);
-	[self moveTabContentsAtIndex:activeIndex_ 
+	int newIndex = MIN([self activeIndex] + 1, [self count] - 1);
+	[self moveTabContentsAtIndex:[self activeIndex] 
 						 toIndex:newIndex
 				 selectAfterMove:YES];
 }
 
 - (void)moveTabPrevious {
-	int newIndex = MAX(activeIndex_ - 1, 0);
-	[self moveTabContentsAtIndex:activeIndex_
+	int newIndex = MAX([self activeIndex] - 1, 0);
+	[self moveTabContentsAtIndex:[self activeIndex]
 						 toIndex:newIndex
 				 selectAfterMove:YES];
 }
@@ -582,23 +1459,29 @@ const int kNoTab = NSNotFound;
 			} else {
 				return NO;
 			}
-		case CommandCloseOtherTabs: {
-			int miniTabCount = [self indexOfFirstNonMiniTab];
-			int nonMiniTabCount = [self count] - miniTabCount;
-			// Close other doesn't effect mini-tabs.
-			return nonMiniTabCount > 1 ||
-			(nonMiniTabCount == 1 && contextIndex != miniTabCount);
-		}
+		case CommandCloseOtherTabs:
 		case CommandCloseTabsToRight:
 			// Close doesn't effect mini-tabs.
-			return [self count] != [self indexOfFirstNonMiniTab] &&
-			contextIndex < ([self count] - 1);
+			return [[self indicesClosedByCommand:commandID
+								   forTabAtIndex:contextIndex] count] > 0;
 		case CommandDuplicate:
 			return [delegate_ canDuplicateContentsAt:contextIndex];
 		case CommandRestoreTab:
 			return [delegate_ canRestoreTab];
-		case CommandTogglePinned:
-			return ![self isAppTabAtIndex:contextIndex];
+		case CommandTogglePinned: {
+			NSIndexSet *indices =
+				[self indicesAffectedByCommandForTabAtIndex:contextIndex];
+			for (NSUInteger i = [indices firstIndex]; i != NSNotFound;
+				 i = [indices indexGreaterThanIndex:i]) {
+				if (![self isAppTabAtIndex:(int)i])
+					return YES;
+			}
+			return NO;
+		}
+		case CommandMoveTabsToNewWindow:
+			// Some tab has to stay behind.
+			return [[self indicesAffectedByCommandForTabAtIndex:contextIndex] count] <
+				[self count];
 		default:
 			NOTREACHED();
 	}
@@ -631,19 +1514,20 @@ const int kNoTab = NSNotFound;
 			//delegate_->DuplicateContentsAt(contextIndex);
 			break;
 		case CommandCloseTab:
-			[self closeTabContentsAtIndex:contextIndex
-						   closeTypes:CLOSE_CREATE_HISTORICAL_TAB |
-							   CLOSE_USER_GESTURE];
+			[self internalCloseTabs:[self indicesClosedByCommand:commandID
+												   forTabAtIndex:contextIndex]
+						 closeTypes:CLOSE_CREATE_HISTORICAL_TAB |
+							 CLOSE_USER_GESTURE];
 			break;
 		case CommandCloseOtherTabs: {
-			[self internalCloseTabs:[self getIndicesClosedByCommand:commandID 
-													  forTabAtIndex:contextIndex]
+			[self internalCloseTabs:[self indicesClosedByCommand:commandID 
+												   forTabAtIndex:contextIndex]
 						 closeTypes:CLOSE_CREATE_HISTORICAL_TAB];
 			break;
 		}
 		case CommandCloseTabsToRight: {
-			[self internalCloseTabs:[self getIndicesClosedByCommand:commandID 
-													  forTabAtIndex:contextIndex]
+			[self internalCloseTabs:[self indicesClosedByCommand:commandID 
+												   forTabAtIndex:contextIndex]
 						 closeTypes:CLOSE_CREATE_HISTORICAL_TAB];
 			break;
 		}
@@ -653,10 +1537,38 @@ const int kNoTab = NSNotFound;
 			break;
 		}
 		case CommandTogglePinned: {
+			if ([[self indicesAffectedByCommandForTabAtIndex:contextIndex] count] > 1) {
+				// The selected tabs all follow the tab the menu is for.
+				[self setSelectedTabsPinned:![self isTabPinnedAtIndex:contextIndex]];
+				break;
+			}
+			[self beginUpdates];
 			[self selectTabContentsAtIndex:contextIndex
 							   userGesture:YES];
 			[self setTabAtIndex:contextIndex 
 						 pinned:![self isTabPinnedAtIndex:contextIndex]];
+			[self endUpdates];
+			break;
+		}
+		case CommandMoveTabsToNewWindow: {
+			NSIndexSet *indices =
+				[self indicesAffectedByCommandForTabAtIndex:contextIndex];
+			if ([indices count] == [self count])
+				break;
+			// Pinned tabs stay pinned; they are the first ones moved since
+			// they come first in the strip.
+			NSMutableIndexSet *pinned = [NSMutableIndexSet indexSet];
+			NSUInteger position = 0;
+			for (NSUInteger i = [indices firstIndex]; i != NSNotFound;
+				 i = [indices indexGreaterThanIndex:i], ++position) {
+				if ([self isTabPinnedAtIndex:(int)i])
+					[pinned addIndex:position];
+			}
+			[self beginUpdates];
+			NSArray *contents = [self detachTabContentsAtIndices:indices];
+			[self endUpdates];
+			[delegate_ createNewStripWithTabContents:contents
+									   pinnedIndices:pinned];
 			break;
 		}
 
@@ -667,18 +1579,14 @@ const int kNoTab = NSNotFound;
 
 - (NSArray *)getIndicesClosedByCommand:(ContextMenuCommand)commandID
 						 forTabAtIndex:(int)index {
-	assert([self containsIndex:index]);
+	NSIndexSet *closing = [self indicesClosedByCommand:commandID
+										 forTabAtIndex:index];
 	
 	// NOTE: some callers assume indices are sorted in reverse order.
-	NSMutableArray *indices = [NSMutableArray array];
-	
-	if (commandID != CommandCloseTabsToRight && commandID != CommandCloseOtherTabs)
-		return indices;
-	
-	int start = (commandID == CommandCloseTabsToRight) ? index + 1 : 0;
-	for (int i = [self count] - 1; i >= start; --i) {
-		if (i != index && ![self isMiniTabAtIndex:i])
-			[indices addObject:[NSNumber numberWithInt:i]];
+	NSMutableArray *indices = [NSMutableArray arrayWithCapacity:[closing count]];
+	for (NSUInteger i = [closing lastIndex]; i != NSNotFound;
+		 i = [closing indexLessThanIndex:i]) {
+		[indices addObject:[NSNumber numberWithInt:i]];
 	}
 	return indices;
 }
@@ -702,14 +1610,51 @@ const int kNoTab = NSNotFound;
 	 contents->controller().entry_count() == 1;*/
 }
 
-- (BOOL)internalCloseTabs:(NSArray *)indices
+- (NSIndexSet *)indicesClosedByCommand:(ContextMenuCommand)commandID
+						 forTabAtIndex:(int)index {
+	assert([self containsIndex:index]);
+	
+	NSIndexSet *affected = [self indicesAffectedByCommandForTabAtIndex:index];
+	if (commandID == CommandCloseTab)
+		return affected;
+	NSMutableIndexSet *indices = [NSMutableIndexSet indexSet];
+	if (commandID != CommandCloseTabsToRight && commandID != CommandCloseOtherTabs)
+		return indices;
+	
+	// Mini-tabs are never closed by these commands, and they are all in front
+	// of the first non-mini-tab.
+	int start = (commandID == CommandCloseTabsToRight) ?
+		(int)[affected lastIndex] + 1 : 0;
+	start = MAX(start, CTTabStripCoreMiniTabCount(core_));
+	if (start < (int)[self count])
+		[indices addIndexesInRange:NSMakeRange(start, [self count] - start)];
+	[indices removeIndexes:affected];
+	return indices;
+}
+
+- (NSIndexSet *)indicesAffectedByCommandForTabAtIndex:(int)index {
+	if (CTTabStripCoreIsSelected(core_, index))
+		return [self selectedIndices];
+	return [NSIndexSet indexSetWithIndex:index];
+}
+
+- (BOOL)internalCloseTabs:(NSIndexSet *)indices
 			   closeTypes:(uint32)closeTypes {
 	BOOL retval = YES;
-		
-	// We now return to our regularly scheduled shutdown procedure.
-	for (size_t i = 0; i < indices.count; ++i) {
-		int index = [[indices objectAtIndex:i] intValue];
-		CTTabContents* detachedContents = [self tabContentsAtIndex:index];
+	
+	// Observers see the whole close as one transaction: a single selection
+	// change and a single layout instead of one per closed tab.
+	[self beginUpdates];
+	
+	// Ask about every tab first, back to front, and only then take the ones
+	// that may close out of the strip in one go.
+	NSMutableIndexSet *closing = [NSMutableIndexSet indexSet];
+	for (NSUInteger i = [indices lastIndex]; i != NSNotFound;
+		 i = [indices indexLessThanIndex:i]) {
+		int index = (int)i;
+		// Deferred tabs have no page to close, so they are closed without
+		// ever getting contents.
+		CTTabContents* detachedContents = [self dataAtIndex:index]->contents;
 		[detachedContents closingOfTabDidStart:self]; // TODO notification
 		
 		if (![delegate_ canCloseContentsAt:index]) {
@@ -725,7 +1670,8 @@ const int kNoTab = NSNotFound;
 			detachedContents.closedByUserGesture = closeTypes & CLOSE_USER_GESTURE;
 		}
 		
-		if ([delegate_ runUnloadListenerBeforeClosing:detachedContents]) {
+		if (detachedContents &&
+			[delegate_ runUnloadListenerBeforeClosing:detachedContents]) {
 			retval = NO;
 			continue;
 		}
@@ -733,52 +1679,280 @@ const int kNoTab = NSNotFound;
 		[self internalCloseTab:detachedContents
 					   atIndex:index
 		   createHistoricalTab:((closeTypes & CLOSE_CREATE_HISTORICAL_TAB) != 0)];
+		[closing addIndex:index];
 	}
+	[self removeTabsAtIndices:closing];
 	
+	[self endUpdates];
 	return retval;	
 }
 
 - (void)internalCloseTab:(CTTabContents *)contents
 				 atIndex:(int)index
 	 createHistoricalTab:(BOOL)createHistoricalTabs {
-    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-                              contents, CTTabContentsUserInfoKey,
-                              [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabClosingNotification 
-														object:self 
-													  userInfo:userInfo];
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventClosing,
+		.contents = contents,
+		.index = index,
+	};
+	[self notifyObservers:&event];
 	
 	// Ask the delegate to save an entry for this tab in the historical tab
 	// database if applicable.
 	if (createHistoricalTabs) {
-		[delegate_ createHistoricalTab:contents];
+		if (contents)
+			[delegate_ createHistoricalTab:contents];
+		else
+			[delegate_ createHistoricalTabForDeferredTabAtIndex:index];
+	}
+}
+
+- (NSArray *)detachTabContentsAtIndices:(NSIndexSet *)indices {
+	// The caller takes the contents, so deferred tabs need theirs.
+	for (NSUInteger i = [indices firstIndex]; i != NSNotFound;
+		 i = [indices indexGreaterThanIndex:i]) {
+		[self contentsOfData:[self dataAtIndex:(int)i]];
+	}
+	return [self removeTabsAtIndices:indices];
+}
+
+- (NSArray *)removeTabsAtIndices:(NSIndexSet *)indices {
+	int count = [self count];
+	if (![indices count])
+		return [NSArray array];
+	assert([indices lastIndex] < (NSUInteger)count);
+	
+	CTTabContents* activeContents = [self activeTabContents];
+	BOOL activeIsClosing = [indices containsIndex:[self activeIndex]];
+	BOOL collapsesSelection = activeIsClosing && [self selectedTabCount] > 1;
+	
+	// Collect the removed tabs per contiguous range, back to front, and the
+	// tabs they opened, while they are still in the strip.
+	NSMutableArray *ranges = [NSMutableArray array];
+	NSMutableArray *rangeContents = [NSMutableArray array];
+	NSMutableArray *removedData = [NSMutableArray arrayWithCapacity:[indices count]];
+	NSMutableArray *orphans = [NSMutableArray array];
+	for (NSUInteger i = [indices lastIndex]; i != NSNotFound;) {
+		NSUInteger end = i + 1;
+		while (i > 0 && [indices containsIndex:i - 1])
+			--i;
+		NSRange range = NSMakeRange(i, end - i);
+		NSMutableArray *contents = [NSMutableArray arrayWithCapacity:range.length];
+		for (NSUInteger j = range.location; j < end; ++j) {
+			TabContentsData* data = [self dataAtIndex:(int)j];
+			[contents addObject:data->contents ? data->contents :
+				(id)[NSNull null]];
+			[removedData addObject:data];
+			[orphans addObjectsFromArray:[self dataOpenedByData:data]];
+		}
+		[ranges addObject:[NSValue valueWithRange:range]];
+		[rangeContents addObject:contents];
+		i = [indices indexLessThanIndex:i];
 	}
+	NSMutableArray *detachedContents =
+		[NSMutableArray arrayWithCapacity:[indices count]];
+	for (NSArray *contents in [rangeContents reverseObjectEnumerator])
+		[detachedContents addObjectsFromArray:contents];
 	
-	// Deleting the CTTabContents will call back to us via NotificationObserver
-	// and detach it.
-	[self detachTabContentsAtIndex:index];
+	// Shrink the groups that lose tabs while their bounds are still current.
+	for (NSUInteger i = [groups_ count]; i-- > 0;) {
+		CTTabGroupData* group = [groups_ objectAtIndex:i];
+		NSRange range = NSMakeRange([self indexOfData:group->first], group->count);
+		int removedCount = (int)[indices countOfIndexesInRange:range];
+		if (!removedCount)
+			continue;
+		if (removedCount == group->count) {
+			[groupsByIdentifier_ removeObjectForKey:
+				[NSNumber numberWithInt:group->identifier]];
+			[groups_ removeObjectAtIndex:i];
+			continue;
+		}
+		group->count -= removedCount;
+		NSUInteger first = range.location;
+		while ([indices containsIndex:first])
+			++first;
+		group->first = [self dataAtIndex:(int)first];
+		NSUInteger last = NSMaxRange(range) - 1;
+		while ([indices containsIndex:last])
+			--last;
+		group->last = [self dataAtIndex:(int)last];
+	}
+	
+	// The core picks the next active tab while the openers are intact,
+	// forgets the ones that leave with the tabs, and shifts the active index
+	// past the removed tabs either way.
+	CTBitVector removed;
+	CTBitVectorInit(&removed);
+	CTBitVectorResize(&removed, count);
+	for (NSUInteger i = [indices firstIndex]; i != NSNotFound;
+		 i = [indices indexGreaterThanIndex:i]) {
+		CTBitVectorSet(&removed, i, true);
+	}
+	int nextActiveIndex = CTTabStripCoreRemoveMarked(core_, &removed);
+	CTBitVectorFree(&removed);
+	for (TabContentsData *data in removedData) {
+		[dataByHandle_ replaceObjectAtIndex:data->handle
+								 withObject:[NSNull null]];
+		data->handle = CTNoTabHandle;
+		if (data->contents)
+			[contentsIndex_ removeObjectForKey:data->contents];
+	}
+	for (TabContentsData *orphan in orphans)
+		[self openerOfDataDidChange:orphan];
+	if ([self count] > 0)
+		closingAll_ = YES;
+	
+	for (NSUInteger i = 0; i < [ranges count]; ++i) {
+		CTTabStripModelEvent event = {
+			.type = CTTabStripModelEventDetachedRange,
+			.range = [[ranges objectAtIndex:i] rangeValue],
+			.rangeContents = [rangeContents objectAtIndex:i],
+		};
+		[self notifyObservers:&event];
+	}
+	if (![self count]) {
+		CTTabStripModelEvent emptyEvent = { .type = CTTabStripModelEventEmpty };
+		[self notifyObservers:&emptyEvent];
+		return detachedContents;
+	}
+	
+	if (activeIsClosing) {
+		[self changeSelectedContentsFrom:activeContents
+								 toIndex:nextActiveIndex
+							 userGesture:NO];
+	}
+	if (collapsesSelection)
+		[self notifySelectionChangedInRange:NSMakeRange(0, [self count])];
+	return detachedContents;
 }
 
 
+- (void)applyPermutation:(const int *)permutation {
+	int count = [self count];
+	int *inverse = malloc(count * sizeof(int));
+	for (int i = 0; i < count; ++i)
+		inverse[permutation[i]] = i;
+	// Where each group starts, before the core moves the tabs.
+	int groupCount = (int)[groups_ count];
+	int *groupStarts = malloc(MAX(groupCount, 1) * sizeof(int));
+	for (int i = 0; i < groupCount; ++i) {
+		CTTabGroupData *group = [groups_ objectAtIndex:i];
+		groupStarts[i] = [self indexOfData:group->first];
+	}
+	if (updateDepth_) {
+		for (int i = 0; i < count; ++i) {
+			if (permutation[i] != i)
+				[movedWhileUpdating_ addObject:[self dataAtIndex:permutation[i]]];
+		}
+	}
+	// The flags, the active index and the openers follow the tabs.
+	CTTabStripCoreReorder(core_, permutation);
+	
+	// Groups whose tabs are still adjacent follow them; the others are
+	// dissolved.
+	NSMutableArray *groups = [NSMutableArray arrayWithCapacity:groupCount];
+	for (int i = 0; i < groupCount; ++i) {
+		CTTabGroupData *group = [groups_ objectAtIndex:i];
+		int first = count;
+		int last = -1;
+		for (int j = groupStarts[i]; j < groupStarts[i] + group->count; ++j) {
+			first = MIN(first, inverse[j]);
+			last = MAX(last, inverse[j]);
+		}
+		if (last - first + 1 == group->count) {
+			group->first = [self dataAtIndex:first];
+			group->last = [self dataAtIndex:last];
+			[groups addObject:group];
+		} else {
+			[groupsByIdentifier_ removeObjectForKey:
+				[NSNumber numberWithInt:group->identifier]];
+		}
+	}
+	CTTabStripCore *core = core_;
+	[groups sortUsingComparator:^NSComparisonResult(id a, id b) {
+		TabContentsData *aFirst = ((CTTabGroupData *)a)->first;
+		TabContentsData *bFirst = ((CTTabGroupData *)b)->first;
+		return CTTabStripCoreIsBefore(core, aFirst->handle, bFirst->handle) ?
+			NSOrderedAscending : NSOrderedDescending;
+	}];
+	groups_ = groups;
+	free(groupStarts);
+	free(inverse);
+	
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventReordered,
+		.permutation = permutation,
+	};
+	[self notifyObservers:&event];
+}
+
 - (void)changeSelectedContentsFrom:(CTTabContents *)oldContents
 						   toIndex:(int)toIndex
 					   userGesture:(BOOL)userGesture {
 	assert([self containsIndex:toIndex]);
 	CTTabContents* newContents = [self tabContentsAtIndex:toIndex];
-	if (oldContents == newContents)
+	// Selecting the active tab still drops the other selected tabs.
+	if (oldContents == newContents && [self selectedTabCount] == 1)
 		return;
+	NSRange oldSpan = [self selectionSpan];
+	CTTabStripCoreSetActiveIndex(core_, toIndex);
+	[self selectionDidChangeFrom:oldContents
+				   selectionSpan:oldSpan
+					 userGesture:userGesture];
+}
 
-	activeIndex_ = toIndex;
-	NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-                              newContents, CTTabNewContentsUserInfoKey,
-                              [NSNumber numberWithInt:self.activeIndex], CTTabIndexUserInfoKey,
-                              [NSNumber numberWithBool:userGesture], CTTabUserGestureUserInfoKey,
-                              oldContents, CTTabContentsUserInfoKey,
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabSelectedNotification 
-														object:self 
-													  userInfo:userInfo];
+- (NSRange)selectionSpan {
+	const CTRangeSet *selection = CTTabStripCoreSelection(core_);
+	if (!selection->count)
+		return NSMakeRange(NSNotFound, 0);
+	int first = selection->ranges[0].start;
+	int end = selection->ranges[selection->count - 1].end;
+	return NSMakeRange(first, end - first);
+}
+
+- (void)selectionDidChangeFrom:(CTTabContents *)oldContents
+				 selectionSpan:(NSRange)oldSpan
+				   userGesture:(BOOL)userGesture {
+	CTTabContents* newContents = [self activeTabContents];
+	NSRange newSpan = [self selectionSpan];
+	if (newContents != oldContents) {
+		if (updateDepth_) {
+			// Reported once, when the updates are committed.
+			selectionByUserGesture_ = userGesture;
+		} else {
+			newContents = [self loadPlaceholderAtIndex:[self activeIndex]];
+			CTTabStripModelEvent event = {
+				.type = CTTabStripModelEventSelected,
+				.contents = newContents,
+				.oldContents = oldContents,
+				.index = [self activeIndex],
+				.flag = userGesture,
+			};
+			[self notifyObservers:&event];
+		}
+	}
+	// A single selected tab is the active tab, which the Selected event
+	// already covers.
+	if (oldSpan.length <= 1 && newSpan.length <= 1)
+		return;
+	if (oldSpan.location == NSNotFound)
+		oldSpan = newSpan;
+	else if (newSpan.location != NSNotFound)
+		oldSpan = NSUnionRange(oldSpan, newSpan);
+	[self notifySelectionChangedInRange:oldSpan];
+}
+
+- (void)notifySelectionChangedInRange:(NSRange)range {
+	if (updateDepth_) {
+		selectionChangedWhileUpdating_ = YES;
+		return;
+	}
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventSelectionChanged,
+		.index = [self activeIndex],
+		.range = range,
+	};
+	[self notifyObservers:&event];
 }
 
 // Selects either the next tab (|foward| is true), or the previous tab
@@ -786,10 +1960,10 @@ const int kNoTab = NSNotFound;
 - (void)selectRelativeTab:(BOOL)forward {
 	// This may happen during automated testing or if a user somehow buffers
 	// many key accelerators.
-	if ([contentsData_ count] == 0)
+	if ([self count] == 0)
 		return;
 	
-	int index = activeIndex_;
+	int index = [self activeIndex];
 	int delta = forward ? 1 : -1;
 	index = (index + [self count] + delta) % [self count];
 	
@@ -800,44 +1974,747 @@ const int kNoTab = NSNotFound;
 - (void)moveTabContentsAtImpl:(int)index
 				   toPosition:(int)toPosition
 			  selectAfterMove:(BOOL)selectAfterMove {
-	TabContentsData* movedData = [contentsData_ objectAtIndex:index];
-	[contentsData_ removeObjectAtIndex:index];
-	[contentsData_ insertObject:movedData atIndex:toPosition];
-	
-	// if !selectAfterMove, keep the same tab active as was active before.
-	if (selectAfterMove || index == activeIndex_) {
-		activeIndex_ = toPosition;
-	} else if (index < activeIndex_ && toPosition >= activeIndex_) {
-		activeIndex_--;
-	} else if (index > activeIndex_ && toPosition <= activeIndex_) {
-		activeIndex_++;
-	}
-	
-    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-                              movedData->contents, CTTabNewContentsUserInfoKey,
-                              [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-                              [NSNumber numberWithInt:toPosition], CTTabToIndexUserInfoKey,
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabMovedNotification 
-														object:self 
-													  userInfo:userInfo];
+	TabContentsData* movedData = [self dataAtIndex:index];
+	// A tab that is a group of its own takes the group along. Otherwise it
+	// leaves its group, and rejoins it below unless it ends up apart from it.
+	CTTabGroupData* group = nil;
+	CTTabGroupData* soleGroup = nil;
+	NSUInteger groupPosition = [self positionOfGroupContainingIndex:index];
+	if (groupPosition != NSNotFound) {
+		group = [groups_ objectAtIndex:groupPosition];
+		if (group->count == 1) {
+			soleGroup = group;
+			group = nil;
+			[groups_ removeObjectAtIndex:groupPosition];
+		} else {
+			[self removeDataFromGroup:movedData atIndex:index];
+		}
+	}
+	// if !selectAfterMove, the core keeps the same tab active as was active
+	// before, and the selection follows the tabs. The tab keeps its place
+	// among the tabs its opener opened.
+	BOOL collapsesSelection = selectAfterMove && [self selectedTabCount] > 1;
+	CTTabStripCoreMove(core_, index, toPosition, selectAfterMove);
+	if (soleGroup) {
+		NSUInteger position = [self positionOfFirstGroupStartingAtOrAfter:toPosition];
+		CTTabGroupData* surrounding =
+			position > 0 ? [groups_ objectAtIndex:position - 1] : nil;
+		if (surrounding && CTTabStripCoreIsBefore(core_, movedData->handle,
+												  surrounding->last->handle)) {
+			// Dropped into the middle of another group, which absorbs it.
+			[groupsByIdentifier_ removeObjectForKey:
+				[NSNumber numberWithInt:soleGroup->identifier]];
+			++surrounding->count;
+		} else {
+			[groups_ insertObject:soleGroup atIndex:position];
+		}
+	} else {
+		int start = group ? [self indexOfData:group->first] : 0;
+		int last = group ? [self indexOfData:group->last] : 0;
+		if (group && toPosition >= start - 1 && toPosition <= last + 1) {
+			if (toPosition < start)
+				group->first = movedData;
+			else if (toPosition > last)
+				group->last = movedData;
+			++group->count;
+		} else {
+			[self addDataToSurroundingGroup:movedData atIndex:toPosition];
+		}
+	}
+	if (updateDepth_)
+		[movedWhileUpdating_ addObject:movedData];
+	
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventMoved,
+		.contents = [self contentsOfData:movedData],
+		.index = index,
+		.toIndex = toPosition,
+	};
+	[self notifyObservers:&event];
+	if (collapsesSelection)
+		[self notifySelectionChangedInRange:NSMakeRange(0, [self count])];
 }
 
 - (CTTabContents *)replaceTabContentsAtImpl:(int)index
-							   withContents:(CTTabContents *)newContents {
+							   withContents:(CTTabContents *)newContents
+							 keepOpenedTabs:(BOOL)keepOpenedTabs {
 	assert([self containsIndex:index]);
 	CTTabContents* oldContents = [self tabContentsAtIndex:index];
-	TabContentsData* data = [contentsData_ objectAtIndex:index];
+	TabContentsData* data = [self dataAtIndex:index];
 	data->contents = newContents;
+	[contentsIndex_ removeObjectForKey:oldContents];
+	[contentsIndex_ setObject:data forKey:newContents];
+	// The slot keeps its own opener, but tabs opened by |oldContents| lose
+	// theirs now that it left the strip.
+	if (!keepOpenedTabs) {
+		for (TabContentsData* child in [self dataOpenedByData:data]) {
+			CTTabStripCoreSetOpener(core_, child->handle, CTNoTabHandle);
+			[self openerOfDataDidChange:child];
+		}
+	}
+	if (updateDepth_)
+		[changedWhileUpdating_ addObject:data];
 	
-    NSDictionary* userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
-                              oldContents, CTTabContentsUserInfoKey,
-                              newContents, CTTabNewContentsUserInfoKey,
-                              [NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
-                              nil];
-    [[NSNotificationCenter defaultCenter] postNotificationName:CTTabReplacedNotification 
-														object:self 
-													  userInfo:userInfo];
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventReplaced,
+		.contents = newContents,
+		.oldContents = oldContents,
+		.index = index,
+	};
+	[self notifyObservers:&event];
 	return oldContents;
 }
+
+- (CTTabContents *)loadPlaceholderAtIndex:(int)index {
+	CTTabContents* placeholder = [self tabContentsAtIndex:index];
+	if (!placeholder.isPlaceholder)
+		return placeholder;
+	CTTabContents* contents = [delegate_ tabContentsForPlaceholder:placeholder];
+	if (!contents || contents == placeholder)
+		return placeholder;
+	[self swapTabContentsAtIndex:index withContents:contents];
+	return contents;
+}
+
+- (void)discardTabContentsAtIndex:(int)index
+				  withPlaceholder:(CTTabContents *)placeholder {
+	assert([self containsIndex:index]);
+	assert(index != [self activeIndex]);
+	assert(placeholder.isPlaceholder);
+	[self swapTabContentsAtIndex:index withContents:placeholder];
+}
+
+- (void)swapTabContentsAtIndex:(int)index
+				  withContents:(CTTabContents *)newContents {
+	CTTabContents* oldContents = [self tabContentsAtIndex:index];
+	TabContentsData* data = [self dataAtIndex:index];
+	[self replaceTabContentsAtImpl:index
+					  withContents:newContents
+					keepOpenedTabs:YES];
+	// The core still has the tab as the opener of the tabs it opened, and
+	// setting |parentOpener| to the new contents leaves them there.
+	for (TabContentsData *child in [self dataOpenedByData:data]) {
+		if (child->contents.parentOpener == oldContents)
+			child->contents.parentOpener = newContents;
+	}
+}
+
+- (int)indexOfData:(TabContentsData *)data {
+	return CTTabStripCoreIndexOfTab(core_, data->handle);
+}
+
+- (TabContentsData *)dataAtIndex:(int)index {
+	return [dataByHandle_ objectAtIndex:CTTabStripCoreTabAtIndex(core_, index)];
+}
+
+- (NSArray *)dataInRange:(NSRange)range {
+	NSMutableArray *data = [NSMutableArray arrayWithCapacity:range.length];
+	for (NSUInteger i = range.location; i < NSMaxRange(range); ++i)
+		[data addObject:[self dataAtIndex:(int)i]];
+	return data;
+}
+
+- (TabContentsData *)dataOfContents:(CTTabContents *)contents {
+	return contents ? [contentsIndex_ objectForKey:contents] : nil;
+}
+
+- (NSArray *)dataOpenedByData:(TabContentsData *)data {
+	int count = CTTabStripCoreOpenedTabCount(core_, data->handle);
+	NSMutableArray *opened = [NSMutableArray arrayWithCapacity:count];
+	for (int i = 0; i < count; ++i) {
+		CTTabHandle tab = CTTabStripCoreOpenedTab(core_, data->handle, i);
+		[opened addObject:[dataByHandle_ objectAtIndex:tab]];
+	}
+	return opened;
+}
+
+- (CTTabContents *)contentsOfData:(TabContentsData *)data {
+	if (data->contents)
+		return data->contents;
+	CTTabContents* contents =
+		[delegate_ tabContentsForDeferredTabWithKey:data->deferredKey];
+	assert(contents);
+	// Set before the model knows |contents|, so it doesn't refile the tab.
+	CTTabHandle opener = CTTabStripCoreOpenerOfTab(core_, data->handle);
+	if (opener) {
+		TabContentsData* openerData = [dataByHandle_ objectAtIndex:opener];
+		if (openerData->contents)
+			contents.parentOpener = openerData->contents;
+	}
+	data->contents = contents;
+	[contentsIndex_ setObject:data forKey:contents];
+	// The core already has the tab as the opener of the tabs it opened, so
+	// setting their |parentOpener| leaves them where they are.
+	for (TabContentsData *child in [self dataOpenedByData:data])
+		child->contents.parentOpener = contents;
+	return contents;
+}
+
+- (NSUInteger)positionOfFirstGroupStartingAtOrAfter:(int)index {
+	NSUInteger high = [groups_ count];
+	if (!high || index <= 0)
+		return 0;
+	if (index >= (int)[self count])
+		return high;
+	CTTabHandle tab = CTTabStripCoreTabAtIndex(core_, index);
+	NSUInteger low = 0;
+	while (low < high) {
+		NSUInteger middle = low + (high - low) / 2;
+		CTTabGroupData *group = [groups_ objectAtIndex:middle];
+		if (CTTabStripCoreIsBefore(core_, group->first->handle, tab))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+- (NSUInteger)positionOfGroupContainingIndex:(int)index {
+	if (![groups_ count])
+		return NSNotFound;
+	NSUInteger position = [self positionOfFirstGroupStartingAtOrAfter:index + 1];
+	if (position == 0)
+		return NSNotFound;
+	CTTabGroupData *group = [groups_ objectAtIndex:position - 1];
+	CTTabHandle tab = CTTabStripCoreTabAtIndex(core_, index);
+	if (CTTabStripCoreIsBefore(core_, group->last->handle, tab))
+		return NSNotFound;
+	return position - 1;
+}
+
+- (CTTabGroupData *)removeDataFromGroup:(TabContentsData *)data
+								atIndex:(int)index {
+	NSUInteger position = [self positionOfGroupContainingIndex:index];
+	if (position == NSNotFound)
+		return nil;
+	CTTabGroupData *group = [groups_ objectAtIndex:position];
+	if (--group->count == 0) {
+		[groupsByIdentifier_ removeObjectForKey:
+			[NSNumber numberWithInt:group->identifier]];
+		[groups_ removeObjectAtIndex:position];
+	} else if (group->first == data) {
+		group->first = [self dataAtIndex:index + 1];
+	} else if (group->last == data) {
+		group->last = [self dataAtIndex:index - 1];
+	}
+	return group;
+}
+
+- (void)addDataToSurroundingGroup:(TabContentsData *)data
+						  atIndex:(int)index {
+	if (![groups_ count])
+		return;
+	// No group can start at |index|, since |data| is there and not in one.
+	NSUInteger position = [self positionOfFirstGroupStartingAtOrAfter:index];
+	if (position == 0)
+		return;
+	// With |data| in the middle of it, it goes in the group.
+	CTTabGroupData *group = [groups_ objectAtIndex:position - 1];
+	if (CTTabStripCoreIsBefore(core_, data->handle, group->last->handle))
+		++group->count;
+}
+
+- (void)notifyGroupChanged:(CTTabGroupData *)group {
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventGroupChanged,
+		.group = group->identifier,
+		.range = NSMakeRange([self indexOfData:group->first], group->count),
+	};
+	[self notifyObservers:&event];
+}
+
+- (void)commitUpdates {
+	// Tabs that left the strip no longer have a handle in the core.
+	NSMutableIndexSet *removed = [NSMutableIndexSet indexSet];
+	NSUInteger i = 0;
+	for (TabContentsData *data in dataBeforeUpdates_) {
+		if (data->handle == CTNoTabHandle)
+			[removed addIndex:i];
+		++i;
+	}
+	NSMutableIndexSet *inserted = [NSMutableIndexSet indexSet];
+	for (TabContentsData *data in insertedWhileUpdating_) {
+		if (data->handle != CTNoTabHandle)
+			[inserted addIndex:[self indexOfData:data]];
+	}
+	NSMutableIndexSet *moved = [NSMutableIndexSet indexSet];
+	for (TabContentsData *data in movedWhileUpdating_) {
+		if (data->handle == CTNoTabHandle)
+			continue;
+		int index = [self indexOfData:data];
+		if (![inserted containsIndex:index])
+			[moved addIndex:index];
+	}
+	NSMutableIndexSet *changed = [NSMutableIndexSet indexSet];
+	for (TabContentsData *data in changedWhileUpdating_) {
+		if (data->handle != CTNoTabHandle)
+			[changed addIndex:[self indexOfData:data]];
+	}
+	
+	CTTabContents *oldContents = activeContentsBeforeUpdates_;
+	CTTabContents *newContents = [self activeTabContents];
+	if (newContents && newContents != oldContents)
+		newContents = [self loadPlaceholderAtIndex:[self activeIndex]];
+	BOOL gesture = selectionByUserGesture_;
+	BOOL selectionChanged = selectionChangedWhileUpdating_;
+	dataBeforeUpdates_ = nil;
+	activeContentsBeforeUpdates_ = nil;
+	insertedWhileUpdating_ = nil;
+	movedWhileUpdating_ = nil;
+	changedWhileUpdating_ = nil;
+	
+	// Deliver the held back notifications, now that |updateDepth_| is zero.
+	for (NSUInteger index = [changed firstIndex]; index != NSNotFound;
+		 index = [changed indexGreaterThanIndex:index]) {
+		[self updateTabContentsStateAtIndex:index changeType:CTTabChangeTypeAll];
+	}
+	BOOL activeTabChanged = newContents && newContents != oldContents;
+	if (activeTabChanged) {
+		// |changeSelectedContentsFrom:| would bail out since |activeIndex| is
+		// already up to date, so dispatch directly.
+		CTTabStripModelEvent event = {
+			.type = CTTabStripModelEventSelected,
+			.contents = newContents,
+			.oldContents = oldContents,
+			.index = [self activeIndex],
+			.flag = gesture,
+		};
+		[self notifyObservers:&event];
+	}
+	if (selectionChanged && [self count])
+		[self notifySelectionChangedInRange:NSMakeRange(0, [self count])];
+	
+	CTTabStripChangeSet *changes =
+		[[CTTabStripChangeSet alloc] initWithRemovedIndices:removed
+											insertedIndices:inserted
+											   movedIndices:moved
+											 changedIndices:changed
+												activeIndex:[self activeIndex]
+										   activeTabChanged:activeTabChanged];
+	CTTabStripModelEvent event = {
+		.type = CTTabStripModelEventDidCommitUpdates,
+		.changes = changes,
+	};
+	[self notifyObservers:&event];
+}
+
+- (void)notifyObservers:(const CTTabStripModelEvent *)event {
+	[self recordChangeForEvent:event];
+	if (snapshotBuilder_)
+		[self updateSnapshotBuilderForEvent:event];
+	
+	SEL selector = @selector(tabStripModel:didReceiveEvent:);
+	// Observers added while dispatching don't see the current event.
+	int count = observerCount_;
+	++dispatchDepth_;
+	for (int i = 0; i < count; ++i) {
+		// Re-read the entry each time; the array may be reallocated by an
+		// observer registering another observer.
+		CTTabStripModelObserverEntry entry = observers_[i];
+		if (entry.observer)
+			entry.imp(entry.observer, selector, self, event);
+	}
+	if (--dispatchDepth_ == 0 && observersNeedCompaction_) {
+		int live = 0;
+		for (int i = 0; i < observerCount_; ++i) {
+			if (observers_[i].observer)
+				observers_[live++] = observers_[i];
+		}
+		observerCount_ = live;
+		observersNeedCompaction_ = NO;
+	}
+	
+	if (postsNotifications_)
+		[self postNotificationForEvent:event];
+}
+
+#pragma mark -
+#pragma mark Snapshots
+
+- (CTTabStripSnapshot *)snapshot {
+	if (!snapshotBuilder_) {
+		snapshotBuilder_ = [[CTTabStripSnapshotBuilder alloc] init];
+		tabsWithStaleSnapshots_ = [[NSMutableSet alloc] init];
+		int count = [self count];
+		for (int i = 0; i < count; ++i)
+			[snapshotBuilder_ insertTab:[self snapshotOfTabAtIndex:i] atIndex:i];
+	} else if ([tabsWithStaleSnapshots_ count]) {
+		for (TabContentsData *data in tabsWithStaleSnapshots_) {
+			// Skip tabs that left the strip since.
+			if (data->handle == CTNoTabHandle)
+				continue;
+			int index = [self indexOfData:data];
+			[snapshotBuilder_ replaceTabAtIndex:index
+										withTab:[self snapshotOfTabAtIndex:index]];
+		}
+		[tabsWithStaleSnapshots_ removeAllObjects];
+	}
+	return [snapshotBuilder_ snapshotWithActiveIndex:[self activeIndex]
+										  generation:generation_];
+}
+
+- (CTTabSnapshot *)snapshotOfTabAtIndex:(int)index {
+	TabContentsData *data = [self dataAtIndex:index];
+	CTTabHandle opener = CTTabStripCoreOpenerOfTab(core_, data->handle);
+	TabContentsData *openerData =
+		opener ? [dataByHandle_ objectAtIndex:opener] : nil;
+	CTTabSnapshotFlags flags = 0;
+	if (CTTabStripCoreIsPinned(core_, index))
+		flags |= CTTabSnapshotPinned;
+	if (CTTabStripCoreIsBlocked(core_, index))
+		flags |= CTTabSnapshotBlocked;
+	if (CTTabStripCoreIsApp(core_, index))
+		flags |= CTTabSnapshotApp;
+	if ([self isMiniTabAtIndex:index])
+		flags |= CTTabSnapshotMini;
+	// A deferred tab gets a placeholder too when its contents are created.
+	if (!data->contents || data->contents.isPlaceholder)
+		flags |= CTTabSnapshotPlaceholder;
+	return [[CTTabSnapshot alloc] initWithIdentifier:data->identifier
+									openerIdentifier:openerData ? openerData->identifier : 0
+											   title:[self titleOfTabAtIndex:index]
+											   flags:flags];
+}
+
+- (void)updateSnapshotBuilderForEvent:(const CTTabStripModelEvent *)event {
+	switch (event->type) {
+		case CTTabStripModelEventInserted:
+			[snapshotBuilder_ insertTab:[self snapshotOfTabAtIndex:event->index]
+								atIndex:event->index];
+			break;
+		case CTTabStripModelEventDetached:
+			[snapshotBuilder_ removeTabsInRange:NSMakeRange(event->index, 1)];
+			break;
+		case CTTabStripModelEventDetachedRange:
+			[snapshotBuilder_ removeTabsInRange:event->range];
+			break;
+		case CTTabStripModelEventMoved:
+			[snapshotBuilder_ moveTabAtIndex:event->index toIndex:event->toIndex];
+			break;
+		case CTTabStripModelEventReordered:
+			[snapshotBuilder_ reorderTabsWithPermutation:event->permutation];
+			break;
+		case CTTabStripModelEventChanged:
+		case CTTabStripModelEventReplaced:
+		case CTTabStripModelEventPinnedStateChanged:
+		case CTTabStripModelEventBlockedStateChanged:
+		case CTTabStripModelEventMiniStateChanged:
+			[snapshotBuilder_ replaceTabAtIndex:event->index
+										withTab:[self snapshotOfTabAtIndex:event->index]];
+			break;
+		default:
+			break;
+	}
+}
+
+- (void)openerOfDataDidChange:(TabContentsData *)data {
+	if (snapshotBuilder_)
+		[tabsWithStaleSnapshots_ addObject:data];
+}
+
+#pragma mark -
+#pragma mark Change log
+
+- (void)recordChangeForEvent:(const CTTabStripModelEvent *)event {
+	switch (event->type) {
+		case CTTabStripModelEventInserted:
+		case CTTabStripModelEventDetached:
+			++generation_;
+			[self logChangeFromIndex:event->index
+							 toIndex:event->index
+				 shiftsFollowingTabs:YES
+						  attributes:CTTabStripAttributeStructure];
+			break;
+		case CTTabStripModelEventDetachedRange:
+			++generation_;
+			[self logChangeFromIndex:event->range.location
+							 toIndex:NSMaxRange(event->range) - 1
+				 shiftsFollowingTabs:YES
+						  attributes:CTTabStripAttributeStructure];
+			break;
+		case CTTabStripModelEventMoved:
+			++generation_;
+			[self logChangeFromIndex:MIN(event->index, event->toIndex)
+							 toIndex:MAX(event->index, event->toIndex)
+				 shiftsFollowingTabs:NO
+						  attributes:CTTabStripAttributeStructure];
+			break;
+		case CTTabStripModelEventReordered: {
+			// Only the span between the first and last tab that moved.
+			int count = [self count];
+			int first = 0;
+			int last = count - 1;
+			while (first < count && event->permutation[first] == first)
+				++first;
+			while (last > first && event->permutation[last] == last)
+				--last;
+			++generation_;
+			if (first < count) {
+				[self logChangeFromIndex:first
+								 toIndex:last
+					 shiftsFollowingTabs:NO
+							  attributes:CTTabStripAttributeStructure];
+			}
+			break;
+		}
+		case CTTabStripModelEventSelected: {
+			++generation_;
+			[self logChangeFromIndex:event->index
+							 toIndex:event->index
+				 shiftsFollowingTabs:NO
+						  attributes:CTTabStripAttributeSelection];
+			int oldIndex = event->oldContents ?
+				[self indexOfTabContents:event->oldContents] : kNoTab;
+			if (oldIndex != kNoTab) {
+				[self logChangeFromIndex:oldIndex
+								 toIndex:oldIndex
+					 shiftsFollowingTabs:NO
+						  attributes:CTTabStripAttributeSelection];
+			}
+			break;
+		}
+		case CTTabStripModelEventSelectionChanged:
+			++generation_;
+			[self logChangeFromIndex:event->range.location
+							 toIndex:NSMaxRange(event->range) - 1
+				 shiftsFollowingTabs:NO
+						  attributes:CTTabStripAttributeSelection];
+			break;
+		case CTTabStripModelEventChanged:
+		case CTTabStripModelEventReplaced:
+		case CTTabStripModelEventPinnedStateChanged:
+		case CTTabStripModelEventBlockedStateChanged:
+		case CTTabStripModelEventMiniStateChanged: {
+			CTTabStripAttributes attributes = CTTabStripAttributeContents;
+			if (event->type == CTTabStripModelEventPinnedStateChanged)
+				attributes = CTTabStripAttributePinned;
+			else if (event->type == CTTabStripModelEventBlockedStateChanged)
+				attributes = CTTabStripAttributeBlocked;
+			else if (event->type == CTTabStripModelEventMiniStateChanged)
+				attributes = CTTabStripAttributeMini;
+			++generation_;
+			[self logChangeFromIndex:event->index
+							 toIndex:event->index
+				 shiftsFollowingTabs:NO
+						  attributes:attributes];
+			break;
+		}
+		case CTTabStripModelEventGroupChanged:
+			++generation_;
+			[self logChangeFromIndex:event->range.location
+							 toIndex:NSMaxRange(event->range) - 1
+				 shiftsFollowingTabs:NO
+						  attributes:CTTabStripAttributeGroup];
+			break;
+		default:
+			// Closing, Empty, DidCommitUpdates and Deleted don't change the
+			// model themselves.
+			break;
+	}
+}
+
+- (void)logChangeFromIndex:(int)index
+				   toIndex:(int)lastIndex
+		shiftsFollowingTabs:(BOOL)shiftsFollowingTabs
+				attributes:(CTTabStripAttributes)attributes {
+	if (changeLogCount_ == kChangeLogCapacity) {
+		// Drop the oldest record. Changes are no longer known since any
+		// generation before it.
+		firstLoggedGeneration_ = changeLog_[changeLogStart_].generation;
+		changeLogStart_ = (changeLogStart_ + 1) % kChangeLogCapacity;
+		--changeLogCount_;
+	}
+	CTTabStripChangeRecord *record =
+		&changeLog_[(changeLogStart_ + changeLogCount_) % kChangeLogCapacity];
+	record->generation = generation_;
+	record->index = index;
+	record->lastIndex = lastIndex;
+	record->shiftsFollowingTabs = shiftsFollowingTabs;
+	record->attributes = attributes;
+	++changeLogCount_;
+}
+
+- (NSIndexSet *)changedIndicesSinceGeneration:(NSUInteger)generation
+								   attributes:(CTTabStripAttributes *)attributes {
+	if (generation < firstLoggedGeneration_)
+		return nil;
+	
+	// A record only shifts the tabs at or after its own span, so the tabs
+	// before the earliest such span never moved, and the indices the other
+	// records touched are still where those tabs are now.
+	int count = [self count];
+	int shiftedFrom = count;
+	NSMutableIndexSet *indices = [NSMutableIndexSet indexSet];
+	CTTabStripAttributes changed = 0;
+	for (int i = 0; i < changeLogCount_; ++i) {
+		const CTTabStripChangeRecord *record =
+			&changeLog_[(changeLogStart_ + i) % kChangeLogCapacity];
+		if (record->generation <= generation)
+			continue;
+		changed |= record->attributes;
+		if (record->shiftsFollowingTabs)
+			shiftedFrom = MIN(shiftedFrom, record->index);
+		else if (record->index < shiftedFrom)
+			[indices addIndexesInRange:NSMakeRange(record->index,
+				record->lastIndex - record->index + 1)];
+	}
+	if (shiftedFrom < count)
+		[indices addIndexesInRange:NSMakeRange(shiftedFrom, count - shiftedFrom)];
+	[indices removeIndexesInRange:NSMakeRange(count, NSNotFound - count)];
+	if (attributes)
+		*attributes = changed;
+	return indices;
+}
+
+- (void)postNotificationForEvent:(const CTTabStripModelEvent *)event {
+	NSString *name = nil;
+	NSDictionary *userInfo = nil;
+	NSNumber *index = [NSNumber numberWithInt:event->index];
+	// Legacy observers expect the contents of deferred tabs too.
+	CTTabContents *contents = event->contents;
+	if (!contents && (event->type == CTTabStripModelEventInserted ||
+					  event->type == CTTabStripModelEventBlockedStateChanged)) {
+		contents = [self tabContentsAtIndex:event->index];
+	}
+	// A deferred tab that closes never gets any.
+	if (!contents && event->type == CTTabStripModelEventClosing)
+		contents = (id)[NSNull null];
+	switch (event->type) {
+		case CTTabStripModelEventInserted:
+			name = CTTabInsertedNotification;
+			userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+						contents, CTTabContentsUserInfoKey,
+						index, CTTabIndexUserInfoKey,
+						[NSNumber numberWithBool:event->flag], CTTabForegroundUserInfoKey,
+						nil];
+			break;
+		case CTTabStripModelEventClosing:
+		case CTTabStripModelEventDetached:
+		case CTTabStripModelEventMiniStateChanged:
+			name = event->type == CTTabStripModelEventClosing ? CTTabClosingNotification :
+				   event->type == CTTabStripModelEventDetached ? CTTabDetachedNotification :
+				   CTTabMiniStateChangedNotification;
+			userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+						contents, CTTabContentsUserInfoKey,
+						index, CTTabIndexUserInfoKey,
+						nil];
+			break;
+		case CTTabStripModelEventSelected:
+			name = CTTabSelectedNotification;
+			// |oldContents| may be nil, so it goes last.
+			userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+						contents, CTTabNewContentsUserInfoKey,
+						index, CTTabIndexUserInfoKey,
+						[NSNumber numberWithBool:event->flag], CTTabUserGestureUserInfoKey,
+						event->oldContents, CTTabContentsUserInfoKey,
+						nil];
+			break;
+		case CTTabStripModelEventSelectionChanged:
+			name = CTTabSelectionChangedNotification;
+			userInfo = [NSDictionary dictionaryWithObject:index
+												   forKey:CTTabIndexUserInfoKey];
+			break;
+		case CTTabStripModelEventMoved:
+			name = CTTabMovedNotification;
+			userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+						contents, CTTabNewContentsUserInfoKey,
+						index, CTTabIndexUserInfoKey,
+						[NSNumber numberWithInt:event->toIndex], CTTabToIndexUserInfoKey,
+						nil];
+			break;
+		case CTTabStripModelEventReordered: {
+			// Replay the reorder as single moves, placing the tab that belongs
+			// at each slot in turn, with indices that are valid as each move
+			// arrives. Before slot |i| is filled, the tabs not placed yet fill
+			// the slots from |i| on in their original order, so the tab that
+			// was at |from| is at |i| plus the number of unplaced tabs that were
+			// before it. |placed| counts the placed tabs by original index as a
+			// Fenwick tree, so the whole replay is one O(n log n) pass.
+			int count = [self count];
+			int *placed = calloc(count + 1, sizeof(int));
+			for (int i = 0; i < count; ++i) {
+				int from = event->permutation[i];
+				int placedBefore = 0;
+				for (int j = from; j > 0; j -= j & -j)
+					placedBefore += placed[j];
+				for (int j = from + 1; j <= count; j += j & -j)
+					++placed[j];
+				int index = i + from - placedBefore;
+				if (index == i)
+					continue;
+				TabContentsData *data = [self dataAtIndex:i];
+				userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+							data->contents ? data->contents : (id)[NSNull null],
+							CTTabNewContentsUserInfoKey,
+							[NSNumber numberWithInt:index], CTTabIndexUserInfoKey,
+							[NSNumber numberWithInt:i], CTTabToIndexUserInfoKey,
+							nil];
+				[[NSNotificationCenter defaultCenter] postNotificationName:CTTabMovedNotification
+																	object:self
+																  userInfo:userInfo];
+			}
+			free(placed);
+			return;
+		}
+		case CTTabStripModelEventChanged:
+			name = CTTabChangedNotification;
+			userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+						contents, CTTabContentsUserInfoKey,
+						index, CTTabIndexUserInfoKey,
+						[NSNumber numberWithInt:event->changeType], CTTabOptionsUserInfoKey,
+						nil];
+			break;
+		case CTTabStripModelEventReplaced:
+			name = CTTabReplacedNotification;
+			userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+						event->oldContents, CTTabContentsUserInfoKey,
+						contents, CTTabNewContentsUserInfoKey,
+						index, CTTabIndexUserInfoKey,
+						nil];
+			break;
+		case CTTabStripModelEventPinnedStateChanged:
+		case CTTabStripModelEventBlockedStateChanged:
+			name = event->type == CTTabStripModelEventPinnedStateChanged ?
+				CTTabPinnedStateChangedNotification :
+				CTTabBlockedStateChangedNotification;
+			userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+						contents, CTTabContentsUserInfoKey,
+						index, CTTabIndexUserInfoKey,
+						[NSNumber numberWithInt:event->flag], CTTabOptionsUserInfoKey,
+						nil];
+			break;
+		case CTTabStripModelEventDetachedRange:
+			// Legacy observers expect one notification per tab, with indices
+			// that are valid as each one arrives.
+			for (NSUInteger i = event->range.length; i-- > 0;) {
+				userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+							[event->rangeContents objectAtIndex:i], CTTabContentsUserInfoKey,
+							[NSNumber numberWithInt:(int)(event->range.location + i)], CTTabIndexUserInfoKey,
+							nil];
+				[[NSNotificationCenter defaultCenter] postNotificationName:CTTabDetachedNotification
+																	object:self
+																  userInfo:userInfo];
+			}
+			return;
+		case CTTabStripModelEventEmpty:
+			name = CTTabStripEmptyNotification;
+			break;
+		case CTTabStripModelEventGroupChanged:
+			name = CTTabGroupChangedNotification;
+			userInfo = [NSDictionary dictionaryWithObject:[NSNumber numberWithInt:event->group]
+												   forKey:CTTabGroupUserInfoKey];
+			break;
+		case CTTabStripModelEventDidCommitUpdates:
+			name = CTTabStripModelDidCommitUpdatesNotification;
+			userInfo = [NSDictionary dictionaryWithObject:event->changes
+												   forKey:CTTabChangeSetUserInfoKey];
+			break;
+		case CTTabStripModelEventDeleted:
+			name = CTTabStripModelDeletedNotification;
+			break;
+	}
+	[[NSNotificationCenter defaultCenter] postNotificationName:name
+														object:self
+													  userInfo:userInfo];
+}
 @end
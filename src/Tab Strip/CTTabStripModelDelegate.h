@@ -18,6 +18,21 @@
 -(CTTabContents*)addBlankTabInForeground:(BOOL)foreground;
 -(CTTabContents*)addBlankTabAtIndex:(int)index inForeground:(BOOL)foreground;
 
+// Returns the real contents for |placeholder| (see
+// |-[CTTabContents initPlaceholderWithTitle:icon:]|), which is about to become
+// the active tab for the first time. Returning nil keeps the placeholder.
+-(CTTabContents*)tabContentsForPlaceholder:(CTTabContents*)placeholder;
+
+// Returns the contents of the deferred tab inserted with |key| (see
+// |-[CTTabStripModel insertDeferredTabWithKey:isApp:atIndex:withAddTypes:]|),
+// which the model needs for the first time. Usually a placeholder. Must not
+// return nil.
+-(CTTabContents*)tabContentsForDeferredTabWithKey:(NSUInteger)key;
+
+// Returns the title of the deferred tab inserted with |key|, without creating
+// its contents.
+-(NSString*)titleOfDeferredTabWithKey:(NSUInteger)key;
+
 // Asks for a new TabStripModel to be created and the given tab contents to
 // be added to it. Its size and position are reflected in |window_bounds|.
 // If |dock_info|'s type is other than NONE, the newly created window should
@@ -26,6 +41,12 @@
 // show the window, it's up to the caller to do so.
 -(CTBrowser*)createNewStripWithContents:(CTTabContents*)contents;
 
+// Creates a new CTBrowser and window with |contents| as its tabs, in order,
+// pins the ones at |pinnedIndices| and shows the window. Used to move several
+// tabs to a new window at once. Returns the new CTBrowser.
+-(CTBrowser*)createNewStripWithTabContents:(NSArray*)contents
+                             pinnedIndices:(NSIndexSet*)pinnedIndices;
+
 // Creates a new CTBrowser object and window containing the specified
 // |contents|, and continues a drag operation that began within the source
 // window's tab strip. |window_bounds| are the bounds of the source window in
@@ -51,6 +72,10 @@
 // CTTabContents.
 -(void)createHistoricalTab:(CTTabContents*)contents;
 
+// Same as |createHistoricalTab:| for the deferred tab at |index|, which is
+// closed without ever getting contents.
+-(void)createHistoricalTabForDeferredTabAtIndex:(int)index;
+
 // Runs any unload listeners associated with the specified CTTabContents before
 // it is closed. If there are unload listeners that need to be run, this
 // function returns true and the TabStripModel will wait before closing the
@@ -61,7 +86,8 @@
 // Returns true if a tab can be restored.
 -(BOOL)canRestoreTab;
 
-// Restores the last closed tab if CanRestoreTab would return true.
+// Restores the last closed tab if CanRestoreTab would return true. The tab
+// may only be inserted after this returns.
 -(void)restoreTab;
 
 // Returns whether some contents can be closed.
@@ -11,18 +11,27 @@
 #import "CTTabStripModel.h"
 
 @class CTTabContents;
+struct CTTabStripCore;
 ///////////////////////////////////////////////////////////////////////////////
 // CTTabStripModelOrderController
 //
 //  An object that allows different types of ordering and reselection to be
 //  heuristics plugged into a TabStripModel.
 //
-@interface CTTabStripModelOrderController : NSObject
+//  The rules themselves live in the model's CTTabStripCore; this wraps them
+//  and observes the model to keep the core's most-recently-activated history
+//  of its tabs, which is where selection goes first when the active tab
+//  closes.
+//
+@interface CTTabStripModelOrderController : NSObject<CTTabStripModelObserver>
 
 // The insertion policy. Default is INSERT_AFTER.
 @property (readwrite, assign) InsertionPolicy insertionPolicy;
 
-- (id)initWithTabStripModel:(CTTabStripModel *)tabStripModel;
+// |core| is the one |tabStripModel| keeps in step with its tabs, and must
+// outlive the order controller's use of it.
+- (id)initWithTabStripModel:(CTTabStripModel *)tabStripModel
+					   core:(struct CTTabStripCore *)core;
 
 // Determine where to place a newly opened tab by using the supplied
 // transition and foreground flag to figure out how it was opened.
@@ -33,7 +42,18 @@
 // Returns the index to append tabs at.
 - (int)determineInsertionIndexForAppending;
 
-// Determine where to shift selection after a tab is closed.
+// Determine where to shift selection after a tab is closed. This is the
+// most recently active other tab if there is one, otherwise a tab related to
+// the closed one by opener, otherwise its neighbour.
 - (int)determineNewSelectedIndexAfterClose:(int)removedIndex;
 
+// Determine where to shift selection when the active tab is closed together
+// with the rest of |closingIndices|. Returns the index, before any of them
+// are removed, of a tab that stays open, or kNoTab if they all close.
+- (int)determineNewSelectedIndexAfterClosingIndices:(NSIndexSet *)closingIndices;
+
+// Returns the index of the tab that was active before the active one, or
+// kNoTab if no other tab has been active.
+- (int)indexOfPreviouslyActiveTab;
+
 @end
@@ -0,0 +1,86 @@
+//
+//  CTTabStripSnapshot.h
+//  chromium-tabs
+//
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+//
+
+#import <Foundation/Foundation.h>
+
+// The per-tab state a CTTabSnapshot records.
+enum {
+	CTTabSnapshotPinned      = 1 << 0,
+	CTTabSnapshotBlocked     = 1 << 1,
+	CTTabSnapshotApp         = 1 << 2,
+	CTTabSnapshotMini        = 1 << 3,
+	CTTabSnapshotPlaceholder = 1 << 4,
+};
+typedef NSUInteger CTTabSnapshotFlags;
+
+// What a CTTabStripSnapshot knows about one tab. Immutable.
+@interface CTTabSnapshot : NSObject
+
+- (id)initWithIdentifier:(uint64_t)identifier
+		openerIdentifier:(uint64_t)openerIdentifier
+				   title:(NSString *)title
+				   flags:(CTTabSnapshotFlags)flags;
+
+// Identifies the tab for as long as it is in its tab strip, across
+// snapshots, even if its contents are replaced. Never 0.
+@property (readonly, nonatomic) uint64_t identifier;
+// The |identifier| of the tab that opened this one, or 0.
+@property (readonly, nonatomic) uint64_t openerIdentifier;
+// The title as of the tab's last Changed event.
+@property (readonly, nonatomic) NSString *title;
+@property (readonly, nonatomic) CTTabSnapshotFlags flags;
+
+@end
+
+// An immutable copy of the tabs of a CTTabStripModel, which can be read from
+// any thread without locking. See |-[CTTabStripModel snapshot]|.
+//
+// Snapshots share structure with the model and with each other: the tabs
+// are kept in a sequence of small blocks, and a block is only copied when
+// the model changes a tab in it after a snapshot has seen it. Taking a
+// snapshot copies nothing.
+@interface CTTabStripSnapshot : NSObject
+
+@property (readonly, nonatomic) int count;
+// The active index, or kNoTab.
+@property (readonly, nonatomic) int activeIndex;
+// The model's |generation| when the snapshot was taken.
+@property (readonly, nonatomic) NSUInteger generation;
+
+// O(log(count)).
+- (CTTabSnapshot *)tabAtIndex:(int)index;
+
+// Calls |block| with every tab in order until it sets |stop|. O(count).
+- (void)enumerateTabsUsingBlock:(void (^)(CTTabSnapshot *tab, int index,
+										  BOOL *stop))block;
+
+@end
+
+// Keeps the tabs of a model in the shape CTTabStripSnapshot shares, and
+// hands out snapshots of them. Used by CTTabStripModel on the main thread;
+// every change costs O(count / 64) at worst.
+@interface CTTabStripSnapshotBuilder : NSObject
+
+@property (readonly, nonatomic) int count;
+
+- (CTTabSnapshot *)tabAtIndex:(int)index;
+- (void)insertTab:(CTTabSnapshot *)tab atIndex:(int)index;
+- (void)removeTabsInRange:(NSRange)range;
+- (void)replaceTabAtIndex:(int)index withTab:(CTTabSnapshot *)tab;
+- (void)moveTabAtIndex:(int)index toIndex:(int)toIndex;
+// Rearranges the tabs so that the one at |i| is the one that was at
+// |permutation[i]|.
+- (void)reorderTabsWithPermutation:(const int *)permutation;
+
+// Returns a snapshot of the tabs. Later changes to the builder copy what
+// they touch instead of changing the snapshot. O(1).
+- (CTTabStripSnapshot *)snapshotWithActiveIndex:(int)activeIndex
+									 generation:(NSUInteger)generation;
+
+@end
@@ -0,0 +1,327 @@
+//
+//  CTTabStripSnapshot.m
+//  chromium-tabs
+//
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+//
+
+#import "CTTabStripSnapshot.h"
+
+// Blocks are split when they grow past this many tabs, and merged with their
+// neighbour when they shrink below a quarter of it.
+static const NSUInteger kBlockCapacity = 64;
+
+// A run of adjacent tabs. A block may only be changed by the builder while
+// its |epoch| is the builder's; once a snapshot has been taken it is frozen
+// and copied before the next change.
+@interface CTTabSnapshotBlock : NSObject {
+@public
+	NSMutableArray* tabs;
+	NSUInteger epoch;
+}
+@end
+
+@implementation CTTabSnapshotBlock
+@end
+
+// The blocks in order, and for each block the index just past its last tab,
+// so that a tab is found by binary search. Frozen like the blocks.
+@interface CTTabSnapshotSpine : NSObject {
+@public
+	NSMutableArray* blocks;
+	int* ends;
+	NSUInteger capacity;
+	NSUInteger epoch;
+}
+@end
+
+@implementation CTTabSnapshotSpine
+
+- (void)dealloc {
+	free(ends);
+}
+
+@end
+
+// Returns the position in |spine| of the block that holds |index|, which must
+// be less than the number of tabs.
+static NSUInteger CTSpineBlockContainingIndex(CTTabSnapshotSpine* spine,
+											  int index) {
+	NSUInteger low = 0;
+	NSUInteger high = [spine->blocks count];
+	while (low < high) {
+		NSUInteger middle = low + (high - low) / 2;
+		if (spine->ends[middle] <= index)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+static int CTSpineBlockStart(CTTabSnapshotSpine* spine, NSUInteger block) {
+	return block ? spine->ends[block - 1] : 0;
+}
+
+@implementation CTTabSnapshot {
+	uint64_t identifier_;
+	uint64_t openerIdentifier_;
+	NSString* title_;
+	CTTabSnapshotFlags flags_;
+}
+
+@synthesize identifier = identifier_;
+@synthesize openerIdentifier = openerIdentifier_;
+@synthesize title = title_;
+@synthesize flags = flags_;
+
+- (id)initWithIdentifier:(uint64_t)identifier
+		openerIdentifier:(uint64_t)openerIdentifier
+				   title:(NSString *)title
+				   flags:(CTTabSnapshotFlags)flags {
+	if ((self = [super init])) {
+		assert(identifier);
+		identifier_ = identifier;
+		openerIdentifier_ = openerIdentifier;
+		title_ = [title copy];
+		flags_ = flags;
+	}
+	return self;
+}
+
+@end
+
+@implementation CTTabStripSnapshot {
+	CTTabSnapshotSpine* spine_;
+	int count_;
+	int activeIndex_;
+	NSUInteger generation_;
+}
+
+@synthesize count = count_;
+@synthesize activeIndex = activeIndex_;
+@synthesize generation = generation_;
+
+- (id)initWithSpine:(CTTabSnapshotSpine *)spine
+			  count:(int)count
+		activeIndex:(int)activeIndex
+		 generation:(NSUInteger)generation {
+	if ((self = [super init])) {
+		spine_ = spine;
+		count_ = count;
+		activeIndex_ = activeIndex;
+		generation_ = generation;
+	}
+	return self;
+}
+
+- (CTTabSnapshot *)tabAtIndex:(int)index {
+	assert(index >= 0 && index < count_);
+	NSUInteger block = CTSpineBlockContainingIndex(spine_, index);
+	CTTabSnapshotBlock* tabs = [spine_->blocks objectAtIndex:block];
+	return [tabs->tabs objectAtIndex:index - CTSpineBlockStart(spine_, block)];
+}
+
+- (void)enumerateTabsUsingBlock:(void (^)(CTTabSnapshot *tab, int index,
+										  BOOL *stop))block {
+	int index = 0;
+	BOOL stop = NO;
+	for (CTTabSnapshotBlock* tabs in spine_->blocks) {
+		for (CTTabSnapshot* tab in tabs->tabs) {
+			block(tab, index++, &stop);
+			if (stop)
+				return;
+		}
+	}
+}
+
+@end
+
+@interface CTTabStripSnapshotBuilder (PrivateMethods)
+// Make |spine_| and the block at |position| safe to change, copying them if
+// a snapshot has them.
+- (CTTabSnapshotSpine *)writableSpine;
+- (CTTabSnapshotBlock *)writableBlockAtPosition:(NSUInteger)position;
+// Adds |block| to |spine_|, which must be writable, at |position|.
+- (void)insertBlock:(CTTabSnapshotBlock *)block atPosition:(NSUInteger)position;
+// Recomputes |ends| of the writable |spine_| from the block at |position| on.
+- (void)updateEndsFromPosition:(NSUInteger)position;
+@end
+
+@implementation CTTabStripSnapshotBuilder {
+	CTTabSnapshotSpine* spine_;
+	int count_;
+	// Goes up with every snapshot, freezing everything made before.
+	NSUInteger epoch_;
+}
+
+@synthesize count = count_;
+
+- (id)init {
+	if ((self = [super init])) {
+		spine_ = [[CTTabSnapshotSpine alloc] init];
+		spine_->blocks = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (CTTabSnapshot *)tabAtIndex:(int)index {
+	assert(index >= 0 && index < count_);
+	NSUInteger position = CTSpineBlockContainingIndex(spine_, index);
+	CTTabSnapshotBlock* block = [spine_->blocks objectAtIndex:position];
+	return [block->tabs objectAtIndex:index - CTSpineBlockStart(spine_, position)];
+}
+
+- (void)insertTab:(CTTabSnapshot *)tab atIndex:(int)index {
+	assert(index >= 0 && index <= count_);
+	CTTabSnapshotSpine* spine = [self writableSpine];
+	NSUInteger blockCount = [spine->blocks count];
+	if (!blockCount) {
+		CTTabSnapshotBlock* block = [[CTTabSnapshotBlock alloc] init];
+		block->tabs = [[NSMutableArray alloc] initWithCapacity:kBlockCapacity];
+		block->epoch = epoch_;
+		[self insertBlock:block atPosition:0];
+		blockCount = 1;
+	}
+	// Appending goes into the last block.
+	NSUInteger position = index == count_ ?
+		blockCount - 1 : CTSpineBlockContainingIndex(spine, index);
+	CTTabSnapshotBlock* block = [self writableBlockAtPosition:position];
+	[block->tabs insertObject:tab
+					  atIndex:index - CTSpineBlockStart(spine, position)];
+	++count_;
+	if ([block->tabs count] > kBlockCapacity) {
+		NSRange back = NSMakeRange(kBlockCapacity / 2,
+								   [block->tabs count] - kBlockCapacity / 2);
+		CTTabSnapshotBlock* split = [[CTTabSnapshotBlock alloc] init];
+		split->tabs = [[block->tabs subarrayWithRange:back] mutableCopy];
+		split->epoch = epoch_;
+		[block->tabs removeObjectsInRange:back];
+		[self insertBlock:split atPosition:position + 1];
+	}
+	[self updateEndsFromPosition:position];
+}
+
+- (void)removeTabsInRange:(NSRange)range {
+	assert(NSMaxRange(range) <= (NSUInteger)count_);
+	CTTabSnapshotSpine* spine = [self writableSpine];
+	while (range.length) {
+		NSUInteger position =
+			CTSpineBlockContainingIndex(spine, (int)range.location);
+		CTTabSnapshotBlock* block = [self writableBlockAtPosition:position];
+		NSUInteger offset = range.location - CTSpineBlockStart(spine, position);
+		NSUInteger length = MIN(range.length, [block->tabs count] - offset);
+		[block->tabs removeObjectsInRange:NSMakeRange(offset, length)];
+		count_ -= (int)length;
+		range.length -= length;
+
+		NSUInteger blockLength = [block->tabs count];
+		if (!blockLength) {
+			[spine->blocks removeObjectAtIndex:position];
+		} else if (blockLength < kBlockCapacity / 4 &&
+				   position + 1 < [spine->blocks count]) {
+			CTTabSnapshotBlock* next = [spine->blocks objectAtIndex:position + 1];
+			if (blockLength + [next->tabs count] <= kBlockCapacity) {
+				[block->tabs addObjectsFromArray:next->tabs];
+				[spine->blocks removeObjectAtIndex:position + 1];
+			}
+		}
+		[self updateEndsFromPosition:position];
+	}
+}
+
+- (void)replaceTabAtIndex:(int)index withTab:(CTTabSnapshot *)tab {
+	assert(index >= 0 && index < count_);
+	[self writableSpine];
+	NSUInteger position = CTSpineBlockContainingIndex(spine_, index);
+	CTTabSnapshotBlock* block = [self writableBlockAtPosition:position];
+	[block->tabs replaceObjectAtIndex:index - CTSpineBlockStart(spine_, position)
+						   withObject:tab];
+}
+
+- (void)moveTabAtIndex:(int)index toIndex:(int)toIndex {
+	if (index == toIndex)
+		return;
+	CTTabSnapshot* tab = [self tabAtIndex:index];
+	[self removeTabsInRange:NSMakeRange(index, 1)];
+	[self insertTab:tab atIndex:toIndex];
+}
+
+- (void)reorderTabsWithPermutation:(const int *)permutation {
+	// Everything moves, so build new blocks rather than copy the old ones.
+	CTTabSnapshotSpine* old = spine_;
+	int count = count_;
+	NSMutableArray* tabs = [NSMutableArray arrayWithCapacity:count];
+	for (CTTabSnapshotBlock* block in old->blocks)
+		[tabs addObjectsFromArray:block->tabs];
+	spine_ = [[CTTabSnapshotSpine alloc] init];
+	spine_->blocks = [[NSMutableArray alloc] init];
+	spine_->epoch = epoch_;
+	count_ = 0;
+	for (int i = 0; i < count; ++i)
+		[self insertTab:[tabs objectAtIndex:permutation[i]] atIndex:i];
+}
+
+- (CTTabStripSnapshot *)snapshotWithActiveIndex:(int)activeIndex
+									 generation:(NSUInteger)generation {
+	CTTabStripSnapshot* snapshot =
+		[[CTTabStripSnapshot alloc] initWithSpine:spine_
+											count:count_
+									  activeIndex:activeIndex
+									   generation:generation];
+	++epoch_;
+	return snapshot;
+}
+
+#pragma mark -
+#pragma mark Private
+
+- (CTTabSnapshotSpine *)writableSpine {
+	if (spine_->epoch == epoch_)
+		return spine_;
+	CTTabSnapshotSpine* spine = [[CTTabSnapshotSpine alloc] init];
+	spine->blocks = [spine_->blocks mutableCopy];
+	spine->capacity = MAX([spine->blocks count], 4u);
+	spine->ends = malloc(spine->capacity * sizeof(int));
+	if ([spine->blocks count])
+		memcpy(spine->ends, spine_->ends, [spine->blocks count] * sizeof(int));
+	spine->epoch = epoch_;
+	spine_ = spine;
+	return spine;
+}
+
+- (CTTabSnapshotBlock *)writableBlockAtPosition:(NSUInteger)position {
+	assert(spine_->epoch == epoch_);
+	CTTabSnapshotBlock* block = [spine_->blocks objectAtIndex:position];
+	if (block->epoch == epoch_)
+		return block;
+	CTTabSnapshotBlock* copy = [[CTTabSnapshotBlock alloc] init];
+	copy->tabs = [block->tabs mutableCopy];
+	copy->epoch = epoch_;
+	[spine_->blocks replaceObjectAtIndex:position withObject:copy];
+	return copy;
+}
+
+- (void)insertBlock:(CTTabSnapshotBlock *)block atPosition:(NSUInteger)position {
+	assert(spine_->epoch == epoch_);
+	[spine_->blocks insertObject:block atIndex:position];
+	if ([spine_->blocks count] > spine_->capacity) {
+		spine_->capacity = MAX(spine_->capacity * 2, 4u);
+		spine_->ends = realloc(spine_->ends, spine_->capacity * sizeof(int));
+	}
+}
+
+- (void)updateEndsFromPosition:(NSUInteger)position {
+	NSUInteger blockCount = [spine_->blocks count];
+	int end = position ? spine_->ends[position - 1] : 0;
+	for (NSUInteger i = position; i < blockCount; ++i) {
+		CTTabSnapshotBlock* block = [spine_->blocks objectAtIndex:i];
+		end += (int)[block->tabs count];
+		spine_->ends[i] = end;
+	}
+	assert(end == count_);
+}
+
+@end
@@ -9,6 +9,7 @@
 #import "BackgroundGradientView.h"
 #import "URLDropTarget.h"
 
+@class CTTabStripController;
 @class NewTabButton;
 @class URLDropTargetHandler;
 
@@ -18,6 +19,8 @@
 @interface CTTabStripView : BackgroundGradientView<URLDropTarget>
 
 @property(weak, nonatomic) IBOutlet NewTabButton* addTabButton;
+// Scrolls the tabs when they overflow.
+@property(weak, nonatomic) CTTabStripController* tabStripController;
 @property(assign, nonatomic) BOOL dropArrowShown;
 @property(assign, nonatomic) NSPoint dropArrowPosition;
 @property(assign, nonatomic) BOOL allowGradient;
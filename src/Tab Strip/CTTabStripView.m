@@ -29,6 +29,8 @@ static BOOL ShouldWindowsMiniaturizeOnDoubleClick() {
 	// Weak; the following come from the nib.
 	__weak NewTabButton* addTabButton_;
 	
+	__weak CTTabStripController* tabStripController_;  // weak; owns us
+	
 	// Whether the drop-indicator arrow is shown, and if it is, the coordinate of
 	// its tip.
 	BOOL dropArrowShown_;
@@ -37,6 +39,7 @@ static BOOL ShouldWindowsMiniaturizeOnDoubleClick() {
 }
 
 @synthesize addTabButton = addTabButton_;
+@synthesize tabStripController = tabStripController_;
 @synthesize dropArrowShown = dropArrowShown_;
 @synthesize dropArrowPosition = dropArrowPosition_;
 @synthesize allowGradient = allowGradient_;
@@ -200,6 +203,12 @@ static BOOL ShouldWindowsMiniaturizeOnDoubleClick() {
 	lastMouseUp_ = (clickCount == 1) ? timestamp : -1000.0;
 }
 
+// Scroll events over the tabs end up here too.
+- (void)scrollWheel:(NSEvent*)event {
+	if (![tabStripController_ scrollTabsWithEvent:event])
+		[super scrollWheel:event];
+}
+
 // (URLDropTarget protocol)
 - (id<URLDropTargetController>)urlDropController {
 	//CTBrowserWindowController* windowController = [[self window] windowController];
@@ -43,6 +43,7 @@ extern NSString *const CTTabContentsDidCloseNotification;
 	BOOL isTeared_; // YES while being "teared" (dragged between windows)
 	BOOL isPinned_;
 	BOOL isBlocked_;
+	BOOL isPlaceholder_;
 	id delegate_;
 	unsigned int closedByUserGesture_; // TabStripModel::CloseTypes
 	NSView *view_; // the actual content
@@ -50,6 +51,10 @@ extern NSString *const CTTabContentsDidCloseNotification;
 	NSImage *icon_; // tab icon (nil means no or default icon)
 	CTBrowser *browser_;
 	CTTabContents* parentOpener_; // the tab which opened this tab (unless nil)
+	NSHashTable* openedContents_; // tabs whose parentOpener is us (weak)
+	NSData *pendingTitleData_; // see setTitleFromData:range:
+	NSRange pendingTitleRange_;
+	NSUInteger iconMemoryUsage_; // bytes of |icon_|'s bitmaps
 }
 
 @property(assign, nonatomic) BOOL isApp;
@@ -67,6 +72,19 @@ extern NSString *const CTTabContentsDidCloseNotification;
 @property(retain, nonatomic) CTBrowser *browser;
 @property(strong, nonatomic) CTTabContents* parentOpener;
 
+// YES if this was created with |initPlaceholderWithTitle:icon:| and has not
+// been replaced by real contents yet.
+@property(readonly, nonatomic) BOOL isPlaceholder;
+
+// How many bytes this tab's contents hold, such as page data and caches.
+// Subclasses should override this with an estimate cheap enough to be asked
+// for every second; the default returns 0. Feeds CTBrowser's |memoryUsage|
+// and so which tabs CTTabDiscarder discards first under a memory budget.
+@property(readonly, nonatomic) NSUInteger estimatedMemoryUsage;
+
+// The bytes taken by the bitmaps of |icon|, computed when it is set.
+@property(readonly, nonatomic) NSUInteger iconMemoryUsage;
+
 // If this returns YES, special icons like throbbers and "crashed" is
 // displayed, even if |icon| is nil. By default this returns YES.
 @property(readonly, nonatomic) BOOL hasIcon;
@@ -77,6 +95,21 @@ extern NSString *const CTTabContentsDidCloseNotification;
 // customized initialization.
 -(id)initWithBaseTabContents:(CTTabContents*)baseContents;
 
+// Initialize a placeholder for a tab that has not been looked at yet, like
+// the background tabs of a restored session. A placeholder has a title, an
+// icon and whatever flags the tab strip model keeps for it, but no view, and
+// none of the subclass' initialization runs. The first time it is about to
+// become the active tab, the tab strip model replaces it with the contents
+// returned by CTBrowser's |createTabContentsForPlaceholder:|, so only the
+// tabs that are actually viewed ever cost a real CTTabContents.
+-(id)initPlaceholderWithTitle:(NSString*)title icon:(NSImage*)icon;
+
+// Sets |title| to the UTF-8 string in |range| of |data|, decoding it only
+// when the title is first asked for. Used to restore sessions without
+// decoding the titles of tabs nobody looks at; |data| is typically a memory
+// mapped session snapshot.
+- (void)setTitleFromData:(NSData*)data range:(NSRange)range;
+
 // Called when the tab should be destroyed (involves some finalization).
 //-(void)destroy:(CTTabStripModel *)sender;
 
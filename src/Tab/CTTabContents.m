@@ -28,8 +28,41 @@ _synthAssign(BOOL, IsLoading, isLoading);
 _synthAssign(BOOL, IsWaitingForResponse, isWaitingForResponse);
 _synthAssign(BOOL, IsCrashed, isCrashed);
 
-_synthRetain(NSString*, Title, title);
-_synthRetain(NSImage*, Icon, icon);
+- (NSImage*)icon { return icon_; }
+
+- (void)setIcon:(NSImage*)icon {
+  icon_ = icon;
+  iconMemoryUsage_ = 0;
+  for (NSImageRep* rep in [icon representations])
+    iconMemoryUsage_ += (NSUInteger)[rep pixelsWide] * [rep pixelsHigh] * 4;
+  if (browser_) [browser_ updateTabStateForContent:self];
+}
+
+// The title of a restored tab stays in the session snapshot until someone
+// asks for it.
+- (NSString*)title {
+  if (pendingTitleData_) {
+    const char* bytes = (const char*)[pendingTitleData_ bytes];
+    title_ = [[NSString alloc] initWithBytes:bytes + pendingTitleRange_.location
+                                      length:pendingTitleRange_.length
+                                    encoding:NSUTF8StringEncoding];
+    pendingTitleData_ = nil;
+  }
+  return title_;
+}
+
+- (void)setTitle:(NSString*)title {
+  pendingTitleData_ = nil;
+  title_ = title;
+  if (browser_) [browser_ updateTabStateForContent:self];
+}
+
+- (void)setTitleFromData:(NSData*)data range:(NSRange)range {
+  assert(NSMaxRange(range) <= [data length]);
+  title_ = nil;
+  pendingTitleData_ = data;
+  pendingTitleRange_ = range;
+}
 
 //@synthesize isLoading = isLoading_;
 //@synthesize isWaitingForResponse = isWaitingForResponse_;
@@ -45,6 +78,8 @@ _synthRetain(NSImage*, Icon, icon);
 @synthesize isActive = isActive_;
 @synthesize isTeared = isTeared_;
 @synthesize isVisible = isVisible_;
+@synthesize isPlaceholder = isPlaceholder_;
+@synthesize iconMemoryUsage = iconMemoryUsage_;
 
 #undef _synth
 
@@ -68,8 +103,26 @@ _synthRetain(NSImage*, Icon, icon);
 
 -(id)initWithBaseTabContents:(CTTabContents*)baseContents {
   // subclasses should probably override this
-  self.parentOpener = baseContents;
-  return [super init];
+  if ((self = [super init])) {
+    self.parentOpener = baseContents;
+  }
+  return self;
+}
+
+-(id)initPlaceholderWithTitle:(NSString*)title icon:(NSImage*)icon {
+  // Deliberately skips |initWithBaseTabContents:|, which subclasses override
+  // to build their views.
+  if ((self = [super init])) {
+    isPlaceholder_ = YES;
+    title_ = title;
+    self.icon = icon;
+  }
+  return self;
+}
+
+-(void)dealloc {
+  if (parentOpener_)
+    [parentOpener_->openedContents_ removeObject:self];
 }
 
 #pragma mark Properties impl.
@@ -78,34 +131,41 @@ _synthRetain(NSImage*, Icon, icon);
   return YES;
 }
 
+-(NSUInteger)estimatedMemoryUsage {
+  return 0;
+}
+
 - (CTTabContents*)parentOpener {
   return parentOpener_;
 }
 
-- (void)setParentOpener:(CTTabContents*)parentOpener {
-  NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
+// Each tab keeps an unretained table of the tabs it opened, so that closing
+// it only has to visit its own children instead of every tab observing a
+// global notification.
+- (void)setParentOpener:(CTTabContents*)parentOpener
+          notifyBrowser:(BOOL)notifyBrowser {
+  if (parentOpener == parentOpener_)
+    return;
+  if (parentOpener_)
+    [parentOpener_->openedContents_ removeObject:self];
+  [self willChangeValueForKey:@"parentOpener"];
+  parentOpener_ = parentOpener;
+  [self didChangeValueForKey:@"parentOpener"];
   if (parentOpener_) {
-    [nc removeObserver:self
-                  name:CTTabContentsDidCloseNotification
-                object:parentOpener_];
-  }
-    [self willChangeValueForKey:@"parentOpener"];
-    parentOpener_ = parentOpener;
-    [self didChangeValueForKey:@"parentOpener"];
-  if (parentOpener_) {
-    [nc addObserver:self
-           selector:@selector(tabContentsDidClose:)
-               name:CTTabContentsDidCloseNotification
-             object:parentOpener_];
+    if (!parentOpener_->openedContents_) {
+      parentOpener_->openedContents_ = [[NSHashTable alloc]
+          initWithOptions:NSPointerFunctionsOpaqueMemory |
+                          NSPointerFunctionsOpaquePersonality
+                 capacity:0];
+    }
+    [parentOpener_->openedContents_ addObject:self];
   }
+  if (notifyBrowser && browser_)
+    [browser_.tabStripModel tabContentsParentOpenerDidChange:self];
 }
 
-- (void)tabContentsDidClose:(NSNotification*)notification {
-  // detach (NULLify) our parentOpener_ when it closes
-  CTTabContents* tabContents = [notification object];
-  if (tabContents == parentOpener_) {
-    parentOpener_ = nil;
-  }
+- (void)setParentOpener:(CTTabContents*)parentOpener {
+  [self setParentOpener:parentOpener notifyBrowser:YES];
 }
 
 - (void)setVisible:(BOOL)visible {
@@ -167,6 +227,11 @@ _synthRetain(NSImage*, Icon, icon);
 #pragma mark Callbacks
 
 -(void)closingOfTabDidStart:(CTTabStripModel *)closeInitiatedByTabStripModel {
+  // detach (NULLify) the parentOpener of every tab we opened. The tab strip
+  // model keeps its own opener links until we are actually detached, since
+  // it uses them to pick the tab to select next.
+  for (CTTabContents* child in [openedContents_ allObjects])
+    [child setParentOpener:nil notifyBrowser:NO];
   NSNotificationCenter* nc = [NSNotificationCenter defaultCenter];
   [nc postNotificationName:CTTabContentsDidCloseNotification object:self];
 }
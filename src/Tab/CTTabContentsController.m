@@ -36,6 +36,13 @@
 // Call when the tab view is properly sized and the render widget host view
 // should be put into the view hierarchy.
 - (void)ensureContentsVisible {
+	// Placeholders have nothing to show. If the contents were just discarded,
+	// let go of their view too.
+	if (!contents_.view) {
+		[[[contentsContainer_ subviews] copy]
+			makeObjectsPerformSelector:@selector(removeFromSuperview)];
+		return;
+	}
 	NSArray* subviews = [contentsContainer_ subviews];
 	if ([subviews count] == 0) {
 		[contentsContainer_ addSubview:contents_.view];
@@ -40,6 +40,9 @@ typedef enum {
 @property(assign, nonatomic, setter = setMini:) BOOL isMini;
 @property(assign, nonatomic, setter = setPinned:) BOOL isPinned;
 @property(assign, nonatomic, setter = setActive:) BOOL isActive;
+// Whether the tab is selected along with the active tab. Only drawn when the
+// tab isn't active.
+@property(assign, nonatomic, setter = setSelected:) BOOL isSelected;
 @property(weak, nonatomic) id target;
 
 // Minimum and maximum allowable tab width. The minimum width does not show
@@ -85,6 +88,12 @@ typedef enum {
 
 // Update the title color to match the tabs current state.
 - (void)updateTitleColor;
+
+// Puts the controller and its view back the way they were loaded from the
+// nib, without a target, so the tab strip can use them for another tab
+// instead of loading the nib again. The observers registered in
+// |-initWithNibName:bundle:| stay.
+- (void)prepareForReuse;
 @end
 
 @interface CTTabController(TestingAPI)
@@ -24,6 +24,7 @@ static NSString* const kBrowserThemeDidChangeNotification =
 	BOOL isMini_;
 	BOOL isPinned_;
 	BOOL isActive_;
+	BOOL isSelected_;
 	CTTabLoadingState loadingState_;
 	CGFloat iconTitleXOffset_;  // between left edges of icon and title
 	CGFloat titleCloseWidthOffset_;  // between right edges of icon and close btn.
@@ -38,6 +39,7 @@ static NSString* const kBrowserThemeDidChangeNotification =
 @synthesize isPinned = isPinned_;
 @synthesize target = target_;
 @synthesize isActive = isActive_;
+@synthesize isSelected = isSelected_;
 
 // The min widths match the windows values and are sums of left + right
 // padding, of which we have no comparable constants (we draw using paths, not
@@ -81,6 +83,13 @@ static NSString* const kBrowserThemeDidChangeNotification =
 	//  [super dealloc];
 }
 
+// The state |-[CTTabView state]| draws: see there.
+- (NSCellStateValue)tabViewState {
+	if (isActive_)
+		return NSOnState;
+	return isSelected_ ? NSMixedState : NSOffState;
+}
+
 // The internals of |-setActive:| but doesn't check if we're already set
 // to |active|. Pass the selection change to the subviews that need it and
 // mark ourselves as needing a redraw.
@@ -88,7 +97,7 @@ static NSString* const kBrowserThemeDidChangeNotification =
 	isActive_ = active;
 	CTTabView* tabView = (CTTabView*)[self view];
 	assert([tabView isKindOfClass:[CTTabView class]]);
-	[tabView setState:active];
+	[tabView setState:[self tabViewState]];
 	[tabView cancelAlert];
 	[self updateVisibility];
 	[self updateTitleColor];
@@ -148,6 +157,38 @@ static NSString* const kBrowserThemeDidChangeNotification =
 		[self internalSetActive:active];
 }
 
+- (void)prepareForReuse {
+	CTTabView* tabView = [self tabView];
+	[tabView setClosing:NO];
+	[tabView setTrackingEnabled:NO];
+	[tabView setHoverAlpha:0];
+	[tabView setAlertAlpha:0];
+	// Drop the animations a close left behind, along with their delegates.
+	[tabView setAnimations:[NSDictionary dictionary]];
+	[tabView setToolTip:nil];
+	[super setTitle:nil];
+	
+	isApp_ = NO;
+	isMini_ = NO;
+	isPinned_ = NO;
+	isSelected_ = NO;
+	loadingState_ = CTTabLoadingStateDone;
+	[self setIconView:nil];
+	[self internalSetActive:NO];
+	target_ = nil;
+	action_ = NULL;
+}
+
+- (void)setSelected:(BOOL)selected {
+	if (isSelected_ == selected)
+		return;
+	isSelected_ = selected;
+	CTTabView* tabView = (CTTabView*)[self view];
+	[tabView setState:[self tabViewState]];
+	[tabView setNeedsDisplay:YES];
+}
+
+
 - (void)setIconView:(NSView*)iconView {
 	[iconView_ removeFromSuperview];
 	iconView_ = iconView;
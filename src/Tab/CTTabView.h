@@ -38,6 +38,8 @@ typedef enum {
 
 @interface CTTabView : BackgroundGradientView
 
+// NSOnState for the active tab, NSMixedState for a tab that is selected
+// along with it, NSOffState otherwise.
 @property(assign, nonatomic) NSCellStateValue state;
 @property(assign, nonatomic) CGFloat hoverAlpha;
 @property(assign, nonatomic) CGFloat alertAlpha;
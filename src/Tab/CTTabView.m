@@ -274,7 +274,8 @@ const CGFloat kRapidCloseDist = 2.5;
 	NSRect rect = [self bounds];
 	NSBezierPath* path = [self bezierPathForRect:rect];
 	
-	BOOL isActive = [self state];
+	BOOL isActive = [self state] == NSOnState;
+	BOOL isSelected = [self state] == NSMixedState;
 	// Don't draw the window/tab bar background when active, since the tab
 	// background overlay drawn over it (see below) will be fully opaque.
 	if (!isActive) {
@@ -294,7 +295,7 @@ const CGFloat kRapidCloseDist = 2.5;
 	// for the active state, it's fully opaque.
 	CGFloat hoverAlpha = [self hoverAlpha];
 	CGFloat alertAlpha = [self alertAlpha];
-	if (isActive || hoverAlpha > 0 || alertAlpha > 0) {
+	if (isActive || isSelected || hoverAlpha > 0 || alertAlpha > 0) {
 		// Draw the active background / glow overlay.
 		[context saveGraphicsState];
 		CGContextRef cgContext = [context graphicsPort];
@@ -303,6 +304,10 @@ const CGFloat kRapidCloseDist = 2.5;
 			// The alert glow overlay is like the active state but at most at most
 			// 80% opaque. The hover glow brings up the overlay's opacity at most 50%.
 			CGFloat backgroundAlpha = 0.8 * alertAlpha;
+			// Selected tabs get the overlay at 60%, so that they stand out
+			// without being mistaken for the active tab.
+			if (isSelected)
+				backgroundAlpha = MAX(backgroundAlpha, 0.6);
 			backgroundAlpha += (1 - backgroundAlpha) * 0.5 * hoverAlpha;
 			CGContextSetAlpha(cgContext, backgroundAlpha);
 		}
@@ -0,0 +1,143 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTBitVector.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_COUNT(bits) (((bits) + 63) >> 6)
+
+void CTBitVectorInit(CTBitVector* v) {
+	v->words = NULL;
+	v->count = 0;
+	v->capacity = 0;
+}
+
+void CTBitVectorFree(CTBitVector* v) {
+	free(v->words);
+	CTBitVectorInit(v);
+}
+
+// Makes room for |bits| bits. Newly allocated words are zeroed so that the
+// unused high bits of the last word are always clear, which is what
+// CTBitVectorCountSet and CTBitVectorNextSet rely on.
+static void CTBitVectorReserve(CTBitVector* v, size_t bits) {
+	size_t needed = WORD_COUNT(bits);
+	if (needed <= v->capacity)
+		return;
+	size_t capacity = v->capacity ? v->capacity * 2 : 4;
+	while (capacity < needed)
+		capacity *= 2;
+	v->words = (uint64_t*)realloc(v->words, capacity * sizeof(uint64_t));
+	assert(v->words);
+	memset(v->words + v->capacity, 0,
+		   (capacity - v->capacity) * sizeof(uint64_t));
+	v->capacity = capacity;
+}
+
+void CTBitVectorInsert(CTBitVector* v, size_t index, bool value) {
+	assert(index <= v->count);
+	CTBitVectorReserve(v, v->count + 1);
+	size_t first = index >> 6;
+	size_t last = v->count >> 6;  // word that receives the new top bit
+	// Shift whole words above |first| up by one bit, carrying the top bit of
+	// the word below into bit 0.
+	for (size_t i = last; i > first; --i)
+		v->words[i] = (v->words[i] << 1) | (v->words[i - 1] >> 63);
+	// Within the first word only the bits at and above |index| move.
+	uint64_t bit = (uint64_t)1 << (index & 63);
+	uint64_t low = v->words[first] & (bit - 1);
+	uint64_t high = v->words[first] & ~(bit - 1);
+	v->words[first] = low | (high << 1) | (value ? bit : 0);
+	v->count++;
+}
+
+void CTBitVectorRemove(CTBitVector* v, size_t index) {
+	assert(index < v->count);
+	size_t first = index >> 6;
+	size_t last = (v->count - 1) >> 6;
+	uint64_t bit = (uint64_t)1 << (index & 63);
+	uint64_t low = v->words[first] & (bit - 1);
+	uint64_t high = (v->words[first] >> 1) & ~(bit - 1);
+	v->words[first] = low | high;
+	for (size_t i = first; i < last; ++i) {
+		v->words[i] |= v->words[i + 1] << 63;
+		v->words[i + 1] >>= 1;
+	}
+	v->count--;
+	// Keep the bits past |count| clear.
+	if (v->count & 63)
+		v->words[v->count >> 6] &= ((uint64_t)1 << (v->count & 63)) - 1;
+	else if (v->count >> 6 < v->capacity)
+		v->words[v->count >> 6] = 0;
+}
+
+void CTBitVectorMove(CTBitVector* v, size_t from, size_t to) {
+	if (from == to)
+		return;
+	bool value = CTBitVectorGet(v, from);
+	CTBitVectorRemove(v, from);
+	CTBitVectorInsert(v, to, value);
+}
+
+// Clears the bits of |v| at and after |count| and makes |count| the new size.
+static void CTBitVectorTruncate(CTBitVector* v, size_t count) {
+	size_t words = WORD_COUNT(v->count);
+	if (count & 63)
+		v->words[count >> 6] &= ((uint64_t)1 << (count & 63)) - 1;
+	for (size_t i = WORD_COUNT(count); i < words; ++i)
+		v->words[i] = 0;
+	v->count = count;
+}
+
+void CTBitVectorResize(CTBitVector* v, size_t count) {
+	if (count <= v->count) {
+		CTBitVectorTruncate(v, count);
+		return;
+	}
+	// The bits past the old count are already clear.
+	CTBitVectorReserve(v, count);
+	v->count = count;
+}
+
+void CTBitVectorRemoveMarked(CTBitVector* v, const CTBitVector* marked) {
+	assert(marked->count == v->count);
+	size_t out = 0;
+	for (size_t i = 0; i < v->count; ++i) {
+		// Skip over fully marked words without looking at their bits.
+		if (!(i & 63) && marked->words[i >> 6] == ~(uint64_t)0 &&
+			i + 64 <= v->count) {
+			i += 63;
+			continue;
+		}
+		if (CTBitVectorGet(marked, i))
+			continue;
+		// |out| <= |i|, so this never overwrites a bit that is still to be read.
+		CTBitVectorSet(v, out++, CTBitVectorGet(v, i));
+	}
+	CTBitVectorTruncate(v, out);
+}
+
+size_t CTBitVectorCountSet(const CTBitVector* v) {
+	size_t n = 0;
+	size_t words = WORD_COUNT(v->count);
+	for (size_t i = 0; i < words; ++i)
+		n += __builtin_popcountll(v->words[i]);
+	return n;
+}
+
+size_t CTBitVectorNextSet(const CTBitVector* v, size_t index) {
+	if (index >= v->count)
+		return v->count;
+	size_t i = index >> 6;
+	size_t words = WORD_COUNT(v->count);
+	uint64_t word = v->words[i] & ~(((uint64_t)1 << (index & 63)) - 1);
+	while (!word) {
+		if (++i == words)
+			return v->count;
+		word = v->words[i];
+	}
+	return (i << 6) + __builtin_ctzll(word);
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_BIT_VECTOR_H_
+#define CT_BIT_VECTOR_H_
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A growable, densely packed vector of bits. Used by CTTabStripModel to keep
+// per-tab flags next to each other so that counting and scanning them is a
+// matter of popcounts and word scans rather than one message send per tab.
+//
+// Bits are addressed by position and can be inserted and removed in the
+// middle, shifting the following bits like an array would.
+typedef struct {
+	uint64_t* words;
+	size_t count;     // number of bits in use
+	size_t capacity;  // number of words allocated
+} CTBitVector;
+
+// Initializes |v| to an empty vector. Must be balanced with CTBitVectorFree.
+void CTBitVectorInit(CTBitVector* v);
+void CTBitVectorFree(CTBitVector* v);
+
+// Returns the value of the bit at |index|, which must be < v->count.
+static inline bool CTBitVectorGet(const CTBitVector* v, size_t index) {
+	return (v->words[index >> 6] >> (index & 63)) & 1;
+}
+
+// Sets the value of the bit at |index|, which must be < v->count.
+static inline void CTBitVectorSet(CTBitVector* v, size_t index, bool value) {
+	uint64_t mask = (uint64_t)1 << (index & 63);
+	if (value)
+		v->words[index >> 6] |= mask;
+	else
+		v->words[index >> 6] &= ~mask;
+}
+
+// Inserts a bit with |value| at |index| (<= v->count), shifting the bits at
+// and after |index| up by one.
+void CTBitVectorInsert(CTBitVector* v, size_t index, bool value);
+
+// Removes the bit at |index|, shifting the bits after it down by one.
+void CTBitVectorRemove(CTBitVector* v, size_t index);
+
+// Moves the bit at |from| to |to|, as if it was removed and then inserted.
+void CTBitVectorMove(CTBitVector* v, size_t from, size_t to);
+
+// Grows or shrinks |v| to |count| bits. Bits added at the end are clear.
+void CTBitVectorResize(CTBitVector* v, size_t count);
+
+// Removes every bit of |v| whose position is set in |marked|, which must
+// have the same count, in a single pass. The remaining bits keep their order.
+void CTBitVectorRemoveMarked(CTBitVector* v, const CTBitVector* marked);
+
+// Returns the number of set bits.
+size_t CTBitVectorCountSet(const CTBitVector* v);
+
+// Returns the position of the first set bit at or after |index|, or v->count
+// if there is none.
+size_t CTBitVectorNextSet(const CTBitVector* v, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CT_BIT_VECTOR_H_
@@ -0,0 +1,275 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTClosedTabStore.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// In both rings every entry is framed by its length on both sides, so the
+// oldest can be found from the front and the newest from the back.
+#define FRAME_SIZE (2 * sizeof(uint32_t))
+
+struct CTClosedTabStore {
+	uint8_t* ring;
+	size_t capacity;
+	size_t start;      // offset of the oldest entry in memory
+	size_t used;       // bytes in use, starting at |start| and wrapping around
+	size_t ringCount;
+
+	// The spill file is laid out like |ring|, in |spillCapacity| bytes.
+	char* spillPath;
+	int spillFile;     // -1 until something is spilled
+	uint64_t spillCapacity;
+	uint64_t spillStart;
+	uint64_t spillUsed;
+	size_t spillCount;
+};
+
+// Copies into and out of the ring at |offset|, wrapping around its end.
+static void CTClosedTabStoreWrite(CTClosedTabStore* store,
+                                  size_t offset,
+                                  const void* bytes,
+                                  size_t length) {
+	offset %= store->capacity;
+	size_t first = store->capacity - offset;
+	if (first > length)
+		first = length;
+	if (first)
+		memcpy(store->ring + offset, bytes, first);
+	if (length > first)
+		memcpy(store->ring, (const uint8_t*)bytes + first, length - first);
+}
+
+static void CTClosedTabStoreRead(const CTClosedTabStore* store,
+                                 size_t offset,
+                                 void* bytes,
+                                 size_t length) {
+	offset %= store->capacity;
+	size_t first = store->capacity - offset;
+	if (first > length)
+		first = length;
+	if (first)
+		memcpy(bytes, store->ring + offset, first);
+	if (length > first)
+		memcpy((uint8_t*)bytes + first, store->ring, length - first);
+}
+
+// Writes to and reads from the spill file at |offset|, wrapping around its
+// end like the ring. Return false if the file can't be written or read.
+static bool CTClosedTabStoreWriteSpill(CTClosedTabStore* store,
+                                       uint64_t offset,
+                                       const void* bytes,
+                                       size_t length) {
+	offset %= store->spillCapacity;
+	size_t first = store->spillCapacity - offset < length ?
+		(size_t)(store->spillCapacity - offset) : length;
+	if (first &&
+		pwrite(store->spillFile, bytes, first, (off_t)offset) != (ssize_t)first)
+		return false;
+	size_t rest = length - first;
+	return !rest ||
+		pwrite(store->spillFile, (const uint8_t*)bytes + first, rest, 0) ==
+			(ssize_t)rest;
+}
+
+static bool CTClosedTabStoreReadSpill(const CTClosedTabStore* store,
+                                      uint64_t offset,
+                                      void* bytes,
+                                      size_t length) {
+	offset %= store->spillCapacity;
+	size_t first = store->spillCapacity - offset < length ?
+		(size_t)(store->spillCapacity - offset) : length;
+	if (first &&
+		pread(store->spillFile, bytes, first, (off_t)offset) != (ssize_t)first)
+		return false;
+	size_t rest = length - first;
+	return !rest ||
+		pread(store->spillFile, (uint8_t*)bytes + first, rest, 0) == (ssize_t)rest;
+}
+
+// Forgets everything in the spill file.
+static void CTClosedTabStoreDropSpill(CTClosedTabStore* store) {
+	store->spillStart = 0;
+	store->spillUsed = 0;
+	store->spillCount = 0;
+}
+
+// Drops the oldest entry in the spill file to make room. If its length can't
+// be read, drops them all.
+static void CTClosedTabStoreDropOldestSpilled(CTClosedTabStore* store) {
+	assert(store->spillCount);
+	uint32_t length;
+	if (!CTClosedTabStoreReadSpill(store, store->spillStart, &length,
+	                               sizeof(length)) ||
+		length + FRAME_SIZE > store->spillUsed) {
+		CTClosedTabStoreDropSpill(store);
+		return;
+	}
+	store->spillStart = (store->spillStart + length + FRAME_SIZE) %
+		store->spillCapacity;
+	store->spillUsed -= length + FRAME_SIZE;
+	store->spillCount--;
+}
+
+// Appends an entry to the spill file, dropping the oldest ones if it is
+// full. Returns false, dropping the entry, if there is no spill file, the
+// entry is bigger than all of it or it can't be written.
+static bool CTClosedTabStoreSpill(CTClosedTabStore* store,
+                                  const void* entry,
+                                  uint32_t length) {
+	uint64_t framed = (uint64_t)length + FRAME_SIZE;
+	if (!store->spillPath || framed > store->spillCapacity)
+		return false;
+	if (store->spillFile < 0) {
+		store->spillFile = open(store->spillPath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (store->spillFile < 0)
+			return false;
+	}
+	while (store->spillCapacity - store->spillUsed < framed)
+		CTClosedTabStoreDropOldestSpilled(store);
+	// Whatever doesn't make it to the file is past |spillUsed| and is
+	// overwritten by the next spill.
+	uint64_t end = store->spillStart + store->spillUsed;
+	if (!CTClosedTabStoreWriteSpill(store, end, &length, sizeof(length)) ||
+		!CTClosedTabStoreWriteSpill(store, end + sizeof(length), entry, length) ||
+		!CTClosedTabStoreWriteSpill(store, end + sizeof(length) + length, &length,
+		                            sizeof(length))) {
+		return false;
+	}
+	store->spillUsed += framed;
+	store->spillCount++;
+	return true;
+}
+
+// Moves the oldest entry in memory to the spill file, or drops it.
+static void CTClosedTabStoreEvictOldest(CTClosedTabStore* store) {
+	assert(store->ringCount);
+	uint32_t length;
+	CTClosedTabStoreRead(store, store->start, &length, sizeof(length));
+	if (store->spillPath) {
+		void* entry = malloc(length ? length : 1);
+		assert(entry);
+		CTClosedTabStoreRead(store, store->start + sizeof(length), entry, length);
+		CTClosedTabStoreSpill(store, entry, length);
+		free(entry);
+	}
+	store->start = (store->start + length + FRAME_SIZE) % store->capacity;
+	store->used -= length + FRAME_SIZE;
+	store->ringCount--;
+}
+
+CTClosedTabStore* CTClosedTabStoreCreate(size_t budget,
+                                         const char* spillPath,
+                                         size_t spillBudget) {
+	CTClosedTabStore* store = (CTClosedTabStore*)calloc(1, sizeof(CTClosedTabStore));
+	assert(store);
+	store->capacity = budget > FRAME_SIZE ? budget : FRAME_SIZE;
+	store->ring = (uint8_t*)malloc(store->capacity);
+	assert(store->ring);
+	store->spillFile = -1;
+	store->spillCapacity = spillBudget;
+	if (spillPath) {
+		store->spillPath = strdup(spillPath);
+		assert(store->spillPath);
+	}
+	return store;
+}
+
+void CTClosedTabStoreFree(CTClosedTabStore* store) {
+	if (!store)
+		return;
+	if (store->spillFile >= 0) {
+		close(store->spillFile);
+		unlink(store->spillPath);
+	}
+	free(store->spillPath);
+	free(store->ring);
+	free(store);
+}
+
+bool CTClosedTabStorePush(CTClosedTabStore* store,
+                          const void* entry,
+                          size_t length) {
+	if (length > UINT32_MAX - FRAME_SIZE)
+		return false;
+	uint32_t length32 = (uint32_t)length;
+	size_t framed = length + FRAME_SIZE;
+	if (framed > store->capacity) {
+		// Too big to ever be in memory. Everything older has to go to the
+		// file first to keep the order.
+		while (store->ringCount)
+			CTClosedTabStoreEvictOldest(store);
+		return CTClosedTabStoreSpill(store, entry, length32);
+	}
+	while (store->capacity - store->used < framed)
+		CTClosedTabStoreEvictOldest(store);
+	size_t end = store->start + store->used;
+	CTClosedTabStoreWrite(store, end, &length32, sizeof(length32));
+	CTClosedTabStoreWrite(store, end + sizeof(length32), entry, length);
+	CTClosedTabStoreWrite(store, end + sizeof(length32) + length, &length32,
+	                      sizeof(length32));
+	store->used += framed;
+	store->ringCount++;
+	return true;
+}
+
+void* CTClosedTabStorePop(CTClosedTabStore* store, size_t* length) {
+	if (store->ringCount) {
+		uint32_t entryLength;
+		size_t end = store->start + store->used;
+		CTClosedTabStoreRead(store, end - sizeof(entryLength), &entryLength,
+		                     sizeof(entryLength));
+		size_t entryStart = end - entryLength - FRAME_SIZE;
+		void* entry = malloc(entryLength ? entryLength : 1);
+		assert(entry);
+		CTClosedTabStoreRead(store, entryStart + sizeof(entryLength), entry,
+		                     entryLength);
+		store->used -= entryLength + FRAME_SIZE;
+		store->ringCount--;
+		*length = entryLength;
+		return entry;
+	}
+
+	if (!store->spillCount)
+		return NULL;
+	// Nothing is truncated: the entry's bytes are past |spillUsed| from now on
+	// and are overwritten by the next spill. An entry whose lengths don't
+	// match or can't be read means the file is damaged, and what is left in
+	// it is dropped.
+	uint32_t entryLength;
+	uint32_t leadingLength;
+	uint64_t end = store->spillStart + store->spillUsed;
+	if (!CTClosedTabStoreReadSpill(store, end - sizeof(entryLength), &entryLength,
+	                               sizeof(entryLength)) ||
+		entryLength + FRAME_SIZE > store->spillUsed ||
+		!CTClosedTabStoreReadSpill(store, end - entryLength - FRAME_SIZE,
+		                           &leadingLength, sizeof(leadingLength)) ||
+		leadingLength != entryLength) {
+		CTClosedTabStoreDropSpill(store);
+		return NULL;
+	}
+	void* entry = malloc(entryLength ? entryLength : 1);
+	assert(entry);
+	if (!CTClosedTabStoreReadSpill(store, end - entryLength - sizeof(entryLength),
+	                               entry, entryLength)) {
+		free(entry);
+		CTClosedTabStoreDropSpill(store);
+		return NULL;
+	}
+	store->spillUsed -= entryLength + FRAME_SIZE;
+	store->spillCount--;
+	*length = entryLength;
+	return entry;
+}
+
+size_t CTClosedTabStoreCount(const CTClosedTabStore* store) {
+	return store->ringCount + store->spillCount;
+}
+
+size_t CTClosedTabStoreMemoryUsed(const CTClosedTabStore* store) {
+	return store->used;
+}
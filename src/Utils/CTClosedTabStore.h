@@ -0,0 +1,62 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_CLOSED_TAB_STORE_H_
+#define CT_CLOSED_TAB_STORE_H_
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A stack of recently closed tabs, each an opaque serialized entry, kept
+// within a fixed memory budget.
+//
+// The newest entries live in a ring buffer of |budget| bytes. When a push
+// does not fit, the oldest entries in the ring are moved to a spill file,
+// which is a ring buffer of |spillBudget| bytes itself: it holds the older
+// part of the stack in order, popping past the memory ring reads the newest
+// of them back from its end, and when it is full the oldest entries are
+// dropped. Both push and pop touch a bounded number of entries, however many
+// there are.
+//
+// A store is not thread safe, but it doesn't have to live on the main
+// thread; only pushes and pops that go past the memory ring touch the file.
+typedef struct CTClosedTabStore CTClosedTabStore;
+
+// Creates a store that keeps up to |budget| bytes of entries in memory and
+// up to |spillBudget| bytes of older ones in |spillPath|, which is created
+// when first needed and removed when the store is freed. If |spillPath| is
+// NULL the older entries are dropped instead.
+CTClosedTabStore* CTClosedTabStoreCreate(size_t budget,
+                                         const char* spillPath,
+                                         size_t spillBudget);
+void CTClosedTabStoreFree(CTClosedTabStore* store);
+
+// Pushes a copy of the |length| bytes at |entry|. Returns false if the entry
+// could not be kept.
+bool CTClosedTabStorePush(CTClosedTabStore* store,
+                          const void* entry,
+                          size_t length);
+
+// Pops the newest entry, returning a malloc'ed copy that the caller frees
+// and setting |length| to its size. Returns NULL if the store is empty. If
+// the spill file can't be read back, what is left in it is dropped.
+void* CTClosedTabStorePop(CTClosedTabStore* store, size_t* length);
+
+// The number of entries, in memory and spilled.
+size_t CTClosedTabStoreCount(const CTClosedTabStore* store);
+
+// The number of bytes the entries in memory take.
+size_t CTClosedTabStoreMemoryUsed(const CTClosedTabStore* store);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CT_CLOSED_TAB_STORE_H_
@@ -0,0 +1,49 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTOrderLabels.h"
+#include <assert.h>
+
+void CTOrderLabelsAssign(const CTOrderLabelList* list, int count, int index) {
+	assert(index >= 0 && index < count);
+	uint64_t before = index > 0 ? list->get(list->list, index - 1) : 0;
+	uint64_t after = index + 1 < count ?
+	    list->get(list->list, index + 1) : UINT64_MAX;
+	assert(before < after);
+	if (after - before >= 2) {
+		list->set(list->list, index, before + (after - before) / 2);
+		return;
+	}
+
+	// Find the smallest block of 2^bits labels around |before| holding fewer
+	// than (4/3)^bits items, counting the new one, and spread its items out.
+	// The whole label space always takes them.
+	int first = index;
+	int last = index;
+	double limit = 1;
+	for (int bits = 1; bits <= 64; ++bits) {
+		uint64_t mask = bits == 64 ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+		uint64_t base = before & ~mask;
+		while (first > 0 && list->get(list->list, first - 1) >= base)
+			first--;
+		while (last + 1 < count &&
+		       list->get(list->list, last + 1) - base <= mask) {
+			last++;
+		}
+		uint64_t items = (uint64_t)(last - first + 1);
+		limit *= 4.0 / 3.0;
+		if (bits < 64 && (items >= limit || items + 1 > mask))
+			continue;
+		uint64_t step = mask / (items + 1);
+		for (int i = first; i <= last; ++i)
+			list->set(list->list, i, base + step * (uint64_t)(i - first + 1));
+		return;
+	}
+}
+
+void CTOrderLabelsSpread(const CTOrderLabelList* list, int count) {
+	uint64_t step = UINT64_MAX / ((uint64_t)count + 1);
+	for (int i = 0; i < count; ++i)
+		list->set(list->list, i, step * (uint64_t)(i + 1));
+}
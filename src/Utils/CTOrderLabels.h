@@ -0,0 +1,50 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_ORDER_LABELS_H_
+#define CT_ORDER_LABELS_H_
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Order labels for the items of a list that changes in the middle, like the
+// tabs of a strip: every item has a 64-bit label, and the labels increase
+// along the list. Comparing two labels tells which item comes first without
+// knowing their indices, so anything sorted by label (the tabs a tab opened,
+// say) stays sorted however the list is shifted around them, and can be
+// binary-searched while the indices are stale.
+//
+// An item placed in the list takes the label halfway between its
+// neighbours. When there is no room left, the smallest aligned block of
+// labels around it that isn't too crowded is spread out again, which costs
+// O(log n) relabelled items amortized per placement. Labels are never 0 or
+// UINT64_MAX.
+//
+// The list is reached through |get| and |set|, which read and write the
+// label of the item at an index, so the labels can live wherever the items
+// keep their other state.
+typedef struct {
+	void* list;
+	uint64_t (*get)(void* list, int index);
+	void (*set)(void* list, int index, uint64_t label);
+} CTOrderLabelList;
+
+// Gives the item at |index| of the |count| items of |list| a label between
+// those of its neighbours, whose labels must be in order. Its own label is
+// ignored, so it may be an item that was just inserted or moved there. May
+// relabel items around it, keeping their order.
+void CTOrderLabelsAssign(const CTOrderLabelList* list, int count, int index);
+
+// Relabels the |count| items of |list| evenly, in list order.
+void CTOrderLabelsSpread(const CTOrderLabelList* list, int count);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CT_ORDER_LABELS_H_
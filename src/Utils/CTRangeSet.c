@@ -0,0 +1,218 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTRangeSet.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void CTRangeSetInit(CTRangeSet* s) {
+	s->ranges = NULL;
+	s->count = 0;
+	s->capacity = 0;
+	s->size = 0;
+}
+
+void CTRangeSetFree(CTRangeSet* s) {
+	free(s->ranges);
+	CTRangeSetInit(s);
+}
+
+void CTRangeSetClear(CTRangeSet* s) {
+	s->count = 0;
+	s->size = 0;
+}
+
+// Returns the position of the first range that ends after |index|.
+static int CTRangeSetFirstEndingAfter(const CTRangeSet* s, int index) {
+	int low = 0;
+	int high = s->count;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (s->ranges[middle].end <= index)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+// Returns the position of the first range that starts after |index|.
+static int CTRangeSetFirstStartingAfter(const CTRangeSet* s, int index) {
+	int low = 0;
+	int high = s->count;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (s->ranges[middle].start <= index)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+// Replaces the ranges from position |first| up to |last| by the |count|
+// ranges in |with|, and keeps |size| up to date.
+static void CTRangeSetSplice(CTRangeSet* s,
+                             int first,
+                             int last,
+                             const CTRange* with,
+                             int count) {
+	assert(first >= 0 && first <= last && last <= s->count);
+	int newCount = s->count - (last - first) + count;
+	if (newCount > s->capacity) {
+		int capacity = s->capacity ? s->capacity * 2 : 4;
+		while (capacity < newCount)
+			capacity *= 2;
+		s->ranges = (CTRange*)realloc(s->ranges, capacity * sizeof(CTRange));
+		assert(s->ranges);
+		s->capacity = capacity;
+	}
+	for (int i = first; i < last; ++i)
+		s->size -= s->ranges[i].end - s->ranges[i].start;
+	memmove(&s->ranges[first + count], &s->ranges[last],
+	        (s->count - last) * sizeof(CTRange));
+	for (int i = 0; i < count; ++i) {
+		s->ranges[first + i] = with[i];
+		s->size += with[i].end - with[i].start;
+	}
+	s->count = newCount;
+}
+
+bool CTRangeSetContains(const CTRangeSet* s, int index) {
+	int i = CTRangeSetFirstEndingAfter(s, index);
+	return i < s->count && s->ranges[i].start <= index;
+}
+
+void CTRangeSetAdd(CTRangeSet* s, int start, int end) {
+	if (start >= end)
+		return;
+	// Merge with every range that overlaps or touches [start, end).
+	int first = CTRangeSetFirstEndingAfter(s, start - 1);
+	int last = CTRangeSetFirstStartingAfter(s, end);
+	CTRange merged = { start, end };
+	if (first < last) {
+		if (s->ranges[first].start < merged.start)
+			merged.start = s->ranges[first].start;
+		if (s->ranges[last - 1].end > merged.end)
+			merged.end = s->ranges[last - 1].end;
+	}
+	CTRangeSetSplice(s, first, last, &merged, 1);
+}
+
+void CTRangeSetRemove(CTRangeSet* s, int start, int end) {
+	if (start >= end)
+		return;
+	int first = CTRangeSetFirstEndingAfter(s, start);
+	int last = CTRangeSetFirstStartingAfter(s, end - 1);
+	if (first >= last)
+		return;
+	// What is left of the first and last overlapping ranges.
+	CTRange pieces[2];
+	int count = 0;
+	if (s->ranges[first].start < start) {
+		pieces[count].start = s->ranges[first].start;
+		pieces[count++].end = start;
+	}
+	if (s->ranges[last - 1].end > end) {
+		pieces[count].start = end;
+		pieces[count++].end = s->ranges[last - 1].end;
+	}
+	CTRangeSetSplice(s, first, last, pieces, count);
+}
+
+int CTRangeSetNext(const CTRangeSet* s, int index) {
+	int i = CTRangeSetFirstEndingAfter(s, index);
+	if (i == s->count)
+		return -1;
+	return s->ranges[i].start > index ? s->ranges[i].start : index;
+}
+
+int CTRangeSetPrevious(const CTRangeSet* s, int index) {
+	int i = CTRangeSetFirstStartingAfter(s, index);
+	if (i == 0)
+		return -1;
+	return s->ranges[i - 1].end <= index ? s->ranges[i - 1].end - 1 : index;
+}
+
+void CTRangeSetInsertSlots(CTRangeSet* s, int index, int count) {
+	assert(count >= 0);
+	int i = CTRangeSetFirstEndingAfter(s, index);
+	if (i < s->count && s->ranges[i].start < index) {
+		CTRange pieces[2] = {
+			{ s->ranges[i].start, index },
+			{ index + count, s->ranges[i].end + count },
+		};
+		CTRangeSetSplice(s, i, i + 1, pieces, 2);
+		i += 2;
+	}
+	for (; i < s->count; ++i) {
+		s->ranges[i].start += count;
+		s->ranges[i].end += count;
+	}
+}
+
+void CTRangeSetRemoveSlots(CTRangeSet* s, int index, int count) {
+	assert(count >= 0);
+	CTRangeSetRemove(s, index, index + count);
+	// Nothing is left in the removed slots, so every range from here on
+	// starts after them.
+	int first = CTRangeSetFirstEndingAfter(s, index);
+	for (int i = first; i < s->count; ++i) {
+		s->ranges[i].start -= count;
+		s->ranges[i].end -= count;
+	}
+	// The ranges on either side of the removed slots may touch now.
+	if (first > 0 && first < s->count &&
+	    s->ranges[first - 1].end == s->ranges[first].start) {
+		CTRange merged = { s->ranges[first - 1].start, s->ranges[first].end };
+		CTRangeSetSplice(s, first - 1, first + 1, &merged, 1);
+	}
+}
+
+void CTRangeSetMoveSlot(CTRangeSet* s, int from, int to) {
+	if (from == to)
+		return;
+	bool contained = CTRangeSetContains(s, from);
+	CTRangeSetRemoveSlots(s, from, 1);
+	CTRangeSetInsertSlots(s, to, 1);
+	if (contained)
+		CTRangeSetAdd(s, to, to + 1);
+}
+
+void CTRangeSetRemoveMarked(CTRangeSet* s, const CTBitVector* marked) {
+	// Walk the set bits along with the ranges, counting the marked slots
+	// before each range and inside it. Ranges only shrink and move down, so
+	// they can be compacted in place.
+	size_t bit = CTBitVectorNextSet(marked, 0);
+	int removedBefore = 0;
+	int count = 0;
+	s->size = 0;
+	for (int i = 0; i < s->count; ++i) {
+		CTRange range = s->ranges[i];
+		assert((size_t)range.end <= marked->count);
+		while (bit < (size_t)range.start) {
+			++removedBefore;
+			bit = CTBitVectorNextSet(marked, bit + 1);
+		}
+		int removedInside = 0;
+		while (bit < (size_t)range.end) {
+			++removedInside;
+			bit = CTBitVectorNextSet(marked, bit + 1);
+		}
+		int start = range.start - removedBefore;
+		int end = range.end - removedBefore - removedInside;
+		removedBefore += removedInside;
+		if (start == end)
+			continue;
+		if (count && s->ranges[count - 1].end == start) {
+			s->ranges[count - 1].end = end;
+		} else {
+			s->ranges[count].start = start;
+			s->ranges[count++].end = end;
+		}
+		s->size += end - start;
+	}
+	s->count = count;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_RANGE_SET_H_
+#define CT_RANGE_SET_H_
+#pragma once
+
+#include <stdbool.h>
+#include "CTBitVector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A set of indices stored as sorted, disjoint, non-adjacent ranges. Used for
+// the tab selection, which is usually one run of tabs however long it is:
+// Shift-clicking across 500 tabs stores a single range.
+//
+// Like CTBitVector, slots can be inserted and removed in the middle, which
+// shifts the indices after them, so the set can follow the tabs it is about.
+// Costs are in the number of ranges, not the number of indices.
+typedef struct {
+	int start;  // first index in the range
+	int end;    // one past the last
+} CTRange;
+
+typedef struct {
+	CTRange* ranges;
+	int count;     // number of ranges in use
+	int capacity;  // number of ranges allocated
+	int size;      // number of indices in the set
+} CTRangeSet;
+
+// Initializes |s| to an empty set. Must be balanced with CTRangeSetFree.
+void CTRangeSetInit(CTRangeSet* s);
+void CTRangeSetFree(CTRangeSet* s);
+
+void CTRangeSetClear(CTRangeSet* s);
+
+// Returns whether |index| is in |s|. O(log ranges).
+bool CTRangeSetContains(const CTRangeSet* s, int index);
+
+// Adds or removes the indices from |start| up to, but not including, |end|.
+void CTRangeSetAdd(CTRangeSet* s, int start, int end);
+void CTRangeSetRemove(CTRangeSet* s, int start, int end);
+
+// Returns the first index in |s| at or after |index|, or -1.
+int CTRangeSetNext(const CTRangeSet* s, int index);
+// Returns the last index in |s| at or before |index|, or -1.
+int CTRangeSetPrevious(const CTRangeSet* s, int index);
+
+// Inserts |count| slots that aren't in the set at |index|, shifting the
+// indices at and after |index| up by |count|. A range |index| falls into is
+// split in two.
+void CTRangeSetInsertSlots(CTRangeSet* s, int index, int count);
+
+// Removes the slots from |index| up to |index| + |count|, shifting the
+// indices after them down by |count|.
+void CTRangeSetRemoveSlots(CTRangeSet* s, int index, int count);
+
+// Moves the slot at |from| to |to|, as if it was removed and then inserted.
+void CTRangeSetMoveSlot(CTRangeSet* s, int from, int to);
+
+// Removes every slot whose bit is set in |marked|, in one pass over the
+// ranges and the set bits.
+void CTRangeSetRemoveMarked(CTRangeSet* s, const CTBitVector* marked);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CT_RANGE_SET_H_
@@ -0,0 +1,409 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTSessionJournal.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t CTSessionJournalChecksum(const CTSessionJournalRecord* record,
+                                         const void* payload) {
+	uint32_t hash = 2166136261u;
+	const uint8_t* bytes = (const uint8_t*)record + sizeof(record->checksum);
+	for (size_t i = 0; i < sizeof(*record) - sizeof(record->checksum); ++i)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	bytes = (const uint8_t*)payload;
+	for (uint32_t i = 0; i < record->payloadLength; ++i)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+void CTSessionJournalInitHeader(CTSessionJournalHeader* header, uint32_t epoch) {
+	header->magic = CT_SESSION_JOURNAL_MAGIC;
+	header->version = CT_SESSION_JOURNAL_VERSION;
+	header->headerSize = sizeof(CTSessionJournalHeader);
+	header->epoch = epoch;
+}
+
+void CTSessionJournalEncodeRecord(void* buffer,
+                                  CTSessionJournalRecordType type,
+                                  uint32_t window,
+                                  int32_t index,
+                                  int32_t argument,
+                                  uint32_t flags,
+                                  const void* payload,
+                                  uint32_t payloadLength) {
+	CTSessionJournalRecord* record = (CTSessionJournalRecord*)buffer;
+	record->type = (uint16_t)type;
+	record->reserved = 0;
+	record->window = window;
+	record->index = index;
+	record->argument = argument;
+	record->flags = flags;
+	record->payloadLength = payloadLength;
+	uint8_t* out = (uint8_t*)(record + 1);
+	if (payloadLength)
+		memcpy(out, payload, payloadLength);
+	memset(out + payloadLength, 0,
+	       CTSessionJournalRecordSize(payloadLength) - sizeof(*record) -
+	       payloadLength);
+	record->checksum = CTSessionJournalChecksum(record, out);
+}
+
+// State -----------------------------------------------------------------------
+
+typedef struct {
+	// Identifies the tab for as long as the state lives, so opener links
+	// survive tabs moving around.
+	uint32_t key;
+	// The key of the opener, or 0.
+	uint32_t opener;
+	uint32_t flags;
+	uint32_t titleLength;
+	char* title;
+} CTSessionTab;
+
+typedef struct {
+	uint32_t identifier;
+	int32_t activeIndex;
+	uint32_t count;
+	uint32_t capacity;
+	CTSessionTab* tabs;
+} CTSessionWindow;
+
+struct CTSessionState {
+	CTSessionWindow* windows;
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t nextKey;
+	// Scratch space for replaying reorders, kept across records.
+	void* scratch;
+	size_t scratchSize;
+};
+
+static char* CTSessionCopyTitle(const void* title, uint32_t length) {
+	char* copy = (char*)malloc(length ? length : 1);
+	assert(copy);
+	if (length)
+		memcpy(copy, title, length);
+	return copy;
+}
+
+static CTSessionWindow* CTSessionStateFindWindow(const CTSessionState* state,
+                                                 uint32_t identifier) {
+	for (uint32_t i = 0; i < state->count; ++i) {
+		if (state->windows[i].identifier == identifier)
+			return &state->windows[i];
+	}
+	return NULL;
+}
+
+static CTSessionWindow* CTSessionStateAddWindow(CTSessionState* state,
+                                                uint32_t identifier) {
+	if (state->count == state->capacity) {
+		state->capacity = state->capacity ? state->capacity * 2 : 4;
+		state->windows = (CTSessionWindow*)realloc(
+			state->windows, state->capacity * sizeof(CTSessionWindow));
+		assert(state->windows);
+	}
+	CTSessionWindow* window = &state->windows[state->count++];
+	memset(window, 0, sizeof(*window));
+	window->identifier = identifier;
+	window->activeIndex = -1;
+	return window;
+}
+
+static void CTSessionWindowReserve(CTSessionWindow* window, uint32_t count) {
+	if (count <= window->capacity)
+		return;
+	uint32_t capacity = window->capacity ? window->capacity * 2 : 16;
+	while (capacity < count)
+		capacity *= 2;
+	window->tabs = (CTSessionTab*)realloc(window->tabs,
+	                                      capacity * sizeof(CTSessionTab));
+	assert(window->tabs);
+	window->capacity = capacity;
+}
+
+// Returns the state's scratch space, grown to at least |size| bytes.
+static void* CTSessionStateReserveScratch(CTSessionState* state, size_t size) {
+	if (state->scratch && size <= state->scratchSize)
+		return state->scratch;
+	size_t scratchSize = state->scratchSize ? state->scratchSize * 2 : 256;
+	while (scratchSize < size)
+		scratchSize *= 2;
+	free(state->scratch);
+	state->scratch = malloc(scratchSize);
+	assert(state->scratch);
+	state->scratchSize = scratchSize;
+	return state->scratch;
+}
+
+static void CTSessionWindowFree(CTSessionWindow* window) {
+	for (uint32_t i = 0; i < window->count; ++i)
+		free(window->tabs[i].title);
+	free(window->tabs);
+}
+
+CTSessionState* CTSessionStateCreate(const CTSessionSnapshot* snapshot) {
+	CTSessionState* state = (CTSessionState*)calloc(1, sizeof(CTSessionState));
+	assert(state);
+	state->nextKey = 1;
+	if (!snapshot)
+		return state;
+
+	uint32_t windowCount = CTSessionSnapshotWindowCount(snapshot);
+	for (uint32_t w = 0; w < windowCount; ++w) {
+		const CTSessionSnapshotWindowRecord* windowRecord =
+			CTSessionSnapshotGetWindow(snapshot, w);
+		CTSessionWindow* window = CTSessionStateAddWindow(state, w);
+		CTSessionWindowReserve(window, windowRecord->tabCount);
+		// Keys of the snapshot's tabs by their index in it, for the openers.
+		uint32_t firstKey = state->nextKey;
+		state->nextKey += windowRecord->tabCount;
+		for (uint32_t i = 0; i < windowRecord->tabCount; ++i) {
+			const CTSessionSnapshotTabRecord* record;
+			const char* title;
+			if (!CTSessionSnapshotGetTab(snapshot, w, i, &record, &title))
+				continue;
+			if ((int32_t)i == windowRecord->activeIndex)
+				window->activeIndex = (int32_t)window->count;
+			CTSessionTab* tab = &window->tabs[window->count++];
+			tab->key = firstKey + i;
+			tab->opener = record->opener >= 0 ? firstKey + record->opener : 0;
+			tab->flags = record->flags;
+			tab->titleLength = record->titleLength;
+			tab->title = CTSessionCopyTitle(title, record->titleLength);
+		}
+	}
+	return state;
+}
+
+void CTSessionStateFree(CTSessionState* state) {
+	if (!state)
+		return;
+	for (uint32_t i = 0; i < state->count; ++i)
+		CTSessionWindowFree(&state->windows[i]);
+	free(state->windows);
+	free(state->scratch);
+	free(state);
+}
+
+bool CTSessionStateApplyRecord(CTSessionState* state,
+                               const CTSessionJournalRecord* record,
+                               const void* payload) {
+	if (record->type == kCTSessionJournalOpenWindow) {
+		if (CTSessionStateFindWindow(state, record->window))
+			return false;
+		CTSessionStateAddWindow(state, record->window);
+		return true;
+	}
+
+	CTSessionWindow* window = CTSessionStateFindWindow(state, record->window);
+	if (!window)
+		return false;
+	// Indices are int32_t, so a window can't have more tabs than that.
+	if (window->count > INT32_MAX)
+		return false;
+	int32_t count = (int32_t)window->count;
+	int32_t index = record->index;
+	int32_t argument = record->argument;
+	switch (record->type) {
+		case kCTSessionJournalCloseWindow: {
+			CTSessionWindowFree(window);
+			uint32_t position = (uint32_t)(window - state->windows);
+			memmove(window, window + 1,
+			        (state->count - position - 1) * sizeof(CTSessionWindow));
+			state->count--;
+			return true;
+		}
+		case kCTSessionJournalInsert: {
+			if (index < 0 || index > count || argument < -1 || argument > count ||
+				count == INT32_MAX)
+				return false;
+			CTSessionWindowReserve(window, window->count + 1);
+			memmove(&window->tabs[index + 1], &window->tabs[index],
+			        (count - index) * sizeof(CTSessionTab));
+			window->count++;
+			CTSessionTab* tab = &window->tabs[index];
+			tab->key = state->nextKey++;
+			tab->flags = record->flags;
+			tab->titleLength = record->payloadLength;
+			tab->title = CTSessionCopyTitle(payload, record->payloadLength);
+			tab->opener = argument >= 0 && argument != index ?
+				window->tabs[argument].key : 0;
+			if (window->activeIndex >= index)
+				window->activeIndex++;
+			return true;
+		}
+		case kCTSessionJournalDetach: {
+			if (index < 0 || argument < 1 || argument > count - index)
+				return false;
+			for (int32_t i = index; i < index + argument; ++i)
+				free(window->tabs[i].title);
+			memmove(&window->tabs[index], &window->tabs[index + argument],
+			        (count - index - argument) * sizeof(CTSessionTab));
+			window->count -= argument;
+			// A Select record follows if the active tab was removed.
+			if (window->activeIndex >= index + argument)
+				window->activeIndex -= argument;
+			else if (window->activeIndex >= index)
+				window->activeIndex = -1;
+			return true;
+		}
+		case kCTSessionJournalMove: {
+			if (index < 0 || index >= count || argument < 0 || argument >= count)
+				return false;
+			CTSessionTab moved = window->tabs[index];
+			if (index < argument) {
+				memmove(&window->tabs[index], &window->tabs[index + 1],
+				        (argument - index) * sizeof(CTSessionTab));
+			} else {
+				memmove(&window->tabs[argument + 1], &window->tabs[argument],
+				        (index - argument) * sizeof(CTSessionTab));
+			}
+			window->tabs[argument] = moved;
+			int32_t active = window->activeIndex;
+			if (active == index)
+				window->activeIndex = argument;
+			else if (index < active && active <= argument)
+				window->activeIndex--;
+			else if (argument <= active && active < index)
+				window->activeIndex++;
+			return true;
+		}
+		case kCTSessionJournalReorder: {
+			size_t tabCount = window->count;
+			if (argument != count ||
+				record->payloadLength != tabCount * sizeof(int32_t))
+				return false;
+			const int32_t* permutation = (const int32_t*)payload;
+			// The reordered tabs, followed by a byte per tab to check it really
+			// is a permutation before touching anything.
+			CTSessionTab* tabs = (CTSessionTab*)CTSessionStateReserveScratch(
+				state, tabCount * (sizeof(CTSessionTab) + 1));
+			uint8_t* seen = (uint8_t*)(tabs + tabCount);
+			memset(seen, 0, tabCount);
+			for (int32_t i = 0; i < count; ++i) {
+				int32_t from = permutation[i];
+				if (from < 0 || from >= count || seen[from])
+					return false;
+				seen[from] = 1;
+			}
+			int32_t active = -1;
+			for (int32_t i = 0; i < count; ++i) {
+				tabs[i] = window->tabs[permutation[i]];
+				if (permutation[i] == window->activeIndex)
+					active = i;
+			}
+			if (tabCount)
+				memcpy(window->tabs, tabs, tabCount * sizeof(CTSessionTab));
+			window->activeIndex = active;
+			return true;
+		}
+		case kCTSessionJournalReplace:
+		case kCTSessionJournalSetTitle: {
+			if (index < 0 || index >= count)
+				return false;
+			CTSessionTab* tab = &window->tabs[index];
+			free(tab->title);
+			tab->titleLength = record->payloadLength;
+			tab->title = CTSessionCopyTitle(payload, record->payloadLength);
+			return true;
+		}
+		case kCTSessionJournalSetFlags:
+			if (index < 0 || index >= count)
+				return false;
+			window->tabs[index].flags = record->flags;
+			return true;
+		case kCTSessionJournalSelect:
+			if (index < -1 || index >= count)
+				return false;
+			window->activeIndex = index;
+			return true;
+		default:
+			return false;
+	}
+}
+
+size_t CTSessionStateApplyJournal(CTSessionState* state,
+                                  const void* bytes,
+                                  size_t size,
+                                  uint32_t epoch) {
+	const CTSessionJournalHeader* header = (const CTSessionJournalHeader*)bytes;
+	if (!bytes || ((uintptr_t)bytes & 3) || size < sizeof(*header) ||
+		header->magic != CT_SESSION_JOURNAL_MAGIC ||
+		header->version != CT_SESSION_JOURNAL_VERSION ||
+		header->headerSize != sizeof(*header) ||
+		header->epoch != epoch)
+		return 0;
+
+	const uint8_t* cursor = (const uint8_t*)bytes + sizeof(*header);
+	const uint8_t* end = (const uint8_t*)bytes + size;
+	size_t applied = 0;
+	while ((size_t)(end - cursor) >= sizeof(CTSessionJournalRecord)) {
+		const CTSessionJournalRecord* record = (const CTSessionJournalRecord*)cursor;
+		if (record->payloadLength > (size_t)(end - cursor) ||
+			CTSessionJournalRecordSize(record->payloadLength) >
+				(size_t)(end - cursor))
+			break;  // torn
+		const void* payload = record + 1;
+		if (record->checksum != CTSessionJournalChecksum(record, payload))
+			break;
+		if (!CTSessionStateApplyRecord(state, record, payload))
+			break;
+		++applied;
+		cursor += CTSessionJournalRecordSize(record->payloadLength);
+	}
+	return applied;
+}
+
+// Snapshot --------------------------------------------------------------------
+
+typedef struct {
+	uint32_t key;
+	int32_t index;
+} CTSessionKeyIndex;
+
+static int CTSessionCompareKeys(const void* a, const void* b) {
+	uint32_t left = ((const CTSessionKeyIndex*)a)->key;
+	uint32_t right = ((const CTSessionKeyIndex*)b)->key;
+	return left < right ? -1 : left > right;
+}
+
+CTSessionSnapshotWriter* CTSessionStateCreateSnapshotWriter(
+		const CTSessionState* state, uint32_t epoch) {
+	CTSessionSnapshotWriter* writer = CTSessionSnapshotWriterCreate();
+	CTSessionSnapshotWriterSetEpoch(writer, epoch);
+	for (uint32_t w = 0; w < state->count; ++w) {
+		const CTSessionWindow* window = &state->windows[w];
+		// Openers are stored by key; the snapshot wants indices.
+		CTSessionKeyIndex* keys = (CTSessionKeyIndex*)malloc(
+			(window->count ? window->count : 1) * sizeof(CTSessionKeyIndex));
+		assert(keys);
+		for (uint32_t i = 0; i < window->count; ++i) {
+			keys[i].key = window->tabs[i].key;
+			keys[i].index = (int32_t)i;
+		}
+		qsort(keys, window->count, sizeof(CTSessionKeyIndex), CTSessionCompareKeys);
+
+		CTSessionSnapshotWriterBeginWindow(writer, window->activeIndex);
+		for (uint32_t i = 0; i < window->count; ++i) {
+			const CTSessionTab* tab = &window->tabs[i];
+			int32_t opener = -1;
+			if (tab->opener) {
+				CTSessionKeyIndex wanted = { tab->opener, 0 };
+				const CTSessionKeyIndex* found = (const CTSessionKeyIndex*)bsearch(
+					&wanted, keys, window->count, sizeof(CTSessionKeyIndex),
+					CTSessionCompareKeys);
+				if (found)
+					opener = found->index;
+			}
+			CTSessionSnapshotWriterAddTab(writer, tab->flags, opener, tab->title,
+			                              tab->titleLength);
+		}
+		free(keys);
+	}
+	return writer;
+}
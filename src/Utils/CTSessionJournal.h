@@ -0,0 +1,137 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_SESSION_JOURNAL_H_
+#define CT_SESSION_JOURNAL_H_
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "CTSessionSnapshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An append-only log of tab strip mutations that is replayed on top of a
+// session snapshot (see CTSessionSnapshot.h).
+//
+// A journal file starts with a CTSessionJournalHeader and is followed by
+// records, each a CTSessionJournalRecord and |payloadLength| bytes of
+// payload padded to a multiple of four. Every record carries a checksum, so a
+// record torn by a crash in the middle of a write ends the replay instead of
+// corrupting it.
+//
+// Compacting writes a new snapshot with the next epoch and then starts a new
+// journal with that epoch. A journal whose epoch is not the snapshot's is
+// ignored: if the crash came between the two steps, the snapshot already has
+// everything the old journal did.
+//
+// Tabs are addressed by window and index as they were when the record was
+// written. Windows are numbered by whoever writes the journal; the windows
+// of a snapshot are numbered 0, 1, ... in the order they are stored.
+
+#define CT_SESSION_JOURNAL_MAGIC 0x4a535443  // "CTSJ"
+#define CT_SESSION_JOURNAL_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize;
+	uint32_t epoch;
+} CTSessionJournalHeader;
+
+typedef enum {
+	// A window with no tabs was opened.
+	kCTSessionJournalOpenWindow = 1,
+	// The window was closed along with any tabs left in it.
+	kCTSessionJournalCloseWindow,
+	// A tab was inserted at |index| with |flags|. |argument| is the index of
+	// its opener after the insertion, or -1. The payload is its title.
+	kCTSessionJournalInsert,
+	// |argument| tabs starting at |index| were removed.
+	kCTSessionJournalDetach,
+	// The tab at |index| was moved to |argument|.
+	kCTSessionJournalMove,
+	// All |argument| tabs were reordered. The payload is an int32_t per tab,
+	// the index each tab now at that position had before.
+	kCTSessionJournalReorder,
+	// The tab at |index| was replaced. The payload is the new title.
+	kCTSessionJournalReplace,
+	// The flags of the tab at |index| are now |flags|.
+	kCTSessionJournalSetFlags,
+	// The title of the tab at |index| is now the payload.
+	kCTSessionJournalSetTitle,
+	// The tab at |index| became active.
+	kCTSessionJournalSelect,
+} CTSessionJournalRecordType;
+
+typedef struct {
+	// FNV-1a over the rest of the record and its payload.
+	uint32_t checksum;
+	uint16_t type;
+	uint16_t reserved;
+	uint32_t window;
+	int32_t index;
+	int32_t argument;
+	uint32_t flags;
+	uint32_t payloadLength;
+} CTSessionJournalRecord;
+
+// Fills in a header for a journal of |epoch|.
+void CTSessionJournalInitHeader(CTSessionJournalHeader* header, uint32_t epoch);
+
+// The number of bytes a record with |payloadLength| bytes of payload takes.
+static inline size_t CTSessionJournalRecordSize(size_t payloadLength) {
+	return sizeof(CTSessionJournalRecord) + ((payloadLength + 3) & ~(size_t)3);
+}
+
+// Encodes a record into |buffer|, which must have room for
+// CTSessionJournalRecordSize(payloadLength) bytes.
+void CTSessionJournalEncodeRecord(void* buffer,
+                                  CTSessionJournalRecordType type,
+                                  uint32_t window,
+                                  int32_t index,
+                                  int32_t argument,
+                                  uint32_t flags,
+                                  const void* payload,
+                                  uint32_t payloadLength);
+
+// Replay ----------------------------------------------------------------------
+
+// The tab strips of a session, as plain data that journals can be replayed
+// onto.
+typedef struct CTSessionState CTSessionState;
+
+// Creates the state a snapshot describes, or an empty one if |snapshot| is
+// NULL. Damaged tab records of the snapshot are left out.
+CTSessionState* CTSessionStateCreate(const CTSessionSnapshot* snapshot);
+void CTSessionStateFree(CTSessionState* state);
+
+// Applies the records of the journal in the |size| bytes at |bytes|, if its
+// epoch is |epoch|. Stops at the end, at a torn or damaged record, or at a
+// record that does not apply to the state. Returns the number of records
+// applied.
+size_t CTSessionStateApplyJournal(CTSessionState* state,
+                                  const void* bytes,
+                                  size_t size,
+                                  uint32_t epoch);
+
+// Applies a single record. Returns false, leaving the state alone, if the
+// record does not apply to it.
+bool CTSessionStateApplyRecord(CTSessionState* state,
+                               const CTSessionJournalRecord* record,
+                               const void* payload);
+
+// Creates a writer for a snapshot of |state| with |epoch|. The windows are
+// written in the order they were opened.
+CTSessionSnapshotWriter* CTSessionStateCreateSnapshotWriter(
+		const CTSessionState* state, uint32_t epoch);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CT_SESSION_JOURNAL_H_
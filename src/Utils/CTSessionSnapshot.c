@@ -0,0 +1,239 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTSessionSnapshot.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The records are read and written in host byte order; every platform this
+// builds for is little-endian.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "CTSessionSnapshot assumes a little-endian host"
+#endif
+
+// A growable byte buffer.
+typedef struct {
+	uint8_t* data;
+	size_t size;
+	size_t capacity;
+} CTSessionBuffer;
+
+static void CTSessionBufferAppend(CTSessionBuffer* buffer,
+                                  const void* bytes,
+                                  size_t length) {
+	if (buffer->size + length > buffer->capacity) {
+		size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+		while (capacity < buffer->size + length)
+			capacity *= 2;
+		buffer->data = (uint8_t*)realloc(buffer->data, capacity);
+		assert(buffer->data);
+		buffer->capacity = capacity;
+	}
+	if (length)
+		memcpy(buffer->data + buffer->size, bytes, length);
+	buffer->size += length;
+}
+
+struct CTSessionSnapshotWriter {
+	CTSessionBuffer windows;
+	CTSessionBuffer tabs;
+	CTSessionBuffer strings;
+	uint32_t windowCount;
+	uint32_t tabCount;
+	uint32_t epoch;
+};
+
+CTSessionSnapshotWriter* CTSessionSnapshotWriterCreate(void) {
+	CTSessionSnapshotWriter* writer =
+		(CTSessionSnapshotWriter*)calloc(1, sizeof(CTSessionSnapshotWriter));
+	assert(writer);
+	return writer;
+}
+
+void CTSessionSnapshotWriterFree(CTSessionSnapshotWriter* writer) {
+	if (!writer)
+		return;
+	free(writer->windows.data);
+	free(writer->tabs.data);
+	free(writer->strings.data);
+	free(writer);
+}
+
+void CTSessionSnapshotWriterSetEpoch(CTSessionSnapshotWriter* writer,
+                                     uint32_t epoch) {
+	writer->epoch = epoch;
+}
+
+void CTSessionSnapshotWriterBeginWindow(CTSessionSnapshotWriter* writer,
+                                        int32_t activeIndex) {
+	CTSessionSnapshotWindowRecord record = {
+		.firstTab = writer->tabCount,
+		.tabCount = 0,
+		.activeIndex = activeIndex,
+	};
+	CTSessionBufferAppend(&writer->windows, &record, sizeof(record));
+	writer->windowCount++;
+}
+
+void CTSessionSnapshotWriterAddTab(CTSessionSnapshotWriter* writer,
+                                   uint32_t flags,
+                                   int32_t opener,
+                                   const char* title,
+                                   size_t titleLength) {
+	assert(writer->windowCount);
+	CTSessionSnapshotTabRecord record = {
+		.flags = flags,
+		.opener = opener,
+		.titleOffset = (uint32_t)writer->strings.size,
+		.titleLength = (uint32_t)titleLength,
+	};
+	CTSessionBufferAppend(&writer->tabs, &record, sizeof(record));
+	CTSessionBufferAppend(&writer->strings, title, titleLength);
+	writer->tabCount++;
+	CTSessionSnapshotWindowRecord* window =
+		(CTSessionSnapshotWindowRecord*)writer->windows.data +
+		(writer->windowCount - 1);
+	window->tabCount++;
+}
+
+static CTSessionSnapshotHeader CTSessionSnapshotWriterHeader(
+		const CTSessionSnapshotWriter* writer) {
+	CTSessionSnapshotHeader header = {
+		.magic = CT_SESSION_SNAPSHOT_MAGIC,
+		.version = CT_SESSION_SNAPSHOT_VERSION,
+		.headerSize = sizeof(CTSessionSnapshotHeader),
+		.windowCount = writer->windowCount,
+		.tabCount = writer->tabCount,
+		.stringsSize = (uint32_t)writer->strings.size,
+		.epoch = writer->epoch,
+	};
+	return header;
+}
+
+size_t CTSessionSnapshotWriterSize(const CTSessionSnapshotWriter* writer) {
+	return sizeof(CTSessionSnapshotHeader) + writer->windows.size +
+		writer->tabs.size + writer->strings.size;
+}
+
+void CTSessionSnapshotWriterCopyBytes(const CTSessionSnapshotWriter* writer,
+                                      void* buffer) {
+	CTSessionSnapshotHeader header = CTSessionSnapshotWriterHeader(writer);
+	uint8_t* out = (uint8_t*)buffer;
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	if (writer->windows.size)
+		memcpy(out, writer->windows.data, writer->windows.size);
+	out += writer->windows.size;
+	if (writer->tabs.size)
+		memcpy(out, writer->tabs.data, writer->tabs.size);
+	out += writer->tabs.size;
+	if (writer->strings.size)
+		memcpy(out, writer->strings.data, writer->strings.size);
+}
+
+bool CTSessionSnapshotWriterWriteToFile(const CTSessionSnapshotWriter* writer,
+                                        const char* path) {
+	size_t pathLength = strlen(path);
+	char* temporaryPath = (char*)malloc(pathLength + 5);
+	assert(temporaryPath);
+	memcpy(temporaryPath, path, pathLength);
+	memcpy(temporaryPath + pathLength, ".tmp", 5);
+
+	CTSessionSnapshotHeader header = CTSessionSnapshotWriterHeader(writer);
+	bool ok = false;
+	FILE* file = fopen(temporaryPath, "wb");
+	if (file) {
+		ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(writer->windows.data, 1, writer->windows.size, file) ==
+				writer->windows.size &&
+			fwrite(writer->tabs.data, 1, writer->tabs.size, file) ==
+				writer->tabs.size &&
+			fwrite(writer->strings.data, 1, writer->strings.size, file) ==
+				writer->strings.size &&
+			fflush(file) == 0 &&
+			fsync(fileno(file)) == 0;
+		ok = fclose(file) == 0 && ok;
+	}
+	if (ok)
+		ok = rename(temporaryPath, path) == 0;
+	if (!ok)
+		unlink(temporaryPath);
+	free(temporaryPath);
+	return ok;
+}
+
+bool CTSessionSnapshotInit(CTSessionSnapshot* snapshot,
+                           const void* bytes,
+                           size_t size) {
+	memset(snapshot, 0, sizeof(*snapshot));
+	// The records are read in place, so they have to be aligned.
+	if (!bytes || ((uintptr_t)bytes & 3) ||
+		size < sizeof(CTSessionSnapshotHeader))
+		return false;
+	const CTSessionSnapshotHeader* header = (const CTSessionSnapshotHeader*)bytes;
+	if (header->magic != CT_SESSION_SNAPSHOT_MAGIC ||
+		header->version != CT_SESSION_SNAPSHOT_VERSION ||
+		header->headerSize != sizeof(CTSessionSnapshotHeader))
+		return false;
+
+	// 64-bit arithmetic so the counts can't overflow the checks.
+	uint64_t windowsSize =
+		(uint64_t)header->windowCount * sizeof(CTSessionSnapshotWindowRecord);
+	uint64_t tabsSize =
+		(uint64_t)header->tabCount * sizeof(CTSessionSnapshotTabRecord);
+	uint64_t expected = sizeof(CTSessionSnapshotHeader) + windowsSize +
+		tabsSize + header->stringsSize;
+	if (expected != size)
+		return false;
+
+	const uint8_t* base = (const uint8_t*)bytes;
+	const CTSessionSnapshotWindowRecord* windows =
+		(const CTSessionSnapshotWindowRecord*)(base + sizeof(CTSessionSnapshotHeader));
+	for (uint32_t i = 0; i < header->windowCount; ++i) {
+		const CTSessionSnapshotWindowRecord* window = &windows[i];
+		if ((uint64_t)window->firstTab + window->tabCount > header->tabCount)
+			return false;
+		if (window->activeIndex < -1 ||
+			(window->activeIndex >= 0 &&
+			 (uint32_t)window->activeIndex >= window->tabCount))
+			return false;
+	}
+
+	snapshot->bytes = base;
+	snapshot->size = size;
+	snapshot->header = header;
+	snapshot->windows = windows;
+	snapshot->tabs = (const CTSessionSnapshotTabRecord*)
+		(base + sizeof(CTSessionSnapshotHeader) + windowsSize);
+	snapshot->strings = base + sizeof(CTSessionSnapshotHeader) + windowsSize +
+		tabsSize;
+	return true;
+}
+
+bool CTSessionSnapshotGetTab(const CTSessionSnapshot* snapshot,
+                             uint32_t window,
+                             uint32_t index,
+                             const CTSessionSnapshotTabRecord** record,
+                             const char** title) {
+	if (window >= snapshot->header->windowCount)
+		return false;
+	const CTSessionSnapshotWindowRecord* windowRecord = &snapshot->windows[window];
+	if (index >= windowRecord->tabCount)
+		return false;
+	const CTSessionSnapshotTabRecord* tab =
+		&snapshot->tabs[windowRecord->firstTab + index];
+	if ((uint64_t)tab->titleOffset + tab->titleLength >
+		snapshot->header->stringsSize)
+		return false;
+	if (tab->opener < -1 ||
+		(tab->opener >= 0 && (uint32_t)tab->opener >= windowRecord->tabCount))
+		return false;
+	*record = tab;
+	*title = (const char*)snapshot->strings + tab->titleOffset;
+	return true;
+}
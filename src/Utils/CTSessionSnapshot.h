@@ -0,0 +1,148 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_SESSION_SNAPSHOT_H_
+#define CT_SESSION_SNAPSHOT_H_
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A compact, versioned binary snapshot of the tab strips of a session.
+//
+// The format is laid out so it can be used straight from a memory mapping:
+// after a fixed header come one fixed-size record per window, one fixed-size
+// record per tab (all the windows' tabs back to back), and finally the UTF-8
+// titles the tab records point into. Reading the records of a tab touches
+// only those bytes, so restoring a window's visible tabs costs the same no
+// matter how many tabs the snapshot holds. All integers are little-endian.
+//
+//   header    CTSessionSnapshotHeader
+//   windows   CTSessionSnapshotWindowRecord[windowCount]
+//   tabs      CTSessionSnapshotTabRecord[tabCount]
+//   strings   uint8_t[stringsSize]
+
+#define CT_SESSION_SNAPSHOT_MAGIC 0x53535443  // "CTSS"
+#define CT_SESSION_SNAPSHOT_VERSION 1
+
+// Per-tab flags. Mini-tabs are not stored; a tab is mini if it is pinned or
+// an app.
+enum {
+	kCTSessionTabPinned  = 1 << 0,
+	kCTSessionTabApp     = 1 << 1,
+	kCTSessionTabBlocked = 1 << 2,
+};
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize;  // sizeof(CTSessionSnapshotHeader) in this version
+	uint32_t windowCount;
+	uint32_t tabCount;
+	uint32_t stringsSize;
+	// Which session journal the snapshot was compacted from. A journal only
+	// applies on top of the snapshot with the same epoch; see
+	// CTSessionJournal.h.
+	uint32_t epoch;
+} CTSessionSnapshotHeader;
+
+typedef struct {
+	uint32_t firstTab;     // index of the window's first tab record
+	uint32_t tabCount;
+	int32_t activeIndex;   // -1 if no tab was active
+	uint32_t reserved;
+} CTSessionSnapshotWindowRecord;
+
+typedef struct {
+	uint32_t flags;
+	int32_t opener;        // index of the opener in the same window, or -1
+	uint32_t titleOffset;  // into the strings
+	uint32_t titleLength;  // in bytes, not NUL terminated
+} CTSessionSnapshotTabRecord;
+
+// Writing ---------------------------------------------------------------------
+
+typedef struct CTSessionSnapshotWriter CTSessionSnapshotWriter;
+
+CTSessionSnapshotWriter* CTSessionSnapshotWriterCreate(void);
+void CTSessionSnapshotWriterFree(CTSessionSnapshotWriter* writer);
+
+// Sets the epoch written to the header. Zero by default.
+void CTSessionSnapshotWriterSetEpoch(CTSessionSnapshotWriter* writer,
+                                     uint32_t epoch);
+
+// Starts a new window. The tabs added after this belong to it.
+void CTSessionSnapshotWriterBeginWindow(CTSessionSnapshotWriter* writer,
+                                        int32_t activeIndex);
+
+// Adds a tab to the current window. |opener| is the index of its opener in
+// the window, or -1.
+void CTSessionSnapshotWriterAddTab(CTSessionSnapshotWriter* writer,
+                                   uint32_t flags,
+                                   int32_t opener,
+                                   const char* title,
+                                   size_t titleLength);
+
+// The size of the snapshot, and a copy of it into |buffer|, which must be at
+// least that large.
+size_t CTSessionSnapshotWriterSize(const CTSessionSnapshotWriter* writer);
+void CTSessionSnapshotWriterCopyBytes(const CTSessionSnapshotWriter* writer,
+                                      void* buffer);
+
+// Writes the snapshot to |path| atomically: it goes to a temporary file next
+// to |path| which is synced and then renamed over it. Returns false on
+// failure, leaving any previous snapshot at |path| in place.
+bool CTSessionSnapshotWriterWriteToFile(const CTSessionSnapshotWriter* writer,
+                                        const char* path);
+
+// Reading ---------------------------------------------------------------------
+
+// A validated view of snapshot bytes. It does not own them; they must stay
+// around (and unchanged) for as long as the view is used.
+typedef struct {
+	const uint8_t* bytes;
+	size_t size;
+	const CTSessionSnapshotHeader* header;
+	const CTSessionSnapshotWindowRecord* windows;
+	const CTSessionSnapshotTabRecord* tabs;
+	const uint8_t* strings;
+} CTSessionSnapshot;
+
+// Checks the header and the window records of |size| bytes at |bytes| and
+// sets up |snapshot| to read them. Tab records are only checked as they are
+// read. Returns false if the bytes are not a snapshot this version can read.
+bool CTSessionSnapshotInit(CTSessionSnapshot* snapshot,
+                           const void* bytes,
+                           size_t size);
+
+static inline uint32_t CTSessionSnapshotWindowCount(
+		const CTSessionSnapshot* snapshot) {
+	return snapshot->header->windowCount;
+}
+
+// Returns the record of |window|, which must be < the window count.
+static inline const CTSessionSnapshotWindowRecord* CTSessionSnapshotGetWindow(
+		const CTSessionSnapshot* snapshot, uint32_t window) {
+	return &snapshot->windows[window];
+}
+
+// Looks up tab |index| of |window|. On success sets |record|, and |title| to
+// the title bytes inside the snapshot, and returns true. Returns false if the
+// tab does not exist or its record is damaged.
+bool CTSessionSnapshotGetTab(const CTSessionSnapshot* snapshot,
+                             uint32_t window,
+                             uint32_t index,
+                             const CTSessionSnapshotTabRecord** record,
+                             const char** title);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CT_SESSION_SNAPSHOT_H_
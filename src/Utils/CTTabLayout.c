@@ -0,0 +1,284 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTTabLayout.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void CTTabLayoutStateInit(CTTabLayoutState* state) {
+	memset(state, 0, sizeof(*state));
+	state->placeholderIndex = -1;
+	state->placeholderGapIndex = -1;
+}
+
+void CTTabLayoutStateFree(CTTabLayoutState* state) {
+	free(state->cursors);
+	CTTabLayoutStateInit(state);
+}
+
+void CTTabLayoutStateInvalidate(CTTabLayoutState* state) {
+	state->valid = false;
+}
+
+// Returns whether |a| and |b| lay out the same tabs at the same places,
+// leaving aside the placeholder.
+static bool CTTabLayoutSameGeometry(const CTTabLayoutParameters* a,
+                                    const CTTabLayoutParameters* b) {
+	return a->maxTabWidth == b->maxTabWidth &&
+	    a->minTabWidth == b->minTabWidth &&
+	    a->minActiveTabWidth == b->minActiveTabWidth &&
+	    a->miniTabWidth == b->miniTabWidth &&
+	    a->appTabWidth == b->appTabWidth &&
+	    a->tabOverlap == b->tabOverlap &&
+	    a->lastMiniTabSpacing == b->lastMiniTabSpacing &&
+	    a->start == b->start &&
+	    a->availableWidth == b->availableWidth;
+}
+
+static bool CTTabLayoutSamePlaceholder(const CTTabLayoutParameters* a,
+                                       const CTTabLayoutParameters* b) {
+	if (a->hasPlaceholder != b->hasPlaceholder)
+		return false;
+	return !a->hasPlaceholder || (a->placeholderX == b->placeholderX &&
+	                              a->placeholderWidth == b->placeholderWidth);
+}
+
+// Returns the first tab before |end| whose frame a placeholder moving from
+// where |state| had it to where |params| has it may change, or |end|. May
+// return a tab or so early.
+static int CTTabLayoutFirstTabNearPlaceholder(
+    const CTTabLayoutState* state,
+    const CTTabLayoutParameters* params,
+    int end) {
+	// The placeholder itself, and where the old gap was.
+	if (state->placeholderIndex >= 0 && state->placeholderIndex < end)
+		end = state->placeholderIndex;
+	if (state->placeholderGapIndex >= 0 && state->placeholderGapIndex < end)
+		end = state->placeholderGapIndex;
+	if (!params->hasPlaceholder)
+		return end;
+
+	// Where the new gap opens, at the first tab whose middle is to the right of
+	// |placeholderX|. That is no earlier than the first tab that ends to the
+	// right of it, which |CTTabLayoutTabsBetween| would find, and before |end|
+	// the offsets don't include a gap.
+	const CTTabLayoutCursor* cursors = state->cursors;
+	double overlap = state->params.tabOverlap;
+	int low = 0;
+	int high = end;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (cursors[middle + 1].offset + overlap <= params->placeholderX)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+CTTabLayoutResult CTTabLayoutUpdate(CTTabLayoutState* state,
+                                    const CTTabLayoutParameters* params,
+                                    const CTTabLayoutFlags* flags,
+                                    int count,
+                                    int firstChanged,
+                                    CTTabLayoutFrame* frames,
+                                    int* firstLaidOut) {
+	assert(count >= 0);
+	int first = firstChanged;
+	if (first > count)
+		first = count;
+	if (first > state->count)
+		first = state->count;
+	if (first < 0 || !state->valid ||
+	    !CTTabLayoutSameGeometry(&state->params, params))
+		first = 0;
+
+	if (count + 1 > state->capacity) {
+		int capacity = state->capacity ? state->capacity * 2 : 16;
+		while (capacity < count + 1)
+			capacity *= 2;
+		state->cursors = (CTTabLayoutCursor*)realloc(
+		    state->cursors, capacity * sizeof(CTTabLayoutCursor));
+		assert(state->cursors);
+		state->capacity = capacity;
+	}
+	if (first == 0)
+		memset(&state->cursors[0], 0, sizeof(CTTabLayoutCursor));
+
+	// Count the tabs that share the room: the ones before |first| were counted
+	// last time. Mini-tabs in collapsed groups still count against the room
+	// for the others, as the controller always did; other hidden tabs take
+	// none.
+	int miniTabCount = state->cursors[first].miniTabCount;
+	int nonMiniTabCount = state->cursors[first].nonMiniTabCount;
+	for (int i = first; i < count; ++i) {
+		CTTabLayoutFlags tab = flags[i];
+		if (tab & CTTabLayoutClosing)
+			continue;
+		if (tab & CTTabLayoutMini)
+			++miniTabCount;
+		else if (!(tab & CTTabLayoutHidden))
+			++nonMiniTabCount;
+	}
+
+	double availableSpace = params->availableWidth;
+	if (miniTabCount)
+		availableSpace -= params->lastMiniTabSpacing;
+	double availableSpaceForNonMini = availableSpace -
+	    miniTabCount * (params->miniTabWidth - params->tabOverlap);
+
+	// Only used if there are non-mini-tabs.
+	double nonMiniTabWidth = params->maxTabWidth;
+	double nonMiniTabWidthFraction = 0;
+	if (nonMiniTabCount) {
+		// Add in the amount we "get back" from the tabs overlapping, and divide
+		// up the space.
+		availableSpaceForNonMini += (nonMiniTabCount - 1) * params->tabOverlap;
+		nonMiniTabWidth = availableSpaceForNonMini / nonMiniTabCount;
+		nonMiniTabWidth = fmax(fmin(nonMiniTabWidth, params->maxTabWidth),
+		                       params->minTabWidth);
+		// Separate integral and fractional parts.
+		double integralPart = floor(nonMiniTabWidth);
+		nonMiniTabWidthFraction = nonMiniTabWidth - integralPart;
+		nonMiniTabWidth = integralPart;
+	}
+
+	// Tabs only keep their widths if the width didn't change. With a
+	// fractional part, the last non-mini-tab also gets what is left over.
+	if (nonMiniTabWidth != state->nonMiniTabWidth ||
+	    nonMiniTabWidthFraction != state->nonMiniTabWidthFraction ||
+	    (nonMiniTabWidthFraction && nonMiniTabCount != state->nonMiniTabCount)) {
+		first = 0;
+		memset(&state->cursors[0], 0, sizeof(CTTabLayoutCursor));
+	}
+	if (first && !CTTabLayoutSamePlaceholder(&state->params, params))
+		first = CTTabLayoutFirstTabNearPlaceholder(state, params, first);
+
+	state->valid = true;
+	state->params = *params;
+	state->nonMiniTabCount = nonMiniTabCount;
+	state->nonMiniTabWidth = nonMiniTabWidth;
+	state->nonMiniTabWidthFraction = nonMiniTabWidthFraction;
+	state->count = count;
+	*firstLaidOut = first;
+	if (state->placeholderIndex >= first)
+		state->placeholderIndex = -1;
+	if (state->placeholderGapIndex >= first)
+		state->placeholderGapIndex = -1;
+
+	CTTabLayoutCursor cursor = state->cursors[first];
+	if (first == 0)
+		cursor.offset = params->start;
+	for (int i = first; i < count; ++i) {
+		state->cursors[i] = cursor;
+		CTTabLayoutFlags tab = flags[i];
+		if (tab & CTTabLayoutClosing)
+			continue;
+		bool isMini = (tab & CTTabLayoutMini) != 0;
+		if (isMini)
+			++cursor.miniTabCount;
+		else if (!(tab & CTTabLayoutHidden))
+			++cursor.nonMiniTabCount;
+		if (tab & CTTabLayoutHidden)
+			continue;
+
+		CTTabLayoutFrame* frame = &frames[i];
+		if (tab & CTTabLayoutPlaceholder) {
+			state->placeholderIndex = i;
+			frame->x = params->placeholderX;
+			frame->width = params->placeholderWidth;
+			continue;
+		}
+
+		if (isMini) {
+			frame->width = (tab & CTTabLayoutApp) ? params->appTabWidth :
+			    params->miniTabWidth;
+		} else {
+			// Tabs have non-integer widths. Assign the integer part to the tab, and
+			// keep an accumulation of the fractional parts. When the fractional
+			// accumulation gets to be more than one pixel, assign that to the
+			// current tab being laid out. This is vaguely inspired by Bresenham's
+			// line algorithm.
+			frame->width = nonMiniTabWidth;
+			cursor.accumulatedFraction += nonMiniTabWidthFraction;
+			if (cursor.accumulatedFraction >= 1.0) {
+				++frame->width;
+				--cursor.accumulatedFraction;
+			}
+			// In case of rounding error, give any left over pixels to the last tab.
+			if (cursor.laidOutNonMiniTabs == nonMiniTabCount - 1 &&
+			    cursor.accumulatedFraction > 0.5) {
+				++frame->width;
+			}
+			++cursor.laidOutNonMiniTabs;
+		}
+
+		// Active tabs are slightly wider when things get really small.
+		if (tab & CTTabLayoutActive)
+			frame->width = fmax(frame->width, params->minActiveTabWidth);
+
+		// Slide over to make room for the placeholder at the first tab whose
+		// middle is to the right of the placeholder's left edge.
+		if (params->hasPlaceholder && !cursor.hasPlaceholderGap &&
+		    cursor.offset + frame->width / 2 > params->placeholderX) {
+			cursor.hasPlaceholderGap = true;
+			cursor.offset += params->placeholderWidth - params->tabOverlap;
+			state->placeholderGapIndex = i;
+		}
+
+		// Add a bit of spacing between the last mini-tab and the first other tab.
+		if (!isMini && cursor.isLastTabMini)
+			cursor.offset += params->lastMiniTabSpacing;
+		cursor.isLastTabMini = isMini;
+
+		frame->x = cursor.offset;
+		if (frame->width > 0) {
+			if (!cursor.hasExtent) {
+				cursor.minX = frame->x;
+				cursor.maxX = frame->x + frame->width;
+				cursor.hasExtent = true;
+			} else {
+				cursor.minX = fmin(cursor.minX, frame->x);
+				cursor.maxX = fmax(cursor.maxX, frame->x + frame->width);
+			}
+		}
+		cursor.offset += frame->width - params->tabOverlap;
+	}
+	state->cursors[count] = cursor;
+
+	CTTabLayoutResult result = { cursor.offset, cursor.minX, cursor.maxX };
+	return result;
+}
+
+void CTTabLayoutTabsBetween(const CTTabLayoutState* state,
+                            double minX,
+                            double maxX,
+                            int* first,
+                            int* end) {
+	// A tab starts at or after the offset before it and ends where the offset
+	// after it is, plus the overlap. The offsets only grow.
+	const CTTabLayoutCursor* cursors = state->cursors;
+	double overlap = state->params.tabOverlap;
+	int low = 0;
+	int high = state->count;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (cursors[middle + 1].offset + overlap <= minX)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	*first = low;
+	high = state->count;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (cursors[middle].offset < maxX)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	*end = low;
+}
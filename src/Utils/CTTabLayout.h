@@ -0,0 +1,161 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_TAB_LAYOUT_H_
+#define CT_TAB_LAYOUT_H_
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The geometry of a horizontal tab strip, without AppKit: how wide every tab
+// is and where it goes, given what kind of tab it is and how much room there
+// is. CTTabStripController fills in one byte of flags per tab, calls
+// |CTTabLayoutUpdate|, asks |CTTabLayoutTabsBetween| which tabs are in sight
+// and only gives those views. On its own it is what tools/tab-strip-core
+// benchmarks.
+//
+// Tabs are laid out left to right, overlapping by |tabOverlap|. Mini-tabs
+// have a fixed width and the space left is divided between the other tabs,
+// within |minTabWidth| and |maxTabWidth|, in whole points.
+//
+// A tab's offset only depends on the tabs before it, so the layout keeps the
+// state it had before every tab and picks up from the first tab that
+// changed. Everything is laid out again only when the width of the non-mini
+// tabs changes, which it doesn't once they are all at their minimum width.
+
+// The per-tab flags.
+enum {
+	CTTabLayoutMini = 1 << 0,
+	// An app tab. Only used with CTTabLayoutMini.
+	CTTabLayoutApp = 1 << 1,
+	CTTabLayoutActive = 1 << 2,
+	// A tab animating closed. It is no longer in the model and takes no room.
+	CTTabLayoutClosing = 1 << 3,
+	// A tab in a collapsed group. It takes no room.
+	CTTabLayoutHidden = 1 << 4,
+	// The tab being dragged, which goes where the placeholder is.
+	CTTabLayoutPlaceholder = 1 << 5,
+};
+typedef uint8_t CTTabLayoutFlags;
+
+typedef struct {
+	// The widths of the different kinds of tabs. Active tabs are never made
+	// narrower than |minActiveTabWidth|.
+	double maxTabWidth;
+	double minTabWidth;
+	double minActiveTabWidth;
+	double miniTabWidth;
+	double appTabWidth;
+	// The amount by which tabs overlap.
+	double tabOverlap;
+	// The amount by which mini-tabs are separated from the other tabs.
+	double lastMiniTabSpacing;
+	// Where the first tab starts.
+	double start;
+	// The room for tabs from |start| on. May be negative, in which case all
+	// tabs get their minimum width.
+	double availableWidth;
+	// While a tab is dragged, the tabs after |placeholderX| make a gap of
+	// |placeholderWidth| for it.
+	bool hasPlaceholder;
+	double placeholderX;
+	double placeholderWidth;
+} CTTabLayoutParameters;
+
+// Where a tab goes. All tabs have the same height and a y of 0.
+typedef struct {
+	double x;
+	double width;
+} CTTabLayoutFrame;
+
+typedef struct {
+	// Where a tab after the last one would start, which is where the new tab
+	// button goes.
+	double end;
+	// The horizontal extent of the tabs laid out, not counting the
+	// placeholder. Both are 0 if there are none.
+	double minX;
+	double maxX;
+} CTTabLayoutResult;
+
+// Where the layout was before a tab.
+typedef struct {
+	double offset;
+	// The fractional width the tabs so far didn't get.
+	double accumulatedFraction;
+	int laidOutNonMiniTabs;
+	// The tabs before this one that count against the room, laid out or not.
+	int miniTabCount;
+	int nonMiniTabCount;
+	bool isLastTabMini;
+	bool hasPlaceholderGap;
+	// The extent of the tabs so far, as in CTTabLayoutResult.
+	bool hasExtent;
+	double minX;
+	double maxX;
+} CTTabLayoutCursor;
+
+// What the last layout needs to be picked up from. Must be balanced with
+// CTTabLayoutStateFree.
+typedef struct {
+	bool valid;
+	// The parameters and non-mini-tab width of the last layout.
+	CTTabLayoutParameters params;
+	int nonMiniTabCount;
+	double nonMiniTabWidth;
+	double nonMiniTabWidthFraction;
+	// One cursor per tab and one past the last.
+	CTTabLayoutCursor* cursors;
+	int count;
+	int capacity;
+	// The placeholder tab of the last layout, and the tab its gap opened
+	// before, or -1. Where a moving placeholder changes the layout starts no
+	// later than either.
+	int placeholderIndex;
+	int placeholderGapIndex;
+} CTTabLayoutState;
+
+void CTTabLayoutStateInit(CTTabLayoutState* state);
+void CTTabLayoutStateFree(CTTabLayoutState* state);
+
+// Makes the next update lay out every tab.
+void CTTabLayoutStateInvalidate(CTTabLayoutState* state);
+
+// Lays out the |count| tabs with |flags|, writing the frame of every tab
+// from |*firstLaidOut| on to |frames|. The frames of closing and hidden
+// tabs are left as they are.
+//
+// The flags and frames before |firstChanged| must be the ones of the last
+// update; |frames| is only read there. The update starts at |firstChanged|,
+// or before it if the placeholder moved, or at 0 if the parameters or the
+// non-mini-tab width changed. O(log count + count - *firstLaidOut).
+CTTabLayoutResult CTTabLayoutUpdate(CTTabLayoutState* state,
+                                    const CTTabLayoutParameters* params,
+                                    const CTTabLayoutFlags* flags,
+                                    int count,
+                                    int firstChanged,
+                                    CTTabLayoutFrame* frames,
+                                    int* firstLaidOut);
+
+// Finds the tabs [*first, *end) of the last update that may be seen between
+// |minX| and |maxX|, which are the ones the strip needs views for. Tabs out
+// of order (the placeholder) and hidden ones may be in the range, and tabs
+// narrower than |tabOverlap| may make it too wide, never too narrow.
+// O(log count).
+void CTTabLayoutTabsBetween(const CTTabLayoutState* state,
+                            double minX,
+                            double maxX,
+                            int* first,
+                            int* end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CT_TAB_LAYOUT_H_
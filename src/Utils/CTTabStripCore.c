@@ -0,0 +1,935 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "CTTabStripCore.h"
+#include <assert.h>
+#include "CTOrderLabels.h"
+#include <stdlib.h>
+#include <string.h>
+
+// What the core knows about a tab, found by its handle. Records of tabs that
+// left the strip are chained into a free list through |older|.
+typedef struct {
+	// The slot of the tab. Only valid when it is less than the core's
+	// |firstStaleIndex|.
+	int index;
+	// Increases along the strip, and unlike |index| is never stale. See
+	// CTOrderLabels.h.
+	uint64_t order;
+	CTTabHandle opener;
+	// The tabs in the strip this tab opened, sorted by |order|.
+	CTTabHandle* opened;
+	int openedCount;
+	int openedCapacity;
+	// The activation history is a doubly linked list from |mostRecent|
+	// onwards. Tabs that have never been active are not in it.
+	CTTabHandle newer;
+	CTTabHandle older;
+	bool activated;
+	bool live;
+} CTTabRecord;
+
+struct CTTabStripCore {
+	// The handle of the tab in every slot.
+	CTTabHandle* slots;
+	int count;
+	int slotCapacity;
+
+	// Indexed by handle. Record 0 is never used, so that no tab has handle 0.
+	CTTabRecord* records;
+	uint32_t recordCount;
+	uint32_t recordCapacity;
+	CTTabHandle freeRecords;
+
+	// One bit per slot, in slot order.
+	CTBitVector pinned;
+	CTBitVector blocked;
+	CTBitVector app;
+	int miniTabCount;
+
+	int activeIndex;
+	// Always holds |activeIndex| when there is an active tab, and is empty
+	// otherwise.
+	CTRangeSet selection;
+	int anchorIndex;
+	CTTabHandle mostRecent;
+	CTTabStripCoreInsertionPolicy insertionPolicy;
+
+	// Cached slots at or above this may be out of date.
+	int firstStaleIndex;
+};
+
+static void CTTabStripCoreInvalidateFrom(CTTabStripCore* core, int index) {
+	if (index < core->firstStaleIndex)
+		core->firstStaleIndex = index;
+}
+
+static CTTabHandle CTTabStripCoreNewRecord(CTTabStripCore* core) {
+	CTTabHandle tab = core->freeRecords;
+	if (tab) {
+		core->freeRecords = core->records[tab].older;
+	} else {
+		if (core->recordCount == core->recordCapacity) {
+			core->recordCapacity *= 2;
+			core->records = (CTTabRecord*)realloc(
+			    core->records, core->recordCapacity * sizeof(CTTabRecord));
+			assert(core->records);
+		}
+		tab = core->recordCount++;
+		core->records[tab].opened = NULL;
+		core->records[tab].openedCapacity = 0;
+	}
+	// Keep the list of opened tabs a released record had.
+	CTTabRecord* record = &core->records[tab];
+	CTTabHandle* opened = record->opened;
+	int openedCapacity = record->openedCapacity;
+	memset(record, 0, sizeof(CTTabRecord));
+	record->opened = opened;
+	record->openedCapacity = openedCapacity;
+	record->live = true;
+	return tab;
+}
+
+static uint64_t CTTabStripCoreGetOrder(void* list, int index) {
+	CTTabStripCore* core = (CTTabStripCore*)list;
+	return core->records[core->slots[index]].order;
+}
+
+static void CTTabStripCoreSetOrder(void* list, int index, uint64_t order) {
+	CTTabStripCore* core = (CTTabStripCore*)list;
+	core->records[core->slots[index]].order = order;
+}
+
+// Labels the tab at |index|, which was just inserted or moved there.
+static void CTTabStripCoreAssignOrder(CTTabStripCore* core, int index) {
+	CTOrderLabelList list = {
+		core, CTTabStripCoreGetOrder, CTTabStripCoreSetOrder
+	};
+	CTOrderLabelsAssign(&list, core->count, index);
+}
+
+// Returns the position in the tabs |opener| opened of the first one whose
+// order isn't less than |order|.
+static int CTTabStripCoreLowerBoundOfOrder(const CTTabStripCore* core,
+                                           CTTabHandle opener,
+                                           uint64_t order) {
+	const CTTabRecord* record = &core->records[opener];
+	int low = 0;
+	int high = record->openedCount;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (core->records[record->opened[middle]].order < order)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+// Adds |tab| to the tabs its opener opened.
+static void CTTabStripCoreLinkToOpener(CTTabStripCore* core, CTTabHandle tab) {
+	CTTabHandle opener = core->records[tab].opener;
+	if (!opener)
+		return;
+	int position = CTTabStripCoreLowerBoundOfOrder(
+	    core, opener, core->records[tab].order);
+	CTTabRecord* record = &core->records[opener];
+	if (record->openedCount == record->openedCapacity) {
+		record->openedCapacity = record->openedCapacity ?
+		    record->openedCapacity * 2 : 4;
+		record->opened = (CTTabHandle*)realloc(
+		    record->opened, record->openedCapacity * sizeof(CTTabHandle));
+		assert(record->opened);
+	}
+	memmove(&record->opened[position + 1], &record->opened[position],
+	        (record->openedCount - position) * sizeof(CTTabHandle));
+	record->opened[position] = tab;
+	record->openedCount++;
+}
+
+// Takes |tab| out of the tabs its opener opened, while its order is still
+// the one it was added with.
+static void CTTabStripCoreUnlinkFromOpener(CTTabStripCore* core,
+                                           CTTabHandle tab) {
+	CTTabHandle opener = core->records[tab].opener;
+	if (!opener)
+		return;
+	int position = CTTabStripCoreLowerBoundOfOrder(
+	    core, opener, core->records[tab].order);
+	CTTabRecord* record = &core->records[opener];
+	assert(position < record->openedCount && record->opened[position] == tab);
+	memmove(&record->opened[position], &record->opened[position + 1],
+	        (record->openedCount - position - 1) * sizeof(CTTabHandle));
+	record->openedCount--;
+}
+
+// Returns the index of |tab|, which is in the strip, without renumbering
+// the stale slots: the cached one if it is still valid, else a binary search
+// of the slots by order.
+static int CTTabStripCoreFindTab(const CTTabStripCore* core, CTTabHandle tab) {
+	const CTTabRecord* record = &core->records[tab];
+	if (record->index < core->firstStaleIndex)
+		return record->index;
+	int low = core->firstStaleIndex;
+	int high = core->count;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (core->records[core->slots[middle]].order < record->order)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	assert(low < core->count && core->slots[low] == tab);
+	return low;
+}
+
+// Takes |tab| out of the activation history.
+static void CTTabStripCoreUnlinkActivation(CTTabStripCore* core,
+                                           CTTabHandle tab) {
+	CTTabRecord* record = &core->records[tab];
+	if (!record->activated)
+		return;
+	if (record->newer)
+		core->records[record->newer].older = record->older;
+	else
+		core->mostRecent = record->older;
+	if (record->older)
+		core->records[record->older].newer = record->newer;
+	record->newer = CTNoTabHandle;
+	record->older = CTNoTabHandle;
+	record->activated = false;
+}
+
+// Returns the record of |tab|, which left the strip, to the free list.
+static void CTTabStripCoreReleaseRecord(CTTabStripCore* core, CTTabHandle tab) {
+	CTTabStripCoreUnlinkActivation(core, tab);
+	CTTabStripCoreUnlinkFromOpener(core, tab);
+	CTTabRecord* record = &core->records[tab];
+	record->opener = CTNoTabHandle;
+	record->live = false;
+	record->older = core->freeRecords;
+	core->freeRecords = tab;
+}
+
+// Returns the first tab after |index| opened by |opener| that isn't in
+// |except| (which may be NULL), or failing that the closest one before
+// |index|, or CTTabStripCoreNoTab. A binary search of the tabs |opener|
+// opened, so closing tabs one after another never walks the strip.
+static int CTTabStripCoreNearestOpenedBy(const CTTabStripCore* core,
+                                         CTTabHandle opener,
+                                         int index,
+                                         const CTBitVector* except) {
+	if (!opener || !core->records[opener].openedCount)
+		return CTTabStripCoreNoTab;
+	const CTTabRecord* record = &core->records[opener];
+	CTTabHandle tab = core->slots[index];
+	int position = CTTabStripCoreLowerBoundOfOrder(
+	    core, opener, core->records[tab].order);
+	for (int i = position; i < record->openedCount; ++i) {
+		if (record->opened[i] == tab)
+			continue;
+		int other = CTTabStripCoreFindTab(core, record->opened[i]);
+		if (!(except && CTBitVectorGet(except, other)))
+			return other;
+	}
+	for (int i = position - 1; i >= 0; --i) {
+		int other = CTTabStripCoreFindTab(core, record->opened[i]);
+		if (!(except && CTBitVectorGet(except, other)))
+			return other;
+	}
+	return CTTabStripCoreNoTab;
+}
+
+// Returns the index of the most recently active tab that isn't |tab| and
+// isn't in |except| (which may be NULL), or CTTabStripCoreNoTab.
+static int CTTabStripCoreMostRecentlyActiveExcept(CTTabStripCore* core,
+                                                  CTTabHandle tab,
+                                                  const CTBitVector* except) {
+	for (CTTabHandle other = core->mostRecent; other;
+	     other = core->records[other].older) {
+		if (other == tab)
+			continue;
+		int index = CTTabStripCoreFindTab(core, other);
+		if (!(except && CTBitVectorGet(except, index)))
+			return index;
+	}
+	return CTTabStripCoreNoTab;
+}
+
+// Makes |index| the only selected tab and the anchor, or clears the
+// selection if it is CTTabStripCoreNoTab.
+static void CTTabStripCoreSelectOnly(CTTabStripCore* core, int index) {
+	CTRangeSetClear(&core->selection);
+	if (index != CTTabStripCoreNoTab)
+		CTRangeSetAdd(&core->selection, index, index + 1);
+	core->anchorIndex = index;
+}
+
+// Clears the opener of every tab |tab| opened.
+static void CTTabStripCoreForgetOpener(CTTabStripCore* core, CTTabHandle tab) {
+	CTTabRecord* record = &core->records[tab];
+	for (int i = 0; i < record->openedCount; ++i)
+		core->records[record->opened[i]].opener = CTNoTabHandle;
+	record->openedCount = 0;
+}
+
+CTTabStripCore* CTTabStripCoreCreate(void) {
+	CTTabStripCore* core = (CTTabStripCore*)calloc(1, sizeof(CTTabStripCore));
+	assert(core);
+	core->recordCapacity = 16;
+	core->records = (CTTabRecord*)calloc(core->recordCapacity, sizeof(CTTabRecord));
+	assert(core->records);
+	core->recordCount = 1;
+	CTBitVectorInit(&core->pinned);
+	CTBitVectorInit(&core->blocked);
+	CTBitVectorInit(&core->app);
+	core->activeIndex = CTTabStripCoreNoTab;
+	CTRangeSetInit(&core->selection);
+	core->anchorIndex = CTTabStripCoreNoTab;
+	core->insertionPolicy = CTTabStripCoreInsertAfter;
+	return core;
+}
+
+void CTTabStripCoreFree(CTTabStripCore* core) {
+	if (!core)
+		return;
+	CTBitVectorFree(&core->pinned);
+	CTBitVectorFree(&core->blocked);
+	CTBitVectorFree(&core->app);
+	CTRangeSetFree(&core->selection);
+	for (uint32_t tab = 1; tab < core->recordCount; ++tab)
+		free(core->records[tab].opened);
+	free(core->records);
+	free(core->slots);
+	free(core);
+}
+
+int CTTabStripCoreCount(const CTTabStripCore* core) {
+	return core->count;
+}
+
+int CTTabStripCoreActiveIndex(const CTTabStripCore* core) {
+	return core->activeIndex;
+}
+
+void CTTabStripCoreSetActiveIndex(CTTabStripCore* core, int index) {
+	assert(index == CTTabStripCoreNoTab || (index >= 0 && index < core->count));
+	core->activeIndex = index;
+	CTTabStripCoreSelectOnly(core, index);
+}
+
+void CTTabStripCoreTabWasActivated(CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	CTTabHandle tab = core->slots[index];
+	if (core->mostRecent == tab)
+		return;
+	CTTabStripCoreUnlinkActivation(core, tab);
+	CTTabRecord* record = &core->records[tab];
+	record->older = core->mostRecent;
+	if (core->mostRecent)
+		core->records[core->mostRecent].newer = tab;
+	core->mostRecent = tab;
+	record->activated = true;
+}
+
+CTTabHandle CTTabStripCoreTabAtIndex(const CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	return core->slots[index];
+}
+
+int CTTabStripCoreIndexOfTab(const CTTabStripCore* core, CTTabHandle tab) {
+	if (!tab || tab >= core->recordCount || !core->records[tab].live)
+		return CTTabStripCoreNoTab;
+	return CTTabStripCoreFindTab(core, tab);
+}
+
+bool CTTabStripCoreIsBefore(const CTTabStripCore* core,
+                            CTTabHandle tab,
+                            CTTabHandle other) {
+	assert(tab && tab < core->recordCount && core->records[tab].live);
+	assert(other && other < core->recordCount && core->records[other].live);
+	return core->records[tab].order < core->records[other].order;
+}
+
+CTTabHandle CTTabStripCoreOpenerOfTab(const CTTabStripCore* core,
+                                      CTTabHandle tab) {
+	assert(tab && tab < core->recordCount && core->records[tab].live);
+	return core->records[tab].opener;
+}
+
+void CTTabStripCoreSetOpener(CTTabStripCore* core,
+                             CTTabHandle tab,
+                             CTTabHandle opener) {
+	assert(tab && tab < core->recordCount && core->records[tab].live);
+	assert(!opener || (opener < core->recordCount && core->records[opener].live));
+	if (opener == tab)
+		opener = CTNoTabHandle;
+	CTTabRecord* record = &core->records[tab];
+	if (record->opener == opener)
+		return;
+	CTTabStripCoreUnlinkFromOpener(core, tab);
+	record->opener = opener;
+	CTTabStripCoreLinkToOpener(core, tab);
+}
+
+int CTTabStripCoreOpenedTabCount(const CTTabStripCore* core,
+                                 CTTabHandle opener) {
+	assert(opener && opener < core->recordCount && core->records[opener].live);
+	return core->records[opener].openedCount;
+}
+
+CTTabHandle CTTabStripCoreOpenedTab(const CTTabStripCore* core,
+                                    CTTabHandle opener,
+                                    int position) {
+	assert(opener && opener < core->recordCount && core->records[opener].live);
+	assert(position >= 0 && position < core->records[opener].openedCount);
+	return core->records[opener].opened[position];
+}
+
+int CTTabStripCoreIndexOfNextTabOpenedBy(const CTTabStripCore* core,
+                                         CTTabHandle opener,
+                                         int index) {
+	assert(opener && opener < core->recordCount && core->records[opener].live);
+	const CTTabRecord* record = &core->records[opener];
+	if (!record->openedCount)
+		return CTTabStripCoreNoTab;
+	if (index < 0)
+		return CTTabStripCoreFindTab(core, record->opened[0]);
+	if (index >= core->count)
+		return CTTabStripCoreFindTab(core, record->opened[record->openedCount - 1]);
+	return CTTabStripCoreNearestOpenedBy(core, opener, index, NULL);
+}
+
+bool CTTabStripCoreIsPinned(const CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	return CTBitVectorGet(&core->pinned, index);
+}
+
+bool CTTabStripCoreIsBlocked(const CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	return CTBitVectorGet(&core->blocked, index);
+}
+
+bool CTTabStripCoreIsApp(const CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	return CTBitVectorGet(&core->app, index);
+}
+
+bool CTTabStripCoreIsMini(const CTTabStripCore* core, int index) {
+	return CTTabStripCoreIsPinned(core, index) || CTTabStripCoreIsApp(core, index);
+}
+
+void CTTabStripCoreSetBlocked(CTTabStripCore* core, int index, bool blocked) {
+	assert(index >= 0 && index < core->count);
+	CTBitVectorSet(&core->blocked, index, blocked);
+}
+
+const CTBitVector* CTTabStripCorePinnedTabs(const CTTabStripCore* core) {
+	return &core->pinned;
+}
+
+const CTBitVector* CTTabStripCoreBlockedTabs(const CTTabStripCore* core) {
+	return &core->blocked;
+}
+
+int CTTabStripCoreSetPinned(CTTabStripCore* core, int index, bool pinned) {
+	assert(index >= 0 && index < core->count);
+	if (CTBitVectorGet(&core->pinned, index) == pinned)
+		return index;
+	if (CTBitVectorGet(&core->app, index)) {
+		// App tabs are always pinned, and mini-tabs either way.
+		assert(pinned);
+		return index;
+	}
+	int firstNonMiniTab = core->miniTabCount;
+	CTBitVectorSet(&core->pinned, index, pinned);
+	core->miniTabCount += pinned ? 1 : -1;
+	if (pinned && index != firstNonMiniTab)
+		return firstNonMiniTab;
+	if (!pinned && index + 1 != firstNonMiniTab)
+		return firstNonMiniTab - 1;
+	return index;
+}
+
+int CTTabStripCoreMiniTabCount(const CTTabStripCore* core) {
+	return core->miniTabCount;
+}
+
+int CTTabStripCoreConstrainInsertionIndex(const CTTabStripCore* core,
+                                          int index,
+                                          bool miniTab) {
+	if (miniTab) {
+		if (index < 0)
+			return 0;
+		return index < core->miniTabCount ? index : core->miniTabCount;
+	}
+	if (index < core->miniTabCount)
+		return core->miniTabCount;
+	return index < core->count ? index : core->count;
+}
+
+CTTabStripCoreInsertionPolicy CTTabStripCoreGetInsertionPolicy(
+    const CTTabStripCore* core) {
+	return core->insertionPolicy;
+}
+
+void CTTabStripCoreSetInsertionPolicy(CTTabStripCore* core,
+                                      CTTabStripCoreInsertionPolicy policy) {
+	core->insertionPolicy = policy;
+}
+
+int CTTabStripCoreInsertionIndexForLink(const CTTabStripCore* core) {
+	if (!core->count)
+		return 0;
+	if (core->activeIndex == CTTabStripCoreNoTab)
+		return CTTabStripCoreInsertionIndexForAppending(core);
+	// Adjacent to the tab the link was clicked in. Mini-tabs are kept in
+	// front when the tab is inserted, so there is no need to check here.
+	return core->activeIndex +
+	    (core->insertionPolicy == CTTabStripCoreInsertAfter ? 1 : 0);
+}
+
+int CTTabStripCoreInsertionIndexForAppending(const CTTabStripCore* core) {
+	return core->insertionPolicy == CTTabStripCoreInsertAfter ? core->count : 0;
+}
+
+CTTabHandle CTTabStripCoreInsert(CTTabStripCore* core,
+                                 int index,
+                                 unsigned flags,
+                                 CTTabHandle opener) {
+	if (flags & CTTabStripCoreApp)
+		flags |= CTTabStripCorePinned;
+	bool mini = (flags & CTTabStripCorePinned) != 0;
+	assert(index == CTTabStripCoreConstrainInsertionIndex(core, index, mini));
+
+	CTTabHandle tab = CTTabStripCoreNewRecord(core);
+	if (core->count == core->slotCapacity) {
+		core->slotCapacity = core->slotCapacity ? core->slotCapacity * 2 : 16;
+		core->slots = (CTTabHandle*)realloc(
+		    core->slots, core->slotCapacity * sizeof(CTTabHandle));
+		assert(core->slots);
+	}
+	memmove(&core->slots[index + 1], &core->slots[index],
+	        (core->count - index) * sizeof(CTTabHandle));
+	core->slots[index] = tab;
+	core->count++;
+	core->records[tab].index = index;
+	CTTabStripCoreInvalidateFrom(core, index);
+	CTTabStripCoreAssignOrder(core, index);
+
+	CTBitVectorInsert(&core->pinned, index, mini);
+	CTBitVectorInsert(&core->blocked, index, (flags & CTTabStripCoreBlocked) != 0);
+	CTBitVectorInsert(&core->app, index, (flags & CTTabStripCoreApp) != 0);
+	if (mini)
+		core->miniTabCount++;
+	if (opener)
+		CTTabStripCoreSetOpener(core, tab, opener);
+	if (core->activeIndex != CTTabStripCoreNoTab && index <= core->activeIndex)
+		core->activeIndex++;
+	CTRangeSetInsertSlots(&core->selection, index, 1);
+	if (core->anchorIndex != CTTabStripCoreNoTab && index <= core->anchorIndex)
+		core->anchorIndex++;
+	return tab;
+}
+
+int CTTabStripCoreRemove(CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	bool wasActive = index == core->activeIndex;
+	int nextActiveIndex = wasActive ?
+	    CTTabStripCoreIndexToActivateAfterClosing(core, index) : core->activeIndex;
+
+	CTTabHandle tab = core->slots[index];
+	CTTabStripCoreForgetOpener(core, tab);
+	if (CTTabStripCoreIsMini(core, index))
+		core->miniTabCount--;
+	memmove(&core->slots[index], &core->slots[index + 1],
+	        (core->count - index - 1) * sizeof(CTTabHandle));
+	core->count--;
+	CTTabStripCoreInvalidateFrom(core, index);
+	CTBitVectorRemove(&core->pinned, index);
+	CTBitVectorRemove(&core->blocked, index);
+	CTBitVectorRemove(&core->app, index);
+	CTTabStripCoreReleaseRecord(core, tab);
+
+	if (!core->count)
+		core->activeIndex = CTTabStripCoreNoTab;
+	else if (wasActive)
+		core->activeIndex = nextActiveIndex;
+	else if (core->activeIndex != CTTabStripCoreNoTab && index < core->activeIndex)
+		core->activeIndex--;
+
+	if (wasActive || !core->count) {
+		CTTabStripCoreSelectOnly(core, core->activeIndex);
+	} else {
+		CTRangeSetRemoveSlots(&core->selection, index, 1);
+		if (index == core->anchorIndex)
+			core->anchorIndex = core->activeIndex;
+		else if (core->anchorIndex != CTTabStripCoreNoTab && index < core->anchorIndex)
+			core->anchorIndex--;
+	}
+	return core->activeIndex;
+}
+
+int CTTabStripCoreRemoveMarked(CTTabStripCore* core, const CTBitVector* marked) {
+	assert(marked->count == (size_t)core->count);
+	int first = (int)CTBitVectorNextSet(marked, 0);
+	if (first == core->count)
+		return core->activeIndex;
+	bool activeIsClosing = core->activeIndex != CTTabStripCoreNoTab &&
+	    CTBitVectorGet(marked, core->activeIndex);
+	int nextActiveIndex = activeIsClosing ?
+	    CTTabStripCoreIndexToActivateAfterClosingMarked(core, marked) :
+	    core->activeIndex;
+
+	// Forget the openers of the closing tabs first, through their lists, and
+	// mark them so that a single pass can drop them.
+	for (size_t i = first; i < marked->count; i = CTBitVectorNextSet(marked, i + 1)) {
+		CTTabHandle tab = core->slots[i];
+		CTTabStripCoreForgetOpener(core, tab);
+		CTTabStripCoreUnlinkFromOpener(core, tab);
+		core->records[tab].opener = CTNoTabHandle;
+		core->records[tab].live = false;
+	}
+	int miniTabCount = core->miniTabCount;
+	int count = 0;
+	int newActiveIndex = CTTabStripCoreNoTab;
+	int newAnchorIndex = CTTabStripCoreNoTab;
+	for (int i = 0; i < core->count; ++i) {
+		CTTabHandle tab = core->slots[i];
+		CTTabRecord* record = &core->records[tab];
+		if (!record->live) {
+			if (i < miniTabCount)
+				core->miniTabCount--;
+			record->live = true;
+			CTTabStripCoreReleaseRecord(core, tab);
+			continue;
+		}
+		if (i == nextActiveIndex)
+			newActiveIndex = count;
+		if (i == core->anchorIndex)
+			newAnchorIndex = count;
+		// Renumber on the way, since every slot is visited anyway.
+		record->index = count;
+		core->slots[count++] = tab;
+	}
+	core->count = count;
+	core->firstStaleIndex = count;
+	CTBitVectorRemoveMarked(&core->pinned, marked);
+	CTBitVectorRemoveMarked(&core->blocked, marked);
+	CTBitVectorRemoveMarked(&core->app, marked);
+	core->activeIndex = count ? newActiveIndex : CTTabStripCoreNoTab;
+
+	// Closing the active tab leaves its replacement as the only selected tab.
+	// Otherwise the rest of the selection stays, and a closed anchor moves to
+	// the active tab.
+	if (activeIsClosing || !count) {
+		CTTabStripCoreSelectOnly(core, core->activeIndex);
+	} else {
+		CTRangeSetRemoveMarked(&core->selection, marked);
+		core->anchorIndex = newAnchorIndex != CTTabStripCoreNoTab ?
+		    newAnchorIndex : core->activeIndex;
+	}
+	return core->activeIndex;
+}
+
+bool CTTabStripCoreCanMove(const CTTabStripCore* core, int from, int to) {
+	assert(from >= 0 && from < core->count);
+	assert(to >= 0 && to < core->count);
+	int firstNonMiniTab = core->miniTabCount;
+	return !((from < firstNonMiniTab && to >= firstNonMiniTab) ||
+	         (to < firstNonMiniTab && from >= firstNonMiniTab));
+}
+
+// Returns where the tab at |index| ends up when the tab at |from| moves to
+// |to|.
+static int CTTabStripCoreIndexAfterMove(int index, int from, int to) {
+	if (index == CTTabStripCoreNoTab)
+		return index;
+	if (index == from)
+		return to;
+	if (from < index && to >= index)
+		return index - 1;
+	if (from > index && to <= index)
+		return index + 1;
+	return index;
+}
+
+void CTTabStripCoreMove(CTTabStripCore* core,
+                        int from,
+                        int to,
+                        bool selectAfterMove) {
+	assert(from >= 0 && from < core->count);
+	assert(to >= 0 && to < core->count);
+	CTTabHandle tab = core->slots[from];
+	if (from < to) {
+		memmove(&core->slots[from], &core->slots[from + 1],
+		        (to - from) * sizeof(CTTabHandle));
+	} else {
+		memmove(&core->slots[to + 1], &core->slots[to],
+		        (from - to) * sizeof(CTTabHandle));
+	}
+	core->slots[to] = tab;
+	CTTabStripCoreInvalidateFrom(core, from < to ? from : to);
+	// Relabel the tab for its new place, and file it again under its opener.
+	CTTabStripCoreUnlinkFromOpener(core, tab);
+	CTTabStripCoreAssignOrder(core, to);
+	CTTabStripCoreLinkToOpener(core, tab);
+	CTBitVectorMove(&core->pinned, from, to);
+	CTBitVectorMove(&core->blocked, from, to);
+	CTBitVectorMove(&core->app, from, to);
+
+	if (selectAfterMove) {
+		core->activeIndex = to;
+		CTTabStripCoreSelectOnly(core, to);
+		return;
+	}
+	core->activeIndex = CTTabStripCoreIndexAfterMove(core->activeIndex, from, to);
+	core->anchorIndex = CTTabStripCoreIndexAfterMove(core->anchorIndex, from, to);
+	CTRangeSetMoveSlot(&core->selection, from, to);
+}
+
+void CTTabStripCoreReorder(CTTabStripCore* core, const int* permutation) {
+	int count = core->count;
+	CTTabHandle* slots = (CTTabHandle*)malloc((count ? count : 1) * sizeof(CTTabHandle));
+	assert(slots);
+	CTBitVector pinned = core->pinned;
+	CTBitVector blocked = core->blocked;
+	CTBitVector app = core->app;
+	CTBitVectorInit(&core->pinned);
+	CTBitVectorInit(&core->blocked);
+	CTBitVectorInit(&core->app);
+	CTBitVectorResize(&core->pinned, count);
+	CTBitVectorResize(&core->blocked, count);
+	CTBitVectorResize(&core->app, count);
+	CTRangeSet selection = core->selection;
+	CTRangeSetInit(&core->selection);
+	int activeIndex = CTTabStripCoreNoTab;
+	int anchorIndex = CTTabStripCoreNoTab;
+	for (int i = 0; i < count; ++i) {
+		int from = permutation[i];
+		slots[i] = core->slots[from];
+		core->records[slots[i]].index = i;
+		CTBitVectorSet(&core->pinned, i, CTBitVectorGet(&pinned, from));
+		CTBitVectorSet(&core->blocked, i, CTBitVectorGet(&blocked, from));
+		CTBitVectorSet(&core->app, i, CTBitVectorGet(&app, from));
+		if (CTRangeSetContains(&selection, from))
+			CTRangeSetAdd(&core->selection, i, i + 1);
+		if (from == core->activeIndex)
+			activeIndex = i;
+		if (from == core->anchorIndex)
+			anchorIndex = i;
+	}
+	CTBitVectorFree(&pinned);
+	CTBitVectorFree(&blocked);
+	CTBitVectorFree(&app);
+	CTRangeSetFree(&selection);
+	core->anchorIndex = anchorIndex;
+	free(core->slots);
+	core->slots = slots;
+	core->slotCapacity = count;
+	core->firstStaleIndex = count;
+	core->activeIndex = activeIndex;
+
+	// Relabel the tabs in their new order and file them again, in that order,
+	// under their openers.
+	CTOrderLabelList list = {
+		core, CTTabStripCoreGetOrder, CTTabStripCoreSetOrder
+	};
+	CTOrderLabelsSpread(&list, count);
+	for (int i = 0; i < count; ++i)
+		core->records[slots[i]].openedCount = 0;
+	for (int i = 0; i < count; ++i)
+		CTTabStripCoreLinkToOpener(core, slots[i]);
+}
+
+const CTRangeSet* CTTabStripCoreSelection(const CTTabStripCore* core) {
+	return &core->selection;
+}
+
+bool CTTabStripCoreIsSelected(const CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	return CTRangeSetContains(&core->selection, index);
+}
+
+int CTTabStripCoreAnchorIndex(const CTTabStripCore* core) {
+	return core->anchorIndex;
+}
+
+void CTTabStripCoreToggleSelected(CTTabStripCore* core, int index) {
+	assert(index >= 0 && index < core->count);
+	if (!CTRangeSetContains(&core->selection, index)) {
+		CTRangeSetAdd(&core->selection, index, index + 1);
+		core->activeIndex = index;
+		core->anchorIndex = index;
+		return;
+	}
+	if (core->selection.size == 1)
+		return;
+	CTRangeSetRemove(&core->selection, index, index + 1);
+	if (index != core->activeIndex)
+		return;
+	int next = CTRangeSetNext(&core->selection, index);
+	if (next == -1)
+		next = CTRangeSetPrevious(&core->selection, index);
+	core->activeIndex = next;
+	core->anchorIndex = next;
+}
+
+void CTTabStripCoreExtendSelection(CTTabStripCore* core, int index, bool add) {
+	assert(index >= 0 && index < core->count);
+	int anchor = core->anchorIndex;
+	if (anchor == CTTabStripCoreNoTab) {
+		anchor = index;
+		core->anchorIndex = index;
+	}
+	if (!add)
+		CTRangeSetClear(&core->selection);
+	if (anchor < index)
+		CTRangeSetAdd(&core->selection, anchor, index + 1);
+	else
+		CTRangeSetAdd(&core->selection, index, anchor + 1);
+	core->activeIndex = index;
+}
+
+// Fills |permutation| with the tabs of |order| (|count| indices), mini-tabs
+// first, keeping their order otherwise.
+static void CTTabStripCorePartitionMiniTabs(const CTTabStripCore* core,
+                                            const int* order,
+                                            int count,
+                                            int* permutation) {
+	int next = 0;
+	for (int i = 0; i < count; ++i) {
+		if (CTTabStripCoreIsMini(core, order[i]))
+			permutation[next++] = order[i];
+	}
+	for (int i = 0; i < count; ++i) {
+		if (!CTTabStripCoreIsMini(core, order[i]))
+			permutation[next++] = order[i];
+	}
+}
+
+int CTTabStripCoreSetSelectionPinned(CTTabStripCore* core,
+                                     bool pinned,
+                                     int* permutation) {
+	int changed = 0;
+	for (int r = 0; r < core->selection.count; ++r) {
+		CTRange range = core->selection.ranges[r];
+		for (int i = range.start; i < range.end; ++i) {
+			if (CTBitVectorGet(&core->app, i) ||
+			    CTBitVectorGet(&core->pinned, i) == pinned) {
+				continue;
+			}
+			CTBitVectorSet(&core->pinned, i, pinned);
+			changed++;
+		}
+	}
+	core->miniTabCount += pinned ? changed : -changed;
+
+	int* order = (int*)malloc((core->count ? core->count : 1) * sizeof(int));
+	assert(order);
+	for (int i = 0; i < core->count; ++i)
+		order[i] = i;
+	CTTabStripCorePartitionMiniTabs(core, order, core->count, permutation);
+	free(order);
+	return changed;
+}
+
+void CTTabStripCorePermutationForMovingSelection(const CTTabStripCore* core,
+                                                 int index,
+                                                 int* permutation) {
+	int unselectedCount = core->count - core->selection.size;
+	if (index < 0)
+		index = 0;
+	if (index > unselectedCount)
+		index = unselectedCount;
+	int* order = (int*)malloc((core->count ? core->count : 1) * sizeof(int));
+	assert(order);
+	// The unselected tabs, with a gap of the selection's size at |index|.
+	int next = 0;
+	for (int i = 0; i < core->count; ++i) {
+		if (CTRangeSetContains(&core->selection, i))
+			continue;
+		if (next == index)
+			next += core->selection.size;
+		order[next++] = i;
+	}
+	next = index;
+	for (int r = 0; r < core->selection.count; ++r) {
+		CTRange range = core->selection.ranges[r];
+		for (int i = range.start; i < range.end; ++i)
+			order[next++] = i;
+	}
+	CTTabStripCorePartitionMiniTabs(core, order, core->count, permutation);
+	free(order);
+}
+
+int CTTabStripCoreIndexToActivateAfterClosing(CTTabStripCore* core,
+                                              int removedIndex) {
+	assert(removedIndex >= 0 && removedIndex < core->count);
+	CTTabHandle removed = core->slots[removedIndex];
+
+	// The tab the user was looking at before is the most likely to still be
+	// warm, so go back to it. Then the first tab the closed one opened, then
+	// the next one opened by the same tab, then the tab that opened it.
+	int index = CTTabStripCoreMostRecentlyActiveExcept(core, removed, NULL);
+	if (index == CTTabStripCoreNoTab)
+		index = CTTabStripCoreNearestOpenedBy(core, removed, removedIndex, NULL);
+	CTTabHandle opener = core->records[removed].opener;
+	if (index == CTTabStripCoreNoTab && opener) {
+		index = CTTabStripCoreNearestOpenedBy(core, opener, removedIndex, NULL);
+		if (index == CTTabStripCoreNoTab)
+			index = CTTabStripCoreFindTab(core, opener);
+	}
+	if (index != CTTabStripCoreNoTab)
+		return removedIndex < index ? index - 1 : index;
+
+	// Otherwise the neighbour that slides into place, or the one to the left
+	// at the end of the strip.
+	int activeIndex = core->activeIndex;
+	if (activeIndex >= core->count - 1)
+		return activeIndex - 1;
+	return activeIndex;
+}
+
+int CTTabStripCoreIndexToActivateAfterClosingMarked(CTTabStripCore* core,
+                                                    const CTBitVector* marked) {
+	int activeIndex = core->activeIndex;
+	assert(activeIndex != CTTabStripCoreNoTab && CTBitVectorGet(marked, activeIndex));
+	CTTabHandle active = core->slots[activeIndex];
+
+	// Same preference as for a single tab, skipping anything that closes too.
+	int index = CTTabStripCoreMostRecentlyActiveExcept(core, active, marked);
+	if (index != CTTabStripCoreNoTab)
+		return index;
+	index = CTTabStripCoreNearestOpenedBy(core, active, activeIndex, marked);
+	if (index != CTTabStripCoreNoTab)
+		return index;
+	CTTabHandle opener = core->records[active].opener;
+	if (opener) {
+		index = CTTabStripCoreNearestOpenedBy(core, opener, activeIndex, marked);
+		if (index != CTTabStripCoreNoTab)
+			return index;
+		index = CTTabStripCoreFindTab(core, opener);
+		if (!CTBitVectorGet(marked, index))
+			return index;
+	}
+
+	// Otherwise the first tab to the right that stays open, like closing the
+	// tabs one at a time would, then the nearest one to the left.
+	for (int i = activeIndex + 1; i < core->count; ++i) {
+		if (!CTBitVectorGet(marked, i))
+			return i;
+	}
+	for (int i = activeIndex - 1; i >= 0; --i) {
+		if (!CTBitVectorGet(marked, i))
+			return i;
+	}
+	return CTTabStripCoreNoTab;
+}
+
+int CTTabStripCoreIndexOfPreviouslyActiveTab(CTTabStripCore* core) {
+	CTTabHandle active = core->activeIndex == CTTabStripCoreNoTab ?
+	    CTNoTabHandle : core->slots[core->activeIndex];
+	return CTTabStripCoreMostRecentlyActiveExcept(core, active, NULL);
+}
@@ -0,0 +1,252 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef CT_TAB_STRIP_CORE_H_
+#define CT_TAB_STRIP_CORE_H_
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "CTBitVector.h"
+#include "CTRangeSet.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The index level semantics of a tab strip, without Foundation: which slots
+// hold mini-tabs, which tab is active and which other tabs are selected, who
+// opened whom, which tab was active before, and the rules built on those
+// (where a new tab goes, where selection goes when tabs close, which moves
+// are allowed).
+//
+// CTTabStripModel keeps the order, flags and openers of its tabs in one and
+// only each tab's contents itself, and CTTabStripModelOrderController is a thin wrapper around its rules. On its
+// own it is what tools/tab-strip-core benchmarks.
+//
+// Tabs are referred to by index, or by the handle they get when inserted,
+// which stays the same while the tab is in the strip. The core caches the
+// slot of every handle; an insert, remove or move leaves the cached slots
+// after it stale, and looking those up is a binary search by order label
+// until a pass over the whole strip renumbers them.
+typedef struct CTTabStripCore CTTabStripCore;
+
+typedef uint32_t CTTabHandle;
+
+// The handle of no tab.
+#define CTNoTabHandle ((CTTabHandle)0)
+// The index of no tab, as returned by the lookups and rules below.
+#define CTTabStripCoreNoTab (-1)
+
+// The per-tab flags.
+enum {
+	CTTabStripCorePinned = 1 << 0,
+	CTTabStripCoreBlocked = 1 << 1,
+	// App tabs are always pinned.
+	CTTabStripCoreApp = 1 << 2,
+};
+
+// Where |CTTabStripCoreInsertionIndexForLink| and
+// |CTTabStripCoreInsertionIndexForAppending| put new tabs, relative to the
+// active tab or the end of the strip. Matches InsertionPolicy.
+typedef enum {
+	CTTabStripCoreInsertAfter,
+	CTTabStripCoreInsertBefore,
+} CTTabStripCoreInsertionPolicy;
+
+CTTabStripCore* CTTabStripCoreCreate(void);
+void CTTabStripCoreFree(CTTabStripCore* core);
+
+int CTTabStripCoreCount(const CTTabStripCore* core);
+
+// The active index, or CTTabStripCoreNoTab.
+int CTTabStripCoreActiveIndex(const CTTabStripCore* core);
+
+// Makes the tab at |index| the active one, and the only selected one, or
+// none if |index| is CTTabStripCoreNoTab. Does not touch the activation
+// history; see |CTTabStripCoreTabWasActivated|.
+void CTTabStripCoreSetActiveIndex(CTTabStripCore* core, int index);
+
+// Moves the tab at |index| to the front of the activation history, which is
+// where selection goes first when the active tab closes. The model calls it
+// once observers have been told about the new active tab, so that changes
+// made while updating only count once.
+void CTTabStripCoreTabWasActivated(CTTabStripCore* core, int index);
+
+CTTabHandle CTTabStripCoreTabAtIndex(const CTTabStripCore* core, int index);
+
+// Returns the index of |tab|, or CTTabStripCoreNoTab if it isn't in the
+// strip. O(1) if its cached slot is still valid, else O(log n); never
+// renumbers the strip.
+int CTTabStripCoreIndexOfTab(const CTTabStripCore* core, CTTabHandle tab);
+
+// Whether |tab| comes before |other| in the strip, without looking up
+// either index. Both must be in the strip.
+bool CTTabStripCoreIsBefore(const CTTabStripCore* core,
+                            CTTabHandle tab,
+                            CTTabHandle other);
+
+// The tab that opened |tab|, or CTNoTabHandle. Openers are forgotten when
+// they leave the strip.
+CTTabHandle CTTabStripCoreOpenerOfTab(const CTTabStripCore* core,
+                                      CTTabHandle tab);
+void CTTabStripCoreSetOpener(CTTabStripCore* core,
+                             CTTabHandle tab,
+                             CTTabHandle opener);
+
+// The tabs |opener| opened, in strip order: how many there are, and the one
+// at |position| among them.
+int CTTabStripCoreOpenedTabCount(const CTTabStripCore* core,
+                                 CTTabHandle opener);
+CTTabHandle CTTabStripCoreOpenedTab(const CTTabStripCore* core,
+                                    CTTabHandle opener,
+                                    int position);
+
+// Returns the index of the first tab after |index| that |opener| opened, or
+// failing that the closest one before |index|, or CTTabStripCoreNoTab.
+// |index| may be outside the strip. A binary search of the tabs |opener|
+// opened.
+int CTTabStripCoreIndexOfNextTabOpenedBy(const CTTabStripCore* core,
+                                         CTTabHandle opener,
+                                         int index);
+
+// Flags.
+bool CTTabStripCoreIsPinned(const CTTabStripCore* core, int index);
+bool CTTabStripCoreIsBlocked(const CTTabStripCore* core, int index);
+bool CTTabStripCoreIsApp(const CTTabStripCore* core, int index);
+bool CTTabStripCoreIsMini(const CTTabStripCore* core, int index);
+void CTTabStripCoreSetBlocked(CTTabStripCore* core, int index, bool blocked);
+// The flags, one bit per slot, for scanning and counting.
+const CTBitVector* CTTabStripCorePinnedTabs(const CTTabStripCore* core);
+const CTBitVector* CTTabStripCoreBlockedTabs(const CTTabStripCore* core);
+
+// Sets the pinned flag of the tab at |index|. Returns the index the tab has
+// to be moved to with |CTTabStripCoreMove| now that it is a mini-tab or not,
+// which is |index| if it can stay where it is.
+int CTTabStripCoreSetPinned(CTTabStripCore* core, int index, bool pinned);
+
+// The number of mini-tabs (pinned or app tabs), which always come first, so
+// also the index of the first non-mini-tab.
+int CTTabStripCoreMiniTabCount(const CTTabStripCore* core);
+
+// Returns |index| clamped to the part of the strip where a mini-tab, or a
+// non-mini-tab, may be inserted.
+int CTTabStripCoreConstrainInsertionIndex(const CTTabStripCore* core,
+                                          int index,
+                                          bool miniTab);
+
+CTTabStripCoreInsertionPolicy CTTabStripCoreGetInsertionPolicy(
+    const CTTabStripCore* core);
+void CTTabStripCoreSetInsertionPolicy(CTTabStripCore* core,
+                                      CTTabStripCoreInsertionPolicy policy);
+
+// Where a tab opened by a link in the active tab goes.
+int CTTabStripCoreInsertionIndexForLink(const CTTabStripCore* core);
+// Where an appended tab goes.
+int CTTabStripCoreInsertionIndexForAppending(const CTTabStripCore* core);
+
+// Inserts a tab with |flags| at |index|, which must already be constrained
+// for it, opened by |opener| (or CTNoTabHandle). The active tab stays
+// active. Returns the new tab's handle.
+CTTabHandle CTTabStripCoreInsert(CTTabStripCore* core,
+                                 int index,
+                                 unsigned flags,
+                                 CTTabHandle opener);
+
+// Removes the tab at |index|. If it was active, the tab chosen by
+// |CTTabStripCoreIndexToActivateAfterClosing| becomes active. Returns the
+// active index afterwards.
+int CTTabStripCoreRemove(CTTabStripCore* core, int index);
+
+// Removes the tabs whose bits are set in |marked|, which has a bit per tab,
+// in one pass. If the active tab is one of them, the tab chosen by
+// |CTTabStripCoreIndexToActivateAfterClosingMarked| becomes active. Returns
+// the active index afterwards.
+int CTTabStripCoreRemoveMarked(CTTabStripCore* core, const CTBitVector* marked);
+
+// Whether the tab at |from| may be moved to |to| without mixing mini-tabs
+// with the others.
+bool CTTabStripCoreCanMove(const CTTabStripCore* core, int from, int to);
+
+// Moves the tab at |from| to |to|. The active tab stays active unless
+// |selectAfterMove|, in which case the moved tab becomes active and the only
+// selected tab.
+void CTTabStripCoreMove(CTTabStripCore* core,
+                        int from,
+                        int to,
+                        bool selectAfterMove);
+
+// Rearranges the tabs so that the one at |i| is the one that was at
+// |permutation[i]|. The active tab stays active, and the selection follows
+// the tabs.
+void CTTabStripCoreReorder(CTTabStripCore* core, const int* permutation);
+
+// Multiple selection. Besides the active tab, which is always selected, any
+// number of tabs can be selected. The selection is kept as ranges and
+// follows the tabs as they are inserted, removed and moved. When the active
+// tab closes, or is moved with |selectAfterMove|, the tab that becomes
+// active is the only one selected afterwards.
+//
+// The selected tabs.
+const CTRangeSet* CTTabStripCoreSelection(const CTTabStripCore* core);
+bool CTTabStripCoreIsSelected(const CTTabStripCore* core, int index);
+
+// The tab a range selection extends from: the last one made active by
+// |CTTabStripCoreSetActiveIndex| or added by
+// |CTTabStripCoreToggleSelected|, or CTTabStripCoreNoTab.
+int CTTabStripCoreAnchorIndex(const CTTabStripCore* core);
+
+// Adds the tab at |index| to the selection and makes it active and the
+// anchor, or takes it out of the selection, like a Cmd-click. When the
+// active tab is taken out, the nearest selected tab after it (else before
+// it) becomes active. The last selected tab stays selected.
+void CTTabStripCoreToggleSelected(CTTabStripCore* core, int index);
+
+// Selects the tabs from the anchor to |index| and makes |index| active, like
+// a Shift-click. The range replaces the selection unless |add|. The anchor
+// stays where it is.
+void CTTabStripCoreExtendSelection(CTTabStripCore* core, int index, bool add);
+
+// Sets the pinned flag of every selected tab that isn't an app, in one pass
+// over the selection. Fills |permutation| (one entry per tab) with the
+// order that puts the mini-tabs back in front, keeping the order of the
+// tabs otherwise, for |CTTabStripCoreReorder|. Returns the number of tabs
+// whose flag changed.
+int CTTabStripCoreSetSelectionPinned(CTTabStripCore* core,
+                                     bool pinned,
+                                     int* permutation);
+
+// Fills |permutation| (one entry per tab) with the order, for
+// |CTTabStripCoreReorder|, that moves the selected tabs next to each other
+// so that the first of them is at |index| among the tabs that aren't
+// selected. The selected mini-tabs and the others each stay on their side
+// of the strip.
+void CTTabStripCorePermutationForMovingSelection(const CTTabStripCore* core,
+                                                 int index,
+                                                 int* permutation);
+
+// Where selection goes when the active tab at |removedIndex| closes, as an
+// index after it is removed: the most recently active other tab, else the
+// next tab it opened, else the next tab its opener opened, else its opener,
+// else its neighbour.
+int CTTabStripCoreIndexToActivateAfterClosing(CTTabStripCore* core,
+                                              int removedIndex);
+
+// Like |CTTabStripCoreIndexToActivateAfterClosing| for the active tab
+// closing with the rest of |marked|, skipping tabs that close too. Returns
+// an index from before the tabs are removed, or CTTabStripCoreNoTab if they
+// all close.
+int CTTabStripCoreIndexToActivateAfterClosingMarked(CTTabStripCore* core,
+                                                    const CTBitVector* marked);
+
+// The most recently active tab other than the active one, or
+// CTTabStripCoreNoTab.
+int CTTabStripCoreIndexOfPreviouslyActiveTab(CTTabStripCore* core);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CT_TAB_STRIP_CORE_H_
@@ -0,0 +1,563 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+// Times the tab strip core (src/Utils/CTTabStripCore.h) and the tab layout
+// (src/Utils/CTTabLayout.h) on strips of many tabs, so that changes to their
+// algorithms can be checked without a Mac.
+//
+//   benchmark [tab count] [seed]
+//
+// Every workload starts from a strip of |tab count| tabs (10000 by default)
+// and prints the time per operation.
+
+#include "CTTabLayout.h"
+#include "CTTabStripCore.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t gRandomState;
+
+// xorshift64*, so that runs are repeatable across C libraries.
+static uint32_t RandomNext(void) {
+	gRandomState ^= gRandomState >> 12;
+	gRandomState ^= gRandomState << 25;
+	gRandomState ^= gRandomState >> 27;
+	return (uint32_t)((gRandomState * 2685821657736338717ULL) >> 32);
+}
+
+static int RandomBelow(int bound) {
+	return bound > 0 ? (int)(RandomNext() % (uint32_t)bound) : 0;
+}
+
+static double Now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void Report(const char* name, int operations, double seconds) {
+	printf("%-24s %8d ops %10.3f ms %10.1f ns/op\n", name, operations,
+	       seconds * 1e3, operations ? seconds * 1e9 / operations : 0.0);
+}
+
+// Checks what every workload has to leave intact.
+static void CheckInvariants(CTTabStripCore* core) {
+	int count = CTTabStripCoreCount(core);
+	int miniTabCount = CTTabStripCoreMiniTabCount(core);
+	for (int i = 0; i < count; ++i) {
+		if (CTTabStripCoreIsMini(core, i) != (i < miniTabCount)) {
+			fprintf(stderr, "mini-tab at %d is out of place\n", i);
+			abort();
+		}
+		if (CTTabStripCoreIndexOfTab(core, CTTabStripCoreTabAtIndex(core, i)) != i) {
+			fprintf(stderr, "stale slot for tab at %d\n", i);
+			abort();
+		}
+	}
+	int active = CTTabStripCoreActiveIndex(core);
+	if (count ? (active < 0 || active >= count) : active != CTTabStripCoreNoTab) {
+		fprintf(stderr, "active index %d out of range\n", active);
+		abort();
+	}
+}
+
+static void Select(CTTabStripCore* core, int index) {
+	CTTabStripCoreSetActiveIndex(core, index);
+	CTTabStripCoreTabWasActivated(core, index);
+}
+
+// A strip of |count| tabs opened the way a user would: mostly appended, some
+// by links from the active tab, a few of them pinned.
+static CTTabStripCore* NewStrip(int count) {
+	CTTabStripCore* core = CTTabStripCoreCreate();
+	for (int i = 0; i < count; ++i) {
+		bool link = i && RandomBelow(4) == 0;
+		unsigned flags = RandomBelow(64) == 0 ? CTTabStripCorePinned : 0;
+		int index = link ? CTTabStripCoreInsertionIndexForLink(core) :
+		    CTTabStripCoreInsertionIndexForAppending(core);
+		index = CTTabStripCoreConstrainInsertionIndex(
+		    core, index, flags & CTTabStripCorePinned);
+		int active = CTTabStripCoreActiveIndex(core);
+		CTTabHandle opener = link && active != CTTabStripCoreNoTab ?
+		    CTTabStripCoreTabAtIndex(core, active) : CTNoTabHandle;
+		CTTabHandle tab = CTTabStripCoreInsert(core, index, flags, opener);
+		if (RandomBelow(3) == 0)
+			Select(core, CTTabStripCoreIndexOfTab(core, tab));
+	}
+	if (CTTabStripCoreActiveIndex(core) == CTTabStripCoreNoTab && count)
+		Select(core, 0);
+	return core;
+}
+
+static void BenchmarkInsert(int count) {
+	double start = Now();
+	CTTabStripCore* core = NewStrip(count);
+	Report("insert", count, Now() - start);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+static void BenchmarkMove(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	int moves = 0;
+	double start = Now();
+	for (int i = 0; i < count; ++i) {
+		int from = RandomBelow(count);
+		int to = RandomBelow(count);
+		if (!CTTabStripCoreCanMove(core, from, to))
+			continue;
+		CTTabStripCoreMove(core, from, to, i % 8 == 0);
+		++moves;
+	}
+	Report("move", moves, Now() - start);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+static void BenchmarkPin(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	double start = Now();
+	for (int i = 0; i < count; ++i) {
+		int index = RandomBelow(count);
+		if (CTTabStripCoreIsApp(core, index))
+			continue;
+		int to = CTTabStripCoreSetPinned(core, index,
+		                                 !CTTabStripCoreIsPinned(core, index));
+		if (to != index)
+			CTTabStripCoreMove(core, index, to, false);
+	}
+	Report("pin", count, Now() - start);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+static void BenchmarkSelect(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	double start = Now();
+	for (int i = 0; i < count; ++i) {
+		int index = i % 4 ? RandomBelow(count) :
+		    CTTabStripCoreIndexOfPreviouslyActiveTab(core);
+		if (index != CTTabStripCoreNoTab)
+			Select(core, index);
+	}
+	Report("select", count, Now() - start);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+// Gives random tabs another opener, or none, the way the model refiles a tab
+// whose |parentOpener| changes. Filing a tab under its opener is a binary
+// search of the tabs that opener opened, by order label, so it doesn't
+// depend on the size of the strip.
+static void BenchmarkOpeners(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	int openerCount = count / 64 + 1;
+	CTTabHandle* openers = (CTTabHandle*)malloc(openerCount * sizeof(CTTabHandle));
+	assert(openers);
+	for (int i = 0; i < openerCount; ++i)
+		openers[i] = CTTabStripCoreTabAtIndex(core, RandomBelow(count));
+	double start = Now();
+	for (int i = 0; i < count; ++i) {
+		CTTabHandle tab = CTTabStripCoreTabAtIndex(core, RandomBelow(count));
+		CTTabStripCoreSetOpener(core, tab, i % 4 ?
+		    openers[RandomBelow(openerCount)] : CTNoTabHandle);
+	}
+	Report("link/unlink", count, Now() - start);
+	// Where selection goes next among the tabs an opener opened, a binary
+	// search of them as well.
+	int found = 0;
+	start = Now();
+	for (int i = 0; i < count; ++i) {
+		found += CTTabStripCoreIndexOfNextTabOpenedBy(
+		    core, openers[RandomBelow(openerCount)], RandomBelow(count)) !=
+		    CTTabStripCoreNoTab;
+	}
+	Report("next opened by", count, Now() - start);
+	if (!found) {
+		fprintf(stderr, "no tab opened by any opener\n");
+		abort();
+	}
+	free(openers);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+// Inserts tabs in front of the others and looks up a random tab after each,
+// the way the model finds the tab of some contents. Every insert leaves the
+// slots after it stale, so the lookups are binary searches rather than
+// renumbering the strip.
+static void BenchmarkLookup(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	CTTabHandle* tabs = (CTTabHandle*)malloc(count * sizeof(CTTabHandle));
+	assert(tabs);
+	for (int i = 0; i < count; ++i)
+		tabs[i] = CTTabStripCoreTabAtIndex(core, i);
+	int found = 0;
+	double start = Now();
+	for (int i = 0; i < count; ++i) {
+		CTTabStripCoreInsert(core, CTTabStripCoreMiniTabCount(core), 0,
+		                     CTNoTabHandle);
+		found += CTTabStripCoreIndexOfTab(core, tabs[RandomBelow(count)]) !=
+		    CTTabStripCoreNoTab;
+	}
+	Report("insert and look up", count, Now() - start);
+	if (found != count) {
+		fprintf(stderr, "found %d of %d tabs\n", found, count);
+		abort();
+	}
+	free(tabs);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+// Closes the active tab until the strip is empty, activating whatever the
+// selection rules pick, like holding down Cmd-W.
+static void BenchmarkCloseActive(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	double start = Now();
+	while (CTTabStripCoreCount(core)) {
+		int active = CTTabStripCoreRemove(core, CTTabStripCoreActiveIndex(core));
+		if (active != CTTabStripCoreNoTab)
+			CTTabStripCoreTabWasActivated(core, active);
+	}
+	Report("close active", count, Now() - start);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+static void BenchmarkCloseRandom(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	double start = Now();
+	while (CTTabStripCoreCount(core)) {
+		int active = CTTabStripCoreRemove(core,
+		                                  RandomBelow(CTTabStripCoreCount(core)));
+		if (active != CTTabStripCoreNoTab)
+			CTTabStripCoreTabWasActivated(core, active);
+	}
+	Report("close random", count, Now() - start);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+// Closes the tabs one tab opened, last first, with no activation history to
+// fall back on, so that every time the tab to select next is found among
+// the tabs the same tab opened. Half the strip, which that tab didn't open,
+// comes after them.
+static void BenchmarkCloseSelection(int count) {
+	CTTabStripCore* core = CTTabStripCoreCreate();
+	CTTabHandle opener = CTTabStripCoreInsert(core, 0, 0, CTNoTabHandle);
+	int opened = count / 2;
+	for (int i = 1; i < count; ++i)
+		CTTabStripCoreInsert(core, i, 0, i <= opened ? opener : CTNoTabHandle);
+	CTTabStripCoreSetActiveIndex(core, opened);
+	double start = Now();
+	int closed = 0;
+	int active = opened;
+	while (active != CTTabStripCoreNoTab &&
+	       CTTabStripCoreTabAtIndex(core, active) != opener) {
+		active = CTTabStripCoreRemove(core, active);
+		++closed;
+	}
+	Report("close selection", closed, Now() - start);
+	if (closed != opened) {
+		fprintf(stderr, "closed %d of the %d opened tabs\n", closed, opened);
+		abort();
+	}
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+// Closes every other tab at once, like "Close Other Tabs" on half the strip.
+static void BenchmarkCloseMarked(int count) {
+	CTTabStripCore* core = NewStrip(count);
+	CTBitVector marked;
+	CTBitVectorInit(&marked);
+	CTBitVectorResize(&marked, count);
+	for (int i = 0; i < count; i += 2)
+		CTBitVectorSet(&marked, i, true);
+	double start = Now();
+	CTTabStripCoreRemoveMarked(core, &marked);
+	Report("close marked", count / 2 + count % 2, Now() - start);
+	CTBitVectorFree(&marked);
+	CheckInvariants(core);
+	CTTabStripCoreFree(core);
+}
+
+// The tab widths of CTTabController, and a 1440 point wide window.
+static const CTTabLayoutParameters kLayoutParameters = {
+	.maxTabWidth = 220,
+	.minTabWidth = 31,
+	.minActiveTabWidth = 46,
+	.miniTabWidth = 53,
+	.appTabWidth = 66,
+	.tabOverlap = 19,
+	.lastMiniTabSpacing = 3,
+	.start = 70,
+	.availableWidth = 1440 - 70 - 34 - 8,
+};
+
+// Checks that the tabs laid out follow each other with the right overlap and
+// have widths the layout allows.
+static void CheckLayout(const CTTabLayoutParameters* params,
+                        const CTTabLayoutFlags* flags,
+                        int count,
+                        const CTTabLayoutFrame* frames,
+                        CTTabLayoutResult result) {
+	double offset = params->start;
+	bool isLastTabMini = false;
+	for (int i = 0; i < count; ++i) {
+		if (flags[i] & (CTTabLayoutClosing | CTTabLayoutHidden))
+			continue;
+		bool isMini = (flags[i] & CTTabLayoutMini) != 0;
+		if (!isMini && isLastTabMini)
+			offset += params->lastMiniTabSpacing;
+		isLastTabMini = isMini;
+		double width = frames[i].width;
+		double minWidth = isMini ? ((flags[i] & CTTabLayoutApp) ?
+		    params->appTabWidth : params->miniTabWidth) : params->minTabWidth;
+		double maxWidth = isMini ? minWidth : params->maxTabWidth + 1;
+		if (flags[i] & CTTabLayoutActive) {
+			minWidth = fmax(minWidth, params->minActiveTabWidth);
+			maxWidth = fmax(maxWidth, params->minActiveTabWidth);
+		}
+		if (frames[i].x != offset || width < minWidth || width > maxWidth ||
+		    width != floor(width)) {
+			fprintf(stderr, "tab %d laid out at %g wide %g, expected at %g\n",
+			        i, frames[i].x, width, offset);
+			abort();
+		}
+		offset += width - params->tabOverlap;
+	}
+	if (result.end != offset) {
+		fprintf(stderr, "layout ends at %g, expected %g\n", result.end, offset);
+		abort();
+	}
+}
+
+// Lays out |count| tabs with |flags| from scratch and checks that |frames|
+// and |result| are what an incremental update came up with.
+static void CheckIncrementalLayout(const CTTabLayoutParameters* params,
+                                   const CTTabLayoutFlags* flags,
+                                   int count,
+                                   const CTTabLayoutFrame* frames,
+                                   CTTabLayoutResult result) {
+	CTTabLayoutFrame* expected =
+	    (CTTabLayoutFrame*)calloc(count ? count : 1, sizeof(*expected));
+	assert(expected);
+	CTTabLayoutState state;
+	CTTabLayoutStateInit(&state);
+	int firstLaidOut;
+	CTTabLayoutResult expectedResult = CTTabLayoutUpdate(
+	    &state, params, flags, count, 0, expected, &firstLaidOut);
+	CTTabLayoutStateFree(&state);
+	for (int i = 0; i < count; ++i) {
+		if (flags[i] & (CTTabLayoutClosing | CTTabLayoutHidden))
+			continue;
+		if (frames[i].x != expected[i].x || frames[i].width != expected[i].width) {
+			fprintf(stderr, "tab %d laid out at %g wide %g, expected at %g wide %g\n",
+			        i, frames[i].x, frames[i].width, expected[i].x,
+			        expected[i].width);
+			abort();
+		}
+	}
+	if (result.end != expectedResult.end || result.minX != expectedResult.minX ||
+	    result.maxX != expectedResult.maxX) {
+		fprintf(stderr, "layout ends at %g, expected %g\n", result.end,
+		        expectedResult.end);
+		abort();
+	}
+	free(expected);
+}
+
+// Checks that the tabs |CTTabLayoutTabsBetween| finds between |minX| and
+// |maxX| include every tab laid out there.
+static void CheckTabsBetween(const CTTabLayoutState* state,
+                             const CTTabLayoutFlags* flags,
+                             const CTTabLayoutFrame* frames,
+                             double minX,
+                             double maxX) {
+	int first, end;
+	CTTabLayoutTabsBetween(state, minX, maxX, &first, &end);
+	for (int i = 0; i < state->count; ++i) {
+		if (flags[i] & (CTTabLayoutClosing | CTTabLayoutHidden |
+		                CTTabLayoutPlaceholder))
+			continue;
+		bool seen = frames[i].x < maxX && frames[i].x + frames[i].width > minX;
+		if (seen && (i < first || i >= end)) {
+			fprintf(stderr, "tab %d at %g is seen between %g and %g, not in [%d, %d)\n",
+			        i, frames[i].x, minX, maxX, first, end);
+			abort();
+		}
+	}
+}
+
+static CTTabLayoutFlags RandomTabFlags(bool mini) {
+	if (mini)
+		return CTTabLayoutMini | (RandomBelow(4) ? 0 : CTTabLayoutApp);
+	if (RandomBelow(100) == 0)
+		return CTTabLayoutClosing;
+	if (RandomBelow(50) == 0)
+		return CTTabLayoutHidden;
+	return 0;
+}
+
+// Lays out a strip of |count| tabs, a few of them mini, closing or in
+// collapsed groups, in a window that can't fit them and in one that can.
+// Then changes one tab at a time, which only lays out the tabs after it
+// while the tabs are at their minimum width.
+static void BenchmarkLayout(int count) {
+	const int changes = 1000;
+	int capacity = count + changes;
+	CTTabLayoutFlags* flags =
+	    (CTTabLayoutFlags*)malloc(capacity * sizeof(*flags));
+	CTTabLayoutFrame* frames =
+	    (CTTabLayoutFrame*)calloc(capacity, sizeof(*frames));
+	assert(flags && frames);
+	int miniTabCount = count / 64;
+	for (int i = 0; i < count; ++i)
+		flags[i] = RandomTabFlags(i < miniTabCount);
+	int active = miniTabCount + RandomBelow(count - miniTabCount);
+	flags[active] |= CTTabLayoutActive;
+
+	const int layouts = 1000;
+	CTTabLayoutParameters params = kLayoutParameters;
+	CTTabLayoutState state;
+	CTTabLayoutStateInit(&state);
+	CTTabLayoutResult result;
+	int firstLaidOut;
+	double start = Now();
+	for (int i = 0; i < layouts; ++i) {
+		CTTabLayoutStateInvalidate(&state);
+		result = CTTabLayoutUpdate(&state, &params, flags, count, 0, frames,
+		                           &firstLaidOut);
+	}
+	Report("layout (overflowing)", layouts, Now() - start);
+	CheckLayout(&params, flags, count, frames, result);
+
+	// Insert tabs, and select one after every insert, at random.
+	double seconds = 0;
+	for (int i = 0; i < changes; ++i) {
+		int index = miniTabCount + RandomBelow(count - miniTabCount + 1);
+		memmove(&flags[index + 1], &flags[index], (count - index) * sizeof(*flags));
+		flags[index] = RandomTabFlags(false);
+		++count;
+		if (active >= index)
+			++active;
+		start = Now();
+		result = CTTabLayoutUpdate(&state, &params, flags, count, index, frames,
+		                           &firstLaidOut);
+		seconds += Now() - start;
+		if (firstLaidOut > index) {
+			fprintf(stderr, "insert at %d laid out from %d\n", index,
+			        firstLaidOut);
+			abort();
+		}
+		CheckIncrementalLayout(&params, flags, count, frames, result);
+
+		int newActive = miniTabCount + RandomBelow(count - miniTabCount);
+		flags[active] &= ~CTTabLayoutActive;
+		flags[newActive] |= CTTabLayoutActive;
+		start = Now();
+		result = CTTabLayoutUpdate(&state, &params, flags, count,
+		                           active < newActive ? active : newActive,
+		                           frames, &firstLaidOut);
+		seconds += Now() - start;
+		active = newActive;
+		CheckIncrementalLayout(&params, flags, count, frames, result);
+	}
+	Report("layout (incremental)", 2 * changes, seconds);
+
+	// Drag a tab around. Becoming the placeholder changes the dragged tab,
+	// so the first update starts there.
+	flags[active] |= CTTabLayoutPlaceholder;
+	params.hasPlaceholder = true;
+	params.placeholderWidth = params.minActiveTabWidth;
+	seconds = 0;
+	for (int i = 0; i < changes; ++i) {
+		params.placeholderX = result.end * RandomBelow(1000) / 1000;
+		start = Now();
+		result = CTTabLayoutUpdate(&state, &params, flags, count,
+		                           i ? count : active, frames, &firstLaidOut);
+		seconds += Now() - start;
+		CheckIncrementalLayout(&params, flags, count, frames, result);
+		double minX = result.end * RandomBelow(1000) / 1000;
+		CheckTabsBetween(&state, flags, frames, minX, minX + 1440);
+	}
+	Report("layout (dragging)", changes, seconds);
+	flags[active] &= ~CTTabLayoutPlaceholder;
+	params.hasPlaceholder = false;
+
+	// Scroll the strip over the tabs: nothing is laid out again and only the
+	// tabs in sight are looked up. The dropped tab changed, so lay it out first.
+	result = CTTabLayoutUpdate(&state, &params, flags, count, active, frames,
+	                           &firstLaidOut);
+	seconds = 0;
+	for (int i = 0; i < changes; ++i) {
+		double minX = result.end * RandomBelow(1000) / 1000;
+		int first, end;
+		start = Now();
+		result = CTTabLayoutUpdate(&state, &params, flags, count, count, frames,
+		                           &firstLaidOut);
+		CTTabLayoutTabsBetween(&state, minX, minX + 1440, &first, &end);
+		seconds += Now() - start;
+		if (firstLaidOut != count) {
+			fprintf(stderr, "scrolling laid out from %d\n", firstLaidOut);
+			abort();
+		}
+		CheckTabsBetween(&state, flags, frames, minX, minX + 1440);
+	}
+	Report("layout (scrolling)", changes, seconds);
+
+	params.availableWidth = count * 97.3;
+	start = Now();
+	for (int i = 0; i < layouts; ++i) {
+		CTTabLayoutStateInvalidate(&state);
+		result = CTTabLayoutUpdate(&state, &params, flags, count, 0, frames,
+		                           &firstLaidOut);
+	}
+	Report("layout (fitting)", layouts, Now() - start);
+	CheckLayout(&params, flags, count, frames, result);
+	// App tabs are wider than the mini-tabs the room is divided for.
+	int appTabCount = 0;
+	for (int i = 0; i < miniTabCount; ++i)
+		appTabCount += (flags[i] & CTTabLayoutApp) != 0;
+	double appTabSlack = appTabCount * (params.appTabWidth - params.miniTabWidth);
+	if (result.end + params.tabOverlap >
+	    params.start + params.availableWidth + appTabSlack + 1) {
+		fprintf(stderr, "layout ends at %g, past the available width\n",
+		        result.end);
+		abort();
+	}
+
+	CTTabLayoutStateFree(&state);
+	free(flags);
+	free(frames);
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 10000;
+	gRandomState = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+	if (count <= 0 || !gRandomState) {
+		fprintf(stderr, "usage: %s [tab count] [nonzero seed]\n", argv[0]);
+		return 2;
+	}
+	printf("%d tabs, seed %llu\n", count, (unsigned long long)gRandomState);
+	BenchmarkInsert(count);
+	BenchmarkMove(count);
+	BenchmarkPin(count);
+	BenchmarkSelect(count);
+	BenchmarkOpeners(count);
+	BenchmarkLookup(count);
+	BenchmarkCloseActive(count);
+	BenchmarkCloseRandom(count);
+	BenchmarkCloseSelection(count);
+	BenchmarkCloseMarked(count);
+	BenchmarkLayout(count);
+	return 0;
+}
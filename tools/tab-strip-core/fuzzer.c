@@ -0,0 +1,816 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+// Drives the tab strip core (src/Utils/CTTabStripCore.h) and the reference
+// model in reference.c with the same random operations, and checks after
+// every step that they agree on the tabs, their flags, their order and
+// openers, the tabs each tab opened, the active tab, the selection and
+// every rule.
+//
+//   fuzzer [first seed] [seed count] [steps]
+//   fuzzer --replay <trace>
+//
+// Every operation is recorded with concrete indices, one per line. When the
+// models disagree, the operations up to and including the failing one are
+// written to fuzz-<seed>.trace, which --replay runs again step by step, so
+// a failure can be debugged without the generator. Traces are plain text
+// and can be trimmed by hand; lines starting with '#' are comments.
+
+#include "CTTabStripCore.h"
+#include "reference.h"
+#include <assert.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Small enough that closing and opening keep running into each other.
+static const int kMaxTabs = 40;
+
+typedef enum {
+	// insert <mode> <index> <flags> <opener index>: <mode> 0 inserts at
+	// <index> constrained, 1 where a link goes, 2 where appending goes.
+	kOpInsert,
+	// remove <index>
+	kOpRemove,
+	// remove-marked <index>...
+	kOpRemoveMarked,
+	// move <from> <to> <select after move>
+	kOpMove,
+	// reorder <permutation>...
+	kOpReorder,
+	// pin <index> <pinned>: also moves the tab where the core says.
+	kOpPin,
+	// block <index> <blocked>
+	kOpBlock,
+	// select <index>: makes it active and records the activation.
+	kOpSelect,
+	// set-active <index>: makes it active (or none, for -1) only.
+	kOpSetActive,
+	// toggle <index>: like a Cmd-click.
+	kOpToggle,
+	// extend <index> <add>: like a Shift-click, with Cmd if <add>.
+	kOpExtend,
+	// pin-selection <pinned>: then reorders the way the core says.
+	kOpPinSelection,
+	// move-selection <index>
+	kOpMoveSelection,
+	// set-opener <index> <opener index or -1>
+	kOpSetOpener,
+	// policy <0 after, 1 before>
+	kOpPolicy,
+	kOpCount,
+} OpType;
+
+static const struct {
+	const char* name;
+	int argumentCount;
+	bool hasList;
+} kOps[kOpCount] = {
+	{ "insert", 4, false },
+	{ "remove", 1, false },
+	{ "remove-marked", 0, true },
+	{ "move", 3, false },
+	{ "reorder", 0, true },
+	{ "pin", 2, false },
+	{ "block", 2, false },
+	{ "select", 1, false },
+	{ "set-active", 1, false },
+	{ "toggle", 1, false },
+	{ "extend", 2, false },
+	{ "pin-selection", 1, false },
+	{ "move-selection", 1, false },
+	{ "set-opener", 2, false },
+	{ "policy", 1, false },
+};
+
+typedef struct {
+	OpType type;
+	int arguments[4];
+	int* list;
+	int listCount;
+} Op;
+
+typedef struct {
+	Op* ops;
+	int count;
+	int capacity;
+} Trace;
+
+typedef struct {
+	CTTabStripCore* core;
+	RefStrip ref;
+} Strips;
+
+static uint64_t gRandomState;
+
+// xorshift64*, like the benchmark, so that a seed means the same everywhere.
+static uint32_t RandomNext(void) {
+	gRandomState ^= gRandomState >> 12;
+	gRandomState ^= gRandomState << 25;
+	gRandomState ^= gRandomState >> 27;
+	return (uint32_t)((gRandomState * 2685821657736338717ULL) >> 32);
+}
+
+static int RandomBelow(int bound) {
+	return bound > 0 ? (int)(RandomNext() % (uint32_t)bound) : 0;
+}
+
+static void SeedRandom(uint64_t seed) {
+	// Spread small seeds out; xorshift needs a nonzero state.
+	gRandomState = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+	if (!gRandomState)
+		gRandomState = 1;
+}
+
+static void TraceAppend(Trace* trace, const Op* op) {
+	if (trace->count == trace->capacity) {
+		trace->capacity = trace->capacity ? trace->capacity * 2 : 256;
+		trace->ops = (Op*)realloc(trace->ops, trace->capacity * sizeof(Op));
+		assert(trace->ops);
+	}
+	trace->ops[trace->count++] = *op;
+}
+
+static void TraceFree(Trace* trace) {
+	for (int i = 0; i < trace->count; ++i)
+		free(trace->ops[i].list);
+	free(trace->ops);
+	memset(trace, 0, sizeof(Trace));
+}
+
+static void WriteOp(FILE* file, const Op* op) {
+	fputs(kOps[op->type].name, file);
+	for (int i = 0; i < kOps[op->type].argumentCount; ++i)
+		fprintf(file, " %d", op->arguments[i]);
+	for (int i = 0; i < op->listCount; ++i)
+		fprintf(file, " %d", op->list[i]);
+	fputc('\n', file);
+}
+
+// Writes the first |count| operations of |trace|. Returns false if the file
+// can't be written.
+static bool WriteTrace(const char* path,
+                       const Trace* trace,
+                       int count,
+                       const char* comment) {
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+	fprintf(file, "# %s\n", comment);
+	for (int i = 0; i < count; ++i)
+		WriteOp(file, &trace->ops[i]);
+	return fclose(file) == 0;
+}
+
+// Parses one line of a trace into |op|. Returns false for comments and
+// blank lines, and exits for lines it doesn't understand.
+static bool ParseOp(char* line, int lineNumber, Op* op) {
+	char* token = strtok(line, " \t\r\n");
+	if (!token || token[0] == '#')
+		return false;
+	memset(op, 0, sizeof(Op));
+	int type = 0;
+	while (type < kOpCount && strcmp(kOps[type].name, token))
+		++type;
+	if (type == kOpCount) {
+		fprintf(stderr, "line %d: unknown operation '%s'\n", lineNumber, token);
+		exit(2);
+	}
+	op->type = (OpType)type;
+	int values[kMaxTabs * 4 + 4];
+	int valueCount = 0;
+	while ((token = strtok(NULL, " \t\r\n"))) {
+		if (valueCount == (int)(sizeof(values) / sizeof(values[0]))) {
+			fprintf(stderr, "line %d: too many arguments\n", lineNumber);
+			exit(2);
+		}
+		values[valueCount++] = atoi(token);
+	}
+	int argumentCount = kOps[type].argumentCount;
+	if (valueCount < argumentCount ||
+	    (!kOps[type].hasList && valueCount != argumentCount)) {
+		fprintf(stderr, "line %d: wrong number of arguments for %s\n",
+		        lineNumber, kOps[type].name);
+		exit(2);
+	}
+	memcpy(op->arguments, values, argumentCount * sizeof(int));
+	op->listCount = valueCount - argumentCount;
+	op->list = (int*)malloc((op->listCount ? op->listCount : 1) * sizeof(int));
+	assert(op->list);
+	memcpy(op->list, values + argumentCount, op->listCount * sizeof(int));
+	return true;
+}
+
+static bool Fail(char* error, size_t size, const char* format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(error, size, format, arguments);
+	va_end(arguments);
+	return false;
+}
+
+#define EXPECT_EQ(what, coreValue, refValue) \
+	do { \
+		long long c_ = (long long)(coreValue), r_ = (long long)(refValue); \
+		if (c_ != r_) { \
+			return Fail(error, size, "%s: core %lld, reference %lld", \
+			            what, c_, r_); \
+		} \
+	} while (0)
+
+static bool IsIndex(const Strips* strips, int index) {
+	return index >= 0 && index < strips->ref.count;
+}
+
+static CTTabHandle HandleAt(const Strips* strips, int index) {
+	return index == CTTabStripCoreNoTab ? CTNoTabHandle :
+	    strips->ref.tabs[index].handle;
+}
+
+// Compares the permutations the models asked for, and applies the core's.
+static bool ApplyPermutation(Strips* strips,
+                             int* corePermutation,
+                             int* refPermutation,
+                             char* error,
+                             size_t size) {
+	bool same = !memcmp(corePermutation, refPermutation,
+	                    strips->ref.count * sizeof(int));
+	if (same) {
+		CTTabStripCoreReorder(strips->core, corePermutation);
+		RefReorder(&strips->ref, corePermutation);
+	}
+	free(corePermutation);
+	free(refPermutation);
+	return same || Fail(error, size, "permutations differ");
+}
+
+// Like the model, which tells observers about a newly active tab.
+static void ActivationChanged(Strips* strips, int previousActive) {
+	int active = strips->ref.activeIndex;
+	if (active == previousActive || active == CTTabStripCoreNoTab)
+		return;
+	CTTabStripCoreTabWasActivated(strips->core, active);
+	RefTabWasActivated(&strips->ref, active);
+}
+
+// Applies |op| to both models, comparing what they return. Returns false,
+// with a message in |error|, if they disagree or |op| doesn't fit the
+// strip (which only hand-edited traces do).
+static bool Apply(Strips* strips, const Op* op, char* error, size_t size) {
+	CTTabStripCore* core = strips->core;
+	RefStrip* ref = &strips->ref;
+	const int* a = op->arguments;
+	switch (op->type) {
+		case kOpInsert: {
+			bool mini = (a[2] & (CTTabStripCorePinned | CTTabStripCoreApp)) != 0;
+			if (a[0] < 0 || a[0] > 2 || (a[3] != -1 && !IsIndex(strips, a[3])))
+				return Fail(error, size, "invalid insert");
+			int coreIndex = a[1], refIndex = a[1];
+			if (a[0] == 1) {
+				coreIndex = CTTabStripCoreInsertionIndexForLink(core);
+				refIndex = RefInsertionIndexForLink(ref);
+			} else if (a[0] == 2) {
+				coreIndex = CTTabStripCoreInsertionIndexForAppending(core);
+				refIndex = RefInsertionIndexForAppending(ref);
+			}
+			EXPECT_EQ("insertion index", coreIndex, refIndex);
+			coreIndex = CTTabStripCoreConstrainInsertionIndex(core, coreIndex, mini);
+			refIndex = RefConstrainInsertionIndex(ref, refIndex, mini);
+			EXPECT_EQ("constrained insertion index", coreIndex, refIndex);
+			CTTabHandle opener = a[3] == -1 ? CTNoTabHandle : HandleAt(strips, a[3]);
+			CTTabHandle tab = CTTabStripCoreInsert(core, coreIndex, (unsigned)a[2],
+			                                       opener);
+			if (tab == CTNoTabHandle || RefIndexOfTab(ref, tab) != CTTabStripCoreNoTab)
+				return Fail(error, size, "core handed out handle %u twice", tab);
+			RefInsert(ref, refIndex, (unsigned)a[2], tab, opener);
+			return true;
+		}
+		case kOpRemove: {
+			if (!IsIndex(strips, a[0]))
+				return Fail(error, size, "invalid remove");
+			bool wasActive = a[0] == ref->activeIndex;
+			int coreActive = CTTabStripCoreRemove(core, a[0]);
+			int refActive = RefRemove(ref, a[0]);
+			EXPECT_EQ("active index after remove", coreActive, refActive);
+			// Like the model, which tells observers about the new active tab.
+			if (wasActive && refActive != CTTabStripCoreNoTab) {
+				CTTabStripCoreTabWasActivated(core, coreActive);
+				RefTabWasActivated(ref, refActive);
+			}
+			return true;
+		}
+		case kOpRemoveMarked: {
+			int count = ref->count;
+			bool* marked = (bool*)calloc(count ? count : 1, sizeof(bool));
+			CTBitVector bits;
+			CTBitVectorInit(&bits);
+			CTBitVectorResize(&bits, count);
+			bool valid = true;
+			for (int i = 0; i < op->listCount; ++i) {
+				if (!IsIndex(strips, op->list[i])) {
+					valid = false;
+					break;
+				}
+				marked[op->list[i]] = true;
+				CTBitVectorSet(&bits, op->list[i], true);
+			}
+			bool activeCloses = ref->activeIndex != CTTabStripCoreNoTab &&
+			    marked[ref->activeIndex];
+			int coreActive = 0, refActive = 0;
+			if (valid) {
+				coreActive = CTTabStripCoreRemoveMarked(core, &bits);
+				refActive = RefRemoveMarked(ref, marked);
+			}
+			CTBitVectorFree(&bits);
+			free(marked);
+			if (!valid)
+				return Fail(error, size, "invalid remove-marked");
+			EXPECT_EQ("active index after remove-marked", coreActive, refActive);
+			if (activeCloses && refActive != CTTabStripCoreNoTab) {
+				CTTabStripCoreTabWasActivated(core, coreActive);
+				RefTabWasActivated(ref, refActive);
+			}
+			return true;
+		}
+		case kOpMove: {
+			if (!IsIndex(strips, a[0]) || !IsIndex(strips, a[1]))
+				return Fail(error, size, "invalid move");
+			bool canMove = CTTabStripCoreCanMove(core, a[0], a[1]);
+			EXPECT_EQ("can move", canMove, RefCanMove(ref, a[0], a[1]));
+			if (!canMove)
+				return true;
+			CTTabStripCoreMove(core, a[0], a[1], a[2] != 0);
+			RefMove(ref, a[0], a[1], a[2] != 0);
+			if (a[2]) {
+				CTTabStripCoreTabWasActivated(core, a[1]);
+				RefTabWasActivated(ref, a[1]);
+			}
+			return true;
+		}
+		case kOpReorder: {
+			int count = ref->count;
+			if (op->listCount != count)
+				return Fail(error, size, "invalid reorder");
+			bool* seen = (bool*)calloc(count ? count : 1, sizeof(bool));
+			bool valid = true;
+			int mini = RefMiniTabCount(ref);
+			for (int i = 0; i < count && valid; ++i) {
+				int from = op->list[i];
+				valid = IsIndex(strips, from) && !seen[from] &&
+				    (from < mini) == (i < mini);
+				if (valid)
+					seen[from] = true;
+			}
+			free(seen);
+			if (!valid)
+				return Fail(error, size, "invalid reorder");
+			CTTabStripCoreReorder(core, op->list);
+			RefReorder(ref, op->list);
+			return true;
+		}
+		case kOpPin: {
+			if (!IsIndex(strips, a[0]) || (ref->tabs[a[0]].app && !a[1]))
+				return Fail(error, size, "invalid pin");
+			int coreTo = CTTabStripCoreSetPinned(core, a[0], a[1] != 0);
+			int refTo = RefSetPinned(ref, a[0], a[1] != 0);
+			EXPECT_EQ("index after pinning", coreTo, refTo);
+			if (coreTo != a[0]) {
+				CTTabStripCoreMove(core, a[0], coreTo, false);
+				RefMove(ref, a[0], refTo, false);
+			}
+			return true;
+		}
+		case kOpBlock:
+			if (!IsIndex(strips, a[0]))
+				return Fail(error, size, "invalid block");
+			CTTabStripCoreSetBlocked(core, a[0], a[1] != 0);
+			ref->tabs[a[0]].blocked = a[1] != 0;
+			return true;
+		case kOpSelect:
+			if (!IsIndex(strips, a[0]))
+				return Fail(error, size, "invalid select");
+			CTTabStripCoreSetActiveIndex(core, a[0]);
+			CTTabStripCoreTabWasActivated(core, a[0]);
+			RefSetActiveIndex(ref, a[0]);
+			RefTabWasActivated(ref, a[0]);
+			return true;
+		case kOpSetActive:
+			if (a[0] != CTTabStripCoreNoTab && !IsIndex(strips, a[0]))
+				return Fail(error, size, "invalid set-active");
+			CTTabStripCoreSetActiveIndex(core, a[0]);
+			RefSetActiveIndex(ref, a[0]);
+			return true;
+		case kOpToggle: {
+			if (!IsIndex(strips, a[0]))
+				return Fail(error, size, "invalid toggle");
+			int previousActive = ref->activeIndex;
+			CTTabStripCoreToggleSelected(core, a[0]);
+			RefToggleSelected(ref, a[0]);
+			EXPECT_EQ("active index after toggle", CTTabStripCoreActiveIndex(core),
+			          ref->activeIndex);
+			ActivationChanged(strips, previousActive);
+			return true;
+		}
+		case kOpExtend: {
+			if (!IsIndex(strips, a[0]))
+				return Fail(error, size, "invalid extend");
+			int previousActive = ref->activeIndex;
+			CTTabStripCoreExtendSelection(core, a[0], a[1] != 0);
+			RefExtendSelection(ref, a[0], a[1] != 0);
+			ActivationChanged(strips, previousActive);
+			return true;
+		}
+		case kOpPinSelection: {
+			int count = ref->count;
+			int* corePermutation = (int*)malloc((count ? count : 1) * sizeof(int));
+			int* refPermutation = (int*)malloc((count ? count : 1) * sizeof(int));
+			assert(corePermutation && refPermutation);
+			int coreChanged = CTTabStripCoreSetSelectionPinned(core, a[0] != 0,
+			                                                   corePermutation);
+			int refChanged = RefSetSelectionPinned(ref, a[0] != 0, refPermutation);
+			if (coreChanged != refChanged) {
+				free(corePermutation);
+				free(refPermutation);
+			}
+			EXPECT_EQ("tabs pinned", coreChanged, refChanged);
+			return ApplyPermutation(strips, corePermutation, refPermutation,
+			                        error, size);
+		}
+		case kOpMoveSelection: {
+			int count = ref->count;
+			int* corePermutation = (int*)malloc((count ? count : 1) * sizeof(int));
+			int* refPermutation = (int*)malloc((count ? count : 1) * sizeof(int));
+			assert(corePermutation && refPermutation);
+			CTTabStripCorePermutationForMovingSelection(core, a[0], corePermutation);
+			RefPermutationForMovingSelection(ref, a[0], refPermutation);
+			return ApplyPermutation(strips, corePermutation, refPermutation,
+			                        error, size);
+		}
+		case kOpSetOpener: {
+			if (!IsIndex(strips, a[0]) || (a[1] != -1 && !IsIndex(strips, a[1])))
+				return Fail(error, size, "invalid set-opener");
+			CTTabHandle opener = a[1] == -1 ? CTNoTabHandle : HandleAt(strips, a[1]);
+			CTTabStripCoreSetOpener(core, HandleAt(strips, a[0]), opener);
+			RefSetOpener(ref, a[0], opener);
+			return true;
+		}
+		case kOpPolicy: {
+			CTTabStripCoreInsertionPolicy policy = a[0] ?
+			    CTTabStripCoreInsertBefore : CTTabStripCoreInsertAfter;
+			CTTabStripCoreSetInsertionPolicy(core, policy);
+			ref->insertionPolicy = policy;
+			return true;
+		}
+		case kOpCount:
+			break;
+	}
+	return Fail(error, size, "unknown operation");
+}
+
+// Compares everything the core exposes to the reference. |step| varies the
+// set of tabs the marked closing rule is asked about.
+static bool Check(Strips* strips, int step, char* error, size_t size) {
+	CTTabStripCore* core = strips->core;
+	RefStrip* ref = &strips->ref;
+	int count = ref->count;
+	EXPECT_EQ("count", CTTabStripCoreCount(core), count);
+	EXPECT_EQ("active index", CTTabStripCoreActiveIndex(core), ref->activeIndex);
+	EXPECT_EQ("mini-tab count", CTTabStripCoreMiniTabCount(core),
+	          RefMiniTabCount(ref));
+	EXPECT_EQ("insertion policy", CTTabStripCoreGetInsertionPolicy(core),
+	          ref->insertionPolicy);
+	EXPECT_EQ("anchor index", CTTabStripCoreAnchorIndex(core), ref->anchorIndex);
+	const CTRangeSet* selection = CTTabStripCoreSelection(core);
+	EXPECT_EQ("selected tab count", selection->size, RefSelectedCount(ref));
+	int rangeSize = 0;
+	for (int r = 0; r < selection->count; ++r) {
+		CTRange range = selection->ranges[r];
+		if (range.start >= range.end || range.start < 0 || range.end > count ||
+		    (r && selection->ranges[r - 1].end >= range.start)) {
+			return Fail(error, size, "selection range %d [%d, %d) is malformed", r,
+			            range.start, range.end);
+		}
+		rangeSize += range.end - range.start;
+	}
+	EXPECT_EQ("selection range sizes", rangeSize, selection->size);
+	if (ref->activeIndex != CTTabStripCoreNoTab && !ref->tabs[ref->activeIndex].selected)
+		return Fail(error, size, "active tab isn't selected");
+	const CTBitVector* pinned = CTTabStripCorePinnedTabs(core);
+	const CTBitVector* blocked = CTTabStripCoreBlockedTabs(core);
+	EXPECT_EQ("pinned bits", pinned->count, count);
+	EXPECT_EQ("blocked bits", blocked->count, count);
+	for (int i = 0; i < count; ++i) {
+		const RefTab* tab = &ref->tabs[i];
+		char what[64];
+		snprintf(what, sizeof(what), "tab at %d", i);
+		EXPECT_EQ(what, CTTabStripCoreTabAtIndex(core, i), tab->handle);
+		snprintf(what, sizeof(what), "index of tab %u", tab->handle);
+		EXPECT_EQ(what, CTTabStripCoreIndexOfTab(core, tab->handle), i);
+		snprintf(what, sizeof(what), "opener of tab at %d", i);
+		EXPECT_EQ(what, CTTabStripCoreOpenerOfTab(core, tab->handle), tab->opener);
+		// Against a tab |step| further along, wrapping around.
+		int other = (i + step) % count;
+		snprintf(what, sizeof(what), "tab at %d before tab at %d", i, other);
+		EXPECT_EQ(what, CTTabStripCoreIsBefore(core, tab->handle,
+		                                       ref->tabs[other].handle), i < other);
+		int openedCount = CTTabStripCoreOpenedTabCount(core, tab->handle);
+		snprintf(what, sizeof(what), "tabs opened by tab at %d", i);
+		EXPECT_EQ(what, openedCount, RefOpenedTabCount(ref, tab->handle));
+		for (int j = 0; j < openedCount; ++j) {
+			snprintf(what, sizeof(what), "tab %d opened by tab at %d", j, i);
+			EXPECT_EQ(what, CTTabStripCoreOpenedTab(core, tab->handle, j),
+			          RefOpenedTab(ref, tab->handle, j));
+		}
+		// From anywhere in the strip, and from just outside it.
+		int from = (i + step) % (count + 2) - 1;
+		snprintf(what, sizeof(what), "next tab opened by tab at %d after %d", i,
+		         from);
+		EXPECT_EQ(what, CTTabStripCoreIndexOfNextTabOpenedBy(core, tab->handle, from),
+		          RefIndexOfNextTabOpenedBy(ref, tab->handle, from));
+		snprintf(what, sizeof(what), "pinned at %d", i);
+		EXPECT_EQ(what, CTTabStripCoreIsPinned(core, i), tab->pinned);
+		EXPECT_EQ(what, CTBitVectorGet(pinned, i), tab->pinned);
+		snprintf(what, sizeof(what), "blocked at %d", i);
+		EXPECT_EQ(what, CTTabStripCoreIsBlocked(core, i), tab->blocked);
+		EXPECT_EQ(what, CTBitVectorGet(blocked, i), tab->blocked);
+		snprintf(what, sizeof(what), "app at %d", i);
+		EXPECT_EQ(what, CTTabStripCoreIsApp(core, i), tab->app);
+		snprintf(what, sizeof(what), "selected at %d", i);
+		EXPECT_EQ(what, CTTabStripCoreIsSelected(core, i), tab->selected);
+		snprintf(what, sizeof(what), "mini at %d", i);
+		EXPECT_EQ(what, CTTabStripCoreIsMini(core, i), RefIsMini(ref, i));
+		if (RefIsMini(ref, i) != (i < RefMiniTabCount(ref)))
+			return Fail(error, size, "mini-tab at %d out of place", i);
+	}
+
+	EXPECT_EQ("insertion index for link", CTTabStripCoreInsertionIndexForLink(core),
+	          RefInsertionIndexForLink(ref));
+	EXPECT_EQ("insertion index for appending",
+	          CTTabStripCoreInsertionIndexForAppending(core),
+	          RefInsertionIndexForAppending(ref));
+	EXPECT_EQ("previously active tab", CTTabStripCoreIndexOfPreviouslyActiveTab(core),
+	          RefIndexOfPreviouslyActiveTab(ref));
+	int active = ref->activeIndex;
+	if (active == CTTabStripCoreNoTab)
+		return true;
+	EXPECT_EQ("index to activate after closing the active tab",
+	          CTTabStripCoreIndexToActivateAfterClosing(core, active),
+	          RefIndexToActivateAfterClosing(ref, active));
+
+	// The active tab and every third tab, or all tabs now and then.
+	bool* marked = (bool*)calloc(count, sizeof(bool));
+	CTBitVector bits;
+	CTBitVectorInit(&bits);
+	CTBitVectorResize(&bits, count);
+	for (int i = 0; i < count; ++i) {
+		marked[i] = i == active || step % 7 == 0 || i % 3 == step % 3;
+		CTBitVectorSet(&bits, i, marked[i]);
+	}
+	int coreIndex = CTTabStripCoreIndexToActivateAfterClosingMarked(core, &bits);
+	int refIndex = RefIndexToActivateAfterClosingMarked(ref, marked);
+	CTBitVectorFree(&bits);
+	free(marked);
+	EXPECT_EQ("index to activate after closing marked tabs", coreIndex, refIndex);
+	return true;
+}
+
+// A random operation that fits the strip as it is.
+static void Generate(const Strips* strips, Op* op) {
+	const RefStrip* ref = &strips->ref;
+	int count = ref->count;
+	memset(op, 0, sizeof(Op));
+	int* a = op->arguments;
+	// Grow the strip while it is small, and keep it from growing past
+	// |kMaxTabs|.
+	int insertWeight = count < 4 ? 60 : (count >= kMaxTabs ? 0 : 14);
+	int roll = RandomBelow(insertWeight + 104);
+	if (!count || roll < insertWeight) {
+		op->type = kOpInsert;
+		a[0] = RandomBelow(3);
+		a[1] = RandomBelow(count + 2);
+		a[2] = (RandomBelow(8) == 0 ? CTTabStripCorePinned : 0) |
+		    (RandomBelow(8) == 0 ? CTTabStripCoreBlocked : 0) |
+		    (RandomBelow(16) == 0 ? CTTabStripCoreApp : 0);
+		if (!count || RandomBelow(3) == 0)
+			a[3] = -1;
+		else if (a[0] == 1 && ref->activeIndex != CTTabStripCoreNoTab)
+			a[3] = ref->activeIndex;
+		else
+			a[3] = RandomBelow(count);
+		return;
+	}
+	roll -= insertWeight;
+	if ((roll -= 8) < 0) {
+		op->type = kOpRemove;
+		a[0] = RandomBelow(count);
+	} else if ((roll -= 8) < 0) {
+		op->type = kOpRemove;
+		a[0] = ref->activeIndex != CTTabStripCoreNoTab ? ref->activeIndex :
+		    RandomBelow(count);
+	} else if ((roll -= 4) < 0) {
+		op->type = kOpRemoveMarked;
+		op->list = (int*)malloc(count * sizeof(int));
+		assert(op->list);
+		// Mostly with the active tab, which is how the model closes tabs,
+		// but not always: closing around a selection keeps it.
+		int odds = 2 + RandomBelow(6);
+		bool withActive = RandomBelow(4) != 0;
+		for (int i = 0; i < count; ++i) {
+			if (RandomBelow(odds) == 0 || (withActive && i == ref->activeIndex))
+				op->list[op->listCount++] = i;
+		}
+	} else if ((roll -= 14) < 0) {
+		op->type = kOpMove;
+		a[0] = RandomBelow(count);
+		a[1] = RandomBelow(count);
+		a[2] = RandomBelow(4) == 0;
+	} else if ((roll -= 2) < 0) {
+		// Shuffles the mini-tabs and the others among themselves.
+		op->type = kOpReorder;
+		op->list = (int*)malloc(count * sizeof(int));
+		assert(op->list);
+		op->listCount = count;
+		int mini = RefMiniTabCount(ref);
+		for (int i = 0; i < count; ++i)
+			op->list[i] = i;
+		for (int i = count - 1; i > 0; --i) {
+			int first = i < mini ? 0 : mini;
+			int j = first + RandomBelow(i - first + 1);
+			int swap = op->list[i];
+			op->list[i] = op->list[j];
+			op->list[j] = swap;
+		}
+	} else if ((roll -= 10) < 0) {
+		op->type = kOpPin;
+		a[0] = RandomBelow(count);
+		a[1] = ref->tabs[a[0]].app || !ref->tabs[a[0]].pinned;
+	} else if ((roll -= 4) < 0) {
+		op->type = kOpBlock;
+		a[0] = RandomBelow(count);
+		a[1] = !ref->tabs[a[0]].blocked;
+	} else if ((roll -= 16) < 0) {
+		op->type = kOpSelect;
+		int previous = RefIndexOfPreviouslyActiveTab(ref);
+		a[0] = previous != CTTabStripCoreNoTab && RandomBelow(3) == 0 ? previous :
+		    RandomBelow(count);
+	} else if ((roll -= 3) < 0) {
+		op->type = kOpSetActive;
+		a[0] = RandomBelow(count + 1) - 1;
+	} else if ((roll -= 6) < 0) {
+		op->type = kOpToggle;
+		a[0] = RandomBelow(count);
+	} else if ((roll -= 6) < 0) {
+		op->type = kOpExtend;
+		a[0] = RandomBelow(count);
+		a[1] = RandomBelow(3) == 0;
+	} else if ((roll -= 3) < 0) {
+		op->type = kOpPinSelection;
+		a[0] = RandomBelow(2);
+	} else if ((roll -= 3) < 0) {
+		op->type = kOpMoveSelection;
+		a[0] = RandomBelow(count + 2) - 1;
+	} else if ((roll -= 8) < 0) {
+		op->type = kOpSetOpener;
+		a[0] = RandomBelow(count);
+		a[1] = RandomBelow(4) == 0 ? -1 : RandomBelow(count);
+	} else {
+		op->type = kOpPolicy;
+		a[0] = RandomBelow(2);
+	}
+}
+
+static void StripsInit(Strips* strips) {
+	strips->core = CTTabStripCoreCreate();
+	RefInit(&strips->ref);
+}
+
+static void StripsFree(Strips* strips) {
+	CTTabStripCoreFree(strips->core);
+	RefFree(&strips->ref);
+}
+
+// Prints both strips, one tab per line, for a failure report.
+static void DumpStrips(Strips* strips) {
+	CTTabStripCore* core = strips->core;
+	RefStrip* ref = &strips->ref;
+	int count = CTTabStripCoreCount(core);
+	if (ref->count > count)
+		count = ref->count;
+	fprintf(stderr, "        core (active %d, anchor %d)    "
+	        "reference (active %d, anchor %d)\n",
+	        CTTabStripCoreActiveIndex(core), CTTabStripCoreAnchorIndex(core),
+	        ref->activeIndex, ref->anchorIndex);
+	for (int i = 0; i < count; ++i) {
+		fprintf(stderr, "  %3d", i);
+		if (i < CTTabStripCoreCount(core)) {
+			CTTabHandle tab = CTTabStripCoreTabAtIndex(core, i);
+			fprintf(stderr, "  tab %4u opener %4u %c%c%c%c", tab,
+			        CTTabStripCoreOpenerOfTab(core, tab),
+			        CTTabStripCoreIsPinned(core, i) ? 'P' : '-',
+			        CTTabStripCoreIsBlocked(core, i) ? 'B' : '-',
+			        CTTabStripCoreIsApp(core, i) ? 'A' : '-',
+			        CTTabStripCoreIsSelected(core, i) ? 'S' : '-');
+		} else {
+			fprintf(stderr, "  %25s", "");
+		}
+		if (i < ref->count) {
+			const RefTab* tab = &ref->tabs[i];
+			fprintf(stderr, "  tab %4u opener %4u %c%c%c%c", tab->handle, tab->opener,
+			        tab->pinned ? 'P' : '-', tab->blocked ? 'B' : '-',
+			        tab->app ? 'A' : '-', tab->selected ? 'S' : '-');
+		}
+		fputc('\n', stderr);
+	}
+}
+
+// Runs |steps| random operations from |seed|. Returns false, having written
+// the trace, if the models disagree.
+static bool RunSeed(uint64_t seed, int steps) {
+	SeedRandom(seed);
+	Strips strips;
+	StripsInit(&strips);
+	Trace trace = { NULL, 0, 0 };
+	char error[256];
+	bool ok = true;
+	for (int step = 0; step < steps; ++step) {
+		Op op;
+		Generate(&strips, &op);
+		TraceAppend(&trace, &op);
+		if (Apply(&strips, &op, error, sizeof(error)) &&
+		    Check(&strips, step, error, sizeof(error)))
+			continue;
+		char path[64], comment[384];
+		snprintf(path, sizeof(path), "fuzz-%llu.trace", (unsigned long long)seed);
+		snprintf(comment, sizeof(comment), "seed %llu, step %d: %s",
+		         (unsigned long long)seed, step, error);
+		fprintf(stderr, "%s\n  after ", comment);
+		WriteOp(stderr, &op);
+		DumpStrips(&strips);
+		if (WriteTrace(path, &trace, trace.count, comment))
+			fprintf(stderr, "  replay with: fuzzer --replay %s\n", path);
+		else
+			fprintf(stderr, "  could not write %s\n", path);
+		ok = false;
+		break;
+	}
+	TraceFree(&trace);
+	StripsFree(&strips);
+	return ok;
+}
+
+static int Replay(const char* path) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "can't open %s\n", path);
+		return 2;
+	}
+	Strips strips;
+	StripsInit(&strips);
+	char line[4096], error[256];
+	int step = 0, lineNumber = 0, result = 0;
+	while (fgets(line, sizeof(line), file)) {
+		Op op;
+		if (!ParseOp(line, ++lineNumber, &op))
+			continue;
+		bool ok = Apply(&strips, &op, error, sizeof(error)) &&
+		    Check(&strips, step, error, sizeof(error));
+		if (!ok) {
+			fprintf(stderr, "step %d (line %d): %s\n  after ", step, lineNumber,
+			        error);
+			WriteOp(stderr, &op);
+			DumpStrips(&strips);
+			result = 1;
+		}
+		free(op.list);
+		if (!ok)
+			break;
+		++step;
+	}
+	fclose(file);
+	StripsFree(&strips);
+	if (!result)
+		printf("%s: %d steps, no differences\n", path, step);
+	return result;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && !strcmp(argv[1], "--replay"))
+		return Replay(argv[2]);
+	uint64_t firstSeed = argc > 1 ? strtoull(argv[1], NULL, 0) : 1;
+	int seedCount = argc > 2 ? atoi(argv[2]) : 1000;
+	int steps = argc > 3 ? atoi(argv[3]) : 1000;
+	if (argc > 4 || seedCount <= 0 || steps <= 0) {
+		fprintf(stderr, "usage: %s [first seed] [seed count] [steps]\n"
+		        "       %s --replay <trace>\n", argv[0], argv[0]);
+		return 2;
+	}
+	int failures = 0;
+	for (int i = 0; i < seedCount; ++i)
+		failures += !RunSeed(firstSeed + i, steps);
+	printf("%d seeds of %d steps from seed %llu: %d failed\n", seedCount, steps,
+	       (unsigned long long)firstSeed, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,453 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#include "reference.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void RefInit(RefStrip* strip) {
+	memset(strip, 0, sizeof(RefStrip));
+	strip->activeIndex = CTTabStripCoreNoTab;
+	strip->anchorIndex = CTTabStripCoreNoTab;
+	strip->insertionPolicy = CTTabStripCoreInsertAfter;
+}
+
+void RefFree(RefStrip* strip) {
+	free(strip->tabs);
+	memset(strip, 0, sizeof(RefStrip));
+}
+
+int RefIndexOfTab(const RefStrip* strip, CTTabHandle tab) {
+	for (int i = 0; i < strip->count; ++i) {
+		if (strip->tabs[i].handle == tab)
+			return i;
+	}
+	return CTTabStripCoreNoTab;
+}
+
+// Makes the tab at |index| the only selected one and the anchor, or selects
+// nothing for CTTabStripCoreNoTab.
+static void RefSelectOnly(RefStrip* strip, int index) {
+	for (int i = 0; i < strip->count; ++i)
+		strip->tabs[i].selected = i == index;
+	strip->anchorIndex = index;
+}
+
+static CTTabHandle RefAnchorTab(const RefStrip* strip) {
+	return strip->anchorIndex == CTTabStripCoreNoTab ? CTNoTabHandle :
+	    strip->tabs[strip->anchorIndex].handle;
+}
+
+// Finds the anchor tab again after the tabs moved, falling back to the
+// active tab if it was removed.
+static void RefFindAnchor(RefStrip* strip, CTTabHandle anchor) {
+	int index = anchor ? RefIndexOfTab(strip, anchor) : CTTabStripCoreNoTab;
+	strip->anchorIndex = index != CTTabStripCoreNoTab || !anchor ? index :
+	    strip->activeIndex;
+}
+
+bool RefIsMini(const RefStrip* strip, int index) {
+	return strip->tabs[index].pinned || strip->tabs[index].app;
+}
+
+int RefMiniTabCount(const RefStrip* strip) {
+	int count = 0;
+	for (int i = 0; i < strip->count; ++i)
+		count += RefIsMini(strip, i);
+	return count;
+}
+
+int RefConstrainInsertionIndex(const RefStrip* strip, int index, bool miniTab) {
+	int mini = RefMiniTabCount(strip);
+	if (miniTab) {
+		if (index < 0)
+			index = 0;
+		return index > mini ? mini : index;
+	}
+	if (index < mini)
+		index = mini;
+	return index > strip->count ? strip->count : index;
+}
+
+int RefInsertionIndexForLink(const RefStrip* strip) {
+	if (!strip->count)
+		return 0;
+	if (strip->activeIndex == CTTabStripCoreNoTab)
+		return RefInsertionIndexForAppending(strip);
+	if (strip->insertionPolicy == CTTabStripCoreInsertAfter)
+		return strip->activeIndex + 1;
+	return strip->activeIndex;
+}
+
+int RefInsertionIndexForAppending(const RefStrip* strip) {
+	return strip->insertionPolicy == CTTabStripCoreInsertAfter ? strip->count : 0;
+}
+
+void RefInsert(RefStrip* strip, int index, unsigned flags, CTTabHandle handle,
+               CTTabHandle opener) {
+	assert(index >= 0 && index <= strip->count);
+	if (strip->count == strip->capacity) {
+		strip->capacity = strip->capacity ? strip->capacity * 2 : 16;
+		strip->tabs = (RefTab*)realloc(strip->tabs, strip->capacity * sizeof(RefTab));
+		assert(strip->tabs);
+	}
+	memmove(&strip->tabs[index + 1], &strip->tabs[index],
+	        (strip->count - index) * sizeof(RefTab));
+	strip->count++;
+	RefTab* tab = &strip->tabs[index];
+	memset(tab, 0, sizeof(RefTab));
+	tab->handle = handle;
+	tab->opener = opener == handle ? CTNoTabHandle : opener;
+	tab->app = (flags & CTTabStripCoreApp) != 0;
+	tab->pinned = tab->app || (flags & CTTabStripCorePinned);
+	tab->blocked = (flags & CTTabStripCoreBlocked) != 0;
+	if (strip->activeIndex != CTTabStripCoreNoTab && index <= strip->activeIndex)
+		strip->activeIndex++;
+	if (strip->anchorIndex != CTTabStripCoreNoTab && index <= strip->anchorIndex)
+		strip->anchorIndex++;
+}
+
+// Removes the tab at |index| and forgets it as an opener, without touching
+// the active index.
+static void RefRemoveTab(RefStrip* strip, int index) {
+	CTTabHandle handle = strip->tabs[index].handle;
+	memmove(&strip->tabs[index], &strip->tabs[index + 1],
+	        (strip->count - index - 1) * sizeof(RefTab));
+	strip->count--;
+	for (int i = 0; i < strip->count; ++i) {
+		if (strip->tabs[i].opener == handle)
+			strip->tabs[i].opener = CTNoTabHandle;
+	}
+}
+
+int RefRemove(RefStrip* strip, int index) {
+	assert(index >= 0 && index < strip->count);
+	bool wasActive = index == strip->activeIndex;
+	int next = wasActive ? RefIndexToActivateAfterClosing(strip, index) :
+	    strip->activeIndex;
+	CTTabHandle anchor = RefAnchorTab(strip);
+	RefRemoveTab(strip, index);
+	if (!strip->count)
+		strip->activeIndex = CTTabStripCoreNoTab;
+	else if (wasActive)
+		strip->activeIndex = next;
+	else if (strip->activeIndex != CTTabStripCoreNoTab && index < strip->activeIndex)
+		strip->activeIndex--;
+	if (wasActive || !strip->count)
+		RefSelectOnly(strip, strip->activeIndex);
+	else
+		RefFindAnchor(strip, anchor);
+	return strip->activeIndex;
+}
+
+int RefRemoveMarked(RefStrip* strip, const bool* marked) {
+	int active = strip->activeIndex;
+	int next = active;
+	if (active != CTTabStripCoreNoTab && marked[active])
+		next = RefIndexToActivateAfterClosingMarked(strip, marked);
+	CTTabHandle anchor = RefAnchorTab(strip);
+	// Back to front, so that the indices in |marked| stay valid.
+	int removedBeforeNext = 0;
+	for (int i = strip->count - 1; i >= 0; --i) {
+		if (!marked[i])
+			continue;
+		if (next != CTTabStripCoreNoTab && i < next)
+			removedBeforeNext++;
+		RefRemoveTab(strip, i);
+	}
+	if (!strip->count || next == CTTabStripCoreNoTab)
+		strip->activeIndex = CTTabStripCoreNoTab;
+	else
+		strip->activeIndex = next - removedBeforeNext;
+	if (next != active || !strip->count)
+		RefSelectOnly(strip, strip->activeIndex);
+	else
+		RefFindAnchor(strip, anchor);
+	return strip->activeIndex;
+}
+
+bool RefCanMove(const RefStrip* strip, int from, int to) {
+	return RefIsMini(strip, from) == RefIsMini(strip, to);
+}
+
+void RefMove(RefStrip* strip, int from, int to, bool selectAfterMove) {
+	RefTab tab = strip->tabs[from];
+	int active = strip->activeIndex;
+	CTTabHandle activeTab = active != CTTabStripCoreNoTab ?
+	    strip->tabs[active].handle : CTNoTabHandle;
+	CTTabHandle anchor = RefAnchorTab(strip);
+	if (from < to) {
+		memmove(&strip->tabs[from], &strip->tabs[from + 1],
+		        (to - from) * sizeof(RefTab));
+	} else {
+		memmove(&strip->tabs[to + 1], &strip->tabs[to],
+		        (from - to) * sizeof(RefTab));
+	}
+	strip->tabs[to] = tab;
+	if (selectAfterMove) {
+		strip->activeIndex = to;
+		RefSelectOnly(strip, to);
+		return;
+	}
+	if (activeTab)
+		strip->activeIndex = RefIndexOfTab(strip, activeTab);
+	RefFindAnchor(strip, anchor);
+}
+
+void RefReorder(RefStrip* strip, const int* permutation) {
+	RefTab* tabs = (RefTab*)malloc((strip->count ? strip->count : 1) * sizeof(RefTab));
+	assert(tabs);
+	int active = CTTabStripCoreNoTab;
+	CTTabHandle anchor = RefAnchorTab(strip);
+	for (int i = 0; i < strip->count; ++i) {
+		tabs[i] = strip->tabs[permutation[i]];
+		if (permutation[i] == strip->activeIndex)
+			active = i;
+	}
+	memcpy(strip->tabs, tabs, strip->count * sizeof(RefTab));
+	free(tabs);
+	strip->activeIndex = active;
+	RefFindAnchor(strip, anchor);
+}
+
+int RefSetPinned(RefStrip* strip, int index, bool pinned) {
+	RefTab* tab = &strip->tabs[index];
+	if (tab->pinned == pinned || tab->app)
+		return index;
+	// A tab that becomes a mini-tab goes right after the others, and one
+	// that stops being one right in front of the others.
+	int others = RefMiniTabCount(strip);
+	tab->pinned = pinned;
+	return pinned ? others : others - 1;
+}
+
+void RefSetOpener(RefStrip* strip, int index, CTTabHandle opener) {
+	RefTab* tab = &strip->tabs[index];
+	tab->opener = opener == tab->handle ? CTNoTabHandle : opener;
+}
+
+void RefTabWasActivated(RefStrip* strip, int index) {
+	strip->tabs[index].activation = ++strip->clock;
+}
+
+// The most recently activated tab other than the one at |except| that isn't
+// marked, or CTTabStripCoreNoTab.
+static int RefMostRecentlyActiveExcept(const RefStrip* strip,
+                                       int except,
+                                       const bool* marked) {
+	int best = CTTabStripCoreNoTab;
+	uint64_t bestActivation = 0;
+	for (int i = 0; i < strip->count; ++i) {
+		if (i == except || (marked && marked[i]))
+			continue;
+		if (strip->tabs[i].activation > bestActivation) {
+			best = i;
+			bestActivation = strip->tabs[i].activation;
+		}
+	}
+	return best;
+}
+
+// The first unmarked tab after |index| opened by |opener|, else the last
+// one before it.
+static int RefNearestOpenedBy(const RefStrip* strip,
+                              CTTabHandle opener,
+                              int index,
+                              const bool* marked) {
+	if (!opener)
+		return CTTabStripCoreNoTab;
+	for (int i = index + 1; i < strip->count; ++i) {
+		if (strip->tabs[i].opener == opener && !(marked && marked[i]))
+			return i;
+	}
+	for (int i = index - 1; i >= 0; --i) {
+		if (strip->tabs[i].opener == opener && !(marked && marked[i]))
+			return i;
+	}
+	return CTTabStripCoreNoTab;
+}
+
+int RefOpenedTabCount(const RefStrip* strip, CTTabHandle opener) {
+	int count = 0;
+	for (int i = 0; i < strip->count; ++i)
+		count += strip->tabs[i].opener == opener;
+	return count;
+}
+
+CTTabHandle RefOpenedTab(const RefStrip* strip, CTTabHandle opener, int position) {
+	for (int i = 0; i < strip->count; ++i) {
+		if (strip->tabs[i].opener == opener && !position--)
+			return strip->tabs[i].handle;
+	}
+	return CTNoTabHandle;
+}
+
+int RefIndexOfNextTabOpenedBy(const RefStrip* strip, CTTabHandle opener, int index) {
+	if (index < -1)
+		index = -1;
+	if (index > strip->count)
+		index = strip->count;
+	return RefNearestOpenedBy(strip, opener, index, NULL);
+}
+
+int RefIndexToActivateAfterClosing(const RefStrip* strip, int removedIndex) {
+	const RefTab* removed = &strip->tabs[removedIndex];
+	int index = RefMostRecentlyActiveExcept(strip, removedIndex, NULL);
+	if (index == CTTabStripCoreNoTab)
+		index = RefNearestOpenedBy(strip, removed->handle, removedIndex, NULL);
+	if (index == CTTabStripCoreNoTab && removed->opener) {
+		index = RefNearestOpenedBy(strip, removed->opener, removedIndex, NULL);
+		if (index == CTTabStripCoreNoTab)
+			index = RefIndexOfTab(strip, removed->opener);
+	}
+	if (index != CTTabStripCoreNoTab)
+		return index > removedIndex ? index - 1 : index;
+	if (strip->activeIndex >= strip->count - 1)
+		return strip->activeIndex - 1;
+	return strip->activeIndex;
+}
+
+int RefIndexToActivateAfterClosingMarked(const RefStrip* strip,
+                                         const bool* marked) {
+	int active = strip->activeIndex;
+	const RefTab* tab = &strip->tabs[active];
+	int index = RefMostRecentlyActiveExcept(strip, active, marked);
+	if (index != CTTabStripCoreNoTab)
+		return index;
+	index = RefNearestOpenedBy(strip, tab->handle, active, marked);
+	if (index != CTTabStripCoreNoTab)
+		return index;
+	if (tab->opener) {
+		index = RefNearestOpenedBy(strip, tab->opener, active, marked);
+		if (index != CTTabStripCoreNoTab)
+			return index;
+		index = RefIndexOfTab(strip, tab->opener);
+		if (!marked[index])
+			return index;
+	}
+	for (int i = active + 1; i < strip->count; ++i) {
+		if (!marked[i])
+			return i;
+	}
+	for (int i = active - 1; i >= 0; --i) {
+		if (!marked[i])
+			return i;
+	}
+	return CTTabStripCoreNoTab;
+}
+
+int RefIndexOfPreviouslyActiveTab(const RefStrip* strip) {
+	return RefMostRecentlyActiveExcept(strip, strip->activeIndex, NULL);
+}
+
+void RefSetActiveIndex(RefStrip* strip, int index) {
+	strip->activeIndex = index;
+	RefSelectOnly(strip, index);
+}
+
+int RefSelectedCount(const RefStrip* strip) {
+	int count = 0;
+	for (int i = 0; i < strip->count; ++i)
+		count += strip->tabs[i].selected;
+	return count;
+}
+
+void RefToggleSelected(RefStrip* strip, int index) {
+	RefTab* tab = &strip->tabs[index];
+	if (!tab->selected) {
+		tab->selected = true;
+		strip->activeIndex = index;
+		strip->anchorIndex = index;
+		return;
+	}
+	if (RefSelectedCount(strip) == 1)
+		return;
+	tab->selected = false;
+	if (index != strip->activeIndex)
+		return;
+	int next = CTTabStripCoreNoTab;
+	for (int i = index + 1; i < strip->count && next == CTTabStripCoreNoTab; ++i) {
+		if (strip->tabs[i].selected)
+			next = i;
+	}
+	for (int i = index - 1; i >= 0 && next == CTTabStripCoreNoTab; --i) {
+		if (strip->tabs[i].selected)
+			next = i;
+	}
+	strip->activeIndex = next;
+	strip->anchorIndex = next;
+}
+
+void RefExtendSelection(RefStrip* strip, int index, bool add) {
+	if (strip->anchorIndex == CTTabStripCoreNoTab)
+		strip->anchorIndex = index;
+	int anchor = strip->anchorIndex;
+	for (int i = 0; i < strip->count; ++i) {
+		bool inRange = (i >= anchor && i <= index) || (i >= index && i <= anchor);
+		strip->tabs[i].selected = inRange || (add && strip->tabs[i].selected);
+	}
+	strip->activeIndex = index;
+}
+
+// Fills |permutation| with |order|, mini-tabs first.
+static void RefPartitionMiniTabs(const RefStrip* strip,
+                                 const int* order,
+                                 int* permutation) {
+	int next = 0;
+	for (int mini = 1; mini >= 0; --mini) {
+		for (int i = 0; i < strip->count; ++i) {
+			if (RefIsMini(strip, order[i]) == (bool)mini)
+				permutation[next++] = order[i];
+		}
+	}
+}
+
+int RefSetSelectionPinned(RefStrip* strip, bool pinned, int* permutation) {
+	int changed = 0;
+	int* order = (int*)malloc((strip->count ? strip->count : 1) * sizeof(int));
+	assert(order);
+	for (int i = 0; i < strip->count; ++i) {
+		RefTab* tab = &strip->tabs[i];
+		if (tab->selected && !tab->app && tab->pinned != pinned) {
+			tab->pinned = pinned;
+			changed++;
+		}
+		order[i] = i;
+	}
+	RefPartitionMiniTabs(strip, order, permutation);
+	free(order);
+	return changed;
+}
+
+void RefPermutationForMovingSelection(const RefStrip* strip,
+                                      int index,
+                                      int* permutation) {
+	int* order = (int*)malloc((strip->count ? strip->count : 1) * sizeof(int));
+	assert(order);
+	int unselectedCount = strip->count - RefSelectedCount(strip);
+	if (index < 0)
+		index = 0;
+	if (index > unselectedCount)
+		index = unselectedCount;
+	// The unselected tabs, with all the selected ones in front of the
+	// |index|th of them, or at the end.
+	int count = 0;
+	int unselected = 0;
+	for (int i = 0; i <= strip->count; ++i) {
+		if (i < strip->count && strip->tabs[i].selected)
+			continue;
+		if (unselected++ == index) {
+			for (int j = 0; j < strip->count; ++j) {
+				if (strip->tabs[j].selected)
+					order[count++] = j;
+			}
+		}
+		if (i < strip->count)
+			order[count++] = i;
+	}
+	assert(count == strip->count);
+	RefPartitionMiniTabs(strip, order, permutation);
+	free(order);
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2010 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE-chromium file.
+
+#ifndef REFERENCE_H_
+#define REFERENCE_H_
+
+#include "CTTabStripCore.h"
+
+// The tab strip semantics of CTTabStripCore written the obvious way: an
+// array of tabs, flags stored per tab, the activation history as a counter
+// per tab, and every rule a linear scan. Slow, but simple enough to be
+// checked by reading it, which is what the fuzzer compares the core to.
+//
+// Tabs carry the handle the core gave them, so that openers can be
+// compared. Indices and CTTabStripCoreNoTab mean the same as in the core.
+typedef struct {
+	CTTabHandle handle;
+	CTTabHandle opener;
+	bool pinned;
+	bool blocked;
+	bool app;
+	bool selected;
+	// When the tab was last activated, or 0.
+	uint64_t activation;
+} RefTab;
+
+typedef struct {
+	RefTab* tabs;
+	int count;
+	int capacity;
+	int activeIndex;
+	int anchorIndex;
+	uint64_t clock;
+	CTTabStripCoreInsertionPolicy insertionPolicy;
+} RefStrip;
+
+void RefInit(RefStrip* strip);
+void RefFree(RefStrip* strip);
+
+int RefIndexOfTab(const RefStrip* strip, CTTabHandle tab);
+bool RefIsMini(const RefStrip* strip, int index);
+int RefMiniTabCount(const RefStrip* strip);
+
+int RefConstrainInsertionIndex(const RefStrip* strip, int index, bool miniTab);
+int RefInsertionIndexForLink(const RefStrip* strip);
+int RefInsertionIndexForAppending(const RefStrip* strip);
+
+void RefInsert(RefStrip* strip, int index, unsigned flags, CTTabHandle handle,
+               CTTabHandle opener);
+int RefRemove(RefStrip* strip, int index);
+int RefRemoveMarked(RefStrip* strip, const bool* marked);
+bool RefCanMove(const RefStrip* strip, int from, int to);
+void RefMove(RefStrip* strip, int from, int to, bool selectAfterMove);
+void RefReorder(RefStrip* strip, const int* permutation);
+int RefSetPinned(RefStrip* strip, int index, bool pinned);
+void RefSetOpener(RefStrip* strip, int index, CTTabHandle opener);
+void RefTabWasActivated(RefStrip* strip, int index);
+
+int RefOpenedTabCount(const RefStrip* strip, CTTabHandle opener);
+CTTabHandle RefOpenedTab(const RefStrip* strip, CTTabHandle opener, int position);
+int RefIndexOfNextTabOpenedBy(const RefStrip* strip, CTTabHandle opener, int index);
+
+void RefSetActiveIndex(RefStrip* strip, int index);
+int RefSelectedCount(const RefStrip* strip);
+void RefToggleSelected(RefStrip* strip, int index);
+void RefExtendSelection(RefStrip* strip, int index, bool add);
+int RefSetSelectionPinned(RefStrip* strip, bool pinned, int* permutation);
+void RefPermutationForMovingSelection(const RefStrip* strip,
+                                      int index,
+                                      int* permutation);
+
+int RefIndexToActivateAfterClosing(const RefStrip* strip, int removedIndex);
+int RefIndexToActivateAfterClosingMarked(const RefStrip* strip,
+                                         const bool* marked);
+int RefIndexOfPreviouslyActiveTab(const RefStrip* strip);
+
+#endif  // REFERENCE_H_